@@ -0,0 +1,77 @@
+#ifndef OBSBOT_AI_STATUS_POLLER_HPP
+#define OBSBOT_AI_STATUS_POLLER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "dev.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Polls aiGetAiStatusR in NonBlock mode with up to depth requests in flight, so the sample rate is set by the
+ *         poll period and not by the round trip of the device. Responses are matched to their request for latency,
+ *         a response older than one already applied is dropped, and the change callback only fires when a field
+ *         differs from the last applied status. Requests without a response are given up after timeout.
+ */
+class AiStatusPoller
+{
+public:
+    struct Options
+    {
+        size_t depth = 2;                       /// requests in flight
+        int64_t timeout_ns = 500000000;
+    };
+
+    struct Stats
+    {
+        uint64_t requests = 0;
+        uint64_t responses = 0;
+        uint64_t changes = 0;
+        uint64_t timeouts = 0;
+        uint64_t errors = 0;                    /// requests the sdk refused
+        uint64_t stale = 0;                     /// responses overtaken by a newer one
+        size_t in_flight = 0;
+        double latency_ms = 0.0;                /// moving average over about 16 responses
+        double max_latency_ms = 0.0;
+    };
+
+    /// runs on the sdk thread
+    using ChangeCallback = std::function<void(const Device::AiStatus &status, int64_t latency_ns)>;
+
+    AiStatusPoller(const Options &options, ChangeCallback callback);
+
+    /// responses still on their way are ignored once this returns
+    ~AiStatusPoller();
+
+    AiStatusPoller(const AiStatusPoller &) = delete;
+
+    AiStatusPoller &operator=(const AiStatusPoller &) = delete;
+
+    /**
+     * @brief  Give up expired requests and send a new one if a slot is free.
+     * @param  [in] now_ns   Monotonic time.
+     * @return  true if a request was sent.
+     */
+    bool poll(Device &dev, int64_t now_ns);
+
+    /// forget the outstanding requests and the last status, the next response is reported as a change
+    void reset();
+
+    Stats stats() const;
+
+private:
+    struct State;
+
+    static void onResponse(const std::shared_ptr<State> &state, uint64_t sequence, const void *data);
+
+    /// shared with the callbacks of requests in flight, which may outlive the poller
+    std::shared_ptr<State> state_;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_AI_STATUS_POLLER_HPP
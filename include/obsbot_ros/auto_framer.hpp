@@ -0,0 +1,100 @@
+#ifndef OBSBOT_AUTO_FRAMER_HPP
+#define OBSBOT_AUTO_FRAMER_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "target_selector.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Digital framing from person detections. The subjects are wrapped in a window of the image's aspect ratio
+ *         with some padding; a single person is placed with the eye line on the upper third, a group is centered.
+ *         The desired window is low pass filtered, and the goal sent to the camera only moves once the filtered
+ *         window leaves a dead zone around it, so a standing person never produces a command. Goals are coalesced to
+ *         at most one per min_interval; the camera's smooth ROI switch interpolates between them.
+ */
+class AutoFramer
+{
+public:
+    /// normalized image coordinates, 0..1, equal width and height keep the aspect ratio of the image
+    struct Window
+    {
+        float x_min = 0.0f;
+        float y_min = 0.0f;
+        float x_max = 1.0f;
+        float y_max = 1.0f;
+
+        float size() const
+        { return x_max - x_min; }
+    };
+
+    struct Options
+    {
+        int32_t target_type = 0;                /// person, -1 frames every detection
+        float min_score = 0.3f;
+        float padding = 0.15f;                  /// around the subjects, fraction of their size per side
+        float min_size = 0.3f;                  /// smallest window, fraction of the image
+        int64_t smoothing_ns = 400000000;       /// time constant of the low pass filter
+        float dead_zone = 0.08f;                /// center movement, fraction of the window, that is ignored
+        float size_dead_zone = 0.12f;           /// relative size change that is ignored
+        int64_t lost_ns = 2000000000;           /// without subjects for this long the full image is shown
+        int64_t min_interval_ns = 250000000;    /// shortest time between two commands
+    };
+
+    struct Stats
+    {
+        uint64_t updates = 0;
+        uint64_t commands = 0;
+        uint64_t held = 0;                      /// updates absorbed by the dead zone
+        uint64_t coalesced = 0;                 /// goals replaced before they were sent
+    };
+
+    explicit AutoFramer(const Options &options);
+
+    /**
+     * @brief  Take the detections of one image.
+     * @param  [in] now_ns   Monotonic time.
+     */
+    void update(const DetectionBox *boxes, size_t count, int64_t now_ns);
+
+    /**
+     * @brief  Hand out the goal if it changed and the rate limit allows a command now.
+     * @return  true if window was filled and has to be sent.
+     */
+    bool poll(int64_t now_ns, Window &window);
+
+    /// back to the full image, the next goal is sent without waiting
+    void reset();
+
+    const Window &goal() const
+    { return goal_; }
+
+    const Stats &stats() const
+    { return stats_; }
+
+private:
+    /// window around the eligible boxes, false if there is none
+    bool frame(const DetectionBox *boxes, size_t count, Window &out) const;
+
+    static Window clamp(float center_x, float center_y, float size);
+
+    void setGoal(const Window &window);
+
+    Options options_;
+    Stats stats_;
+
+    Window filtered_;
+    Window goal_;
+    int64_t last_update_ns_ = 0;
+    int64_t last_seen_ns_ = 0;
+    bool pending_ = false;
+    bool sent_any_ = false;
+    int64_t last_command_ns_ = 0;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_AUTO_FRAMER_HPP
@@ -0,0 +1,143 @@
+#ifndef OBSBOT_BANDWIDTH_PLANNER_HPP
+#define OBSBOT_BANDWIDTH_PLANNER_HPP
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "device_registry.hpp"
+#include "devs.hpp"
+#include "v4l2_capture.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Process wide choice of capture formats for every camera on the usb, so that the cameras sharing a bus
+ *         also fit on it together. Each camera node joins with its requested format, the modes the device lists and
+ *         its video node. The planner reads the usb topology behind every video node from sysfs and estimates the
+ *         bandwidth of every mode at or below the request. For each bus (one root hub of a host controller) it then
+ *         picks the modes with the highest priority weighted quality that stay within the bus budget; the search is
+ *         exact in 1 Mbps steps.
+ *
+ *         The plan is made again whenever a camera joins or leaves and on every plug event, when a camera may have
+ *         moved to another port. The listener of a camera whose assignment changed is called, with the planner's
+ *         lock held, so it must only take a note and must not call back into the planner.
+ */
+class BandwidthPlanner
+{
+public:
+    using Listener = std::function<void()>;
+
+    struct Options
+    {
+        double share = 0.8;                     /// of the bus speed available to isochronous video
+        std::map<int32_t, double> bus_limits;   /// bus number to Mbps, instead of share of its speed
+        double mjpeg_bpp = 3.0;                 /// bits per pixel of an mjpeg frame, raw formats are exact
+        double h26x_bpp = 0.5;
+        double overhead = 1.1;                  /// packet headers and payload alignment
+        int32_t min_fps = 5;                    /// lower frame rates are not offered
+    };
+
+    /// where a video node sits on the usb, from sysfs
+    struct UsbPort
+    {
+        int32_t bus = -1;                       /// -1 when the topology could not be read
+        std::string devpath;                    /// port chain below the root hub, eg. 2.1
+        std::string controller;                 /// host controller, eg. its pci address
+        double link_mbps = 0.0;                 /// negotiated speed of the device
+        double bus_mbps = 0.0;                  /// speed of the root hub
+    };
+
+    struct Camera
+    {
+        std::string video_path;
+        double priority = 1.0;
+        V4l2Capture::Format requested;
+        std::vector<Device::VideoFormatInfo> formats; /// as listed by the device, empty offers the request only
+        UsbPort port;                           /// filled by the planner
+    };
+
+    struct Mode
+    {
+        V4l2Capture::Format format;
+        double mbps = 0.0;
+        double quality = 0.0;                   /// share of the requested pixels times share of the requested rate
+    };
+
+    struct Assignment
+    {
+        Mode mode;
+        bool fits = true;                       /// false if even the lightest modes overcommit the bus
+        UsbPort port;
+        double bus_used_mbps = 0.0;             /// by every planned camera on the bus
+        double bus_budget_mbps = 0.0;           /// 0 without a known bus
+    };
+
+    static BandwidthPlanner &get();
+
+    ~BandwidthPlanner();
+
+    BandwidthPlanner(const BandwidthPlanner &) = delete;
+
+    BandwidthPlanner &operator=(const BandwidthPlanner &) = delete;
+
+    /**
+     * @brief  Parse one bus limit, "<bus> <mbps>".
+     * @return  false for a malformed text.
+     */
+    static bool parseLimit(const std::string &text, int32_t &bus, double &mbps);
+
+    /// false off linux or when the video node is not a usb device
+    static bool readPort(const std::string &video_path, UsbPort &out);
+
+    /// estimated Mbps of one format on the wire
+    static double bandwidth(const V4l2Capture::Format &format, const Options &options);
+
+    /// modes of the requested pixel format at or below the request, best first
+    static std::vector<Mode> candidates(const Camera &camera, const Options &options);
+
+    /// one assignment per camera, in order; the ports must be filled
+    static std::vector<Assignment> solve(const std::vector<Camera> &cameras, const Options &options);
+
+    /// taken by the next plan, the last node to set them wins
+    void setOptions(const Options &options);
+
+    /// take part in the plan, eg. from configure; plans at once
+    void join(DeviceRegistry::Handle device, const Camera &camera, Listener listener);
+
+    /// eg. from cleanup, the others may get a better mode
+    void leave(DeviceRegistry::Handle device);
+
+    /// read the topology again and plan
+    void replan();
+
+    /// false if the camera has not joined
+    bool assignment(DeviceRegistry::Handle device, Assignment &out) const;
+
+private:
+    BandwidthPlanner();
+
+    /// with the lock held
+    void plan();
+
+    struct Member
+    {
+        Camera camera;
+        Listener listener;
+        Assignment assignment;
+        bool planned = false;
+    };
+
+    mutable std::mutex mutex_;
+    Options options_;
+    std::map<DeviceRegistry::Handle, Member> members_;
+    uint32_t registry_listener_ = 0;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_BANDWIDTH_PLANNER_HPP
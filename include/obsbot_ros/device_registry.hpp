@@ -0,0 +1,91 @@
+#ifndef OBSBOT_DEVICE_REGISTRY_HPP
+#define OBSBOT_DEVICE_REGISTRY_HPP
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "devs.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Process wide owner of the sdk device changed callback. Devices takes a single callback, so with several
+ *         camera nodes in one process every node registers here and gets every plug event.
+ *
+ *         Every SN is interned on first sight into a small integer handle that stays valid for the life of the
+ *         process, even across unplug and replug. Listeners, lookups and comparisons work on handles, so a plug event
+ *         or a find() on the control path neither copies nor compares SN strings.
+ */
+class DeviceRegistry
+{
+public:
+    using Handle = uint32_t;
+
+    /// never handed out by intern()
+    static constexpr Handle kNoDevice = 0;
+
+    using Listener = std::function<void(Handle device, bool in_out)>;
+
+    static DeviceRegistry &get();
+
+    DeviceRegistry(const DeviceRegistry &) = delete;
+
+    DeviceRegistry &operator=(const DeviceRegistry &) = delete;
+
+    /**
+     * @brief  Register a listener, it is called on the sdk thread.
+     * @return  Id for removeListener().
+     */
+    uint32_t addListener(Listener listener);
+
+    void removeListener(uint32_t id);
+
+    /**
+     * @brief  Handle of an SN, allocated on the first call for it.
+     * @return  kNoDevice for an empty SN.
+     */
+    Handle intern(const std::string &dev_sn);
+
+    /// SN of a handle, the reference stays valid for the life of the process; empty for kNoDevice
+    const std::string &serial(Handle device);
+
+    /// connected device with this handle, nullptr if it is not connected
+    std::shared_ptr<Device> find(Handle device);
+
+    /// connected device with this SN, or the first connected device if sn is empty
+    std::shared_ptr<Device> find(const std::string &dev_sn);
+
+    /// SNs of every connected device, sorted
+    std::vector<std::string> serials();
+
+private:
+    DeviceRegistry();
+
+    void onDevChanged(const std::string &dev_sn, bool in_out);
+
+    struct Entry
+    {
+        std::string serial;
+        std::weak_ptr<Device> device;           /// set while connected
+    };
+
+    std::mutex mutex_;
+    std::vector<std::pair<uint32_t, Listener>> listeners_;
+    uint32_t next_id_ = 1;
+
+    /// entries are only appended, a deque keeps references to them valid; index is handle - 1
+    std::mutex table_mutex_;
+    std::deque<Entry> entries_;
+    std::unordered_map<std::string, Handle> handles_;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_DEVICE_REGISTRY_HPP
@@ -0,0 +1,157 @@
+#ifndef OBSBOT_DIAGNOSTICS_AGGREGATOR_HPP
+#define OBSBOT_DIAGNOSTICS_AGGREGATOR_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
+#include <diagnostic_msgs/msg/diagnostic_status.hpp>
+
+#include "dev.hpp"
+#include "digital_ptz.hpp"
+#include "horizon_leveler.hpp"
+#include "motion_tracker.hpp"
+#include "stabilizer.hpp"
+#include "telemetry_overlay.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Builds diagnostic entries from the cached camera status and the driver counters. update*() may be called at
+ *         any rate, collect() hands out only the entries whose level, message or values changed since the previous
+ *         collect(), so the publish rate stays low without losing transitions.
+ */
+class DiagnosticsAggregator
+{
+public:
+    /// driver side counters, sampled by the owner
+    struct StreamStats
+    {
+        double fps = 0.0;
+        uint64_t captured = 0;
+        uint64_t dropped = 0;
+    };
+
+    struct SdkStats
+    {
+        uint64_t calls = 0;
+        uint64_t errors = 0;
+        double error_rate = 0.0;                /// errors per second over the last update interval
+    };
+
+    /// rtsp link of a network camera
+    struct NetworkStats
+    {
+        bool connected = false;
+        double rx_kbps = 0.0;
+        double loss = 0.0;                      /// lost / expected packets
+        double jitter_ms = 0.0;
+        double delay_ms = 0.0;
+        uint32_t reconnects = 0;
+        size_t rung = 0;                        /// stream adaptation, 0 is the best encoding
+        size_t rung_count = 0;
+    };
+
+    /// NonBlock polling of the AI status
+    struct AiPollStats
+    {
+        double rate_hz = 0.0;                   /// responses per second
+        double latency_ms = 0.0;
+        double max_latency_ms = 0.0;
+        uint64_t timeouts = 0;
+        uint64_t errors = 0;
+    };
+
+    /**
+     * @param  [in] name          Prefix of every entry name, usually the node name.
+     * @param  [in] hardware_id   Device SN.
+     */
+    DiagnosticsAggregator(const std::string &name, const std::string &hardware_id);
+
+    void updateStatus(ObsbotProductType product, const Device::CameraStatus &status);
+
+    void updateStream(const StreamStats &stats);
+
+    void updateSdk(const SdkStats &stats);
+
+    void updateNetwork(const NetworkStats &stats);
+
+    void updateAiPoll(const AiPollStats &stats);
+
+    /// frame stages, the counters of the stage as it keeps them
+    void updateStabilizer(const Stabilizer::Stats &stats);
+
+    void updateLeveler(const HorizonLeveler::Stats &stats);
+
+    void updateOverlay(const TelemetryOverlay::Stats &stats);
+
+    void updateMotion(const MotionTracker::Stats &stats);
+
+    /// digital pan/tilt of a meet camera, from the control group
+    void updatePtz(const DigitalPtz::Stats &stats);
+
+    /**
+     * @brief  Move changed entries into the array.
+     * @param  [out] out   Receives the entries, its status list is cleared first.
+     * @param  [in] full   Hand out every entry, eg. for periodic keep-alive.
+     * @return  true if at least one entry was added.
+     */
+    bool collect(diagnostic_msgs::msg::DiagnosticArray &out, bool full);
+
+private:
+    enum EntryIndex
+    {
+        EntryDevice = 0,
+        EntryStream,
+        EntrySdk,
+        EntryBattery,
+        EntryTemperature,
+        EntrySdCard,
+        EntryModules,
+        EntryNetwork,
+        EntryAiPoll,
+        EntryStabilizer,
+        EntryLeveler,
+        EntryOverlay,
+        EntryMotion,
+        EntryPtz,
+        EntryCount,
+    };
+
+    struct Entry
+    {
+        diagnostic_msgs::msg::DiagnosticStatus status;
+        bool used = false;
+        bool changed = false;
+    };
+
+    /// begin an update of one entry, values are filled with value() and the change is detected in commit()
+    void begin(EntryIndex index);
+
+    void value(const char *key, const std::string &value);
+
+    void value(const char *key, int64_t value);
+
+    void value(const char *key, double value);
+
+    void commit(uint8_t level, const std::string &message);
+
+    /// the values every frame stage has
+    void stageValues(uint64_t unsupported, double process_us, double max_process_us);
+
+    /// idle, running, or a warning while frames come in a format the stage can not handle
+    void commitStage(uint64_t frames, uint64_t unsupported);
+
+    void updateTailAir(const Device::CameraStatus &status);
+
+    std::vector<Entry> entries_;
+    diagnostic_msgs::msg::DiagnosticStatus scratch_;
+    EntryIndex current_ = EntryDevice;
+    size_t value_count_ = 0;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_DIAGNOSTICS_AGGREGATOR_HPP
@@ -0,0 +1,98 @@
+#ifndef OBSBOT_DIGITAL_PTZ_HPP
+#define OBSBOT_DIGITAL_PTZ_HPP
+
+#include <cstdint>
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Local model of the digital pan/tilt window of a meet camera, in the -1..1 range of the sdk. Teleop sets a
+ *         velocity or an absolute target, step() moves the model at a fixed rate with limited speed and
+ *         acceleration, and poll() hands out the modelled position as one absolute command at most every
+ *         min_interval. The model answers immediately, the camera follows at the rate it can take, and nothing
+ *         queues up in between. A velocity that is not refreshed within velocity_timeout falls back to zero.
+ */
+class DigitalPtz
+{
+public:
+    struct Options
+    {
+        double max_speed = 1.0;                 /// range units per second
+        double acceleration = 4.0;              /// range units per second squared
+        int64_t velocity_timeout_ns = 300000000;
+        int64_t min_interval_ns = 100000000;    /// shortest time between two commands
+        double resolution = 0.002;              /// smaller moves are not sent
+    };
+
+    struct State
+    {
+        double pan = 0.0;
+        double tilt = 0.0;
+        double pan_speed = 0.0;
+        double tilt_speed = 0.0;
+        bool moving = false;
+    };
+
+    struct Stats
+    {
+        uint64_t commands = 0;
+        uint64_t inputs = 0;                    /// velocity and target messages
+    };
+
+    explicit DigitalPtz(const Options &options);
+
+    /**
+     * @brief  Move with a speed until the next input or the timeout.
+     * @param  [in] pan, tilt   Fraction of max_speed, -1..1.
+     */
+    void setVelocity(double pan, double tilt, int64_t now_ns);
+
+    /// move to a position, -1..1
+    void setTarget(double pan, double tilt);
+
+    /// advance the model to now
+    void step(int64_t now_ns);
+
+    /**
+     * @brief  Hand out the position if it moved since the last command and the rate limit allows one now.
+     * @return  true if pan and tilt were filled and have to be sent.
+     */
+    bool poll(int64_t now_ns, double &pan, double &tilt);
+
+    /// place the model without moving, eg. at the window the camera reports
+    void reset(double pan, double tilt);
+
+    const State &state() const
+    { return state_; }
+
+    const Stats &stats() const
+    { return stats_; }
+
+private:
+    struct Axis
+    {
+        double position = 0.0;
+        double speed = 0.0;
+        double target = 0.0;                    /// target mode
+        double command = 0.0;                   /// velocity mode, fraction of max_speed
+        double sent = 0.0;
+    };
+
+    void stepAxis(Axis &axis, double dt) const;
+
+    Options options_;
+    State state_;
+    Stats stats_;
+    Axis pan_;
+    Axis tilt_;
+    bool velocity_mode_ = false;
+    int64_t velocity_ns_ = 0;
+    int64_t last_step_ns_ = 0;
+    bool sent_any_ = false;
+    int64_t last_command_ns_ = 0;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_DIGITAL_PTZ_HPP
@@ -0,0 +1,171 @@
+#ifndef OBSBOT_EVENT_BUFFER_HPP
+#define OBSBOT_EVENT_BUFFER_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_sink.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Pre-event recorder. Encoded frames (MJPEG, H.264, H.265) and status records are copied into a byte ring of
+ *         fixed size that always holds the last pre seconds. trigger() hands the ring plus everything that arrives
+ *         in the following post seconds to a writer thread, which writes one directory per event:
+ *           video.mjpeg / video.h264 / video.h265   the frames back to back, from the first keyframe of the ring
+ *           frames.csv                              sequence, stamp, size and keyframe flag of every frame
+ *           status.bin                              status records as {int64 stamp_ns, int32 kind, uint32 size, data}
+ *         Records that are still to be written are never overwritten; if the writer falls that far behind, new
+ *         records are dropped and counted instead. Raw frames are not kept, they would not fit.
+ */
+class EventBuffer : public FrameSink
+{
+public:
+    /// kind of a status record
+    enum StatusKind : int32_t
+    {
+        StatusCamera = 0,                       /// raw Device::CameraStatus
+        StatusEvent = 1,                        /// RmEventType of the device, as an int32_t
+    };
+
+    struct Options
+    {
+        std::string directory = "/tmp/obsbot_events";
+        std::string prefix = "event";           /// of the directory names, eg. the camera SN
+        int64_t pre_ns = 10000000000;           /// kept before a trigger
+        int64_t post_ns = 5000000000;           /// written after a trigger
+        size_t max_bytes = 64 << 20;            /// ring size, sets the longest pre window of a given bitrate
+        size_t max_records = 4096;
+    };
+
+    struct Stats
+    {
+        uint64_t frames = 0;
+        uint64_t status = 0;
+        uint64_t unsupported = 0;               /// raw frames, not kept
+        uint64_t overflow = 0;                  /// records dropped while a dump held the ring
+        uint64_t dumps = 0;
+        uint64_t failed = 0;                    /// dumps that could not be written
+        uint64_t bytes_written = 0;
+        size_t buffered_bytes = 0;
+        double buffered_s = 0.0;                /// stamp span of the ring
+        bool dumping = false;
+    };
+
+    explicit EventBuffer(const Options &options);
+
+    /// finishes a running dump
+    ~EventBuffer() override;
+
+    EventBuffer(const EventBuffer &) = delete;
+
+    EventBuffer &operator=(const EventBuffer &) = delete;
+
+    /// copies encoded frames, never blocks on the writer
+    void onFrame(const FrameRef &frame) override;
+
+    /// frames are copied, so nothing is held; a running dump is closed since no more frames will come
+    void onRelease() override;
+
+    /// always, the pre window only holds anything while the camera streams
+    bool wantsFrames() const override
+    { return true; }
+
+    void addStatus(int64_t stamp_ns, StatusKind kind, const void *data, size_t size);
+
+    /**
+     * @brief  Dump the ring and the next post seconds. A trigger during a running dump extends it.
+     * @param  [in] reason     Written into the directory name, eg. "service" or "event_1000".
+     * @param  [in] stamp_ns   Of the incident, same clock as the frame stamps.
+     * @return  Directory of the dump, empty if there is nothing to write.
+     */
+    std::string trigger(const std::string &reason, int64_t stamp_ns);
+
+    Stats stats() const;
+
+private:
+    enum Kind : uint8_t
+    {
+        KindFrame,
+        KindStatus,
+    };
+
+    struct Record
+    {
+        size_t offset = 0;                      /// in storage_
+        uint32_t size = 0;
+        Kind kind = KindFrame;
+        bool keyframe = false;
+        int32_t status_kind = 0;
+        RmVideoFormat format = RmVideoFormat::Unknown;
+        uint64_t sequence = 0;
+        int64_t stamp_ns = 0;
+    };
+
+    /// copy one record in, false if it does not fit; caller holds mutex_
+    bool append(Record record, const void *data);
+
+    /// place size bytes, evicting what may be evicted; caller holds mutex_
+    bool reserve(size_t size, size_t &offset);
+
+    bool evictable() const;
+
+    void evictOldest();
+
+    Record &at(uint64_t seq)
+    { return records_[seq % records_.size()]; }
+
+    void run();
+
+    /// in the dump directory, which is created on the first call; nullptr marks the dump failed
+    std::FILE *openFile(const char *name);
+
+    /// @return  bytes written
+    size_t writeRecord(const Record &record);
+
+    /// @return  false if anything of the dump could not be written
+    bool closeDump();
+
+    Options options_;
+    std::unique_ptr<uint8_t[]> storage_;
+    std::vector<Record> records_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    uint64_t first_ = 0;                        /// oldest record in the ring
+    uint64_t end_ = 0;                          /// one past the newest
+    size_t head_ = 0;                           /// where the next payload goes
+    Stats stats_;
+
+    /// dump state, records from write_seq_ on are pinned while dumping_
+    bool dumping_ = false;
+    bool closing_ = false;                      /// the post window is over, write up to dump_end_
+    uint64_t write_seq_ = 0;
+    uint64_t dump_end_ = 0;
+    int64_t until_ns_ = 0;
+    std::string dump_dir_;
+    bool stop_ = false;
+
+    /// writer thread only
+    bool opened_ = false;
+    std::string open_dir_;
+    bool dir_made_ = false;
+    std::FILE *video_ = nullptr;
+    std::FILE *index_ = nullptr;
+    std::FILE *status_ = nullptr;
+    bool waiting_keyframe_ = true;
+    bool dump_failed_ = false;
+    std::thread thread_;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_EVENT_BUFFER_HPP
@@ -0,0 +1,106 @@
+#ifndef OBSBOT_EXECUTOR_LAYOUT_HPP
+#define OBSBOT_EXECUTOR_LAYOUT_HPP
+
+#include <array>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <rclcpp/rclcpp.hpp>
+
+namespace obsbot_ros
+{
+
+/// Work classes of the driver, each one is served by its own callback group.
+enum class CallbackRole
+{
+    Capture = 0,                                /// frame capture and image publishing
+    Control,                                    /// gimbal / zoom commands, must never wait on slow calls
+    Status,                                     /// status polling and diagnostics
+    Media,                                      /// burst and device photos, wait seconds on the camera
+    Housekeeping,                               /// file transfer, parameter batches, services
+    Count,
+};
+
+const char *callbackRoleName(CallbackRole role);
+
+/**
+ * @brief  The callback groups of one node, indexed by CallbackRole. Housekeeping is the node's default group so
+ *         parameter services and anything created without an explicit group land there.
+ */
+class CallbackGroups
+{
+public:
+    CallbackGroups() = default;
+
+    /**
+     * @brief  Create the groups on the node. Non-default groups are not added to executors automatically, the
+     *         ExecutorLayout decides where they run.
+     * @param  [in] node_base   Node base interface of the owning node.
+     */
+    explicit CallbackGroups(const rclcpp::node_interfaces::NodeBaseInterface::SharedPtr &node_base);
+
+    const rclcpp::CallbackGroup::SharedPtr &get(CallbackRole role) const
+    { return groups_[static_cast<size_t>(role)]; }
+
+    const rclcpp::node_interfaces::NodeBaseInterface::SharedPtr &nodeBase() const
+    { return node_base_; }
+
+private:
+    rclcpp::node_interfaces::NodeBaseInterface::SharedPtr node_base_;
+    std::array<rclcpp::CallbackGroup::SharedPtr, static_cast<size_t>(CallbackRole::Count)> groups_;
+};
+
+/**
+ * @brief  Maps callback roles onto executors. Roles listed as dedicated get a single threaded executor on their own
+ *         thread, so a blocking SDK call in one role can never delay another. The remaining roles share one
+ *         multi threaded executor.
+ */
+class ExecutorLayout
+{
+public:
+    struct Options
+    {
+        std::vector<std::string> dedicated{"capture", "control", "status", "media", "housekeeping"};
+        int shared_threads = 2;
+    };
+
+    explicit ExecutorLayout(Options options);
+
+    ~ExecutorLayout();
+
+    ExecutorLayout(const ExecutorLayout &) = delete;
+
+    ExecutorLayout &operator=(const ExecutorLayout &) = delete;
+
+    /**
+     * @brief  Read the layout from the "executor.dedicated" and "executor.shared_threads" parameters of a node.
+     */
+    static Options optionsFromParameters(const rclcpp::node_interfaces::NodeParametersInterface::SharedPtr &params);
+
+    /**
+     * @brief  Assign all groups of a node. Must be called before spin().
+     */
+    void add(const CallbackGroups &groups);
+
+    /**
+     * @brief  Start one thread per executor and block until rclcpp shuts down or cancel() is called.
+     */
+    void spin();
+
+    void cancel();
+
+    bool isDedicated(CallbackRole role) const;
+
+private:
+    Options options_;
+    std::array<bool, static_cast<size_t>(CallbackRole::Count)> dedicated_{};
+    std::array<std::shared_ptr<rclcpp::Executor>, static_cast<size_t>(CallbackRole::Count)> dedicated_executors_;
+    std::shared_ptr<rclcpp::executors::MultiThreadedExecutor> shared_executor_;
+    std::vector<std::thread> threads_;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_EXECUTOR_LAYOUT_HPP
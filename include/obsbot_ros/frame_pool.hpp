@@ -0,0 +1,127 @@
+#ifndef OBSBOT_FRAME_POOL_HPP
+#define OBSBOT_FRAME_POOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "dev.hpp"
+
+namespace obsbot_ros
+{
+
+class FramePool;
+
+struct FrameStorage;
+
+/// One video frame in a pooled buffer. Planar formats keep their planes back to back in data, every line stride bytes
+/// long for the first plane and half of that for the chroma planes of i420.
+struct Frame
+{
+    uint8_t *data = nullptr;
+    size_t capacity = 0;                        /// allocated bytes
+    size_t size = 0;                            /// valid bytes
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t stride = 0;                         /// bytes per line of the first plane
+    RmVideoFormat format = RmVideoFormat::Unknown;
+    uint64_t sequence = 0;
+    bool keyframe = false;                      /// encoded formats, the frame decodes on its own
+    int64_t stamp_ns = 0;                       /// capture time, ros clock
+    int64_t steady_ns = 0;                      /// capture time, steady clock
+};
+
+/**
+ * @brief  Reference counted handle to a pooled frame. Copying is an atomic increment, the buffer returns to its pool
+ *         when the last handle goes away. A handle keeps the buffers of its pool alive, so the pool may be replaced
+ *         or destroyed while frames taken from it are still held.
+ */
+class FrameRef
+{
+public:
+    FrameRef() = default;
+
+    FrameRef(const FrameRef &other);
+
+    FrameRef(FrameRef &&other) noexcept;
+
+    FrameRef &operator=(const FrameRef &other);
+
+    FrameRef &operator=(FrameRef &&other) noexcept;
+
+    ~FrameRef();
+
+    void reset();
+
+    explicit operator bool() const
+    { return storage_ != nullptr; }
+
+    Frame *operator->() const;
+
+    Frame &operator*() const;
+
+    Frame *get() const;
+
+private:
+    friend class FramePool;
+
+    FrameRef(FrameStorage *storage, uint32_t index) : storage_(storage), index_(index)
+    {}
+
+    FrameStorage *storage_ = nullptr;
+    uint32_t index_ = 0;
+};
+
+/**
+ * @brief  Fixed set of frame buffers allocated once. acquire() never allocates, it returns an empty handle when every
+ *         buffer is in use so the caller can count the drop instead of stalling. The buffers are freed with the pool
+ *         or, if frames are still held then, with the last of them.
+ */
+class FramePool
+{
+public:
+    /**
+     * @param  [in] count      Number of buffers.
+     * @param  [in] capacity   Bytes per buffer, the largest frame the pool has to hold.
+     */
+    FramePool(size_t count, size_t capacity);
+
+    ~FramePool();
+
+    FramePool(const FramePool &) = delete;
+
+    FramePool &operator=(const FramePool &) = delete;
+
+    FrameRef acquire();
+
+    size_t count() const
+    { return count_; }
+
+    size_t capacity() const
+    { return capacity_; }
+
+    size_t available() const;
+
+private:
+    size_t count_;
+    size_t capacity_;
+    FrameStorage *storage_;                     /// shared with the frames lent out
+};
+
+/**
+ * @brief  Bytes needed for a frame of the given format, 0 for unsupported formats. Encoded formats are sized for the
+ *         worst case of an uncompressed 4:2:2 frame.
+ */
+size_t frameBufferSize(RmVideoFormat format, int32_t width, int32_t height);
+
+/// sensor_msgs encoding for raw formats, format string of CompressedImage for encoded ones, empty if unknown
+const char *encodingName(RmVideoFormat format);
+
+bool isEncoded(RmVideoFormat format);
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_FRAME_POOL_HPP
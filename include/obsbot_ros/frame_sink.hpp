@@ -0,0 +1,32 @@
+#ifndef OBSBOT_FRAME_SINK_HPP
+#define OBSBOT_FRAME_SINK_HPP
+
+#include "frame_pool.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Consumer of the frames of one camera node, eg. a synchronizer or a recorder. It runs on the thread that
+ *         produced the frame and may keep the reference; the buffer stays out of the pool until it is dropped.
+ */
+class FrameSink
+{
+public:
+    virtual ~FrameSink() = default;
+
+    /// must not block, the capture thread waits for it
+    virtual void onFrame(const FrameRef &frame) = 0;
+
+    /// the producer is about to free its pool, every reference taken from it must be dropped before returning
+    virtual void onRelease() = 0;
+
+    /// whether the camera should stream for this sink right now; a sleeping camera is woken for it. A sink that only
+    /// takes what passes by keeps the default and never keeps the camera awake
+    virtual bool wantsFrames() const
+    { return false; }
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_FRAME_SINK_HPP
@@ -0,0 +1,131 @@
+#ifndef OBSBOT_FRAME_SYNCHRONIZER_HPP
+#define OBSBOT_FRAME_SYNCHRONIZER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "frame_sink.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Groups the frames of N streams into sets whose capture stamps lie within a tolerance. Every stream has a
+ *         bounded queue of frame references in arrival order. On each arrival the oldest frames of all queues are
+ *         compared: if they fit in the tolerance they leave as a set, otherwise every oldest frame that lies more than
+ *         the tolerance before the newest one is dropped, since no later set can contain it. Each frame is looked at
+ *         a bounded number of times, so matching costs O(N) per arrival, and no memory is allocated after
+ *         construction. The tolerance should stay below half a frame period so the oldest candidate is also the
+ *         closest one. Complete sets wait in a short queue of their own until the consumer takes them on its own
+ *         thread, so a capture thread never waits for the consumer.
+ */
+class FrameSynchronizer
+{
+public:
+    struct Options
+    {
+        size_t streams = 2;
+        size_t queue_depth = 4;                 /// frames per stream, the oldest is dropped when full
+        int64_t tolerance_ns = 10000000;        /// largest stamp difference inside a set
+        size_t set_depth = 2;                   /// complete sets waiting for take(), the oldest is dropped when full
+    };
+
+    struct Stats
+    {
+        uint64_t frames = 0;                    /// frames pushed
+        uint64_t sets = 0;
+        uint64_t unmatched = 0;                 /// frames dropped without a set, overflows included
+        uint64_t overflows = 0;                 /// frames dropped because their queue was full
+        uint64_t dropped_sets = 0;              /// complete sets nobody took in time
+        double match_rate = 0.0;                /// fraction of pushed frames that left in a set
+        int64_t last_skew_ns = 0;
+        double mean_skew_ns = 0.0;              /// moving average over about 64 sets
+        int64_t max_skew_ns = 0;
+    };
+
+    /**
+     * @brief  Called after a push() completed at least one set, on the pushing thread and without the lock held. It
+     *         should only wake the consumer, eg. its executor, which then calls take().
+     */
+    using ReadyCallback = std::function<void()>;
+
+    /**
+     * @brief  Gets one complete set from take().
+     * @param  [in] frames    One frame per stream, in stream order.
+     * @param  [in] count     Number of streams.
+     * @param  [in] skew_ns   Newest minus oldest stamp of the set.
+     */
+    using SetCallback = std::function<void(const FrameRef *frames, size_t count, int64_t skew_ns)>;
+
+    /// whether anyone takes the sets right now, eg. the bundle topic has subscribers; asked from the cameras' threads
+    using DemandCallback = std::function<bool()>;
+
+    /// without a demand callback the inputs never keep a camera awake
+    FrameSynchronizer(const Options &options, ReadyCallback ready, DemandCallback demand = nullptr);
+
+    FrameSynchronizer(const FrameSynchronizer &) = delete;
+
+    FrameSynchronizer &operator=(const FrameSynchronizer &) = delete;
+
+    void push(size_t stream, const FrameRef &frame);
+
+    /**
+     * @brief  Hand the oldest complete set to callback. Matching goes on meanwhile, but release() waits for it.
+     * @return  false if no set was waiting.
+     */
+    bool take(const SetCallback &callback);
+
+    /// drop the queued frames of one stream and every complete set, after a set being taken is done
+    void release(size_t stream);
+
+    /// sink feeding one stream, valid as long as the synchronizer
+    const std::shared_ptr<FrameSink> &input(size_t stream) const
+    { return inputs_[stream]; }
+
+    size_t streams() const
+    { return options_.streams; }
+
+    Stats stats() const;
+
+private:
+    class Input;
+
+    FrameRef &slot(size_t stream, size_t position)
+    { return storage_[stream * options_.queue_depth + (heads_[stream] + position) % options_.queue_depth]; }
+
+    FrameRef *readySet(size_t position)
+    { return &ready_[((ready_head_ + position) % options_.set_depth) * options_.streams]; }
+
+    void pop(size_t stream, FrameRef *out);
+
+    void dropSet();
+
+    /// @return  number of sets completed
+    size_t match();
+
+    Options options_;
+    ReadyCallback ready_callback_;
+    DemandCallback demand_callback_;
+    std::vector<std::shared_ptr<FrameSink>> inputs_;
+
+    std::mutex take_mutex_;                     /// held while a set is out, before mutex_
+    std::vector<FrameRef> set_;                 /// the set being taken
+
+    mutable std::mutex mutex_;
+    std::vector<FrameRef> storage_;             /// streams * queue_depth ring slots
+    std::vector<size_t> heads_;
+    std::vector<size_t> counts_;
+    std::vector<FrameRef> ready_;               /// set_depth * streams, complete sets in order
+    std::vector<int64_t> ready_skew_ns_;
+    size_t ready_head_ = 0;
+    size_t ready_count_ = 0;
+    Stats stats_;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_FRAME_SYNCHRONIZER_HPP
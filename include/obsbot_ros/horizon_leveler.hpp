@@ -0,0 +1,75 @@
+#ifndef OBSBOT_HORIZON_LEVELER_HPP
+#define OBSBOT_HORIZON_LEVELER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "frame_pool.hpp"
+#include "stabilizer.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Levels the horizon of raw frames for cameras whose roll axis is not driven, eg. handheld or on a vehicle.
+ *         The measured roll at the capture time of a frame is undone by a rotation about the image center, one
+ *         fixed point affine warp per plane, into the largest centered crop that stays inside the picture for any
+ *         roll up to max_roll. Below threshold the frame is only cropped, which is a plain copy, so the output size
+ *         never changes. Output is I420 like the stabilizer's; roll has the same direction, positive when the camera
+ *         is turned clockwise as seen from behind.
+ */
+class HorizonLeveler
+{
+public:
+    struct Options
+    {
+        double threshold_deg = 1.0;             /// smaller roll is left alone
+        double max_roll_deg = 10.0;             /// sets the crop, larger roll is only partly undone
+        int64_t max_gap_ns = 100000000;         /// attitude older than this counts as missing
+        size_t pool_size = 3;
+    };
+
+    struct Stats
+    {
+        uint64_t frames = 0;
+        uint64_t rotated = 0;                   /// frames with roll above the threshold
+        uint64_t no_attitude = 0;
+        uint64_t unsupported = 0;               /// encoded or rgb frames
+        uint64_t dropped = 0;                   /// no free output buffer
+        double roll_deg = 0.0;                  /// of the last frame
+        double process_us = 0.0;                /// moving average
+        double max_process_us = 0.0;
+    };
+
+    explicit HorizonLeveler(const Options &options);
+
+    /**
+     * @brief  Level one frame.
+     * @return  The cropped frame, empty for unsupported formats or when every output buffer is held.
+     */
+    FrameRef process(const Frame &frame, const AttitudeTrack &track);
+
+    const Stats &stats() const
+    { return stats_; }
+
+private:
+    /// false while the buffers of a smaller pool are still held
+    bool prepare(int32_t width, int32_t height);
+
+    /// destination to source map of one plane, 16.16
+    void planeMap(double roll_deg, double scale_x, double scale_y, double out_scale, int32_t m[6]) const;
+
+    Options options_;
+    Stats stats_;
+
+    int32_t in_width_ = 0;
+    int32_t in_height_ = 0;
+    int32_t out_width_ = 0;
+    int32_t out_height_ = 0;
+    std::unique_ptr<FramePool> pool_;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_HORIZON_LEVELER_HPP
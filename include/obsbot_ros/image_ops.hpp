@@ -0,0 +1,117 @@
+#ifndef OBSBOT_IMAGE_OPS_HPP
+#define OBSBOT_IMAGE_OPS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frame_pool.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Row kernels shared by the pipeline stages. They use SSE2 on x86 and NEON on arm, with a scalar fallback,
+ *         and work on unaligned pointers of any length.
+ */
+namespace image_ops
+{
+
+/**
+ * @brief  dst = (a * (256 - weight) + b * weight) / 256, for vertical interpolation and alpha blending.
+ *         dst may alias a or b.
+ * @param  [in] weight   0 gives a, 256 gives b.
+ */
+void blendRow(uint8_t *dst, const uint8_t *a, const uint8_t *b, uint32_t weight, size_t count);
+
+/**
+ * @brief  dst = dst + (src - dst) * alpha / 255 with an alpha per sample, for overlays with their own coverage.
+ *         An alpha of 255 gives src exactly.
+ */
+void blendMask(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, size_t count);
+
+/**
+ * @brief  mask = |a - b| > threshold ? 255 : 0, for frame differencing.
+ * @return  Number of samples above the threshold.
+ */
+size_t diffMask(uint8_t *mask, const uint8_t *a, const uint8_t *b, uint8_t threshold, size_t count);
+
+/// set count samples step bytes apart, eg. the luma of a yuy2 row with step 2; the bytes in between are kept
+void fillSamples(uint8_t *dst, uint8_t value, size_t step, size_t count);
+
+/// sum of count samples step bytes apart, for block averages
+uint32_t sumSamples(const uint8_t *src, size_t step, size_t count);
+
+/// one plane, or one component of a packed plane, as seen by the scaler
+struct PlaneView
+{
+    const uint8_t *data = nullptr;
+    int32_t width = 0;                          /// samples
+    int32_t height = 0;                         /// rows
+    int32_t stride = 0;                         /// bytes per row
+    int32_t step = 1;                           /// bytes between samples, eg. 2 for the luma of yuy2
+};
+
+/**
+ * @brief  Bilinear samples along a straight line through the source, the inner loop of warps that are affine over a
+ *         short run of pixels. The samples are gathered one by one, the interpolation runs 8 pixels wide.
+ * @param  [in] x, y     Source position of the first pixel, 16.16 fixed point, in samples of the plane.
+ * @param  [in] dx, dy   Step per destination pixel, 16.16 fixed point.
+ *         Positions outside the plane take the nearest edge sample.
+ */
+void warpRow(uint8_t *dst, const PlaneView &src, int32_t x, int32_t y, int32_t dx, int32_t dy, size_t count);
+
+/**
+ * @brief  Affine warp of one plane, eg. a rotation. The map is linear along a row, so each row is a single warpRow.
+ *         A translation by whole samples inside the plane is a plain copy.
+ * @param  [in] m   Destination to source, 16.16 fixed point: x = m[0] * col + m[1] * row + m[2],
+ *                  y = m[3] * col + m[4] * row + m[5].
+ */
+void affineWarp(const PlaneView &src, uint8_t *dst, int32_t dst_stride, int32_t width, int32_t height,
+                const int32_t m[6]);
+
+/**
+ * @brief  Luma, Cb and Cr of a raw frame. Chroma of 4:2:2 formats is returned at full height, the scaler takes care of
+ *         the vertical subsampling.
+ * @return  false for formats without a yuv layout (encoded, rgb).
+ */
+bool yuvPlanes(const Frame &frame, PlaneView &y, PlaneView &u, PlaneView &v);
+
+/**
+ * @brief  Bilinear scaler for one plane. Coefficient tables are built when the geometry changes and kept, so scaling a
+ *         stream of frames of the same size does not allocate. The vertical pass and the blend use blendRow().
+ */
+class PlaneScaler
+{
+public:
+    /**
+     * @brief  Scale src into a dst_width x dst_height rectangle.
+     * @param  [in] dst          First byte of the destination rectangle.
+     * @param  [in] dst_stride   Bytes per destination row.
+     * @param  [in] alpha        256 overwrites the destination, less blends over it.
+     */
+    void scale(const PlaneView &src, uint8_t *dst, int32_t dst_stride, int32_t dst_width, int32_t dst_height,
+               uint32_t alpha = 256);
+
+private:
+    void prepare(const PlaneView &src, int32_t dst_width, int32_t dst_height);
+
+    void horizontal(const PlaneView &src, int32_t row, uint8_t *out);
+
+    int32_t src_width_ = 0;
+    int32_t src_height_ = 0;
+    int32_t src_step_ = 0;
+    int32_t dst_width_ = 0;
+    int32_t dst_height_ = 0;
+    std::vector<int32_t> x_offset_;             /// byte offset of the left source sample
+    std::vector<uint16_t> x_weight_;            /// weight of the right sample, 0..256
+    std::vector<int32_t> y_index_;
+    std::vector<uint16_t> y_weight_;
+    std::vector<uint8_t> rows_;                 /// two horizontally scaled rows and one blend row
+};
+
+}  // namespace image_ops
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_IMAGE_OPS_HPP
@@ -0,0 +1,68 @@
+#ifndef OBSBOT_JPEG_ENCODER_HPP
+#define OBSBOT_JPEG_ENCODER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "frame_pool.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Still image encoder for frames of the capture ring. Raw yuv frames are handed to libjpeg as downsampled
+ *         planes (raw data input), so the chroma of I420, NV12 and the packed 4:2:2 formats goes in as it is instead
+ *         of being expanded to rgb and subsampled again; Y800 becomes a grayscale jpeg. Rows of planar formats are
+ *         passed in place, packed components are gathered one row block at a time. MJPEG frames already are a jpeg
+ *         and are copied. The compressor and the row buffers are kept from one frame to the next. Built without
+ *         libjpeg, only MJPEG frames can be encoded.
+ */
+class JpegEncoder
+{
+public:
+    struct Stats
+    {
+        uint64_t frames = 0;                    /// raw frames compressed
+        uint64_t passthrough = 0;               /// mjpeg frames copied
+        uint64_t unsupported = 0;               /// h.264/h.265, rgb, or raw frames without libjpeg
+        double process_us = 0.0;                /// moving average of the compressed frames
+        double max_process_us = 0.0;
+    };
+
+    /// built with libjpeg, raw yuv frames can be compressed
+    static bool supported();
+
+    JpegEncoder();
+
+    ~JpegEncoder();
+
+    JpegEncoder(const JpegEncoder &) = delete;
+
+    JpegEncoder &operator=(const JpegEncoder &) = delete;
+
+    /**
+     * @brief  Encode one frame.
+     * @param  [in] quality   1..100, not used for mjpeg frames.
+     * @param  [out] out      The jpeg, resized to its length.
+     * @return  false if the format can not be encoded; out is left empty.
+     */
+    bool encode(const Frame &frame, int32_t quality, std::vector<uint8_t> &out);
+
+    const Stats &stats() const
+    { return stats_; }
+
+private:
+    struct Codec;
+
+    bool compress(const Frame &frame, int32_t quality, std::vector<uint8_t> &out);
+
+    Stats stats_;
+    std::unique_ptr<Codec> codec_;
+    std::vector<uint8_t> rows_;                 /// gathered and padded rows, one row block of every component
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_JPEG_ENCODER_HPP
@@ -0,0 +1,194 @@
+#ifndef OBSBOT_MCAP_RECORDER_HPP
+#define OBSBOT_MCAP_RECORDER_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_sink.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Records the frames of several cameras and their diagnostics into one MCAP file (ros2 profile, cdr), without
+ *         going through ROS messages. The capture threads only queue a reference to the pooled frame; a writer thread
+ *         encodes the Image / CompressedImage cdr straight from the pooled buffer into the current chunk, compresses
+ *         full chunks with zstd or lz4 and writes them with their message indexes. close() adds the summary with
+ *         schemas, channels, chunk indexes and statistics, so the file opens in ros2 bag and Foxglove as is.
+ *         A full queue drops the new frame instead of stalling the camera. Chunks carry the crc of their records and
+ *         the footer that of the summary; the data section crc is left at 0, which MCAP reads as "not computed".
+ */
+class McapRecorder
+{
+public:
+    enum class Compression
+    {
+        None,
+        Lz4,
+        Zstd,
+    };
+
+    struct Stream
+    {
+        std::string topic;                      /// namespace of the camera, eg. "/obsbot_0"
+        std::string frame_id;
+    };
+
+    struct Options
+    {
+        std::string path;
+        Compression compression = Compression::Zstd;
+        size_t chunk_size = 8 << 20;            /// uncompressed bytes per chunk
+        size_t queue_depth = 4;                 /// frames per stream waiting for the writer
+        size_t diagnostics_depth = 64;          /// diagnostics waiting for the writer, the oldest go first
+    };
+
+    struct Stats
+    {
+        uint64_t messages = 0;
+        uint64_t dropped = 0;                   /// frames that found their queue full
+        uint64_t dropped_diagnostics = 0;       /// diagnostics pushed out of a full queue
+        uint64_t chunks = 0;
+        uint64_t bytes_in = 0;                  /// uncompressed message bytes
+        uint64_t bytes_written = 0;             /// file size so far
+        uint64_t write_errors = 0;
+        double write_mbps = 0.0;                /// sustained rate over the last second, MB/s
+        double ratio = 1.0;                     /// compressed / uncompressed size of the chunks
+        size_t queued = 0;
+    };
+
+    /// compression available in this build
+    static bool supported(Compression compression);
+
+    McapRecorder(const Options &options, const std::vector<Stream> &streams);
+
+    /// closes the file
+    ~McapRecorder();
+
+    McapRecorder(const McapRecorder &) = delete;
+
+    McapRecorder &operator=(const McapRecorder &) = delete;
+
+    /**
+     * @brief  Create the file and start the writer thread.
+     * @return  false if the file can not be created, see lastError().
+     */
+    bool open();
+
+    /// write what is queued, the summary and the footer
+    void close();
+
+    /// sink of one stream, valid as long as the recorder
+    const std::shared_ptr<FrameSink> &input(size_t stream) const
+    { return inputs_[stream]; }
+
+    /**
+     * @brief  Queue one serialized diagnostic_msgs/DiagnosticArray for the /diagnostics channel. A full queue drops
+     *         its oldest entry, so a stalled writer does not grow the memory.
+     * @param  [in] cdr   Serialized message including the encapsulation header.
+     */
+    void writeDiagnostics(int64_t stamp_ns, const uint8_t *cdr, size_t size);
+
+    Stats stats() const;
+
+    /// why open() failed
+    const std::string &lastError() const
+    { return error_; }
+
+private:
+    class Input;
+
+    struct Item
+    {
+        size_t stream = 0;
+        FrameRef frame;
+    };
+
+    struct ChunkIndex
+    {
+        uint64_t start_ns = 0;
+        uint64_t end_ns = 0;
+        uint64_t offset = 0;
+        uint64_t length = 0;
+        std::vector<std::pair<uint16_t, uint64_t>> index_offsets;
+        uint64_t index_length = 0;
+        const char *compression = "";
+        uint64_t compressed_size = 0;
+        uint64_t uncompressed_size = 0;
+    };
+
+    void push(size_t stream, const FrameRef &frame);
+
+    void release(size_t stream);
+
+    /// open and not closing, the cameras stream for the file
+    bool recording() const;
+
+    void run();
+
+    /// append one message record to the chunk, body is filled by the caller
+    size_t beginMessage(uint16_t channel, int64_t stamp_ns);
+
+    void endMessage(size_t start);
+
+    void appendFrame(size_t stream, const Frame &frame);
+
+    void flushChunk();
+
+    void writeSummary();
+
+    void writeOut(const std::vector<uint8_t> &bytes);
+
+    Options options_;
+    std::vector<Stream> streams_;
+    std::vector<std::shared_ptr<FrameSink>> inputs_;
+    std::string error_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable idle_cv_;
+    std::vector<Item> queue_;                   /// ring of streams * queue_depth
+    size_t queue_head_ = 0;
+    size_t queue_count_ = 0;
+    std::vector<size_t> stream_counts_;
+    size_t busy_stream_ = SIZE_MAX;             /// stream of the frame the writer holds
+    std::deque<std::pair<int64_t, std::vector<uint8_t>>> diagnostics_;
+    bool running_ = false;
+    bool stop_ = false;
+    Stats stats_;
+
+    /// writer thread only
+    std::FILE *file_ = nullptr;
+    uint64_t offset_ = 0;
+    uint64_t write_errors_ = 0;
+    std::vector<uint8_t> schema_records_;       /// schemas and channels, repeated in the summary
+    std::vector<uint8_t> chunk_;
+    std::vector<uint8_t> compressed_;
+    std::vector<uint8_t> record_;
+    uint64_t chunk_start_ns_ = 0;
+    uint64_t chunk_end_ns_ = 0;
+    std::vector<std::vector<std::pair<uint64_t, uint64_t>>> message_index_;   /// per channel, time and offset
+    std::vector<uint32_t> channel_sequence_;
+    std::vector<uint64_t> channel_messages_;
+    std::vector<ChunkIndex> chunk_indexes_;
+    uint64_t message_count_ = 0;
+    uint64_t start_ns_ = UINT64_MAX;
+    uint64_t end_ns_ = 0;
+    uint64_t chunk_in_total_ = 0;
+    uint64_t chunk_out_total_ = 0;
+    uint64_t rate_bytes_ = 0;
+    int64_t rate_start_ns_ = 0;
+    std::thread thread_;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_MCAP_RECORDER_HPP
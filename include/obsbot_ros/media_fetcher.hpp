@@ -0,0 +1,130 @@
+#ifndef OBSBOT_MEDIA_FETCHER_HPP
+#define OBSBOT_MEDIA_FETCHER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Copies the files a device writes to its card while it is still writing more, eg. during a burst. A batch
+ *         is opened before the device is triggered; every new file the device reports (CameraFileNotify) is queued
+ *         at once and copied by a few worker threads from the card, as mounted on this host, into one directory
+ *         per batch. Without a mounted card the files are only listed. wait() returns when every expected file is
+ *         on the host, with the time from the trigger to the first and the last of them.
+ */
+class MediaFetcher
+{
+public:
+    struct Options
+    {
+        std::string source_root;                /// the card as mounted on this host, eg. over mtp; empty lists only
+        std::string directory = "/tmp/obsbot_media";
+        size_t workers = 3;
+        size_t chunk_bytes = 1 << 20;
+        uint32_t open_retries = 10;             /// a reported file may show up on the mount a little later
+        int64_t retry_ns = 50000000;
+    };
+
+    struct File
+    {
+        std::string device_path;                /// relative to the card root
+        std::string local_path;                 /// empty while not copied, or when only listing
+        bool ok = false;
+        int64_t reported_ns = 0;                /// steady clock
+        int64_t done_ns = 0;
+    };
+
+    struct Batch
+    {
+        uint32_t expected = 0;
+        int64_t trigger_ns = 0;                 /// steady clock
+        std::string directory;
+        std::vector<File> files;                /// in the order the device reported them
+        uint32_t done = 0;                      /// copied or failed
+        uint32_t failed = 0;
+        int64_t first_ns = 0;                   /// first and last file done, steady clock
+        int64_t last_ns = 0;
+    };
+
+    struct Stats
+    {
+        uint64_t batches = 0;
+        uint64_t files = 0;
+        uint64_t failed = 0;
+        uint64_t ignored = 0;                   /// reported while no batch was open, or past its count
+        uint64_t bytes = 0;
+    };
+
+    explicit MediaFetcher(const Options &options);
+
+    /// waits for the copies in progress
+    ~MediaFetcher();
+
+    MediaFetcher(const MediaFetcher &) = delete;
+
+    MediaFetcher &operator=(const MediaFetcher &) = delete;
+
+    /**
+     * @brief  Open a batch, before the device is triggered. A batch still open is dropped.
+     * @param  [in] name   Subdirectory of the batch.
+     */
+    void begin(uint32_t count, const std::string &name, int64_t trigger_ns);
+
+    /// a new file on the card, from the sdk thread; never blocks on a copy
+    void add(const std::string &device_path, int64_t reported_ns);
+
+    /**
+     * @brief  Wait until every expected file is done and close the batch.
+     * @param  [out] batch   The batch as far as it got.
+     * @return  false on timeout.
+     */
+    bool wait(std::chrono::milliseconds timeout, Batch &batch);
+
+    /// close the batch without waiting, eg. when the trigger failed
+    void cancel();
+
+    Stats stats() const;
+
+private:
+    struct Job
+    {
+        uint64_t generation;
+        size_t index;
+        std::string from;
+        std::string to;
+    };
+
+    void run();
+
+    /// false if the source never showed up or a read or write failed
+    bool copy(const Job &job, std::vector<uint8_t> &buffer, uint64_t &bytes);
+
+    /// with the lock held
+    void finish(size_t index, bool ok, const std::string &local_path, int64_t now_ns);
+
+    Options options_;
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    std::deque<Job> jobs_;
+    Batch batch_;
+    bool open_ = false;
+    bool dir_ok_ = true;                        /// the batch directory could be made
+    uint64_t generation_ = 0;                   /// copies of a closed batch are not counted in the next one
+    bool stop_ = false;
+    Stats stats_;
+    std::vector<std::thread> threads_;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_MEDIA_FETCHER_HPP
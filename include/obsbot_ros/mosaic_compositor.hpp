@@ -0,0 +1,129 @@
+#ifndef OBSBOT_MOSAIC_COMPOSITOR_HPP
+#define OBSBOT_MOSAIC_COMPOSITOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "frame_sink.hpp"
+#include "image_ops.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Composes the latest raw frame of N cameras into one I420 frame, either as a grid or as one main picture with
+ *         the others inset. Every source is scaled straight into its rectangle of a pooled output buffer, keeping its
+ *         aspect ratio, and inset pictures are alpha blended. The producers only swap a frame reference in a slot, and
+ *         compose() takes whatever is there without waiting for them; a source without a new frame is drawn from the
+ *         one it used last time. Encoded frames can not be composed and leave their tile black.
+ */
+class MosaicCompositor
+{
+public:
+    enum class Layout
+    {
+        Grid,
+        PictureInPicture,
+    };
+
+    struct Options
+    {
+        Layout layout = Layout::Grid;
+        int32_t width = 1280;                   /// output size, rounded down to even numbers
+        int32_t height = 720;
+        size_t sources = 1;
+        size_t pip_main = 0;                    /// source filling the frame in PictureInPicture
+        double pip_scale = 0.25;                /// inset size relative to the output
+        uint32_t pip_alpha = 256;               /// inset opacity, 0..256
+        int32_t margin = 16;                    /// pixels between insets and the border
+        size_t pool_size = 3;                   /// output buffers
+    };
+
+    struct Stats
+    {
+        uint64_t composed = 0;
+        uint64_t dropped = 0;                   /// compose() found every output buffer in use
+        uint64_t repeated = 0;                  /// tiles drawn again from an already composed frame
+        uint64_t unsupported = 0;               /// source frames that are not raw yuv
+        double compose_ms = 0.0;                /// moving average
+        double max_compose_ms = 0.0;
+    };
+
+    /// whether anyone wants the composed frames right now, eg. the mosaic topic has subscribers
+    using DemandCallback = std::function<bool()>;
+
+    /// without a demand callback the inputs never keep a camera awake
+    explicit MosaicCompositor(const Options &options, DemandCallback demand = nullptr);
+
+    MosaicCompositor(const MosaicCompositor &) = delete;
+
+    MosaicCompositor &operator=(const MosaicCompositor &) = delete;
+
+    /// sink feeding one source, valid as long as the compositor
+    const std::shared_ptr<FrameSink> &input(size_t source) const
+    { return inputs_[source]; }
+
+    /**
+     * @brief  Compose the current frames of all sources. Call from one thread at a time.
+     * @param  [in] stamp_ns   Stamp of the output frame.
+     * @return  Empty when no output buffer is free.
+     */
+    FrameRef compose(int64_t stamp_ns);
+
+    const Options &options() const
+    { return options_; }
+
+    Stats stats() const;
+
+private:
+    class Input;
+
+    struct Rect
+    {
+        int32_t x = 0;
+        int32_t y = 0;
+        int32_t width = 0;
+        int32_t height = 0;
+    };
+
+    struct Source
+    {
+        std::mutex mutex;                       /// guards latest, held only for a reference swap
+        FrameRef latest;
+        std::mutex draw_mutex;                  /// guards held while it is drawn
+        FrameRef held;
+        uint64_t drawn_sequence = 0;
+        Rect tile;
+        uint32_t alpha = 256;
+        image_ops::PlaneScaler scalers[3];
+    };
+
+    void store(size_t source, const FrameRef &frame);
+
+    void release(size_t source);
+
+    void layoutTiles();
+
+    void clear(Frame &out) const;
+
+    bool draw(Source &source, Frame &out);
+
+    Options options_;
+    DemandCallback demand_callback_;
+    std::vector<std::unique_ptr<Source>> sources_;
+    std::vector<std::shared_ptr<FrameSink>> inputs_;
+    std::vector<size_t> order_;                 /// draw order, the main picture of PictureInPicture first
+    FramePool pool_;
+    uint64_t sequence_ = 0;
+
+    mutable std::mutex stats_mutex_;
+    Stats stats_;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_MOSAIC_COMPOSITOR_HPP
@@ -0,0 +1,94 @@
+#ifndef OBSBOT_MOTION_TRACKER_HPP
+#define OBSBOT_MOTION_TRACKER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frame_pool.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Host side fallback tracker for cameras whose AI is off or missing. The luma plane is decimated to a coarse
+ *         grid, differenced against the previous grid with diffMask(), and the largest connected blob of changed
+ *         cells becomes the target; its center and box are smoothed across frames and held for a few frames without
+ *         motion. A 1080p frame at the default decimation of 8 is a 240x135 grid, which keeps a frame well below a
+ *         millisecond on one core. Differencing assumes a still camera, call reset() whenever the view moves.
+ */
+class MotionTracker
+{
+public:
+    struct Options
+    {
+        int32_t decimation = 8;                 /// source pixels per grid cell and axis
+        uint8_t threshold = 20;                 /// luma difference of a changed cell
+        float min_area = 0.002f;                /// smallest blob, fraction of the grid
+        float smoothing = 0.4f;                 /// weight of a new measurement, 0..1
+        uint32_t hold_frames = 15;              /// frames without motion before the target is dropped
+    };
+
+    /// normalized image coordinates, 0..1
+    struct Target
+    {
+        bool valid = false;
+        float x = 0.5f;                         /// center
+        float y = 0.5f;
+        float x_min = 0.0f;
+        float y_min = 0.0f;
+        float x_max = 0.0f;
+        float y_max = 0.0f;
+        float score = 0.0f;                     /// share of the changed cells that belong to the blob
+        int64_t stamp_ns = 0;                   /// of the frame it was measured in
+    };
+
+    struct Stats
+    {
+        uint64_t frames = 0;
+        uint64_t motion_frames = 0;             /// frames with a blob
+        uint64_t unsupported = 0;               /// frames without a luma plane
+        double process_us = 0.0;                /// moving average
+        double max_process_us = 0.0;
+    };
+
+    explicit MotionTracker(const Options &options);
+
+    /**
+     * @brief  Measure one frame.
+     * @return  false if the frame has no usable luma plane, eg. an encoded format.
+     */
+    bool process(const Frame &frame);
+
+    /// forget the previous frame and the target
+    void reset();
+
+    const Target &target() const
+    { return target_; }
+
+    const Stats &stats() const
+    { return stats_; }
+
+private:
+    void decimate(const uint8_t *data, int32_t stride, int32_t step);
+
+    /// largest 4-connected blob of the mask, false if it is smaller than min_area
+    bool largestBlob(size_t changed, Target &out);
+
+    Options options_;
+    Stats stats_;
+    Target target_;
+    uint32_t missed_ = 0;
+
+    int32_t grid_width_ = 0;
+    int32_t grid_height_ = 0;
+    bool have_previous_ = false;
+    std::vector<uint8_t> current_;
+    std::vector<uint8_t> previous_;
+    std::vector<uint8_t> mask_;
+    std::vector<int32_t> stack_;                /// flood fill, one entry per cell at most
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_MOTION_TRACKER_HPP
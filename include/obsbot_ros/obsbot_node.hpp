@@ -0,0 +1,475 @@
+#ifndef OBSBOT_NODE_HPP
+#define OBSBOT_NODE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <rclcpp/rclcpp.hpp>
+#include <rclcpp_lifecycle/lifecycle_node.hpp>
+#include <rclcpp_lifecycle/lifecycle_publisher.hpp>
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
+#include <geometry_msgs/msg/vector3.hpp>
+#include <geometry_msgs/msg/vector3_stamped.hpp>
+#include <sensor_msgs/msg/compressed_image.hpp>
+#include <sensor_msgs/msg/image.hpp>
+#include <std_msgs/msg/float32.hpp>
+#include <std_msgs/msg/string.hpp>
+#include <std_srvs/srv/trigger.hpp>
+#include <obsbot_ros/msg/ai_status.hpp>
+#include <obsbot_ros/msg/detection_array.hpp>
+#include <obsbot_ros/srv/burst.hpp>
+#include <obsbot_ros/srv/snapshot.hpp>
+
+#include "ai_status_poller.hpp"
+#include "auto_framer.hpp"
+#include "bandwidth_planner.hpp"
+#include "device_registry.hpp"
+#include "digital_ptz.hpp"
+#include "devs.hpp"
+#include "diagnostics_aggregator.hpp"
+#include "event_buffer.hpp"
+#include "executor_layout.hpp"
+#include "frame_pool.hpp"
+#include "frame_sink.hpp"
+#include "horizon_leveler.hpp"
+#include "jpeg_encoder.hpp"
+#include "media_fetcher.hpp"
+#include "motion_tracker.hpp"
+#include "power_manager.hpp"
+#include "privacy_mask.hpp"
+#include "rtsp_client.hpp"
+#include "snapshot_sink.hpp"
+#include "stabilizer.hpp"
+#include "stream_adapter.hpp"
+#include "target_selector.hpp"
+#include "telemetry_overlay.hpp"
+#include "thermal_governor.hpp"
+#include "timelapse_scheduler.hpp"
+#include "v4l2_capture.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  ROS driver for one OBSBOT camera, as a lifecycle node.
+ *         configure  -> find the device, cache its ranges, open the video node and allocate the frame pool.
+ *                       A device in network mode is switched to rtsp instead and its stream is received undecoded.
+ *         activate   -> start streaming.
+ *         deactivate -> stop streaming, the device handle, cached ranges and buffers are kept.
+ *         cleanup    -> close the video node and free the buffers, the device handle and cache are kept.
+ *         Every callback is registered in the group of its CallbackRole, so the slow SDK calls of housekeeping and
+ *         status never sit in front of a gimbal command.
+ */
+class ObsbotNode : public rclcpp_lifecycle::LifecycleNode
+{
+public:
+    using CallbackReturn = rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn;
+
+    explicit ObsbotNode(const rclcpp::NodeOptions &options = rclcpp::NodeOptions());
+
+    ~ObsbotNode() override;
+
+    const CallbackGroups &callbackGroups() const
+    { return groups_; }
+
+    /**
+     * @brief  Hand every captured frame to a sink as well, on the capture thread. Add sinks before configure.
+     */
+    void addFrameSink(std::shared_ptr<FrameSink> sink);
+
+protected:
+    CallbackReturn on_configure(const rclcpp_lifecycle::State &state) override;
+
+    CallbackReturn on_activate(const rclcpp_lifecycle::State &state) override;
+
+    CallbackReturn on_deactivate(const rclcpp_lifecycle::State &state) override;
+
+    CallbackReturn on_cleanup(const rclcpp_lifecycle::State &state) override;
+
+    CallbackReturn on_shutdown(const rclcpp_lifecycle::State &state) override;
+
+private:
+    /// latest gimbal command, only the newest one is sent on each control tick
+    struct GimbalCommand
+    {
+        enum Type
+        {
+            None,
+            Angle,
+            Speed,
+        } type = None;
+        double pitch = 0.0;
+        double yaw = 0.0;
+        double roll = 0.0;
+    };
+
+    /// read once per device and kept across every transition except shutdown
+    struct DeviceCache
+    {
+        bool valid = false;
+        std::vector<Device::VideoFormatInfo> formats;
+        Device::UvcParamRange zoom_range;
+    };
+
+    bool waitForDevice(std::chrono::milliseconds timeout);
+
+    void onDevChanged(DeviceRegistry::Handle device, bool in_out);
+
+    void onDevStatusUpdated(const void *data);
+
+    /// tail air events, runs on the sdk thread
+    void onDevEvent(int32_t event_type, const void *result);
+
+    void onGimbalAngle(const geometry_msgs::msg::Vector3::SharedPtr msg);
+
+    void onGimbalSpeed(const geometry_msgs::msg::Vector3::SharedPtr msg);
+
+    void onZoom(const std_msgs::msg::Float32::SharedPtr msg);
+
+    void onDetections(const msg::DetectionArray::SharedPtr msg);
+
+    void onPtzVelocity(const geometry_msgs::msg::Vector3::SharedPtr msg);
+
+    void onPtzPosition(const geometry_msgs::msg::Vector3::SharedPtr msg);
+
+    void controlTick();
+
+    void statusTick();
+
+    void diagnosticsTick();
+
+    void aiStatusTick();
+
+    /// gimbal attitude for the stabilizer and the leveler, status group
+    void attitudeTick();
+
+    /// runs on the sdk thread
+    void onAiStatus(const Device::AiStatus &status, int64_t latency_ns);
+
+    void captureTick();
+
+    /// privacy regions, in place on the capture thread
+    void maskFrame(Frame &frame);
+
+    /// stamp, sn, zoom, recording state and gimbal angles burned into the frame, capture thread
+    void drawOverlay(Frame &frame);
+
+    /// fallback tracking on the capture thread
+    void trackMotion(const Frame &frame);
+
+    /// turn the latest motion target into a pan/tilt, gimbal or roi command, control group
+    void motionControl(int64_t now_ns);
+
+    bool motionActive() const;
+
+    /// the tracker is active and gets raw frames, the same for the capture thread and the power manager
+    bool motionFed() const;
+
+    /// gimbal aided stabilization on the capture thread
+    void publishStabilized(const Frame &frame);
+
+    /// roll compensation on the capture thread
+    void publishLeveled(const Frame &frame);
+
+    /// counters of the frame stages into the diagnostics, on the capture thread where the stages run
+    void updateStageDiagnostics();
+
+    /// timelapse transitions in housekeeping: wake and stream, give up, or put the device back to sleep
+    void timelapseTick();
+
+    /// fire the timelapse timer once after the delay, with timelapse_mutex_ held
+    void armTimelapse(int64_t delay_ns);
+
+    /// demand driven sleep, status group: nothing wants frames for a while, or demand on a sleeping camera
+    void powerTick();
+
+    /// thermal and battery throttling, status group: one reading of the tail air status per tick
+    void thermalTick();
+
+    /// bitrate and ai over the sdk, resolution and frame rate by reopening the usb capture
+    void applyThermal(const ThermalGovernor::Rung &rung, bool top);
+
+    /// after captureFormat() changed, a running stream is restarted in the new format
+    void reopenCapture();
+
+    /// take part in the process wide usb bandwidth plan, before the capture is opened
+    void joinPlan();
+
+    void logPlan();
+
+    /// network mode, link statistics and stream adaptation
+    void networkTick();
+
+    /// runs on the rtsp receive thread
+    void onAccessUnit(const AccessUnit &au, RtpDepacketizer::Codec codec, int64_t stamp_ns);
+
+    void publishFrame(const Frame &frame);
+
+    void onDownloadImage(const std_srvs::srv::Trigger::Request::SharedPtr request,
+                         std_srvs::srv::Trigger::Response::SharedPtr response);
+
+    void onEventDump(const std_srvs::srv::Trigger::Request::SharedPtr request,
+                     std_srvs::srv::Trigger::Response::SharedPtr response);
+
+    /// deferred reply, waiting for the next frame or a device photo is done in the media group
+    void onSnapshot(const std::shared_ptr<rmw_request_id_t> header, const srv::Snapshot::Request::SharedPtr request);
+
+    /// wake_ns: the expected wake latency of a sleeping camera, added to the wait for the next frame
+    void takeSnapshot(const srv::Snapshot::Request &request, bool next, int64_t wake_ns,
+                      srv::Snapshot::Response &response);
+
+    /// tail air, take a photo on the card and wait for the device to report its file
+    bool takeDevicePhoto(srv::Snapshot::Response &response);
+
+    /// deferred reply, the burst is taken in the media group
+    void onBurst(const std::shared_ptr<rmw_request_id_t> header, const srv::Burst::Request::SharedPtr request);
+
+    void takeBurst(const srv::Burst::Request &request, srv::Burst::Response &response);
+
+    /// run a job in the media group, after the ones already queued
+    void queueMediaJob(std::function<void()> job);
+
+    /// every queued media job, one after the other
+    void mediaTick();
+
+    /// pre-warm ahead of a scheduled consumer, answers with the learned wake latency
+    void onPowerWake(const std_srvs::srv::Trigger::Request::SharedPtr request,
+                     std_srvs::srv::Trigger::Response::SharedPtr response);
+
+    /// @return  directory of the dump, empty if the buffer holds nothing
+    std::string triggerEvent(const std::string &reason);
+
+    rcl_interfaces::msg::SetParametersResult onSetParameters(const std::vector<rclcpp::Parameter> &params);
+
+    /// keep the copy of a parameter the control path reads, it must not wait for the parameter lock
+    void cacheParameter(const rclcpp::Parameter &param);
+
+    V4l2Capture::Format requestedFormat();
+
+    /// the requested format as the bandwidth plan and the thermal rung allow it
+    V4l2Capture::Format captureFormat();
+
+    bool openCapture();
+
+    bool openStream();
+
+    bool startStream();
+
+    /// send the settings that differ from the applied ones, returns true if the stream has to be reopened
+    bool applyRung(const StreamAdapter::Rung &rung);
+
+    std::string streamUrl();
+
+    /// start or stop the capture timer, under capture_timer_mutex_
+    void runCaptureTimer(bool run);
+
+    void closeCapture();
+
+    /// before the frame pool is freed or replaced
+    void releaseSinks();
+
+    /// cancel the timers and deactivate the publishers of on_activate, whether activated or not
+    void deactivateEntities();
+
+    void logTransition(const char *transition, std::chrono::steady_clock::time_point start);
+
+    /// count an sdk call for the error rate in diagnostics, returns ret unchanged
+    int32_t sdkCall(int32_t ret);
+
+    bool hasGimbal() const;
+
+    bool hasMotorAngle() const;
+
+    bool hasTargetSelection() const;
+
+    bool hasAiStatus() const;
+
+    bool hasRoi() const;
+
+    bool hasDigitalPtz() const;
+
+    bool hasSuspendTime() const;
+
+    CallbackGroups groups_;
+
+    std::string serial_;
+    /// interned serial_, kNoDevice until a device is bound
+    DeviceRegistry::Handle device_ = DeviceRegistry::kNoDevice;
+    uint32_t registry_listener_ = 0;
+    std::shared_ptr<Device> dev_;
+    ObsbotProductType product_ = ObsbotProdButt;
+    DeviceCache cache_;
+    std::mutex dev_mutex_;
+    std::condition_variable dev_cv_;
+
+    std::mutex status_mutex_;
+    Device::CameraStatus status_{};
+    bool status_valid_ = false;
+
+    /// diagnostics, aggregated on every status tick and published on the slower diagnostics timer
+    std::unique_ptr<DiagnosticsAggregator> diagnostics_;
+    diagnostic_msgs::msg::DiagnosticArray diagnostics_msg_;
+    std::mutex diagnostics_mutex_;
+    uint32_t diagnostics_tick_count_ = 0;
+    std::atomic<int64_t> diagnostics_full_every_{10}; /// diagnostics.full_every
+    std::atomic<uint64_t> sdk_calls_{0};
+    std::atomic<uint64_t> sdk_errors_{0};
+    uint64_t last_sdk_errors_ = 0;
+    uint64_t last_frames_captured_ = 0;
+    std::chrono::steady_clock::time_point last_status_tick_{};
+    uint64_t last_ai_responses_ = 0;
+    int64_t stage_diagnostics_ns_ = 0;          /// capture thread, last updateStageDiagnostics()
+
+    /// ai status, polled in the status group and published from the sdk thread on change
+    std::unique_ptr<AiStatusPoller> ai_poller_;
+    msg::AiStatus ai_status_msg_;
+
+    /// control state, only touched from the control group
+    GimbalCommand pending_gimbal_;
+    bool pending_zoom_ = false;
+    float zoom_ = 1.0f;
+    std::atomic<float> applied_zoom_{1.0f};     /// last zoom the camera took, read by the capture thread
+    std::chrono::nanoseconds control_period_{};
+    std::chrono::steady_clock::time_point last_control_tick_{};
+    std::unique_ptr<TargetSelector> selector_;
+    std::unique_ptr<AutoFramer> framer_;
+    int32_t roi_type_ = 1;
+    int32_t roi_view_ = 0;
+    std::unique_ptr<DigitalPtz> ptz_;
+    geometry_msgs::msg::Vector3Stamped ptz_state_msg_;
+    int64_t ptz_diagnostics_ns_ = 0;            /// control group, last update of the ptz diagnostics
+
+    /// motion fallback tracker, measured on the capture thread and read by the control group
+    std::string motion_mode_;                   /// auto, on or off
+    std::unique_ptr<MotionTracker> motion_;
+    std::mutex motion_mutex_;
+    MotionTracker::Target motion_target_;
+    msg::DetectionArray motion_msg_;
+    std::atomic<int64_t> view_settle_ns_{0};    /// the view moves until then, differencing is paused
+    std::atomic<int64_t> settle_ns_{0};         /// motion.settle_ms
+    std::atomic<double> motion_deadband_{0.1};  /// motion.*, read by the control group
+    std::atomic<double> motion_gain_{1.0};
+    std::atomic<double> motion_gimbal_speed_{30.0};
+    std::atomic<int32_t> ai_main_mode_{-1};     /// from the ai status poller, -1 unknown
+    bool motion_driving_ = false;               /// the last gimbal speed came from the tracker
+    std::vector<DetectionBox> detection_boxes_;
+
+    /// capture state, guarded by capture_mutex_ between the capture group and transitions
+    std::mutex capture_mutex_;
+    std::mutex capture_timer_mutex_;            /// capture_timer_, replaced by openCapture; taken last
+    V4l2Capture capture_;
+    V4l2Capture::Format capture_format_;
+    std::atomic<bool> capture_raw_{false};      /// capture_format_ is not encoded, read without the capture lock
+    std::unique_ptr<FramePool> pool_;
+    sensor_msgs::msg::Image image_msg_;
+    sensor_msgs::msg::CompressedImage compressed_msg_;
+    std::atomic<uint64_t> frames_captured_{0};
+    std::atomic<uint64_t> frames_dropped_{0};
+    std::vector<std::shared_ptr<FrameSink>> sinks_;
+
+    /// pre-event buffer, one of the sinks; triggered by service, topic or device event
+    std::shared_ptr<EventBuffer> event_buffer_;
+    std::vector<int64_t> trigger_events_;
+
+    /// stills from the newest frame, one of the sinks; served in housekeeping, waits in the media group
+    std::shared_ptr<SnapshotSink> snapshot_;
+    std::mutex jpeg_mutex_;
+    JpegEncoder jpeg_;
+    std::mutex photo_mutex_;
+    std::condition_variable photo_cv_;
+    uint64_t photo_count_ = 0;                  /// new photo files the device reported
+    std::string photo_path_;
+    /// copies the photos of a burst off the card while the device is still taking them
+    std::unique_ptr<MediaFetcher> media_;
+    /// bursts and device photos waiting for the media group, they take turns on the camera
+    std::mutex media_jobs_mutex_;
+    std::deque<std::function<void()>> media_jobs_;
+
+    /// timelapse, the device sleeps between shots; the shot is taken on the capture thread
+    std::unique_ptr<TimelapseScheduler> timelapse_;
+    std::mutex timelapse_mutex_;                /// the scheduler and its timer, taken after capture_mutex_
+    rclcpp::TimerBase::SharedPtr timelapse_timer_; /// made with the scheduler, only its period changes
+
+    /// demand driven sleep outside timelapse; frames are measured on the capture thread
+    std::unique_ptr<PowerManager> power_;
+    std::mutex power_mutex_;                    /// the manager, taken after capture_mutex_
+    std::atomic<bool> power_asleep_{false};     /// the device was put to sleep and not woken since
+    std::atomic<bool> power_privacy_{false};    /// power.sleep_mode is privacy
+    uint64_t power_samples_ = 0;                /// wake latencies published so far
+
+    /// thermal and battery throttling of a tail air; events arrive on the sdk thread
+    std::unique_ptr<ThermalGovernor> thermal_;
+    std::mutex thermal_mutex_;
+    Device::DevVideoBitLevelType thermal_bitrate_ = Device::DevVideoBitLevelDefault; /// the device's own, top rung
+    Device::DevVideoBitLevelType applied_bitrate_ = Device::DevVideoBitLevelDefault;
+    uint64_t thermal_frames_ = 0;               /// frames_captured_ at the last tick
+    int64_t thermal_tick_ns_ = 0;
+
+    /// usb bandwidth plan across the cameras of this process; set by the planner, applied in the status group
+    bool bandwidth_ = false;
+    std::atomic<bool> plan_changed_{false};
+
+    /// stabilization, leveling, privacy masks and the overlay: attitude from the status group, frames on capture
+    std::shared_ptr<AttitudeTrack> attitude_;
+    std::unique_ptr<PrivacyMask> privacy_;
+    std::unique_ptr<TelemetryOverlay> overlay_;
+    std::atomic<bool> camera_recording_{false}; /// tail air status, for the overlay
+    std::unique_ptr<Stabilizer> stabilizer_;
+    sensor_msgs::msg::Image stabilized_msg_;
+    std::unique_ptr<HorizonLeveler> leveler_;
+    sensor_msgs::msg::Image leveled_msg_;
+
+    /// network mode, access units arrive on the rtsp thread instead of the capture timer
+    bool network_ = false;
+    RtspClient rtsp_;
+    RtspClient::Options rtsp_options_;
+    uint64_t stream_sequence_ = 0;
+    std::unique_ptr<StreamAdapter> adapter_;
+    StreamAdapter::Rung applied_rung_;
+    bool rung_applied_ = false;
+
+    rclcpp::Subscription<geometry_msgs::msg::Vector3>::SharedPtr gimbal_angle_sub_;
+    rclcpp::Subscription<geometry_msgs::msg::Vector3>::SharedPtr gimbal_speed_sub_;
+    rclcpp::Subscription<std_msgs::msg::Float32>::SharedPtr zoom_sub_;
+    rclcpp::Subscription<msg::DetectionArray>::SharedPtr detections_sub_;
+    rclcpp::Subscription<geometry_msgs::msg::Vector3>::SharedPtr ptz_velocity_sub_;
+    rclcpp::Subscription<geometry_msgs::msg::Vector3>::SharedPtr ptz_position_sub_;
+    rclcpp::Subscription<std_msgs::msg::String>::SharedPtr event_trigger_sub_;
+    rclcpp_lifecycle::LifecyclePublisher<geometry_msgs::msg::Vector3Stamped>::SharedPtr gimbal_state_pub_;
+    rclcpp_lifecycle::LifecyclePublisher<geometry_msgs::msg::Vector3Stamped>::SharedPtr ptz_state_pub_;
+    rclcpp_lifecycle::LifecyclePublisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr diagnostics_pub_;
+    rclcpp_lifecycle::LifecyclePublisher<msg::AiStatus>::SharedPtr ai_status_pub_;
+    rclcpp_lifecycle::LifecyclePublisher<msg::DetectionArray>::SharedPtr motion_pub_;
+    rclcpp_lifecycle::LifecyclePublisher<sensor_msgs::msg::Image>::SharedPtr image_pub_;
+    rclcpp_lifecycle::LifecyclePublisher<sensor_msgs::msg::CompressedImage>::SharedPtr compressed_pub_;
+    rclcpp_lifecycle::LifecyclePublisher<sensor_msgs::msg::Image>::SharedPtr stabilized_pub_;
+    rclcpp_lifecycle::LifecyclePublisher<sensor_msgs::msg::Image>::SharedPtr leveled_pub_;
+    rclcpp_lifecycle::LifecyclePublisher<std_msgs::msg::Float32>::SharedPtr wake_latency_pub_;
+    rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr download_srv_;
+    rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr event_dump_srv_;
+    rclcpp::Service<srv::Snapshot>::SharedPtr snapshot_srv_;
+    rclcpp::Service<srv::Burst>::SharedPtr burst_srv_;
+    rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr power_wake_srv_;
+    rclcpp::TimerBase::SharedPtr control_timer_;
+    rclcpp::TimerBase::SharedPtr status_timer_;
+    rclcpp::TimerBase::SharedPtr diagnostics_timer_;
+    rclcpp::TimerBase::SharedPtr ai_status_timer_;
+    rclcpp::TimerBase::SharedPtr attitude_timer_;
+    rclcpp::TimerBase::SharedPtr capture_timer_;
+    rclcpp::TimerBase::SharedPtr network_timer_;
+    rclcpp::TimerBase::SharedPtr power_timer_;
+    rclcpp::TimerBase::SharedPtr thermal_timer_;
+    rclcpp::TimerBase::SharedPtr media_timer_;  /// zero period, kept cancelled and reset by queueMediaJob
+    rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr param_cb_handle_;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_NODE_HPP
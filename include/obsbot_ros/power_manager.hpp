@@ -0,0 +1,92 @@
+#ifndef OBSBOT_POWER_MANAGER_HPP
+#define OBSBOT_POWER_MANAGER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Demand driven sleep of one camera. On every check the node reports whether anything wants frames, eg.
+ *         subscribers, recorders or a pre-warm hold. After idle time without demand the camera is put to sleep,
+ *         and on demand it is woken again. The time from the wake to the first frame is learned, so scheduled
+ *         consumers can wake the camera that much ahead of time. A wake that brings no frame is issued again after
+ *         a timeout. Not thread safe; all times are steady clock.
+ */
+class PowerManager
+{
+public:
+    enum class State
+    {
+        Awake,
+        Asleep,
+        Waking,                                 /// wake issued, no frame yet
+    };
+
+    enum class Action
+    {
+        None,
+        Sleep,
+        Wake,
+    };
+
+    struct Options
+    {
+        int64_t idle_ns = 30000000000;          /// without demand before the camera sleeps
+        int64_t initial_latency_ns = 3000000000; /// wake to first frame until one is measured
+        int64_t wake_timeout_ns = 10000000000;  /// the wake is issued again
+        size_t history = 8;                     /// latency samples the estimate is taken over
+    };
+
+    struct Stats
+    {
+        uint64_t sleeps = 0;
+        uint64_t wakes = 0;
+        uint64_t wake_retries = 0;
+        uint64_t samples = 0;                   /// wakes that saw their first frame
+        double latency_ms = 0.0;                /// wake to first frame, last measured
+        double max_latency_ms = 0.0;
+        double asleep_s = 0.0;                  /// in total, up to the last wake
+    };
+
+    explicit PowerManager(const Options &options);
+
+    /// the camera is streaming as of now
+    void reset(int64_t now_ns);
+
+    /// @return  what to do with the camera
+    Action update(bool demand, int64_t now_ns);
+
+    /// demand until then, eg. a pre-warm ahead of a scheduled consumer
+    void hold(int64_t until_ns);
+
+    /// every captured frame; the first one after a wake is measured
+    void onFrame(int64_t frame_ns);
+
+    State state() const
+    { return state_; }
+
+    /// the longest of the last few wakes, what a consumer should wake ahead
+    int64_t latencyEstimate() const;
+
+    const Stats &stats() const
+    { return stats_; }
+
+private:
+    Options options_;
+    Stats stats_;
+    State state_ = State::Awake;
+    int64_t last_demand_ns_ = 0;
+    int64_t hold_until_ns_ = 0;
+    int64_t sleep_ns_ = 0;
+    int64_t wake_ns_ = 0;                       /// first wake call, the latency is measured from here
+    int64_t retry_ns_ = 0;                      /// last wake call
+    std::vector<int64_t> latencies_;            /// ring of the last samples
+    size_t next_latency_ = 0;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_POWER_MANAGER_HPP
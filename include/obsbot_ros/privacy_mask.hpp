@@ -0,0 +1,133 @@
+#ifndef OBSBOT_PRIVACY_MASK_HPP
+#define OBSBOT_PRIVACY_MASK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "frame_pool.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Blacks out or pixelates polygons directly in a raw frame, before it is published or handed to any sink.
+ *         Regions are given either in normalized image coordinates, fixed on the picture, or as gimbal yaw/pitch in
+ *         degrees, which are projected through the current gimbal attitude and zoom so the mask stays on the object
+ *         while the camera pans, tilts and zooms. Each plane is filled span by span along the scanlines of the
+ *         polygon with image_ops::fillSamples; pixelation fills with block averages from image_ops::sumSamples.
+ *         Buffers only grow, a frame allocates nothing once the largest region has been seen.
+ */
+class PrivacyMask
+{
+public:
+    enum class Mode
+    {
+        Black,
+        Pixelate,
+    };
+
+    enum class Space
+    {
+        Image,                                  /// x, y in 0..1 of the picture
+        Gimbal,                                 /// yaw, pitch in degrees, same directions as the gimbal state
+    };
+
+    struct Point
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+    };
+
+    struct Region
+    {
+        Mode mode = Mode::Black;
+        Space space = Space::Image;
+        std::vector<Point> points;
+    };
+
+    struct Options
+    {
+        std::vector<Region> regions;
+        double hfov_deg = 78.0;                 /// horizontal field of view at zoom 1, for gimbal regions
+        int32_t block = 24;                     /// pixelation block, luma pixels
+        bool blank_without_view = true;         /// black out the whole frame while gimbal regions can not be placed
+    };
+
+    /// where the camera looks, for gimbal regions
+    struct View
+    {
+        bool valid = false;
+        float roll = 0.0f;                      /// degrees
+        float pitch = 0.0f;
+        float yaw = 0.0f;
+        float zoom = 1.0f;
+    };
+
+    struct Stats
+    {
+        uint64_t frames = 0;
+        uint64_t blanked = 0;                   /// frames blacked out for want of a view
+        uint64_t unsupported = 0;               /// encoded or rgb frames, left as they are
+        double process_us = 0.0;                /// moving average
+        double max_process_us = 0.0;
+    };
+
+    /**
+     * @brief  Parse one region, "<black|pixelate> <image|gimbal> x,y x,y x,y ...".
+     * @return  false for a malformed text or fewer than three points.
+     */
+    static bool parse(const std::string &text, Region &out);
+
+    explicit PrivacyMask(const Options &options);
+
+    /// some region is in gimbal coordinates, apply() needs a valid view
+    bool needsView() const
+    { return needs_view_; }
+
+    /**
+     * @brief  Mask one frame in place.
+     * @return  false if the format has no yuv layout; the frame is left untouched.
+     */
+    bool apply(Frame &frame, const View &view);
+
+    const Stats &stats() const
+    { return stats_; }
+
+private:
+    struct Plane
+    {
+        uint8_t *data = nullptr;
+        int32_t width = 0;
+        int32_t height = 0;
+        int32_t stride = 0;
+        int32_t step = 1;
+        double scale_x = 1.0;                   /// plane samples per luma pixel
+        double scale_y = 1.0;
+        uint8_t black = 0;
+    };
+
+    /// polygon of a region in luma pixels, false if it is entirely behind the camera
+    bool project(const Region &region, const View &view, int32_t width, int32_t height);
+
+    /// scanline crossings of the projected polygon with the center of one plane row, sorted
+    void crossings(const Plane &plane, int32_t row);
+
+    void fill(const Plane &plane, Mode mode);
+
+    /// block averages of one block row, for the block columns first..last
+    void averages(const Plane &plane, int32_t row, int32_t rows, int32_t block, int32_t first, int32_t last);
+
+    Options options_;
+    Stats stats_;
+    bool needs_view_ = false;
+
+    std::vector<Point> polygon_;
+    std::vector<float> crossings_;
+    std::vector<uint8_t> averages_;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_PRIVACY_MASK_HPP
@@ -0,0 +1,81 @@
+#ifndef OBSBOT_RIG_NODE_HPP
+#define OBSBOT_RIG_NODE_HPP
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <rclcpp/rclcpp.hpp>
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
+#include <sensor_msgs/msg/image.hpp>
+#include <obsbot_ros/msg/frame_bundle.hpp>
+
+#include "frame_synchronizer.hpp"
+#include "mcap_recorder.hpp"
+#include "mosaic_compositor.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Rig of several cameras in one process. It decides which cameras belong to the rig, matches their frames by
+ *         capture stamp and publishes every complete set as one FrameBundle on ~/bundle, from its own executor rather
+ *         than from the capture thread that completed the set. The camera nodes feed it through inputs(), see
+ *         ObsbotNode::addFrameSink(). With mosaic.enabled it also composes the latest frame of every camera into one
+ *         i420 picture on ~/mosaic. With record.enabled every frame and the /diagnostics traffic go straight into an
+ *         MCAP file.
+ */
+class RigNode : public rclcpp::Node
+{
+public:
+    explicit RigNode(const rclcpp::NodeOptions &options = rclcpp::NodeOptions());
+
+    /**
+     * @brief  SNs of the rig: the "serials" parameter, or every device found during discovery. Discovery ends once
+     *         no further device has shown up for discovery_quiet_ms after the first one, or at discovery_timeout_ms.
+     */
+    std::vector<std::string> findCameras();
+
+    /**
+     * @brief  Create the synchronizer, the compositor and the recorder for these cameras, in this order. Call once
+     *         before inputs(). Camera i is expected to run as node obsbot_<i>, its frames are recorded under that name.
+     */
+    void setCameras(const std::vector<std::string> &serials);
+
+    /// sinks the camera at index has to feed
+    std::vector<std::shared_ptr<FrameSink>> inputs(size_t index) const;
+
+private:
+    /// every complete set waiting in the synchronizer, on the rig's executor
+    void bundleTick();
+
+    void publishBundle(const FrameRef *frames, size_t count, int64_t skew_ns);
+
+    void mosaicTick();
+
+    void startRecording();
+
+    void diagnosticsTick();
+
+    std::vector<std::string> serials_;
+    std::unique_ptr<FrameSynchronizer> synchronizer_;
+    std::unique_ptr<MosaicCompositor> mosaic_;
+    std::unique_ptr<McapRecorder> recorder_;
+    uint64_t recorded_dropped_ = 0;
+    msg::FrameBundle bundle_msg_;
+    sensor_msgs::msg::Image mosaic_msg_;
+    diagnostic_msgs::msg::DiagnosticArray diagnostics_msg_;
+
+    rclcpp::Publisher<msg::FrameBundle>::SharedPtr bundle_pub_;
+    rclcpp::Publisher<sensor_msgs::msg::Image>::SharedPtr mosaic_pub_;
+    rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr diagnostics_pub_;
+    rclcpp::Subscription<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr diagnostics_sub_;
+    rclcpp::TimerBase::SharedPtr bundle_timer_; /// zero period, kept cancelled and reset by the synchronizer
+    rclcpp::TimerBase::SharedPtr mosaic_timer_;
+    rclcpp::TimerBase::SharedPtr diagnostics_timer_;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_RIG_NODE_HPP
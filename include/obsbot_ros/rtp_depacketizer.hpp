@@ -0,0 +1,195 @@
+#ifndef OBSBOT_RTP_DEPACKETIZER_HPP
+#define OBSBOT_RTP_DEPACKETIZER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace obsbot_ros
+{
+
+/// One RTP packet, payload points into the buffer it was parsed from.
+struct RtpPacket
+{
+    uint8_t payload_type = 0;
+    bool marker = false;
+    uint16_t sequence = 0;
+    uint32_t timestamp = 0;
+    uint32_t ssrc = 0;
+    const uint8_t *payload = nullptr;
+    size_t payload_size = 0;
+
+    /**
+     * @brief  Parse the fixed header, csrc list, extension and padding (RFC 3550).
+     * @return  false if the packet is malformed or not RTP version 2.
+     */
+    static bool parse(const uint8_t *data, size_t size, RtpPacket &out);
+};
+
+/**
+ * @brief  Optional reordering stage. Packets are copied into preallocated slots indexed by sequence number and handed
+ *         out in order; a missing packet is skipped once the packet after it has waited max_delay_ns. A packet too
+ *         far ahead for the window waits aside while pop() releases everything queued before it, gaps included.
+ */
+class RtpJitterBuffer
+{
+public:
+    /**
+     * @param  [in] depth           Number of slots, the largest reordering distance that can be repaired.
+     * @param  [in] packet_size     Bytes preallocated per slot, eg. the path mtu; a larger packet grows its slot.
+     * @param  [in] max_delay_ns    How long a packet may wait for a missing predecessor.
+     */
+    RtpJitterBuffer(size_t depth, size_t packet_size, int64_t max_delay_ns);
+
+    /**
+     * @brief  Store a packet. Duplicates and packets older than the release point are discarded. Call pop() until it
+     *         returns false after every push().
+     * @return  false if the packet was discarded.
+     */
+    bool push(const uint8_t *data, size_t size, int64_t arrival_ns);
+
+    /**
+     * @brief  Take the next packet in sequence order.
+     * @param  [out] packet       Parsed packet, payload stays valid until the next push() or pop().
+     * @param  [out] arrival_ns   Arrival time of the packet.
+     * @param  [in] now_ns        Current time, used to give up on missing packets.
+     * @return  true if a packet was released.
+     */
+    bool pop(RtpPacket &packet, int64_t &arrival_ns, int64_t now_ns);
+
+    void reset();
+
+    uint64_t skipped() const
+    { return skipped_; }
+
+private:
+    struct Slot
+    {
+        bool used = false;
+        uint16_t sequence = 0;
+        int64_t arrival_ns = 0;
+        size_t size = 0;
+        std::vector<uint8_t> data;
+    };
+
+    static void store(Slot &slot, const uint8_t *data, size_t size, uint16_t sequence, int64_t arrival_ns);
+
+    /// the packet that jumped ahead takes its slot, the queue before it is released or dropped by now
+    void placeAhead();
+
+    int64_t max_delay_ns_;
+    std::vector<Slot> slots_;
+    Slot ahead_;                                /// waits while the packets before it are released
+    bool started_ = false;
+    uint16_t next_ = 0;
+    size_t count_ = 0;
+    uint64_t skipped_ = 0;
+};
+
+/// Encoded video access unit in Annex-B format, valid until the next call into the depacketizer.
+struct AccessUnit
+{
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    uint32_t rtp_timestamp = 0;
+    bool keyframe = false;
+};
+
+/**
+ * @brief  Reassembles H.264 (RFC 6184) or H.265 (RFC 7798) RTP payloads into Annex-B access units without decoding.
+ *         Single NAL units, aggregation packets (STAP-A / AP) and fragmentation units (FU-A / FU) are supported.
+ *         An access unit ends on the marker bit or when the timestamp changes. Access units with a lost packet are
+ *         dropped because they cannot be decoded without artifacts. All buffers are allocated up front.
+ */
+class RtpDepacketizer
+{
+public:
+    enum class Codec
+    {
+        H264,
+        H265,
+    };
+
+    /**
+     * @param  [in] codec          Payload codec.
+     * @param  [in] max_au_size    Largest access unit in bytes, larger ones are dropped.
+     */
+    RtpDepacketizer(Codec codec, size_t max_au_size);
+
+    /**
+     * @brief  Parameter sets from the SDP (sprop-*), in Annex-B format. They are put in front of keyframes that do
+     *         not carry their own, so a decoder can start on any keyframe.
+     */
+    void setParameterSets(const std::vector<uint8_t> &annexb);
+
+    /**
+     * @brief  Feed one packet in sequence order. Completed access units are taken with next().
+     */
+    void push(const RtpPacket &packet);
+
+    /**
+     * @brief  Take the oldest completed access unit. Call until it returns false after every push().
+     * @param  [out] au   Access unit, valid until the next push().
+     * @return  true if an access unit was returned.
+     */
+    bool next(AccessUnit &au);
+
+    Codec codec() const
+    { return codec_; }
+
+    uint64_t lostPackets() const
+    { return lost_; }
+
+    uint64_t droppedUnits() const
+    { return dropped_; }
+
+private:
+    struct Buffer
+    {
+        std::vector<uint8_t> data;
+        size_t size = 0;
+        uint32_t timestamp = 0;
+        bool keyframe = false;
+        bool has_parameter_sets = false;
+        bool corrupt = false;
+    };
+
+    /// one unit in assembly, at most two completed by a single packet, one lent out through next()
+    static constexpr size_t kBufferCount = 4;
+
+    void appendNal(const uint8_t *nal, size_t size);
+
+    void appendStartCode();
+
+    void appendBytes(const uint8_t *data, size_t size);
+
+    void inspectNal(uint8_t header0);
+
+    /// close the current unit and queue it if it is deliverable
+    void finish();
+
+    bool handleH264(const RtpPacket &packet);
+
+    bool handleH265(const RtpPacket &packet);
+
+    Buffer &current()
+    { return buffers_[current_]; }
+
+    Codec codec_;
+    size_t max_au_size_;
+    Buffer buffers_[kBufferCount];
+    size_t current_ = 0;
+    size_t ready_[kBufferCount];
+    size_t ready_count_ = 0;
+    size_t lent_ = kBufferCount;
+    std::vector<uint8_t> parameter_sets_;
+    bool in_fragment_ = false;
+    bool have_sequence_ = false;
+    uint16_t last_sequence_ = 0;
+    uint64_t lost_ = 0;
+    uint64_t dropped_ = 0;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_RTP_DEPACKETIZER_HPP
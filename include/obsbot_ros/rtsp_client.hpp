@@ -0,0 +1,134 @@
+#ifndef OBSBOT_RTSP_CLIENT_HPP
+#define OBSBOT_RTSP_CLIENT_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rtp_depacketizer.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Minimal RTSP client for the video stream of a network camera. It runs DESCRIBE / SETUP / PLAY on its own
+ *         thread, receives RTP over TCP (interleaved) or UDP and hands out H.264 / H.265 access units without
+ *         decoding. The session is kept alive with GET_PARAMETER and reopened with a backoff when it breaks.
+ *         Authentication is not supported, the camera serves its stream without it.
+ */
+class RtspClient
+{
+public:
+    struct Options
+    {
+        std::string url;                        /// rtsp://host[:port]/path, an ipv6 host in brackets
+        bool tcp = true;                        /// interleaved over the rtsp connection, false for udp
+        bool jitter_buffer = false;             /// reorder packets, only useful with udp
+        uint32_t jitter_depth = 128;            /// packets
+        int32_t jitter_delay_ms = 40;           /// longest wait for a missing packet
+        bool map_timestamps = true;             /// stamp from the rtp clock instead of the arrival time
+        size_t max_au_size = 4 << 20;           /// bytes
+        int32_t timeout_ms = 3000;              /// request and receive timeout
+        int32_t reconnect_ms = 1000;            /// first reconnect delay, doubled up to 10 s
+    };
+
+    struct Stats
+    {
+        uint64_t packets = 0;
+        uint64_t bytes = 0;
+        uint64_t lost = 0;                      /// missing sequence numbers
+        uint64_t units = 0;                     /// access units handed out
+        uint64_t dropped_units = 0;             /// incomplete or oversized access units
+        uint32_t reconnects = 0;
+        bool connected = false;
+        double jitter_ms = 0.0;                 /// interarrival jitter (RFC 3550)
+        double delay_ms = 0.0;                  /// smoothed queueing delay above the least delayed packet
+    };
+
+    /**
+     * @brief  Called on the receive thread for every complete access unit.
+     * @param  [in] au         Access unit, valid only during the call.
+     * @param  [in] codec      Codec announced in the SDP.
+     * @param  [in] stamp_ns   Capture time on the system clock, see Options::map_timestamps.
+     */
+    using AccessUnitCallback = std::function<void(const AccessUnit &au, RtpDepacketizer::Codec codec,
+                                                  int64_t stamp_ns)>;
+
+    RtspClient() = default;
+
+    ~RtspClient();
+
+    RtspClient(const RtspClient &) = delete;
+
+    RtspClient &operator=(const RtspClient &) = delete;
+
+    /**
+     * @brief  Host and port of rtsp://[user@]host[:port][/path]; the host may be an ipv6 literal in brackets.
+     * @return  false if the url can not be parsed.
+     */
+    static bool parseUrl(const std::string &url, std::string &host, uint16_t &port);
+
+    /**
+     * @brief  Start the receive thread. It keeps reconnecting until stop().
+     * @return  false if the url can not be parsed or the client is already running.
+     */
+    bool start(const Options &options, AccessUnitCallback callback);
+
+    /**
+     * @brief  Stop and join the receive thread. A connect or read in progress is cut short by shutting down the
+     *         receive side of the rtsp connection; a session that is up still gets its TEARDOWN on the way out.
+     */
+    void stop();
+
+    bool isRunning() const
+    { return running_; }
+
+    Stats stats() const;
+
+    std::string lastError() const;
+
+private:
+    struct Session;
+
+    void run();
+
+    bool connect(Session &session);
+
+    bool receive(Session &session);
+
+    void teardown(Session &session);
+
+    bool request(Session &session, const char *method, const std::string &url, const std::string &headers,
+                 std::string &response);
+
+    bool readPacket(Session &session, std::vector<uint8_t> &packet, uint8_t &channel);
+
+    void handlePacket(Session &session, const uint8_t *data, size_t size, int64_t arrival_ns);
+
+    void deliver(Session &session, const RtpPacket &packet, int64_t arrival_ns);
+
+    int64_t mapTimestamp(Session &session, uint32_t rtp_timestamp, int64_t arrival_ns);
+
+    void setError(const std::string &error);
+
+    Options options_;
+    AccessUnitCallback callback_;
+    std::string host_;
+    uint16_t port_ = 554;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+
+    mutable std::mutex mutex_;
+    Stats stats_;
+    std::string last_error_;
+    int control_fd_ = -1;                       /// rtsp connection of the current session, for stop()
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_RTSP_CLIENT_HPP
@@ -0,0 +1,62 @@
+#ifndef OBSBOT_SNAPSHOT_SINK_HPP
+#define OBSBOT_SNAPSHOT_SINK_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include "frame_pool.hpp"
+#include "frame_sink.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Keeps the newest frame of a camera for stills, so a snapshot is a reference to a buffer already in the
+ *         ring instead of a second capture at photo resolution. The held frame keeps one buffer out of the pool; the
+ *         capture thread only moves the reference under a mutex. next() waits for the first frame captured after a
+ *         point in time, for callers that must not get a picture older than their request, eg. right after moving
+ *         the gimbal.
+ */
+class SnapshotSink : public FrameSink
+{
+public:
+    struct Stats
+    {
+        uint64_t frames = 0;
+        uint64_t requests = 0;
+        uint64_t timeouts = 0;                  /// next() found no frame in time
+    };
+
+    void onFrame(const FrameRef &frame) override;
+
+    void onRelease() override;
+
+    /// only while a next() waits, the last frame stays available while the camera sleeps
+    bool wantsFrames() const override;
+
+    /// empty before the first frame and after onRelease()
+    FrameRef latest();
+
+    /**
+     * @brief  Wait for a frame captured after a point in time.
+     * @param  [in] after_ns   Steady clock.
+     * @return  The frame, empty on timeout or when the pool is released meanwhile.
+     */
+    FrameRef next(int64_t after_ns, std::chrono::milliseconds timeout);
+
+    Stats stats() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    FrameRef latest_;
+    uint32_t waiters_ = 0;
+    uint64_t released_ = 0;                     /// bumped by onRelease(), waiters give up
+    Stats stats_;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_SNAPSHOT_SINK_HPP
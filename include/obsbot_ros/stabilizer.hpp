@@ -0,0 +1,143 @@
+#ifndef OBSBOT_STABILIZER_HPP
+#define OBSBOT_STABILIZER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "frame_pool.hpp"
+#include "image_ops.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Recent gimbal attitude samples on the steady clock. Filled from the sdk callback of aiGetGimbalStateR and
+ *         read by the capture thread, so it is shared and locked; the ring is allocated once.
+ */
+class AttitudeTrack
+{
+public:
+    /// degrees, see Stabilizer for the directions
+    struct Sample
+    {
+        int64_t steady_ns = 0;
+        float roll = 0.0f;
+        float pitch = 0.0f;
+        float yaw = 0.0f;
+    };
+
+    explicit AttitudeTrack(size_t capacity = 256);
+
+    void add(const Sample &sample);
+
+    /**
+     * @brief  Attitude at a point in time, interpolated between the samples around it. A stamp after the newest sample
+     *         takes the newest one.
+     * @param  [in] max_gap_ns   Samples further than this from the stamp are not used.
+     * @return  false if there is no sample close enough.
+     */
+    bool at(int64_t steady_ns, int64_t max_gap_ns, Sample &out) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<Sample> ring_;
+    size_t next_ = 0;
+    size_t count_ = 0;
+};
+
+/**
+ * @brief  Gimbal aided electronic stabilization of raw frames. The gimbal attitude at the capture time of a frame is
+ *         compared with a low passed camera path; the difference is the shake the gimbal did not take out, and the
+ *         frame is warped by the homography K R^T K^-1 of that residual rotation into a centered crop. The warp is
+ *         exact on a grid of nodes every grid pixels and linear in between, each run of a row goes through
+ *         image_ops::warpRow. Maps and the output pool are sized when the geometry changes, a frame allocates
+ *         nothing. Output is I420, chroma of Y800 input is flat grey.
+ *         Angles are degrees in camera terms: positive yaw turns the view right, positive pitch turns it up, positive
+ *         roll turns it clockwise as seen from behind the camera.
+ */
+class Stabilizer
+{
+public:
+    struct Options
+    {
+        double hfov_deg = 78.0;                 /// horizontal field of view of the input
+        double crop = 0.85;                     /// output size relative to the input, the margin absorbs the warp
+        int64_t smoothing_ns = 500000000;       /// time constant of the camera path
+        double max_correction_deg = 5.0;        /// per axis
+        int64_t latency_ns = 0;                 /// added to the frame stamp before the attitude lookup
+        int64_t max_gap_ns = 100000000;         /// attitude older than this counts as missing
+        int32_t grid = 16;                      /// pixels between exact map nodes
+        size_t pool_size = 3;
+    };
+
+    struct Stats
+    {
+        uint64_t frames = 0;
+        uint64_t no_attitude = 0;               /// frames passed through as a plain crop
+        uint64_t unsupported = 0;               /// encoded or rgb frames
+        uint64_t dropped = 0;                   /// no free output buffer
+        double correction_deg = 0.0;            /// largest axis of the last residual
+        double process_us = 0.0;                /// moving average
+        double max_process_us = 0.0;
+    };
+
+    explicit Stabilizer(const Options &options);
+
+    /**
+     * @brief  Stabilize one frame.
+     * @return  The cropped frame, empty for unsupported formats or when every output buffer is held.
+     */
+    FrameRef process(const Frame &frame, const AttitudeTrack &track);
+
+    /// forget the camera path, eg. after the gimbal was moved on purpose
+    void reset();
+
+    const Stats &stats() const
+    { return stats_; }
+
+private:
+    struct PlaneMap
+    {
+        int32_t width = 0;                      /// output samples
+        int32_t height = 0;
+        int32_t nodes_x = 0;
+        int32_t nodes_y = 0;
+        double out_scale = 1.0;                 /// output samples per output luma sample
+        std::vector<int32_t> x;                 /// 16.16 source position of every node
+        std::vector<int32_t> y;
+    };
+
+    void prepare(int32_t width, int32_t height);
+
+    /// residual rotation of the frame, degrees; false without attitude
+    bool residual(int64_t steady_ns, const AttitudeTrack &track, double &roll, double &pitch, double &yaw);
+
+    void buildMap(PlaneMap &map, const double h[9], double scale_x, double scale_y) const;
+
+    void warp(const PlaneMap &map, const image_ops::PlaneView &src, uint8_t *dst, int32_t stride) const;
+
+    Options options_;
+    Stats stats_;
+
+    int32_t in_width_ = 0;
+    int32_t in_height_ = 0;
+    int32_t out_width_ = 0;
+    int32_t out_height_ = 0;
+    PlaneMap luma_;
+    PlaneMap chroma_;
+    std::unique_ptr<FramePool> pool_;
+
+    /// low passed camera path
+    bool have_path_ = false;
+    int64_t path_ns_ = 0;
+    double path_roll_ = 0.0;
+    double path_pitch_ = 0.0;
+    double path_yaw_ = 0.0;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_STABILIZER_HPP
@@ -0,0 +1,107 @@
+#ifndef OBSBOT_STREAM_ADAPTER_HPP
+#define OBSBOT_STREAM_ADAPTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "dev.hpp"
+#include "rtsp_client.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Closed loop choice of the rtsp encoding of a network camera. The ladder runs from the best stream to the
+ *         lightest one; the adapter steps down one rung after a few bad samples (loss, delay or jitter above the high
+ *         marks) and probes one rung up after a longer run of good samples (all below the low marks). Every change is
+ *         followed by a settle time in which samples are ignored, and a probe that fails right away doubles the wait
+ *         before the next one, so a marginal link does not flap between two rungs.
+ */
+class StreamAdapter
+{
+public:
+    struct Rung
+    {
+        Device::DevVideoResType resolution = Device::DevVideoResAuto;
+        Device::DevVideoBitLevelType bitrate = Device::DevVideoBitLevelDefault;
+        Device::DevVideoEncoderFormat encoder = Device::DevVideoEncoderAuto;
+    };
+
+    struct Options
+    {
+        bool adapt = true;                      /// false only measures, the rung never changes
+        double loss_high = 0.02;                /// lost / expected packets
+        double loss_low = 0.002;
+        double delay_high_ms = 250.0;
+        double delay_low_ms = 80.0;
+        double jitter_high_ms = 30.0;
+        double jitter_low_ms = 10.0;
+        uint32_t degrade_after = 2;             /// bad samples in a row
+        uint32_t upgrade_after = 10;            /// good samples in a row before a probe
+        uint32_t max_backoff = 16;              /// largest multiplier of upgrade_after
+        int64_t settle_ns = 3000000000;         /// samples ignored after a change
+    };
+
+    /// link quality over the last update interval
+    struct Sample
+    {
+        double rx_kbps = 0.0;
+        double loss = 0.0;
+        double jitter_ms = 0.0;
+        double delay_ms = 0.0;
+    };
+
+    /**
+     * @brief  Build a ladder below a starting point: bitrate high, medium, low, then h265 if allowed, then the next
+     *         smaller resolution at the same frame rate down to 720p.
+     * @param  [in] top          Resolution of the first rung.
+     * @param  [in] encoder      Encoder of the first rung.
+     * @param  [in] allow_h265   Add a rung that switches an h264 stream to h265 before the resolution drops.
+     */
+    static std::vector<Rung> defaultLadder(Device::DevVideoResType top, Device::DevVideoEncoderFormat encoder,
+                                           bool allow_h265);
+
+    StreamAdapter(std::vector<Rung> ladder, const Options &options);
+
+    /**
+     * @brief  Take new client counters and decide.
+     * @param  [in] stats    Counters of the rtsp client, they may restart from zero after a restart of the client.
+     * @param  [in] now_ns   Monotonic time.
+     * @return  true if the rung changed, the caller applies current().
+     */
+    bool update(const RtspClient::Stats &stats, int64_t now_ns);
+
+    size_t rung() const
+    { return rung_; }
+
+    size_t rungCount() const
+    { return ladder_.size(); }
+
+    const Rung &current() const
+    { return ladder_[rung_]; }
+
+    const Sample &sample() const
+    { return sample_; }
+
+private:
+    void change(size_t rung, int64_t now_ns);
+
+    std::vector<Rung> ladder_;
+    Options options_;
+    size_t rung_ = 0;
+    Sample sample_;
+
+    bool have_last_ = false;
+    RtspClient::Stats last_;
+    int64_t last_ns_ = 0;
+    int64_t changed_ns_ = 0;
+    bool probing_ = false;                      /// the last change was an upgrade still in its probe window
+    uint32_t bad_ = 0;
+    uint32_t good_ = 0;
+    uint32_t backoff_ = 1;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_STREAM_ADAPTER_HPP
@@ -0,0 +1,123 @@
+#ifndef OBSBOT_TARGET_SELECTOR_HPP
+#define OBSBOT_TARGET_SELECTOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace obsbot_ros
+{
+
+/// one detection of the ~/detections topic, normalized image coordinates 0..1
+struct DetectionBox
+{
+    float x_min = 0.0f;
+    float y_min = 0.0f;
+    float x_max = 0.0f;
+    float y_max = 0.0f;
+    float score = 0.0f;
+    int32_t target_type = -1;                   /// AiTargetType, -1 unknown
+    int32_t track_id = -1;
+};
+
+/// intersection over union
+double iou(const DetectionBox &a, const DetectionBox &b);
+
+/**
+ * @brief  Turns a stream of external detections into rare target selection commands for the camera's AI. The selected
+ *         target is followed from frame to frame by track id, or by overlap when the detector has no tracker, and is
+ *         remembered for a while after it disappears. A selection is only sent again when a different target has
+ *         clearly won for several frames in a row, or when the selected one has moved away from the box the camera
+ *         was given, so detection jitter never reaches the device. Commands are coalesced: at most one leaves per
+ *         min_interval and it always carries the newest box.
+ */
+class TargetSelector
+{
+public:
+    /// sdk call used for a selection
+    enum class Mode
+    {
+        Box,                                    /// aiSetSelectTargetByBox
+        Position,                               /// aiSetSelectTargetByPos with the box center
+        Central,                                /// aiSetSelectCentralTarget, the box only decides when
+    };
+
+    using Box = DetectionBox;
+
+    struct Options
+    {
+        Mode mode = Mode::Box;
+        int32_t target_type = -1;               /// only detections of this type, -1 any
+        float min_score = 0.0f;
+        double match_iou = 0.3;                 /// same target in the next frame, without track ids
+        double switch_margin = 0.25;            /// a challenger must score this fraction above the selection ...
+        uint32_t switch_after = 5;              /// ... in this many updates in a row
+        double reselect_iou = 0.3;              /// re-send once the target overlaps the last sent box less than this
+        int64_t memory_ns = 1500000000;         /// a target unseen this long is forgotten
+        int64_t min_interval_ns = 500000000;    /// shortest time between two commands
+    };
+
+    struct Command
+    {
+        Mode mode = Mode::Box;
+        Box box;
+        int32_t target_type = -1;               /// for Position and Central
+    };
+
+    struct Stats
+    {
+        uint64_t updates = 0;
+        uint64_t commands = 0;
+        uint64_t suppressed = 0;                /// updates that moved the target without a command
+        uint64_t coalesced = 0;                 /// selections replaced by a newer one before they were sent
+        uint64_t switches = 0;                  /// changes from one target to another
+        uint64_t lost = 0;                      /// targets forgotten after memory_ns
+    };
+
+    explicit TargetSelector(const Options &options);
+
+    /**
+     * @brief  Take the detections of one image.
+     * @param  [in] now_ns   Monotonic time.
+     */
+    void update(const Box *boxes, size_t count, int64_t now_ns);
+
+    /**
+     * @brief  Hand out the pending selection if the rate limit allows one now.
+     * @return  true if command was filled and has to be sent.
+     */
+    bool poll(int64_t now_ns, Command &command);
+
+    /// forget the target and drop the pending command
+    void reset();
+
+    bool tracking() const
+    { return tracking_; }
+
+    const Box &target() const
+    { return target_; }
+
+    const Stats &stats() const
+    { return stats_; }
+
+private:
+    void select(const Box &box, int64_t now_ns);
+
+    void queue();
+
+    Options options_;
+    Stats stats_;
+
+    bool tracking_ = false;
+    Box target_;
+    int64_t last_seen_ns_ = 0;
+    uint32_t challenger_ = 0;                   /// updates in a row with a better candidate
+
+    bool pending_ = false;
+    bool sent_valid_ = false;
+    Box sent_;
+    int64_t last_command_ns_ = 0;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_TARGET_SELECTOR_HPP
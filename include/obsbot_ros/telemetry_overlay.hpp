@@ -0,0 +1,84 @@
+#ifndef OBSBOT_TELEMETRY_OVERLAY_HPP
+#define OBSBOT_TELEMETRY_OVERLAY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frame_pool.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Burns a few lines of text into raw frames, in yuv, eg. stamp, SN, zoom and gimbal angles for evidentiary
+ *         recordings. A 5x7 font is rasterized once into an atlas of luma and alpha cells at the chosen scale. Each
+ *         line keeps its rendered cells, and setLine() copies only the cells whose character changed, so a running
+ *         clock redraws a digit or two per frame. apply() blends the lines with their dark backing box into the
+ *         picture with image_ops::blendMask; chroma under the box goes towards grey. Lower case is drawn as upper
+ *         case, characters outside the font as '?'.
+ */
+class TelemetryOverlay
+{
+public:
+    struct Options
+    {
+        size_t lines = 3;
+        size_t max_chars = 48;                  /// per line, longer text is cut
+        int32_t scale = 2;                      /// font pixels per output pixel
+        int32_t margin = 16;                    /// from the picture edge, pixels
+        bool bottom = false;                    /// bottom left corner instead of top left
+        uint8_t background = 160;               /// opacity of the box behind the text
+    };
+
+    struct Stats
+    {
+        uint64_t frames = 0;
+        uint64_t cells_drawn = 0;               /// characters copied from the atlas
+        uint64_t unsupported = 0;               /// encoded or rgb frames, left as they are
+        double process_us = 0.0;                /// moving average
+        double max_process_us = 0.0;
+    };
+
+    explicit TelemetryOverlay(const Options &options);
+
+    /// cheap when the text is unchanged, nullptr or "" hides the line
+    void setLine(size_t line, const char *text);
+
+    /**
+     * @brief  Blend the lines into one frame, in place.
+     * @return  false if the format has no yuv layout; the frame is left untouched.
+     */
+    bool apply(Frame &frame);
+
+    const Stats &stats() const
+    { return stats_; }
+
+private:
+    struct Line
+    {
+        std::vector<char> text;                 /// max_chars, what the cells show
+        size_t length = 0;
+        std::vector<uint8_t> luma;              /// max_chars cells wide, one cell high
+        std::vector<uint8_t> alpha;
+        std::vector<uint8_t> chroma_alpha;      /// half width, full height
+    };
+
+    /// atlas index of a character
+    static size_t glyph(char c);
+
+    void drawCell(Line &line, size_t index, char c);
+
+    Options options_;
+    Stats stats_;
+    int32_t cell_width_ = 0;
+    int32_t cell_height_ = 0;
+    std::vector<uint8_t> atlas_luma_;           /// glyph cells one below the other
+    std::vector<uint8_t> atlas_alpha_;
+    std::vector<Line> lines_;
+    std::vector<uint8_t> grey_;                 /// chroma of the box, one line wide
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_TELEMETRY_OVERLAY_HPP
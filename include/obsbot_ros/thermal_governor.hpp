@@ -0,0 +1,165 @@
+#ifndef OBSBOT_THERMAL_GOVERNOR_HPP
+#define OBSBOT_THERMAL_GOVERNOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dev.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Graceful degradation of a tail air that runs hot or low on battery. The ladder runs from the configured
+ *         capture down to the lightest one; every rung sets resolution, frame rate, the bitrate level of the main
+ *         video and whether the ai runs. A lens or cpu temperature error steps down at once and again after every
+ *         settle time, a warning steps down after it has lasted a while, and a long enough run of normal readings
+ *         steps back up one rung. Battery thresholds put a floor under the rung while discharging, lifted when the
+ *         camera charges. Every change is kept as a decision, and its effect on temperature, battery drain and frame
+ *         rate is measured over a window after it. Not thread safe; all times are steady clock.
+ */
+class ThermalGovernor
+{
+public:
+    struct Rung
+    {
+        int32_t width = 0;                      /// 0 keeps the configured capture
+        int32_t height = 0;
+        int32_t fps = 0;
+        Device::DevVideoBitLevelType bitrate = Device::DevVideoBitLevelDefault;
+        bool ai = true;
+    };
+
+    struct Options
+    {
+        std::vector<Rung> ladder;               /// the first rung is the full capture
+        int64_t settle_ns = 20000000000;        /// between two steps down on a temperature error
+        int64_t warning_hold_ns = 60000000000;  /// a warning this long steps down
+        int64_t recover_ns = 300000000000;      /// normal this long steps up one rung
+        std::vector<int32_t> battery_steps = {30, 15, 5}; /// at or below step i, discharging, rung i + 1 at least
+        int64_t effect_ns = 300000000000;       /// window the effect of a change is measured over
+    };
+
+    /// tail air status, temperatures 0 normal, 1 warning, 2 error
+    struct Reading
+    {
+        int32_t lens_temp = 0;
+        int32_t cpu_temp = 0;
+        int32_t capacity = -1;                  /// percent, -1 while unknown
+        bool charging = false;                  /// charging or on the adapter
+        double fps = 0.0;                       /// measured capture rate
+    };
+
+    struct Decision
+    {
+        size_t from = 0;
+        size_t to = 0;
+        std::string reason;
+        int64_t at_ns = 0;
+        Reading reading;                        /// when the decision was taken
+        double drain_pct_h = 0.0;               /// battery drain over the window before, negative while charging
+    };
+
+    struct Effect
+    {
+        Decision decision;
+        int64_t after_ns = 0;                   /// measured over this long, shorter if the next change came first
+        Reading reading;
+        double drain_pct_h = 0.0;               /// over the window after the decision
+    };
+
+    struct Stats
+    {
+        uint64_t steps_down = 0;
+        uint64_t steps_up = 0;
+        uint64_t temp_events = 0;
+        uint64_t battery_events = 0;
+    };
+
+    /**
+     * @brief  Parse one rung, "<width>x<height>@<fps> <default|low|medium|high> <ai|noai>".
+     * @return  false for a malformed text.
+     */
+    static bool parse(const std::string &text, Rung &out);
+
+    /// rung text as parse() takes it
+    static std::string format(const Rung &rung);
+
+    /// normal, warning or error
+    static const char *tempName(int32_t status);
+
+    explicit ThermalGovernor(const Options &options);
+
+    /// back to the full capture, eg. on activate; a decision still waiting for its effect is dropped
+    void reset(int64_t now_ns);
+
+    /// @return  true if the rung changed, the caller applies current() and logs decision()
+    bool update(const Reading &reading, int64_t now_ns);
+
+    /// the device reported kEvtErrDevTempHigh, taken as an error reading by the next update
+    void onTempHigh();
+
+    /// the device reported kEvtErrBatLowCapacity, the lowest rung until it charges
+    void onBatteryLow();
+
+    /// @return  true once for every decision, when its window has passed or the next decision cut it short
+    bool effect(int64_t now_ns, Effect &out);
+
+    /**
+     * @brief  Follow the ai setting of the rungs. A rung without ai turns it off and keeps whether it was tracking;
+     *         the ai comes back only if it tracked before throttling began.
+     * @param  [in] ai        Setting of the new rung.
+     * @param  [in] tracking  Whether the ai tracks right now, an unknown mode counts as tracking.
+     * @return  true if the caller sets the ai to ai.
+     */
+    bool switchAi(bool ai, bool tracking);
+
+    size_t rung() const
+    { return rung_; }
+
+    size_t rungCount() const
+    { return options_.ladder.size(); }
+
+    const Rung &current() const
+    { return options_.ladder[rung_]; }
+
+    const Decision &decision() const
+    { return decision_; }
+
+    const Stats &stats() const
+    { return stats_; }
+
+private:
+    /// percent per hour over the samples at or after since_ns
+    double drain(int64_t since_ns) const;
+
+    void finish(int64_t now_ns);
+
+    Options options_;
+    Stats stats_;
+    size_t rung_ = 0;
+    size_t thermal_rung_ = 0;
+    size_t battery_floor_ = 0;
+    bool temp_event_ = false;
+    bool battery_event_ = false;
+    int64_t hot_since_ns_ = -1;                 /// first reading of the current warning or error, -1 while normal
+    bool hot_stepped_ = false;                  /// the current warning or error has stepped down
+    int64_t normal_since_ns_ = 0;
+    int64_t step_ns_ = 0;                       /// last thermal step
+    Reading last_;
+    std::deque<std::pair<int64_t, int32_t>> capacity_; /// samples over the effect window and the one before
+    Decision decision_;
+    bool pending_ = false;                      /// decision_ still waits for its effect
+    bool ready_ = false;                        /// effect_ is complete
+    Effect effect_;
+    bool ai_ = true;                            /// false while a rung keeps the ai off
+    bool ai_saved_ = true;                      /// whether the ai tracked before a rung turned it off
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_THERMAL_GOVERNOR_HPP
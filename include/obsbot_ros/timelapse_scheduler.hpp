@@ -0,0 +1,94 @@
+#ifndef OBSBOT_TIMELAPSE_SCHEDULER_HPP
+#define OBSBOT_TIMELAPSE_SCHEDULER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Timing of a timelapse that lets the device sleep between shots. Shots are planned on a fixed grid; the
+ *         wake is issued ahead of a shot by the longest of the last few measured wake to first frame latencies plus
+ *         a margin, so the stream is up just in time and runs for as short as possible. Frames before the planned
+ *         time only feed the latency estimate, the first one at or after it is the shot. Slots that can no longer be
+ *         reached in time are skipped and counted. Not thread safe; all times are steady clock.
+ */
+class TimelapseScheduler
+{
+public:
+    enum class Phase
+    {
+        Sleeping,                               /// until wakeAt()
+        Waking,                                 /// wake issued, waiting for the shot until deadline()
+        Shot,                                   /// shot taken, the device can go back to sleep
+    };
+
+    struct Options
+    {
+        int64_t interval_ns = 60000000000;
+        int64_t initial_latency_ns = 3000000000; /// wake to first frame until one is measured
+        int64_t margin_ns = 200000000;          /// on top of the estimate
+        int64_t timeout_ns = 10000000000;       /// after the wake, the shot is given up
+        size_t history = 8;                     /// latency samples the estimate is taken over
+    };
+
+    struct Stats
+    {
+        uint64_t shots = 0;
+        uint64_t missed = 0;                    /// given up or skipped slots
+        double latency_ms = 0.0;                /// wake to first frame, last measured
+        double max_latency_ms = 0.0;
+        double estimate_ms = 0.0;               /// wake lead without the margin
+        double late_ms = 0.0;                   /// last shot after its planned time
+        double streaming_ms = 0.0;              /// wake to shot of the last shot
+    };
+
+    explicit TimelapseScheduler(const Options &options);
+
+    /// plan the first shot as soon as the device can deliver it
+    void start(int64_t now_ns);
+
+    Phase phase() const
+    { return phase_; }
+
+    /// time to issue the wake for the next shot
+    int64_t wakeAt() const;
+
+    int64_t shotAt() const
+    { return shot_ns_; }
+
+    /// a wake without a shot is given up at this time
+    int64_t deadline() const
+    { return wake_ns_ + options_.timeout_ns; }
+
+    /// the wake was issued at now_ns
+    void onWake(int64_t now_ns);
+
+    /// @return  true for the shot; earlier frames are only measured and should be dropped
+    bool onFrame(int64_t frame_ns);
+
+    /// the device is asleep again, after a shot or after giving up; plans the next shot
+    void onSleep(int64_t now_ns);
+
+    /// wake lead without the margin
+    int64_t latencyEstimate() const;
+
+    const Stats &stats() const
+    { return stats_; }
+
+private:
+    Options options_;
+    Stats stats_;
+    Phase phase_ = Phase::Sleeping;
+    int64_t shot_ns_ = 0;
+    int64_t wake_ns_ = 0;
+    bool measured_ = false;                     /// the current wake has seen its first frame
+    std::vector<int64_t> latencies_;            /// ring of the last samples
+    size_t next_latency_ = 0;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_TIMELAPSE_SCHEDULER_HPP
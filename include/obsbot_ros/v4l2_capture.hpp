@@ -0,0 +1,107 @@
+#ifndef OBSBOT_V4L2_CAPTURE_HPP
+#define OBSBOT_V4L2_CAPTURE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "frame_pool.hpp"
+
+namespace obsbot_ros
+{
+
+/**
+ * @brief  Memory mapped V4L2 capture on the UVC node of a camera (Device::videoDevPath()). The device stays open and
+ *         its buffers stay mapped across stop()/start(), so toggling the stream skips format negotiation.
+ */
+class V4l2Capture
+{
+public:
+    struct Format
+    {
+        int32_t width = 1920;
+        int32_t height = 1080;
+        int32_t fps = 30;
+        RmVideoFormat format = RmVideoFormat::MJPEG;
+    };
+
+    V4l2Capture() = default;
+
+    ~V4l2Capture();
+
+    V4l2Capture(const V4l2Capture &) = delete;
+
+    V4l2Capture &operator=(const V4l2Capture &) = delete;
+
+    /**
+     * @brief  Open the device, negotiate the format and map the driver buffers.
+     * @param  [in] path          Video device path, eg. /dev/video0.
+     * @param  [in] format        Requested format, updated with what the driver accepted.
+     * @param  [in] buffer_count  Number of driver buffers to request.
+     * @return  true for success, false for failed, see lastError().
+     */
+    bool open(const std::string &path, Format &format, uint32_t buffer_count = 4);
+
+    void close();
+
+    bool start();
+
+    void stop();
+
+    /**
+     * @brief  Wait for the next frame and copy it into a pooled frame. A frame larger than the pooled buffer goes
+     *         back to the driver and is counted in dropped().
+     * @param  [out] out          Receives the frame, must hold a buffer of at least frameSize() bytes.
+     * @param  [in] timeout_ms    Maximum wait time.
+     * @return  true when a frame was copied, false on timeout, error or a dropped frame.
+     */
+    bool grab(Frame &out, int timeout_ms);
+
+    bool isOpen() const
+    { return fd_ >= 0; }
+
+    bool isStreaming() const
+    { return streaming_; }
+
+    const Format &format() const
+    { return format_; }
+
+    /// bytes of one frame as the driver lays it out, line padding included
+    size_t frameSize() const
+    { return frame_size_; }
+
+    /// frames dequeued but not copied since open()
+    uint64_t dropped() const
+    { return dropped_; }
+
+    const std::string &lastError() const
+    { return last_error_; }
+
+    static uint32_t toFourcc(RmVideoFormat format);
+
+    static RmVideoFormat fromFourcc(uint32_t fourcc);
+
+private:
+    struct MappedBuffer
+    {
+        void *start = nullptr;
+        size_t length = 0;
+    };
+
+    bool negotiate(const std::string &path, Format &format, uint32_t buffer_count);
+
+    bool fail(const std::string &what);
+
+    int fd_ = -1;
+    bool streaming_ = false;
+    Format format_;
+    int32_t stride_ = 0;                        /// bytesperline of the driver, chroma planes of i420 take half
+    size_t frame_size_ = 0;
+    uint64_t dropped_ = 0;
+    std::vector<MappedBuffer> buffers_;
+    std::string last_error_;
+};
+
+}  // namespace obsbot_ros
+
+#endif // OBSBOT_V4L2_CAPTURE_HPP
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include <obsbot_ros/ai_status_poller.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+int64_t steadyNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool sameStatus(const Device::AiStatus &a, const Device::AiStatus &b)
+{
+    return a.gesture_target == b.gesture_target && a.gesture_zoom == b.gesture_zoom &&
+           a.gesture_dynamic_zoom == b.gesture_dynamic_zoom && a.gesture_record == b.gesture_record &&
+           a.gesture_mirror == b.gesture_mirror && a.gesture_zoom_factor == b.gesture_zoom_factor &&
+           a.yaw_reverse == b.yaw_reverse && a.v_track_landscape == b.v_track_landscape &&
+           a.v_track_portrait == b.v_track_portrait && a.main_mode == b.main_mode &&
+           a.hand_track_type == b.hand_track_type && a.ai_zone_track == b.ai_zone_track &&
+           a.speed_mode == b.speed_mode;
+}
+}
+
+struct AiStatusPoller::State
+{
+    struct Request
+    {
+        uint64_t sequence = 0;                  /// 0 for a free slot
+        int64_t sent_ns = 0;
+    };
+
+    Options options;
+    ChangeCallback callback;
+
+    std::mutex mutex;
+    std::vector<Request> requests;
+    uint64_t next_sequence = 1;
+    uint64_t applied_sequence = 0;
+    Device::AiStatus last{};
+    bool last_valid = false;
+    Stats stats;
+
+    /// held while the callback runs, so closing waits for a delivery in progress
+    std::mutex deliver_mutex;
+    bool closed = false;
+};
+
+AiStatusPoller::AiStatusPoller(const Options &options, ChangeCallback callback) :
+    state_(std::make_shared<State>())
+{
+    state_->options = options;
+    state_->options.depth = std::max<size_t>(1, options.depth);
+    state_->callback = std::move(callback);
+    state_->requests.resize(state_->options.depth);
+}
+
+AiStatusPoller::~AiStatusPoller()
+{
+    std::lock_guard<std::mutex> deliver(state_->deliver_mutex);
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->closed = true;
+}
+
+bool AiStatusPoller::poll(Device &dev, int64_t now_ns)
+{
+    State::Request *slot = nullptr;
+    uint64_t sequence;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        for (auto &request : state_->requests)
+        {
+            if (request.sequence != 0 && now_ns - request.sent_ns > state_->options.timeout_ns)
+            {
+                request.sequence = 0;
+                ++state_->stats.timeouts;
+                --state_->stats.in_flight;
+            }
+            if (request.sequence == 0 && !slot)
+            { slot = &request; }
+        }
+        if (!slot)
+        { return false; }
+
+        sequence = state_->next_sequence++;
+        slot->sequence = sequence;
+        slot->sent_ns = now_ns;
+        ++state_->stats.requests;
+        ++state_->stats.in_flight;
+    }
+
+    /// outside the lock, the sdk may answer before the call returns
+    auto state = state_;
+    int32_t ret = dev.aiGetAiStatusR(nullptr, [state, sequence](void *, const void *data)
+                                     { onResponse(state, sequence, data); }, nullptr, Device::NonBlock);
+    if (ret == RM_RET_OK)
+    { return true; }
+
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    ++state_->stats.errors;
+    if (slot->sequence == sequence)
+    {
+        slot->sequence = 0;
+        --state_->stats.in_flight;
+    }
+    return false;
+}
+
+void AiStatusPoller::reset()
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    for (auto &request : state_->requests)
+    {
+        request.sequence = 0;
+    }
+    state_->stats.in_flight = 0;
+    state_->applied_sequence = state_->next_sequence - 1;
+    state_->last_valid = false;
+}
+
+AiStatusPoller::Stats AiStatusPoller::stats() const
+{
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->stats;
+}
+
+void AiStatusPoller::onResponse(const std::shared_ptr<State> &state, uint64_t sequence, const void *data)
+{
+    int64_t now_ns = steadyNs();
+    int64_t latency_ns = 0;
+    Device::AiStatus status;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        auto request = std::find_if(state->requests.begin(), state->requests.end(),
+                                    [sequence](const State::Request &r)
+                                    { return r.sequence == sequence; });
+        if (request != state->requests.end())
+        {
+            latency_ns = now_ns - request->sent_ns;
+            request->sequence = 0;
+            --state->stats.in_flight;
+
+            auto &stats = state->stats;
+            double latency_ms = static_cast<double>(latency_ns) * 1e-6;
+            stats.latency_ms = stats.responses == 0 ? latency_ms
+                                                    : stats.latency_ms + (latency_ms - stats.latency_ms) / 16.0;
+            stats.max_latency_ms = std::max(stats.max_latency_ms, latency_ms);
+            ++stats.responses;
+        }
+
+        /// a late answer to a timed out request is still newer than what was applied before it
+        if (!data || sequence <= state->applied_sequence)
+        {
+            ++state->stats.stale;
+            return;
+        }
+        state->applied_sequence = sequence;
+        status = *static_cast<const Device::AiStatus *>(data);
+        if (state->last_valid && sameStatus(status, state->last))
+        { return; }
+        state->last = status;
+        state->last_valid = true;
+        ++state->stats.changes;
+    }
+
+    std::lock_guard<std::mutex> deliver(state->deliver_mutex);
+    if (!state->closed && state->callback)
+    { state->callback(status, latency_ns); }
+}
+
+}  // namespace obsbot_ros
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <cmath>
+
+#include <obsbot_ros/auto_framer.hpp>
+
+namespace obsbot_ros
+{
+
+AutoFramer::AutoFramer(const Options &options) : options_(options)
+{
+    options_.min_size = std::min(1.0f, std::max(0.05f, options_.min_size));
+    options_.smoothing_ns = std::max<int64_t>(1, options_.smoothing_ns);
+}
+
+void AutoFramer::update(const DetectionBox *boxes, size_t count, int64_t now_ns)
+{
+    ++stats_.updates;
+    Window desired;
+    if (frame(boxes, count, desired))
+    {
+        last_seen_ns_ = now_ns;
+    }
+    else if (last_seen_ns_ != 0 && now_ns - last_seen_ns_ <= options_.lost_ns)
+    {
+        /// a short miss of the detector keeps the current framing
+        ++stats_.held;
+        return;
+    }
+
+    double dt = last_update_ns_ != 0 ? static_cast<double>(now_ns - last_update_ns_)
+                                     : static_cast<double>(options_.smoothing_ns);
+    last_update_ns_ = now_ns;
+    auto alpha = static_cast<float>(1.0 - std::exp(-dt / static_cast<double>(options_.smoothing_ns)));
+    filtered_.x_min += alpha * (desired.x_min - filtered_.x_min);
+    filtered_.y_min += alpha * (desired.y_min - filtered_.y_min);
+    filtered_.x_max += alpha * (desired.x_max - filtered_.x_max);
+    filtered_.y_max += alpha * (desired.y_max - filtered_.y_max);
+
+    float size = goal_.size();
+    float dx = std::fabs((filtered_.x_min + filtered_.x_max) - (goal_.x_min + goal_.x_max)) * 0.5f;
+    float dy = std::fabs((filtered_.y_min + filtered_.y_max) - (goal_.y_min + goal_.y_max)) * 0.5f;
+    float ds = std::fabs(filtered_.size() - size);
+    if (std::max(dx, dy) > options_.dead_zone * size || ds > options_.size_dead_zone * size)
+    { setGoal(filtered_); }
+    else
+    { ++stats_.held; }
+}
+
+bool AutoFramer::poll(int64_t now_ns, Window &window)
+{
+    if (!pending_ || (sent_any_ && now_ns - last_command_ns_ < options_.min_interval_ns))
+    { return false; }
+
+    window = goal_;
+    pending_ = false;
+    sent_any_ = true;
+    last_command_ns_ = now_ns;
+    ++stats_.commands;
+    return true;
+}
+
+void AutoFramer::reset()
+{
+    filtered_ = Window();
+    goal_ = Window();
+    pending_ = false;
+    sent_any_ = false;
+    last_update_ns_ = 0;
+    last_seen_ns_ = 0;
+}
+
+bool AutoFramer::frame(const DetectionBox *boxes, size_t count, Window &out) const
+{
+    float x_min = 1.0f;
+    float y_min = 1.0f;
+    float x_max = 0.0f;
+    float y_max = 0.0f;
+    size_t subjects = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto &box = boxes[i];
+        if (box.score < options_.min_score ||
+            (options_.target_type >= 0 && box.target_type >= 0 && box.target_type != options_.target_type))
+        { continue; }
+        x_min = std::min(x_min, box.x_min);
+        y_min = std::min(y_min, box.y_min);
+        x_max = std::max(x_max, box.x_max);
+        y_max = std::max(y_max, box.y_max);
+        ++subjects;
+    }
+    if (subjects == 0 || x_max <= x_min || y_max <= y_min)
+    { return false; }
+
+    float width = x_max - x_min;
+    float height = y_max - y_min;
+    float size = std::max(width, height) * (1.0f + 2.0f * options_.padding);
+    float center_x = 0.5f * (x_min + x_max);
+    float center_y;
+    if (subjects == 1)
+    {
+        /// eyes about a tenth below the top of a person box go on the upper third line, which needs room below
+        size = std::max(size, 1.4f * height);
+        size = std::min(1.0f, std::max(options_.min_size, size));
+        float eyes = y_min + 0.1f * height;
+        center_y = eyes + size / 6.0f;
+    }
+    else
+    {
+        size = std::min(1.0f, std::max(options_.min_size, size));
+        center_y = 0.5f * (y_min + y_max);
+    }
+    out = clamp(center_x, center_y, size);
+    return true;
+}
+
+AutoFramer::Window AutoFramer::clamp(float center_x, float center_y, float size)
+{
+    size = std::min(1.0f, size);
+    Window window;
+    window.x_min = std::min(1.0f - size, std::max(0.0f, center_x - 0.5f * size));
+    window.y_min = std::min(1.0f - size, std::max(0.0f, center_y - 0.5f * size));
+    window.x_max = window.x_min + size;
+    window.y_max = window.y_min + size;
+    return window;
+}
+
+void AutoFramer::setGoal(const Window &window)
+{
+    if (pending_)
+    { ++stats_.coalesced; }
+    goal_ = window;
+    pending_ = true;
+}
+
+}  // namespace obsbot_ros
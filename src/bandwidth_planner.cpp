@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <obsbot_ros/bandwidth_planner.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+
+bool readLine(const std::string &path, std::string &out)
+{
+    std::ifstream in(path);
+    return static_cast<bool>(std::getline(in, out));
+}
+
+#ifndef _WIN32
+bool resolve(const std::string &path, std::string &out)
+{
+    char resolved[PATH_MAX];
+    if (!::realpath(path.c_str(), resolved))
+    { return false; }
+    out = resolved;
+    return true;
+}
+
+std::string parent(const std::string &path)
+{
+    auto slash = path.find_last_of('/');
+    return slash == std::string::npos ? std::string() : path.substr(0, slash);
+}
+
+std::string basename(const std::string &path)
+{
+    auto slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+#endif
+
+}  // namespace
+
+BandwidthPlanner &BandwidthPlanner::get()
+{
+    static BandwidthPlanner planner;
+    return planner;
+}
+
+BandwidthPlanner::BandwidthPlanner()
+{
+    /// a replugged camera may come back on another port, an unplugged one frees its share of the bus
+    registry_listener_ = DeviceRegistry::get().addListener([this](DeviceRegistry::Handle, bool)
+                                                           { replan(); });
+}
+
+BandwidthPlanner::~BandwidthPlanner()
+{
+    DeviceRegistry::get().removeListener(registry_listener_);
+}
+
+bool BandwidthPlanner::parseLimit(const std::string &text, int32_t &bus, double &mbps)
+{
+    std::istringstream in(text);
+    return static_cast<bool>(in >> bus >> mbps) && bus > 0 && mbps > 0.0;
+}
+
+bool BandwidthPlanner::readPort(const std::string &video_path, UsbPort &out)
+{
+#ifdef _WIN32
+    (void)video_path;
+    (void)out;
+    return false;
+#else
+    /// /dev/v4l/by-id links resolve to the node name sysfs knows
+    std::string node;
+    if (!resolve(video_path, node) || !resolve("/sys/class/video4linux/" + basename(node) + "/device", node))
+    { return false; }
+
+    /// the video node hangs off an interface, the usb device is the first parent with a bus number
+    std::string dir = node, line;
+    while (dir.size() > 4 && !readLine(dir + "/busnum", line))
+    { dir = parent(dir); }
+    if (dir.size() <= 4)
+    { return false; }
+
+    out = UsbPort();
+    out.bus = std::atoi(line.c_str());
+    if (readLine(dir + "/devpath", line))
+    { out.devpath = line; }
+    if (readLine(dir + "/speed", line))
+    { out.link_mbps = std::atof(line.c_str()); }
+
+    /// the root hub of the bus sits right below its host controller
+    std::string root;
+    if (resolve("/sys/bus/usb/devices/usb" + std::to_string(out.bus), root))
+    {
+        out.controller = basename(parent(root));
+        if (readLine(root + "/speed", line))
+        { out.bus_mbps = std::atof(line.c_str()); }
+    }
+    return out.bus > 0;
+#endif
+}
+
+double BandwidthPlanner::bandwidth(const V4l2Capture::Format &format, const Options &options)
+{
+    double bits;
+    if (!isEncoded(format.format))
+    { bits = 8.0 * static_cast<double>(frameBufferSize(format.format, format.width, format.height)); }
+    else
+    {
+        double bpp = format.format == RmVideoFormat::MJPEG ? options.mjpeg_bpp : options.h26x_bpp;
+        bits = bpp * format.width * format.height;
+    }
+    return bits * format.fps * options.overhead / 1e6;
+}
+
+std::vector<BandwidthPlanner::Mode> BandwidthPlanner::candidates(const Camera &camera, const Options &options)
+{
+    const auto &requested = camera.requested;
+    const double pixels = std::max(1.0, static_cast<double>(requested.width) * requested.height);
+    std::vector<Mode> modes;
+    auto add = [&](int32_t width, int32_t height, int32_t fps)
+    {
+        for (const auto &mode : modes)
+        {
+            if (mode.format.width == width && mode.format.height == height && mode.format.fps == fps)
+            { return; }
+        }
+        Mode mode;
+        mode.format = requested;
+        mode.format.width = width;
+        mode.format.height = height;
+        mode.format.fps = fps;
+        mode.mbps = bandwidth(mode.format, options);
+        mode.quality = std::min(1.0, width * static_cast<double>(height) / pixels) *
+                       std::min(1.0, fps / std::max(1.0, static_cast<double>(requested.fps)));
+        modes.push_back(mode);
+    };
+
+    /// listed sizes at the requested rate or the highest below it, then halved down to the lowest rate offered
+    for (const auto &info : camera.formats)
+    {
+        if (info.format_ != requested.format || info.width_ > requested.width || info.height_ > requested.height)
+        { continue; }
+        int32_t top = info.fps_max_ > 0 ? std::min(requested.fps, info.fps_max_) : requested.fps;
+        int32_t lowest = std::max(options.min_fps, info.fps_min_);
+        add(info.width_, info.height_, top);
+        for (int32_t fps = top / 2; fps >= lowest && fps > 0; fps /= 2)
+        { add(info.width_, info.height_, fps); }
+    }
+    if (modes.empty())
+    { add(requested.width, requested.height, requested.fps); }
+
+    std::sort(modes.begin(), modes.end(), [](const Mode &a, const Mode &b)
+              { return a.quality != b.quality ? a.quality > b.quality : a.mbps < b.mbps; });
+    return modes;
+}
+
+std::vector<BandwidthPlanner::Assignment> BandwidthPlanner::solve(const std::vector<Camera> &cameras,
+                                                                  const Options &options)
+{
+    std::vector<Assignment> result(cameras.size());
+    std::vector<std::vector<Mode>> modes(cameras.size());
+    std::map<int32_t, std::vector<size_t>> buses;
+    for (size_t i = 0; i < cameras.size(); ++i)
+    {
+        const auto &port = cameras[i].port;
+        modes[i] = candidates(cameras[i], options);
+        result[i].port = port;
+        /// the device's own link caps every mode, eg. a usb3 camera on a usb2 port
+        if (port.link_mbps > 0.0)
+        {
+            double link = options.share * port.link_mbps;
+            auto lightest = *std::min_element(modes[i].begin(), modes[i].end(), [](const Mode &a, const Mode &b)
+                                              { return a.mbps < b.mbps; });
+            modes[i].erase(std::remove_if(modes[i].begin(), modes[i].end(), [link](const Mode &mode)
+                                          { return mode.mbps > link; }), modes[i].end());
+            if (modes[i].empty())
+            {
+                modes[i].push_back(lightest);
+                result[i].fits = false;
+            }
+        }
+        if (port.bus > 0)
+        { buses[port.bus].push_back(i); }
+        else
+        {
+            /// unknown topology, nothing to share with
+            result[i].mode = modes[i].front();
+            result[i].bus_used_mbps = result[i].mode.mbps;
+        }
+    }
+
+    for (const auto &bus : buses)
+    {
+        const auto &members = bus.second;
+        auto limit = options.bus_limits.find(bus.first);
+        double budget = limit != options.bus_limits.end() ? limit->second
+                                                          : options.share * cameras[members.front()].port.bus_mbps;
+        if (budget <= 0.0)
+        { budget = 1e9; }
+
+        /// multiple choice knapsack in 1 Mbps steps: best[u] is the highest value within u
+        auto units = static_cast<size_t>(std::min(budget, 1e5));
+        std::vector<double> best(units + 1, 0.0), next;
+        std::vector<std::vector<int32_t>> choice(members.size(), std::vector<int32_t>(units + 1, -1));
+        for (size_t k = 0; k < members.size(); ++k)
+        {
+            size_t index = members[k];
+            double priority = std::max(0.0, cameras[index].priority);
+            next.assign(units + 1, -1.0);
+            for (size_t u = 0; u <= units; ++u)
+            {
+                for (size_t m = 0; m < modes[index].size(); ++m)
+                {
+                    auto cost = static_cast<size_t>(std::ceil(modes[index][m].mbps));
+                    if (cost > u || best[u - cost] < 0.0)
+                    { continue; }
+                    double value = best[u - cost] + priority * modes[index][m].quality;
+                    if (value > next[u])
+                    {
+                        next[u] = value;
+                        choice[k][u] = static_cast<int32_t>(m);
+                    }
+                }
+            }
+            best.swap(next);
+        }
+
+        double used = 0.0;
+        bool fits = best[units] >= 0.0;
+        size_t u = units;
+        for (size_t k = members.size(); k-- > 0;)
+        {
+            size_t index = members[k];
+            auto &assignment = result[index];
+            if (fits)
+            {
+                assignment.mode = modes[index][choice[k][u]];
+                u -= static_cast<size_t>(std::ceil(assignment.mode.mbps));
+            }
+            else
+            {
+                /// overcommitted whatever is chosen, everyone takes the lightest mode
+                assignment.mode = *std::min_element(modes[index].begin(), modes[index].end(),
+                                                    [](const Mode &a, const Mode &b)
+                                                    { return a.mbps < b.mbps; });
+                assignment.fits = false;
+            }
+            used += assignment.mode.mbps;
+        }
+        for (size_t index : members)
+        {
+            result[index].bus_used_mbps = used;
+            result[index].bus_budget_mbps = budget < 1e9 ? budget : 0.0;
+        }
+    }
+    return result;
+}
+
+void BandwidthPlanner::setOptions(const Options &options)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+}
+
+void BandwidthPlanner::join(DeviceRegistry::Handle device, const Camera &camera, Listener listener)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &member = members_[device];
+    member.camera = camera;
+    member.listener = std::move(listener);
+    member.planned = false;
+    plan();
+}
+
+void BandwidthPlanner::leave(DeviceRegistry::Handle device)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (members_.erase(device) > 0)
+    { plan(); }
+}
+
+void BandwidthPlanner::replan()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    plan();
+}
+
+bool BandwidthPlanner::assignment(DeviceRegistry::Handle device, Assignment &out) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = members_.find(device);
+    if (it == members_.end() || !it->second.planned)
+    { return false; }
+    out = it->second.assignment;
+    return true;
+}
+
+void BandwidthPlanner::plan()
+{
+    if (members_.empty())
+    { return; }
+
+    std::vector<Camera> cameras;
+    cameras.reserve(members_.size());
+    for (auto &entry : members_)
+    {
+        auto &camera = entry.second.camera;
+        if (!readPort(camera.video_path, camera.port))
+        { camera.port = UsbPort(); }
+        cameras.push_back(camera);
+    }
+
+    auto result = solve(cameras, options_);
+    size_t i = 0;
+    for (auto &entry : members_)
+    {
+        auto &member = entry.second;
+        const auto &next = result[i++];
+        const auto &last = member.assignment.mode.format;
+        bool changed = member.planned && (next.mode.format.width != last.width ||
+                                          next.mode.format.height != last.height || next.mode.format.fps != last.fps);
+        member.assignment = next;
+        member.planned = true;
+        if (changed && member.listener)
+        { member.listener(); }
+    }
+}
+
+}  // namespace obsbot_ros
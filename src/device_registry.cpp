@@ -0,0 +1,123 @@
+#include <algorithm>
+
+#include <obsbot_ros/device_registry.hpp>
+
+namespace obsbot_ros
+{
+
+DeviceRegistry &DeviceRegistry::get()
+{
+    static DeviceRegistry registry;
+    return registry;
+}
+
+DeviceRegistry::DeviceRegistry()
+{
+    Devices::get().setDevChangedCallback([this](const std::string &dev_sn, bool in_out, void *)
+                                         { onDevChanged(dev_sn, in_out); }, nullptr);
+}
+
+uint32_t DeviceRegistry::addListener(Listener listener)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    listeners_.emplace_back(next_id_, std::move(listener));
+    return next_id_++;
+}
+
+void DeviceRegistry::removeListener(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    listeners_.erase(std::remove_if(listeners_.begin(), listeners_.end(),
+                                    [id](const std::pair<uint32_t, Listener> &entry)
+                                    { return entry.first == id; }), listeners_.end());
+}
+
+DeviceRegistry::Handle DeviceRegistry::intern(const std::string &dev_sn)
+{
+    if (dev_sn.empty())
+    { return kNoDevice; }
+
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    auto it = handles_.find(dev_sn);
+    if (it != handles_.end())
+    { return it->second; }
+
+    entries_.push_back(Entry{dev_sn, {}});
+    auto handle = static_cast<Handle>(entries_.size());
+    handles_.emplace(dev_sn, handle);
+    return handle;
+}
+
+const std::string &DeviceRegistry::serial(Handle device)
+{
+    static const std::string none;
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    if (device == kNoDevice || device > entries_.size())
+    { return none; }
+    return entries_[device - 1].serial;
+}
+
+/// the device is cached at the plug event, a device that was enumerated before the registry existed is looked up once
+std::shared_ptr<Device> DeviceRegistry::find(Handle device)
+{
+    const std::string *dev_sn;
+    {
+        std::lock_guard<std::mutex> lock(table_mutex_);
+        if (device == kNoDevice || device > entries_.size())
+        { return nullptr; }
+        auto &entry = entries_[device - 1];
+        if (auto dev = entry.device.lock())
+        { return dev; }
+        dev_sn = &entry.serial;
+    }
+
+    auto dev = Devices::get().getDevBySn(*dev_sn);
+    if (dev)
+    {
+        std::lock_guard<std::mutex> lock(table_mutex_);
+        entries_[device - 1].device = dev;
+    }
+    return dev;
+}
+
+std::shared_ptr<Device> DeviceRegistry::find(const std::string &dev_sn)
+{
+    if (!dev_sn.empty())
+    { return find(intern(dev_sn)); }
+
+    auto devices = Devices::get().getDevList();
+    return devices.empty() ? nullptr : devices.front();
+}
+
+std::vector<std::string> DeviceRegistry::serials()
+{
+    std::vector<std::string> result;
+    for (const auto &dev : Devices::get().getDevList())
+    {
+        result.push_back(dev->devSn());
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+/// listeners run under the lock, so one can not be removed while it is being called
+void DeviceRegistry::onDevChanged(const std::string &dev_sn, bool in_out)
+{
+    Handle device = intern(dev_sn);
+    if (device == kNoDevice)
+    { return; }
+
+    auto dev = in_out ? Devices::get().getDevBySn(dev_sn) : nullptr;
+    {
+        std::lock_guard<std::mutex> lock(table_mutex_);
+        entries_[device - 1].device = dev;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &entry : listeners_)
+    {
+        entry.second(device, in_out);
+    }
+}
+
+}  // namespace obsbot_ros
@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <cstdio>
+
+#include <obsbot_ros/diagnostics_aggregator.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+using diagnostic_msgs::msg::DiagnosticStatus;
+
+const char *kEntryNames[] = {"device", "stream", "sdk", "battery", "temperature", "sd card", "modules", "network",
+                             "ai status", "stabilizer", "horizon leveler", "overlay",
+                             "motion tracker", "digital ptz"};
+
+uint8_t levelFromTempStatus(uint8_t temp_status)
+{
+    return temp_status == 0 ? DiagnosticStatus::OK : (temp_status == 1 ? DiagnosticStatus::WARN
+                                                                        : DiagnosticStatus::ERROR);
+}
+
+const char *devStatusName(int32_t dev_status)
+{
+    switch (dev_status)
+    {
+    case Device::DevStatusRun:
+        return "running";
+    case Device::DevStatusSleep:
+        return "sleep";
+    case Device::DevStatusPrivacy:
+        return "privacy";
+    default:
+        return "unknown";
+    }
+}
+}
+
+DiagnosticsAggregator::DiagnosticsAggregator(const std::string &name, const std::string &hardware_id) :
+    entries_(EntryCount)
+{
+    for (size_t i = 0; i < entries_.size(); ++i)
+    {
+        entries_[i].status.name = name + ": " + kEntryNames[i];
+        entries_[i].status.hardware_id = hardware_id;
+    }
+}
+
+void DiagnosticsAggregator::updateStatus(ObsbotProductType product, const Device::CameraStatus &status)
+{
+    begin(EntryDevice);
+    switch (product)
+    {
+    case ObsbotProdTiny:
+    case ObsbotProdTiny4k:
+    case ObsbotProdTiny2:
+    {
+        value("zoom ratio", static_cast<int64_t>(status.tiny.zoom_ratio));
+        value("ai mode", static_cast<int64_t>(status.tiny.ai_mode));
+        commit(DiagnosticStatus::OK, devStatusName(status.tiny.dev_status));
+        break;
+    }
+    case ObsbotProdMeet:
+    case ObsbotProdMeet4k:
+    {
+        value("zoom ratio", static_cast<int64_t>(status.meet.zoom_ratio));
+        value("media mode", static_cast<int64_t>(status.meet.media_mode));
+        commit(DiagnosticStatus::OK, devStatusName(status.meet.dev_status));
+        break;
+    }
+    case ObsbotProdTailAir:
+    {
+        value("zoom ratio", static_cast<int64_t>(status.tail_air.digi_zoom_ratio));
+        value("ai type", static_cast<int64_t>(status.tail_air.ai_type));
+        value("work mode", static_cast<int64_t>(status.tail_air.work_mode));
+        value("record status", static_cast<int64_t>(status.tail_air.media_running.record_status));
+        commit(status.tail_air.media_running.has_exception ? DiagnosticStatus::WARN : DiagnosticStatus::OK,
+               status.tail_air.media_running.has_exception ? "media exception" : "running");
+        updateTailAir(status);
+        break;
+    }
+    default:
+        commit(DiagnosticStatus::OK, "no status for this product");
+    }
+}
+
+/// battery, temperature, sd card and module bits only exist on tail air
+void DiagnosticsAggregator::updateTailAir(const Device::CameraStatus &status)
+{
+    const auto &tail = status.tail_air;
+
+    begin(EntryBattery);
+    value("capacity", static_cast<int64_t>(tail.battery.capacity));
+    value("charging", static_cast<int64_t>(tail.battery.charging));
+    value("adapter", static_cast<int64_t>(tail.misc_status.adapter_plugin));
+    if (!tail.online_status.bat_online)
+    { commit(DiagnosticStatus::OK, "no battery"); }
+    else if (tail.battery.capacity < 3 && !tail.battery.charging)
+    { commit(DiagnosticStatus::ERROR, "battery critical"); }
+    else if (tail.battery.capacity < 10 && !tail.battery.charging)
+    { commit(DiagnosticStatus::WARN, "battery low"); }
+    else
+    { commit(DiagnosticStatus::OK, tail.battery.charging ? "charging" : "ok"); }
+
+    begin(EntryTemperature);
+    value("lens", static_cast<int64_t>(tail.misc_status.lens_temp_status));
+    value("cpu", static_cast<int64_t>(tail.misc_status.cpu_temp_status));
+    auto temp_level = std::max(levelFromTempStatus(tail.misc_status.lens_temp_status),
+                               levelFromTempStatus(tail.misc_status.cpu_temp_status));
+    commit(temp_level, temp_level == DiagnosticStatus::OK ? "ok" : (temp_level == DiagnosticStatus::WARN
+                                                                    ? "temperature high" : "overheating"));
+
+    begin(EntrySdCard);
+    value("inserted", static_cast<int64_t>(tail.online_status.sd_insert));
+    value("status", static_cast<int64_t>(tail.sd_status));
+    value("speed", static_cast<int64_t>(tail.sd_card_speed));
+    value("total", static_cast<int64_t>(tail.sd_total_size));
+    value("left", static_cast<int64_t>(tail.sd_left_size));
+    if (!tail.online_status.sd_insert)
+    { commit(DiagnosticStatus::OK, "not inserted"); }
+    else if (tail.sd_total_size > 0 && tail.sd_left_size == 0)
+    { commit(DiagnosticStatus::WARN, "full"); }
+    else
+    { commit(DiagnosticStatus::OK, "ok"); }
+
+    begin(EntryModules);
+    const auto &online = tail.online_status;
+    value("ai", static_cast<int64_t>(online.ai_online));
+    value("gimbal", static_cast<int64_t>(online.gim_online));
+    value("battery", static_cast<int64_t>(online.bat_online));
+    value("lens", static_cast<int64_t>(online.lens_online));
+    value("tof", static_cast<int64_t>(online.tof_online));
+    value("bluetooth", static_cast<int64_t>(online.bluetooth_online));
+    value("usb wifi", static_cast<int64_t>(online.usb_wifi));
+    value("poe", static_cast<int64_t>(online.poe_attached));
+    value("swivel base", static_cast<int64_t>(online.swivel_base));
+    value("audio", static_cast<int64_t>(online.audio_attached));
+    value("remote", static_cast<int64_t>(online.remote_attached));
+    value("sensor error", static_cast<int64_t>(online.sensor_err));
+    value("media error", static_cast<int64_t>(online.media_err));
+    if (online.sensor_err || online.media_err)
+    { commit(DiagnosticStatus::ERROR, online.sensor_err ? "sensor error" : "media error"); }
+    else if (!online.ai_online || !online.gim_online || !online.lens_online)
+    { commit(DiagnosticStatus::WARN, "module offline"); }
+    else
+    { commit(DiagnosticStatus::OK, "ok"); }
+}
+
+/// counters that grow every frame are left out, only values worth a new message are compared
+void DiagnosticsAggregator::updateStream(const StreamStats &stats)
+{
+    auto total = stats.captured + stats.dropped;
+    double drop_ratio = total > 0 ? 100.0 * static_cast<double>(stats.dropped) / static_cast<double>(total) : 0.0;
+
+    begin(EntryStream);
+    value("fps", static_cast<int64_t>(stats.fps + 0.5));
+    value("dropped", static_cast<int64_t>(stats.dropped));
+    value("drop ratio %", drop_ratio);
+    commit(drop_ratio > 5.0 ? DiagnosticStatus::WARN : DiagnosticStatus::OK,
+           stats.fps > 0.0 ? "streaming" : "idle");
+}
+
+void DiagnosticsAggregator::updateSdk(const SdkStats &stats)
+{
+    begin(EntrySdk);
+    value("errors", static_cast<int64_t>(stats.errors));
+    value("error rate 1/s", stats.error_rate);
+    commit(stats.error_rate > 1.0 ? DiagnosticStatus::WARN : DiagnosticStatus::OK,
+           stats.error_rate > 0.0 ? "sdk calls failing" : "ok");
+}
+
+/// rates are rounded so a steady link does not produce a message every sample
+void DiagnosticsAggregator::updateNetwork(const NetworkStats &stats)
+{
+    begin(EntryNetwork);
+    value("connected", static_cast<int64_t>(stats.connected));
+    value("rx kbps", static_cast<int64_t>(stats.rx_kbps / 100.0 + 0.5) * 100);
+    value("loss %", 100.0 * stats.loss);
+    value("jitter ms", static_cast<int64_t>(stats.jitter_ms + 0.5));
+    value("delay ms", static_cast<int64_t>(stats.delay_ms / 10.0 + 0.5) * 10);
+    value("reconnects", static_cast<int64_t>(stats.reconnects));
+    value("rung", std::to_string(stats.rung + 1) + "/" + std::to_string(stats.rung_count));
+    if (!stats.connected)
+    { commit(DiagnosticStatus::WARN, "not connected"); }
+    else if (stats.loss > 0.02)
+    { commit(DiagnosticStatus::WARN, "packet loss"); }
+    else
+    { commit(DiagnosticStatus::OK, stats.rung > 0 ? "reduced quality" : "ok"); }
+}
+
+/// latency is compared in 5 ms steps, the counters only matter when they move
+void DiagnosticsAggregator::updateAiPoll(const AiPollStats &stats)
+{
+    begin(EntryAiPoll);
+    value("rate hz", static_cast<int64_t>(stats.rate_hz + 0.5));
+    value("latency ms", static_cast<int64_t>(stats.latency_ms / 5.0 + 0.5) * 5);
+    value("max latency ms", static_cast<int64_t>(stats.max_latency_ms / 5.0 + 0.5) * 5);
+    value("timeouts", static_cast<int64_t>(stats.timeouts));
+    value("errors", static_cast<int64_t>(stats.errors));
+    if (stats.rate_hz <= 0.0)
+    { commit(DiagnosticStatus::WARN, "no responses"); }
+    else if (stats.latency_ms > 100.0)
+    { commit(DiagnosticStatus::WARN, "slow responses"); }
+    else
+    { commit(DiagnosticStatus::OK, "ok"); }
+}
+
+/// the frame counter moves every frame and is left out, the angle is compared in whole degrees
+void DiagnosticsAggregator::updateStabilizer(const Stabilizer::Stats &stats)
+{
+    begin(EntryStabilizer);
+    stageValues(stats.unsupported, stats.process_us, stats.max_process_us);
+    value("dropped", static_cast<int64_t>(stats.dropped));
+    value("no attitude", static_cast<int64_t>(stats.no_attitude));
+    value("correction deg", static_cast<int64_t>(stats.correction_deg + 0.5));
+    commitStage(stats.frames, stats.unsupported);
+}
+
+/// the rotated frames as a share of all, which only moves when the camera tilts more or less often
+void DiagnosticsAggregator::updateLeveler(const HorizonLeveler::Stats &stats)
+{
+    begin(EntryLeveler);
+    stageValues(stats.unsupported, stats.process_us, stats.max_process_us);
+    value("dropped", static_cast<int64_t>(stats.dropped));
+    value("no attitude", static_cast<int64_t>(stats.no_attitude));
+    value("rotated %", static_cast<int64_t>(
+        stats.frames ? 100.0 * static_cast<double>(stats.rotated) / static_cast<double>(stats.frames) + 0.5 : 0.0));
+    value("roll deg", static_cast<int64_t>(stats.roll_deg + (stats.roll_deg < 0.0 ? -0.5 : 0.5)));
+    commitStage(stats.frames, stats.unsupported);
+}
+
+/// cells drawn per frame over the whole run, what the change tracking of the lines saves
+void DiagnosticsAggregator::updateOverlay(const TelemetryOverlay::Stats &stats)
+{
+    begin(EntryOverlay);
+    stageValues(stats.unsupported, stats.process_us, stats.max_process_us);
+    value("cells per frame",
+          stats.frames ? static_cast<double>(stats.cells_drawn) / static_cast<double>(stats.frames) : 0.0);
+    commitStage(stats.frames, stats.unsupported);
+}
+
+void DiagnosticsAggregator::updateMotion(const MotionTracker::Stats &stats)
+{
+    begin(EntryMotion);
+    stageValues(stats.unsupported, stats.process_us, stats.max_process_us);
+    value("motion %", static_cast<int64_t>(
+        stats.frames ? 100.0 * static_cast<double>(stats.motion_frames) / static_cast<double>(stats.frames) + 0.5
+                     : 0.0));
+    commitStage(stats.frames, stats.unsupported);
+}
+
+void DiagnosticsAggregator::updatePtz(const DigitalPtz::Stats &stats)
+{
+    begin(EntryPtz);
+    value("inputs", static_cast<int64_t>(stats.inputs));
+    value("commands", static_cast<int64_t>(stats.commands));
+    commit(DiagnosticStatus::OK, stats.inputs > 0 ? "in use" : "idle");
+}
+
+bool DiagnosticsAggregator::collect(diagnostic_msgs::msg::DiagnosticArray &out, bool full)
+{
+    out.status.clear();
+    for (auto &entry : entries_)
+    {
+        if (entry.used && (entry.changed || full))
+        {
+            out.status.push_back(entry.status);
+            entry.changed = false;
+        }
+    }
+    return !out.status.empty();
+}
+
+void DiagnosticsAggregator::begin(EntryIndex index)
+{
+    current_ = index;
+    value_count_ = 0;
+}
+
+void DiagnosticsAggregator::value(const char *key, const std::string &value)
+{
+    if (value_count_ == scratch_.values.size())
+    { scratch_.values.emplace_back(); }
+    auto &kv = scratch_.values[value_count_++];
+    kv.key = key;
+    kv.value = value;
+}
+
+void DiagnosticsAggregator::value(const char *key, int64_t value)
+{
+    this->value(key, std::to_string(value));
+}
+
+void DiagnosticsAggregator::value(const char *key, double value)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.1f", value);
+    this->value(key, std::string(buf));
+}
+
+/// timings are compared in 50 us steps
+void DiagnosticsAggregator::stageValues(uint64_t unsupported, double process_us, double max_process_us)
+{
+    value("process us", static_cast<int64_t>(process_us / 50.0 + 0.5) * 50);
+    value("max process us", static_cast<int64_t>(max_process_us / 50.0 + 0.5) * 50);
+    value("unsupported", static_cast<int64_t>(unsupported));
+}
+
+void DiagnosticsAggregator::commitStage(uint64_t frames, uint64_t unsupported)
+{
+    if (unsupported > 0)
+    { commit(DiagnosticStatus::WARN, "needs a raw video format"); }
+    else
+    { commit(DiagnosticStatus::OK, frames > 0 ? "running" : "idle"); }
+}
+
+void DiagnosticsAggregator::commit(uint8_t level, const std::string &message)
+{
+    auto &entry = entries_[current_];
+    auto &status = entry.status;
+
+    bool changed = !entry.used || status.level != level || status.message != message ||
+                   status.values.size() != value_count_;
+    for (size_t i = 0; !changed && i < value_count_; ++i)
+    {
+        changed = status.values[i].key != scratch_.values[i].key || status.values[i].value != scratch_.values[i].value;
+    }
+
+    if (changed)
+    {
+        status.level = level;
+        status.message = message;
+        status.values.assign(scratch_.values.begin(), scratch_.values.begin() + static_cast<long>(value_count_));
+        entry.changed = true;
+    }
+    entry.used = true;
+}
+
+}  // namespace obsbot_ros
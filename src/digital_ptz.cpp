@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cmath>
+
+#include <obsbot_ros/digital_ptz.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+double clampRange(double value)
+{
+    return std::min(1.0, std::max(-1.0, value));
+}
+}
+
+DigitalPtz::DigitalPtz(const Options &options) : options_(options)
+{
+    options_.max_speed = std::max(1e-3, options_.max_speed);
+    options_.acceleration = std::max(1e-3, options_.acceleration);
+}
+
+void DigitalPtz::setVelocity(double pan, double tilt, int64_t now_ns)
+{
+    ++stats_.inputs;
+    velocity_mode_ = true;
+    velocity_ns_ = now_ns;
+    pan_.command = clampRange(pan);
+    tilt_.command = clampRange(tilt);
+}
+
+void DigitalPtz::setTarget(double pan, double tilt)
+{
+    ++stats_.inputs;
+    velocity_mode_ = false;
+    pan_.target = clampRange(pan);
+    tilt_.target = clampRange(tilt);
+}
+
+void DigitalPtz::step(int64_t now_ns)
+{
+    double dt = last_step_ns_ != 0 ? static_cast<double>(now_ns - last_step_ns_) * 1e-9 : 0.0;
+    last_step_ns_ = now_ns;
+
+    /// a released or disconnected joystick stops the window
+    if (velocity_mode_ && now_ns - velocity_ns_ > options_.velocity_timeout_ns)
+    {
+        pan_.command = 0.0;
+        tilt_.command = 0.0;
+    }
+    if (dt > 0.0)
+    {
+        /// a late tick must not turn into a jump
+        dt = std::min(dt, 0.1);
+        stepAxis(pan_, dt);
+        stepAxis(tilt_, dt);
+    }
+
+    state_.pan = pan_.position;
+    state_.tilt = tilt_.position;
+    state_.pan_speed = pan_.speed;
+    state_.tilt_speed = tilt_.speed;
+    state_.moving = pan_.speed != 0.0 || tilt_.speed != 0.0;
+}
+
+bool DigitalPtz::poll(int64_t now_ns, double &pan, double &tilt)
+{
+    bool moved = std::fabs(pan_.position - pan_.sent) >= options_.resolution ||
+                 std::fabs(tilt_.position - tilt_.sent) >= options_.resolution;
+    /// the final position of a move is always sent, even if it is closer than the resolution
+    bool settled = !state_.moving && (pan_.position != pan_.sent || tilt_.position != tilt_.sent);
+    if (!(moved || settled) || (sent_any_ && now_ns - last_command_ns_ < options_.min_interval_ns))
+    { return false; }
+
+    pan = pan_.position;
+    tilt = tilt_.position;
+    pan_.sent = pan;
+    tilt_.sent = tilt;
+    sent_any_ = true;
+    last_command_ns_ = now_ns;
+    ++stats_.commands;
+    return true;
+}
+
+void DigitalPtz::reset(double pan, double tilt)
+{
+    pan_ = Axis();
+    tilt_ = Axis();
+    pan_.position = pan_.target = pan_.sent = clampRange(pan);
+    tilt_.position = tilt_.target = tilt_.sent = clampRange(tilt);
+    velocity_mode_ = false;
+    last_step_ns_ = 0;
+    state_ = State();
+    state_.pan = pan_.position;
+    state_.tilt = tilt_.position;
+}
+
+/// speed follows the wanted speed within the acceleration limit; a target is approached on the braking curve
+void DigitalPtz::stepAxis(Axis &axis, double dt) const
+{
+    double wanted;
+    if (velocity_mode_)
+    {
+        wanted = axis.command * options_.max_speed;
+    }
+    else
+    {
+        double distance = axis.target - axis.position;
+        double braking = std::sqrt(2.0 * options_.acceleration * std::fabs(distance));
+        wanted = std::copysign(std::min(options_.max_speed, braking), distance);
+    }
+
+    double change = options_.acceleration * dt;
+    axis.speed += std::min(change, std::max(-change, wanted - axis.speed));
+    double next = axis.position + axis.speed * dt;
+
+    if (!velocity_mode_ && (axis.target - axis.position) * (axis.target - next) <= 0.0)
+    {
+        /// reached or passed the target in this step
+        axis.position = axis.target;
+        axis.speed = 0.0;
+        return;
+    }
+    axis.position = clampRange(next);
+    if (axis.position != next || (velocity_mode_ && wanted == 0.0 && std::fabs(axis.speed) < change))
+    {
+        /// at the edge of the range, or stopped
+        axis.speed = 0.0;
+    }
+}
+
+}  // namespace obsbot_ros
@@ -0,0 +1,32 @@
+#include <memory>
+
+#include <lifecycle_msgs/msg/state.hpp>
+#include <rclcpp/rclcpp.hpp>
+
+#include <obsbot_ros/executor_layout.hpp>
+#include <obsbot_ros/obsbot_node.hpp>
+
+int main(int argc, char **argv)
+{
+    rclcpp::init(argc, argv);
+
+    auto node = std::make_shared<obsbot_ros::ObsbotNode>();
+
+    /// without a lifecycle manager, bring the node up to streaming right away
+    if (node->get_parameter("autostart").as_bool())
+    {
+        if (node->configure().id() == lifecycle_msgs::msg::State::PRIMARY_STATE_INACTIVE)
+        {
+            node->activate();
+        }
+    }
+
+    /// every callback role runs where the executor.* parameters place it
+    obsbot_ros::ExecutorLayout layout(
+        obsbot_ros::ExecutorLayout::optionsFromParameters(node->get_node_parameters_interface()));
+    layout.add(node->callbackGroups());
+    layout.spin();
+
+    rclcpp::shutdown();
+    return 0;
+}
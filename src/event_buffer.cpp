@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#include <sys/stat.h>
+
+#include <obsbot_ros/event_buffer.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+/// mkdir -p
+bool makeDirs(const std::string &path)
+{
+    for (size_t pos = 1; pos <= path.size(); ++pos)
+    {
+        if (pos != path.size() && path[pos] != '/')
+        { continue; }
+        auto part = path.substr(0, pos);
+        if (::mkdir(part.c_str(), 0755) != 0 && errno != EEXIST)
+        { return false; }
+    }
+    return true;
+}
+
+const char *videoName(RmVideoFormat format)
+{
+    switch (format)
+    {
+    case RmVideoFormat::MJPEG:
+        return "video.mjpeg";
+    case RmVideoFormat::H264:
+        return "video.h264";
+    case RmVideoFormat::HEVC:
+        return "video.h265";
+    default:
+        return "video.bin";
+    }
+}
+}
+
+EventBuffer::EventBuffer(const Options &options) : options_(options)
+{
+    options_.max_bytes = std::max<size_t>(1 << 20, options_.max_bytes);
+    options_.max_records = std::max<size_t>(16, options_.max_records);
+    storage_.reset(new uint8_t[options_.max_bytes]);
+    records_.resize(options_.max_records);
+    thread_ = std::thread(&EventBuffer::run, this);
+}
+
+EventBuffer::~EventBuffer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        if (dumping_ && !closing_)
+        {
+            closing_ = true;
+            dump_end_ = end_;
+        }
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void EventBuffer::onFrame(const FrameRef &frame)
+{
+    const Frame &source = *frame;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!isEncoded(source.format))
+    {
+        ++stats_.unsupported;
+        return;
+    }
+
+    Record record;
+    record.kind = KindFrame;
+    record.size = static_cast<uint32_t>(source.size);
+    record.format = source.format;
+    record.keyframe = source.keyframe || source.format == RmVideoFormat::MJPEG;
+    record.sequence = source.sequence;
+    record.stamp_ns = source.stamp_ns;
+    if (append(record, source.data))
+    { ++stats_.frames; }
+    else
+    { ++stats_.overflow; }
+}
+
+void EventBuffer::onRelease()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (dumping_ && !closing_)
+    {
+        closing_ = true;
+        dump_end_ = end_;
+        cv_.notify_one();
+    }
+}
+
+void EventBuffer::addStatus(int64_t stamp_ns, StatusKind kind, const void *data, size_t size)
+{
+    Record record;
+    record.kind = KindStatus;
+    record.size = static_cast<uint32_t>(size);
+    record.status_kind = kind;
+    record.stamp_ns = stamp_ns;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (append(record, data))
+    { ++stats_.status; }
+    else
+    { ++stats_.overflow; }
+}
+
+std::string EventBuffer::trigger(const std::string &reason, int64_t stamp_ns)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t until = stamp_ns + options_.post_ns;
+    if (dumping_)
+    {
+        /// still running, or written up to its end but not yet closed: the dump simply goes on
+        until_ns_ = std::max(until_ns_, until);
+        closing_ = false;
+        cv_.notify_one();
+        return dump_dir_;
+    }
+    if (first_ == end_)
+    { return std::string(); }
+
+    char stamp[32];
+    std::time_t seconds = static_cast<std::time_t>(stamp_ns / 1000000000);
+    std::tm parts{};
+    localtime_r(&seconds, &parts);
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &parts);
+
+    std::string name = reason;
+    std::replace_if(name.begin(), name.end(), [](char c)
+                    { return !std::isalnum(static_cast<unsigned char>(c)); }, '_');
+    dump_dir_ = options_.directory + "/" + options_.prefix + "_" + stamp + "_" + name;
+
+    dumping_ = true;
+    closing_ = false;
+    write_seq_ = first_;
+    until_ns_ = until;
+    ++stats_.dumps;
+    cv_.notify_one();
+    return dump_dir_;
+}
+
+EventBuffer::Stats EventBuffer::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.dumping = dumping_;
+    stats.buffered_bytes = 0;
+    stats.buffered_s = 0.0;
+    if (first_ != end_)
+    {
+        const auto &oldest = records_[first_ % records_.size()];
+        const auto &newest = records_[(end_ - 1) % records_.size()];
+        size_t end = newest.offset + newest.size;
+        stats.buffered_bytes = end >= oldest.offset ? end - oldest.offset : options_.max_bytes - oldest.offset + end;
+        stats.buffered_s = static_cast<double>(newest.stamp_ns - oldest.stamp_ns) * 1e-9;
+    }
+    return stats;
+}
+
+bool EventBuffer::append(Record record, const void *data)
+{
+    /// a frame past the post window ends the dump, it and everything after only go to the ring
+    if (dumping_ && !closing_ && record.stamp_ns > until_ns_)
+    {
+        closing_ = true;
+        dump_end_ = end_;
+        cv_.notify_one();
+    }
+
+    while (evictable() && records_[first_ % records_.size()].stamp_ns < record.stamp_ns - options_.pre_ns)
+    { evictOldest(); }
+    if (end_ - first_ == records_.size())
+    {
+        if (!evictable())
+        { return false; }
+        evictOldest();
+    }
+    if (!reserve(record.size, record.offset))
+    { return false; }
+
+    if (record.size)
+    { std::memcpy(storage_.get() + record.offset, data, record.size); }
+    at(end_) = record;
+    ++end_;
+    return true;
+}
+
+/// payloads are contiguous: at the head if it fits before the end of the storage, otherwise at its start
+bool EventBuffer::reserve(size_t size, size_t &offset)
+{
+    if (size > options_.max_bytes)
+    { return false; }
+
+    while (true)
+    {
+        if (first_ == end_)
+        {
+            offset = 0;
+            head_ = size;
+            return true;
+        }
+
+        size_t tail = records_[first_ % records_.size()].offset;
+        bool fits = false;
+        if (head_ > tail)
+        {
+            if (options_.max_bytes - head_ >= size)
+            {
+                offset = head_;
+                fits = true;
+            }
+            else if (tail >= size)
+            {
+                offset = 0;
+                fits = true;
+            }
+        }
+        else if (head_ < tail && tail - head_ >= size)
+        {
+            offset = head_;
+            fits = true;
+        }
+
+        if (fits)
+        {
+            head_ = offset + size;
+            return true;
+        }
+        if (!evictable())
+        { return false; }
+        evictOldest();
+    }
+}
+
+bool EventBuffer::evictable() const
+{
+    return first_ != end_ && (!dumping_ || first_ < write_seq_);
+}
+
+void EventBuffer::evictOldest()
+{
+    ++first_;
+    if (first_ == end_)
+    { head_ = 0; }
+}
+
+void EventBuffer::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        cv_.wait(lock, [this]()
+        { return stop_ || (dumping_ && (closing_ || write_seq_ < end_)); });
+        if (!dumping_)
+        {
+            if (stop_)
+            { break; }
+            continue;
+        }
+
+        uint64_t limit = closing_ ? dump_end_ : end_;
+        if (write_seq_ < limit)
+        {
+            /// the record is pinned until write_seq_ moves past it, its payload can be read without the lock
+            Record record = at(write_seq_);
+            if (!opened_)
+            {
+                open_dir_ = dump_dir_;
+                opened_ = true;
+            }
+            lock.unlock();
+            size_t written = writeRecord(record);
+            lock.lock();
+            stats_.bytes_written += written;
+            ++write_seq_;
+            continue;
+        }
+        if (!closing_)
+        { continue; }
+
+        /// a trigger from here on starts a new dump
+        dumping_ = false;
+        closing_ = false;
+        lock.unlock();
+        bool ok = closeDump();
+        lock.lock();
+        if (!ok)
+        { ++stats_.failed; }
+    }
+}
+
+std::FILE *EventBuffer::openFile(const char *name)
+{
+    if (dump_failed_)
+    { return nullptr; }
+    if (!dir_made_)
+    {
+        dir_made_ = true;
+        if (!makeDirs(open_dir_))
+        {
+            dump_failed_ = true;
+            return nullptr;
+        }
+    }
+    auto *file = std::fopen((open_dir_ + "/" + name).c_str(), "wb");
+    if (!file)
+    { dump_failed_ = true; }
+    return file;
+}
+
+size_t EventBuffer::writeRecord(const Record &record)
+{
+    const uint8_t *data = storage_.get() + record.offset;
+    if (record.kind == KindStatus)
+    {
+        if (!status_ && !(status_ = openFile("status.bin")))
+        { return 0; }
+        int32_t kind = record.status_kind;
+        bool ok = std::fwrite(&record.stamp_ns, sizeof(record.stamp_ns), 1, status_) == 1 &&
+                  std::fwrite(&kind, sizeof(kind), 1, status_) == 1 &&
+                  std::fwrite(&record.size, sizeof(record.size), 1, status_) == 1 &&
+                  std::fwrite(data, 1, record.size, status_) == record.size;
+        dump_failed_ |= !ok;
+        return ok ? record.size + 16 : 0;
+    }
+
+    /// an encoded stream only decodes from a keyframe on
+    if (!record.keyframe && waiting_keyframe_)
+    { return 0; }
+    waiting_keyframe_ = false;
+
+    if (!video_)
+    {
+        video_ = openFile(videoName(record.format));
+        index_ = openFile("frames.csv");
+        if (!video_ || !index_)
+        { return 0; }
+        std::fputs("sequence,stamp_ns,size,keyframe\n", index_);
+    }
+    bool ok = std::fwrite(data, 1, record.size, video_) == record.size;
+    std::fprintf(index_, "%llu,%lld,%u,%d\n", static_cast<unsigned long long>(record.sequence),
+                 static_cast<long long>(record.stamp_ns), record.size, record.keyframe ? 1 : 0);
+    dump_failed_ |= !ok;
+    return ok ? record.size : 0;
+}
+
+bool EventBuffer::closeDump()
+{
+    bool ok = !dump_failed_;
+    for (auto **file : {&video_, &index_, &status_})
+    {
+        if (*file)
+        {
+            ok &= std::fclose(*file) == 0;
+            *file = nullptr;
+        }
+    }
+    opened_ = false;
+    dir_made_ = false;
+    dump_failed_ = false;
+    waiting_keyframe_ = true;
+    return ok;
+}
+
+}  // namespace obsbot_ros
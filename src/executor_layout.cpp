@@ -0,0 +1,148 @@
+#include <algorithm>
+
+#include <obsbot_ros/executor_layout.hpp>
+
+namespace obsbot_ros
+{
+
+const char *callbackRoleName(CallbackRole role)
+{
+    switch (role)
+    {
+    case CallbackRole::Capture:
+        return "capture";
+    case CallbackRole::Control:
+        return "control";
+    case CallbackRole::Status:
+        return "status";
+    case CallbackRole::Media:
+        return "media";
+    case CallbackRole::Housekeeping:
+        return "housekeeping";
+    default:
+        return "unknown";
+    }
+}
+
+CallbackGroups::CallbackGroups(const rclcpp::node_interfaces::NodeBaseInterface::SharedPtr &node_base) :
+    node_base_(node_base)
+{
+    for (size_t i = 0; i < groups_.size(); ++i)
+    {
+        auto role = static_cast<CallbackRole>(i);
+        if (role == CallbackRole::Housekeeping)
+        {
+            groups_[i] = node_base->get_default_callback_group();
+        }
+        else
+        {
+            groups_[i] = node_base->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive, false);
+        }
+    }
+}
+
+ExecutorLayout::ExecutorLayout(Options options) : options_(std::move(options))
+{
+    bool need_shared = false;
+    for (size_t i = 0; i < dedicated_.size(); ++i)
+    {
+        const char *name = callbackRoleName(static_cast<CallbackRole>(i));
+        dedicated_[i] = std::find(options_.dedicated.begin(), options_.dedicated.end(), name) !=
+                        options_.dedicated.end();
+        if (dedicated_[i])
+        {
+            dedicated_executors_[i] = std::make_shared<rclcpp::executors::SingleThreadedExecutor>();
+        }
+        else
+        {
+            need_shared = true;
+        }
+    }
+
+    if (need_shared)
+    {
+        shared_executor_ = std::make_shared<rclcpp::executors::MultiThreadedExecutor>(
+            rclcpp::ExecutorOptions(), static_cast<size_t>(std::max(1, options_.shared_threads)));
+    }
+}
+
+ExecutorLayout::~ExecutorLayout()
+{
+    cancel();
+    for (auto &thread : threads_)
+    {
+        if (thread.joinable())
+        { thread.join(); }
+    }
+}
+
+ExecutorLayout::Options
+ExecutorLayout::optionsFromParameters(const rclcpp::node_interfaces::NodeParametersInterface::SharedPtr &params)
+{
+    Options options;
+    rclcpp::Parameter param;
+    if (params->get_parameter("executor.dedicated", param))
+    { options.dedicated = param.as_string_array(); }
+    if (params->get_parameter("executor.shared_threads", param))
+    { options.shared_threads = static_cast<int>(param.as_int()); }
+    return options;
+}
+
+void ExecutorLayout::add(const CallbackGroups &groups)
+{
+    for (size_t i = 0; i < dedicated_.size(); ++i)
+    {
+        auto &group = groups.get(static_cast<CallbackRole>(i));
+        if (dedicated_[i])
+        {
+            dedicated_executors_[i]->add_callback_group(group, groups.nodeBase());
+        }
+        else
+        {
+            shared_executor_->add_callback_group(group, groups.nodeBase());
+        }
+    }
+}
+
+void ExecutorLayout::spin()
+{
+    for (auto &executor : dedicated_executors_)
+    {
+        if (executor)
+        {
+            threads_.emplace_back([executor]()
+                                  { executor->spin(); });
+        }
+    }
+
+    /// the shared executor runs its own worker threads, the calling thread becomes one of them
+    if (shared_executor_)
+    {
+        shared_executor_->spin();
+    }
+
+    for (auto &thread : threads_)
+    {
+        if (thread.joinable())
+        { thread.join(); }
+    }
+    threads_.clear();
+}
+
+void ExecutorLayout::cancel()
+{
+    for (auto &executor : dedicated_executors_)
+    {
+        if (executor)
+        { executor->cancel(); }
+    }
+    if (shared_executor_)
+    { shared_executor_->cancel(); }
+}
+
+bool ExecutorLayout::isDedicated(CallbackRole role) const
+{
+    return dedicated_[static_cast<size_t>(role)];
+}
+
+}  // namespace obsbot_ros
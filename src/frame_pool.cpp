@@ -0,0 +1,224 @@
+#include <obsbot_ros/frame_pool.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+/// buffers start on cache line boundaries so simd stages can use aligned loads on the first plane
+constexpr size_t kBufferAlign = 64;
+}
+
+/// the buffers of a pool, freed by the last of the pool and the frames it lent out
+struct FrameStorage
+{
+    struct Slot
+    {
+        Frame frame;
+        std::atomic<uint32_t> refs{0};
+    };
+
+    FrameStorage(size_t count, size_t capacity) : bytes(new uint8_t[capacity * count + kBufferAlign]), slots(count)
+    {}
+
+    void addRef(uint32_t index)
+    {
+        slots[index].refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release(uint32_t index)
+    {
+        if (slots[index].refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            {
+                std::lock_guard<std::mutex> lock(free_mutex);
+                free.push_back(index);
+            }
+            unuse();
+        }
+    }
+
+    void unuse()
+    {
+        if (users.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        { delete this; }
+    }
+
+    std::unique_ptr<uint8_t[]> bytes;
+    std::vector<Slot> slots;
+    std::mutex free_mutex;
+    std::vector<uint32_t> free;
+    std::atomic<size_t> users{1};               /// the pool and every buffer lent out
+};
+
+FrameRef::FrameRef(const FrameRef &other) : storage_(other.storage_), index_(other.index_)
+{
+    if (storage_)
+    { storage_->addRef(index_); }
+}
+
+FrameRef::FrameRef(FrameRef &&other) noexcept : storage_(other.storage_), index_(other.index_)
+{
+    other.storage_ = nullptr;
+}
+
+FrameRef &FrameRef::operator=(const FrameRef &other)
+{
+    if (this != &other)
+    {
+        if (other.storage_)
+        { other.storage_->addRef(other.index_); }
+        reset();
+        storage_ = other.storage_;
+        index_ = other.index_;
+    }
+    return *this;
+}
+
+FrameRef &FrameRef::operator=(FrameRef &&other) noexcept
+{
+    if (this != &other)
+    {
+        reset();
+        storage_ = other.storage_;
+        index_ = other.index_;
+        other.storage_ = nullptr;
+    }
+    return *this;
+}
+
+FrameRef::~FrameRef()
+{
+    reset();
+}
+
+void FrameRef::reset()
+{
+    if (storage_)
+    {
+        storage_->release(index_);
+        storage_ = nullptr;
+    }
+}
+
+Frame *FrameRef::operator->() const
+{
+    return get();
+}
+
+Frame &FrameRef::operator*() const
+{
+    return *get();
+}
+
+Frame *FrameRef::get() const
+{
+    return storage_ ? &storage_->slots[index_].frame : nullptr;
+}
+
+FramePool::FramePool(size_t count, size_t capacity) :
+    count_(count),
+    capacity_((capacity + kBufferAlign - 1) / kBufferAlign * kBufferAlign),
+    storage_(new FrameStorage(count, capacity_))
+{
+    auto base = reinterpret_cast<uintptr_t>(storage_->bytes.get());
+    auto *aligned = reinterpret_cast<uint8_t *>((base + kBufferAlign - 1) & ~(uintptr_t(kBufferAlign) - 1));
+
+    storage_->free.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        storage_->slots[i].frame.data = aligned + i * capacity_;
+        storage_->slots[i].frame.capacity = capacity_;
+        storage_->free.push_back(static_cast<uint32_t>(count - 1 - i));
+    }
+}
+
+FramePool::~FramePool()
+{
+    storage_->unuse();
+}
+
+FrameRef FramePool::acquire()
+{
+    uint32_t index;
+    {
+        std::lock_guard<std::mutex> lock(storage_->free_mutex);
+        if (storage_->free.empty())
+        { return FrameRef(); }
+        index = storage_->free.back();
+        storage_->free.pop_back();
+    }
+
+    auto &slot = storage_->slots[index];
+    slot.refs.store(1, std::memory_order_relaxed);
+    slot.frame.size = 0;
+    storage_->users.fetch_add(1, std::memory_order_relaxed);
+    return FrameRef(storage_, index);
+}
+
+size_t FramePool::available() const
+{
+    std::lock_guard<std::mutex> lock(storage_->free_mutex);
+    return storage_->free.size();
+}
+
+size_t frameBufferSize(RmVideoFormat format, int32_t width, int32_t height)
+{
+    auto pixels = static_cast<size_t>(width) * static_cast<size_t>(height);
+    switch (format)
+    {
+    case RmVideoFormat::I420:
+    case RmVideoFormat::NV12:
+    case RmVideoFormat::YV12:
+        return pixels * 3 / 2;
+    case RmVideoFormat::Y800:
+        return pixels;
+    case RmVideoFormat::YVYU:
+    case RmVideoFormat::YUY2:
+    case RmVideoFormat::UYVY:
+    case RmVideoFormat::HDYC:
+    case RmVideoFormat::MJPEG:
+    case RmVideoFormat::H264:
+    case RmVideoFormat::HEVC:
+        return pixels * 2;
+    case RmVideoFormat::RGB24:
+        return pixels * 3;
+    case RmVideoFormat::ARGB:
+    case RmVideoFormat::XRGB:
+        return pixels * 4;
+    default:
+        return 0;
+    }
+}
+
+const char *encodingName(RmVideoFormat format)
+{
+    switch (format)
+    {
+    case RmVideoFormat::MJPEG:
+        return "jpeg";
+    case RmVideoFormat::H264:
+        return "h264";
+    case RmVideoFormat::HEVC:
+        return "h265";
+    case RmVideoFormat::YUY2:
+        return "yuv422_yuy2";
+    case RmVideoFormat::UYVY:
+        return "yuv422";
+    case RmVideoFormat::NV12:
+        return "nv12";
+    case RmVideoFormat::I420:
+        return "i420";
+    case RmVideoFormat::Y800:
+        return "mono8";
+    default:
+        return "";
+    }
+}
+
+bool isEncoded(RmVideoFormat format)
+{
+    return format == RmVideoFormat::MJPEG || format == RmVideoFormat::H264 || format == RmVideoFormat::HEVC;
+}
+
+}  // namespace obsbot_ros
@@ -0,0 +1,194 @@
+#include <algorithm>
+
+#include <obsbot_ros/frame_synchronizer.hpp>
+
+namespace obsbot_ros
+{
+
+class FrameSynchronizer::Input : public FrameSink
+{
+public:
+    Input(FrameSynchronizer *owner, size_t stream) : owner_(owner), stream_(stream)
+    {}
+
+    void onFrame(const FrameRef &frame) override
+    { owner_->push(stream_, frame); }
+
+    void onRelease() override
+    { owner_->release(stream_); }
+
+    bool wantsFrames() const override
+    { return owner_->demand_callback_ && owner_->demand_callback_(); }
+
+private:
+    FrameSynchronizer *owner_;
+    size_t stream_;
+};
+
+FrameSynchronizer::FrameSynchronizer(const Options &options, ReadyCallback ready, DemandCallback demand) :
+    options_(options),
+    ready_callback_(std::move(ready)),
+    demand_callback_(std::move(demand))
+{
+    options_.streams = std::max<size_t>(1, options_.streams);
+    options_.queue_depth = std::max<size_t>(1, options_.queue_depth);
+    options_.set_depth = std::max<size_t>(1, options_.set_depth);
+    storage_.resize(options_.streams * options_.queue_depth);
+    heads_.assign(options_.streams, 0);
+    counts_.assign(options_.streams, 0);
+    set_.resize(options_.streams);
+    ready_.resize(options_.set_depth * options_.streams);
+    ready_skew_ns_.resize(options_.set_depth);
+    for (size_t i = 0; i < options_.streams; ++i)
+    {
+        inputs_.push_back(std::make_shared<Input>(this, i));
+    }
+}
+
+void FrameSynchronizer::push(size_t stream, const FrameRef &frame)
+{
+    if (stream >= options_.streams || !frame)
+    { return; }
+
+    size_t sets;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.frames;
+        if (counts_[stream] == options_.queue_depth)
+        {
+            pop(stream, nullptr);
+            ++stats_.overflows;
+            ++stats_.unmatched;
+        }
+        slot(stream, counts_[stream]++) = frame;
+        sets = match();
+        stats_.match_rate = static_cast<double>(stats_.sets * options_.streams) / static_cast<double>(stats_.frames);
+    }
+    if (sets > 0 && ready_callback_)
+    { ready_callback_(); }
+}
+
+bool FrameSynchronizer::take(const SetCallback &callback)
+{
+    std::lock_guard<std::mutex> take_lock(take_mutex_);
+    int64_t skew_ns;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ready_count_ == 0)
+        { return false; }
+        auto *frames = readySet(0);
+        for (size_t i = 0; i < options_.streams; ++i)
+        {
+            set_[i] = std::move(frames[i]);
+        }
+        skew_ns = ready_skew_ns_[ready_head_];
+        ready_head_ = (ready_head_ + 1) % options_.set_depth;
+        --ready_count_;
+    }
+
+    callback(set_.data(), set_.size(), skew_ns);
+    for (auto &frame : set_)
+    {
+        frame.reset();
+    }
+    return true;
+}
+
+void FrameSynchronizer::release(size_t stream)
+{
+    if (stream >= options_.streams)
+    { return; }
+
+    std::lock_guard<std::mutex> take_lock(take_mutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (counts_[stream] > 0)
+    {
+        pop(stream, nullptr);
+    }
+    while (ready_count_ > 0)
+    {
+        dropSet();
+    }
+}
+
+FrameSynchronizer::Stats FrameSynchronizer::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void FrameSynchronizer::pop(size_t stream, FrameRef *out)
+{
+    auto &frame = slot(stream, 0);
+    if (out)
+    { *out = std::move(frame); }
+    else
+    { frame.reset(); }
+    heads_[stream] = (heads_[stream] + 1) % options_.queue_depth;
+    --counts_[stream];
+}
+
+void FrameSynchronizer::dropSet()
+{
+    auto *frames = readySet(0);
+    for (size_t i = 0; i < options_.streams; ++i)
+    {
+        frames[i].reset();
+    }
+    ready_head_ = (ready_head_ + 1) % options_.set_depth;
+    --ready_count_;
+    ++stats_.dropped_sets;
+}
+
+size_t FrameSynchronizer::match()
+{
+    size_t sets = 0;
+    while (true)
+    {
+        int64_t oldest = 0;
+        int64_t newest = 0;
+        for (size_t i = 0; i < options_.streams; ++i)
+        {
+            if (counts_[i] == 0)
+            { return sets; }
+            auto stamp = slot(i, 0)->stamp_ns;
+            if (i == 0 || stamp < oldest)
+            { oldest = stamp; }
+            if (i == 0 || stamp > newest)
+            { newest = stamp; }
+        }
+
+        if (newest - oldest <= options_.tolerance_ns)
+        {
+            /// the consumer fell behind, the newest set is worth more than the oldest
+            if (ready_count_ == options_.set_depth)
+            { dropSet(); }
+            auto *frames = readySet(ready_count_);
+            for (size_t i = 0; i < options_.streams; ++i)
+            {
+                pop(i, &frames[i]);
+            }
+            int64_t skew = newest - oldest;
+            ready_skew_ns_[(ready_head_ + ready_count_) % options_.set_depth] = skew;
+            ++ready_count_;
+            ++sets;
+            ++stats_.sets;
+            stats_.last_skew_ns = skew;
+            stats_.max_skew_ns = std::max(stats_.max_skew_ns, skew);
+            stats_.mean_skew_ns += (static_cast<double>(skew) - stats_.mean_skew_ns) / 64.0;
+            continue;
+        }
+
+        /// every head too old for the newest one can never be part of a set
+        for (size_t i = 0; i < options_.streams; ++i)
+        {
+            if (slot(i, 0)->stamp_ns < newest - options_.tolerance_ns)
+            {
+                pop(i, nullptr);
+                ++stats_.unmatched;
+            }
+        }
+    }
+}
+
+}  // namespace obsbot_ros
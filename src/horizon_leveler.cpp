@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include <obsbot_ros/horizon_leveler.hpp>
+#include <obsbot_ros/image_ops.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+constexpr double kPi = 3.14159265358979323846;
+
+int32_t toFixed(double value)
+{
+    return static_cast<int32_t>(std::lround(value * 65536.0));
+}
+}
+
+HorizonLeveler::HorizonLeveler(const Options &options) : options_(options)
+{
+    options_.max_roll_deg = std::min(45.0, std::max(0.0, options_.max_roll_deg));
+    options_.threshold_deg = std::max(0.0, options_.threshold_deg);
+    options_.pool_size = std::max<size_t>(1, options_.pool_size);
+}
+
+FrameRef HorizonLeveler::process(const Frame &frame, const AttitudeTrack &track)
+{
+    image_ops::PlaneView y, u, v;
+    if (!image_ops::yuvPlanes(frame, y, u, v))
+    {
+        ++stats_.unsupported;
+        return FrameRef();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    FrameRef out;
+    if ((y.width == in_width_ && y.height == in_height_) || prepare(y.width, y.height))
+    { out = pool_->acquire(); }
+    if (!out)
+    {
+        ++stats_.dropped;
+        return out;
+    }
+    ++stats_.frames;
+
+    double roll = 0.0;
+    AttitudeTrack::Sample sample;
+    if (track.at(frame.steady_ns, options_.max_gap_ns, sample))
+    { roll = std::min(options_.max_roll_deg, std::max(-options_.max_roll_deg, static_cast<double>(sample.roll))); }
+    else
+    { ++stats_.no_attitude; }
+    stats_.roll_deg = roll;
+    if (std::fabs(roll) < options_.threshold_deg)
+    { roll = 0.0; }
+    else
+    { ++stats_.rotated; }
+
+    Frame &target = *out;
+    const size_t luma_size = static_cast<size_t>(out_width_) * static_cast<size_t>(out_height_);
+    const size_t chroma_size = luma_size / 4;
+    uint8_t *out_u = target.data + luma_size;
+    uint8_t *out_v = out_u + chroma_size;
+    int32_t m[6];
+    planeMap(roll, 1.0, 1.0, 1.0, m);
+    image_ops::affineWarp(y, target.data, out_width_, out_width_, out_height_, m);
+    if (u.data && v.data)
+    {
+        planeMap(roll, static_cast<double>(u.width) / y.width, static_cast<double>(u.height) / y.height, 0.5, m);
+        image_ops::affineWarp(u, out_u, out_width_ / 2, out_width_ / 2, out_height_ / 2, m);
+        image_ops::affineWarp(v, out_v, out_width_ / 2, out_width_ / 2, out_height_ / 2, m);
+    }
+    else
+    {
+        std::memset(out_u, 128, 2 * chroma_size);
+    }
+
+    target.size = frameBufferSize(RmVideoFormat::I420, out_width_, out_height_);
+    target.width = out_width_;
+    target.height = out_height_;
+    target.stride = out_width_;
+    target.format = RmVideoFormat::I420;
+    target.sequence = frame.sequence;
+    target.keyframe = false;
+    target.stamp_ns = frame.stamp_ns;
+    target.steady_ns = frame.steady_ns;
+
+    double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    stats_.process_us = stats_.frames == 1 ? elapsed_us : stats_.process_us + (elapsed_us - stats_.process_us) / 16.0;
+    stats_.max_process_us = std::max(stats_.max_process_us, elapsed_us);
+    return out;
+}
+
+/// largest centered crop of the input aspect that a rotation by max_roll keeps inside the picture
+bool HorizonLeveler::prepare(int32_t width, int32_t height)
+{
+    const double c = std::cos(options_.max_roll_deg * kPi / 180.0);
+    const double s = std::sin(options_.max_roll_deg * kPi / 180.0);
+    const double scale = std::min(width / (width * c + height * s), height / (width * s + height * c));
+    /// margins of whole chroma samples, so an unrotated frame is a copy
+    int32_t out_width = std::max(4, width - ((width - static_cast<int32_t>(width * scale) + 3) & ~3));
+    int32_t out_height = std::max(4, height - ((height - static_cast<int32_t>(height * scale) + 3) & ~3));
+
+    /// a smaller pool can only go once every buffer of it is back, until then frames are dropped
+    size_t capacity = frameBufferSize(RmVideoFormat::I420, out_width, out_height);
+    if (!pool_ || pool_->capacity() < capacity)
+    {
+        if (pool_ && pool_->available() != pool_->count())
+        { return false; }
+        pool_.reset(new FramePool(options_.pool_size, capacity));
+    }
+    in_width_ = width;
+    in_height_ = height;
+    out_width_ = out_width;
+    out_height_ = out_height;
+    return true;
+}
+
+/// source = center + R(roll) * (destination - output center), scaled into the planes' samples
+void HorizonLeveler::planeMap(double roll_deg, double scale_x, double scale_y, double out_scale, int32_t m[6]) const
+{
+    const double c = std::cos(roll_deg * kPi / 180.0);
+    const double s = std::sin(roll_deg * kPi / 180.0);
+    const double cx = 0.5 * (in_width_ - 1);
+    const double cy = 0.5 * (in_height_ - 1);
+    const double hx = 0.5 * (out_width_ - 1);
+    const double hy = 0.5 * (out_height_ - 1);
+    m[0] = toFixed(scale_x * c / out_scale);
+    m[1] = toFixed(scale_x * s / out_scale);
+    m[2] = toFixed(scale_x * (cx - c * hx - s * hy));
+    m[3] = toFixed(-scale_y * s / out_scale);
+    m[4] = toFixed(scale_y * c / out_scale);
+    m[5] = toFixed(scale_y * (cy + s * hx - c * hy));
+}
+
+}  // namespace obsbot_ros
@@ -0,0 +1,512 @@
+#include <algorithm>
+#include <cstring>
+
+/// OBSBOT_SCALAR_ONLY leaves only the scalar fallbacks, the tests compare them with the simd kernels
+#if defined(__SSE2__) && !defined(OBSBOT_SCALAR_ONLY)
+#define OBSBOT_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && !defined(OBSBOT_SCALAR_ONLY)
+#define OBSBOT_NEON
+#include <arm_neon.h>
+#endif
+
+#include <obsbot_ros/image_ops.hpp>
+
+namespace obsbot_ros
+{
+
+namespace image_ops
+{
+
+void blendRow(uint8_t *dst, const uint8_t *a, const uint8_t *b, uint32_t weight, size_t count)
+{
+    if (weight == 0)
+    {
+        if (dst != a)
+        { std::memmove(dst, a, count); }
+        return;
+    }
+    if (weight >= 256)
+    {
+        if (dst != b)
+        { std::memmove(dst, b, count); }
+        return;
+    }
+
+    size_t i = 0;
+#if defined(OBSBOT_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wa = _mm_set1_epi16(static_cast<int16_t>(256 - weight));
+    const __m128i wb = _mm_set1_epi16(static_cast<int16_t>(weight));
+    const __m128i round = _mm_set1_epi16(128);
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+                                   _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                                   _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(OBSBOT_NEON)
+    const uint8x8_t wa = vdup_n_u8(static_cast<uint8_t>(256 - weight));
+    const uint8x8_t wb = vdup_n_u8(static_cast<uint8_t>(weight));
+    for (; i + 16 <= count; i += 16)
+    {
+        uint8x16_t va = vld1q_u8(a + i);
+        uint8x16_t vb = vld1q_u8(b + i);
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(va), wa), vget_low_u8(vb), wb);
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(va), wa), vget_high_u8(vb), wb);
+        vst1q_u8(dst + i, vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        dst[i] = static_cast<uint8_t>((a[i] * (256 - weight) + b[i] * weight + 128) >> 8);
+    }
+}
+
+void blendMask(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, size_t count)
+{
+    size_t i = 0;
+#if defined(OBSBOT_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(256);
+    const __m128i round = _mm_set1_epi16(128);
+    auto half = [&](__m128i d, __m128i s, __m128i a)
+    {
+        /// 0..255 to 0..256, so an opaque sample is the source exactly
+        __m128i w = _mm_add_epi16(a, _mm_srli_epi16(a, 7));
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(d, _mm_sub_epi16(full, w)), _mm_mullo_epi16(s, w));
+        return _mm_srli_epi16(_mm_add_epi16(sum, round), 8);
+    };
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i vd = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+        __m128i vs = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(alpha + i));
+        __m128i lo = half(_mm_unpacklo_epi8(vd, zero), _mm_unpacklo_epi8(vs, zero), _mm_unpacklo_epi8(va, zero));
+        __m128i hi = half(_mm_unpackhi_epi8(vd, zero), _mm_unpackhi_epi8(vs, zero), _mm_unpackhi_epi8(va, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(OBSBOT_NEON)
+    const uint16x8_t full = vdupq_n_u16(256);
+    auto half = [&](uint8x8_t d, uint8x8_t s, uint8x8_t a)
+    {
+        uint16x8_t a16 = vmovl_u8(a);
+        uint16x8_t w = vsraq_n_u16(a16, a16, 7);
+        return vrshrn_n_u16(vmlaq_u16(vmulq_u16(vmovl_u8(d), vsubq_u16(full, w)), vmovl_u8(s), w), 8);
+    };
+    for (; i + 16 <= count; i += 16)
+    {
+        uint8x16_t vd = vld1q_u8(dst + i);
+        uint8x16_t vs = vld1q_u8(src + i);
+        uint8x16_t va = vld1q_u8(alpha + i);
+        vst1q_u8(dst + i, vcombine_u8(half(vget_low_u8(vd), vget_low_u8(vs), vget_low_u8(va)),
+                                      half(vget_high_u8(vd), vget_high_u8(vs), vget_high_u8(va))));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        uint32_t w = alpha[i] + (alpha[i] >> 7);
+        dst[i] = static_cast<uint8_t>((dst[i] * (256 - w) + src[i] * w + 128) >> 8);
+    }
+}
+
+size_t diffMask(uint8_t *mask, const uint8_t *a, const uint8_t *b, uint8_t threshold, size_t count)
+{
+    size_t set = 0;
+    size_t i = 0;
+#if defined(OBSBOT_SSE2)
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(threshold));
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+        /// above the threshold exactly where the saturated difference to it is not zero
+        __m128i above = _mm_xor_si128(_mm_cmpeq_epi8(_mm_subs_epu8(diff, limit), zero), _mm_set1_epi8(-1));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(mask + i), above);
+        set += static_cast<size_t>(__builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(above))));
+    }
+#elif defined(OBSBOT_NEON)
+    const uint8x16_t limit = vdupq_n_u8(threshold);
+    for (; i + 16 <= count; i += 16)
+    {
+        uint8x16_t above = vcgtq_u8(vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)), limit);
+        vst1q_u8(mask + i, above);
+        uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(vshrq_n_u8(above, 7))));
+        set += static_cast<size_t>(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        int diff = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+        mask[i] = diff > threshold ? 255 : 0;
+        set += mask[i] != 0;
+    }
+    return set;
+}
+
+void fillSamples(uint8_t *dst, uint8_t value, size_t step, size_t count)
+{
+    if (count == 0)
+    { return; }
+    if (step == 1)
+    {
+        std::memset(dst, value, count);
+        return;
+    }
+
+    /// packed samples: 16 bytes at a time, the bytes between the samples are kept
+    size_t i = 0;
+#if defined(OBSBOT_SSE2) || defined(OBSBOT_NEON)
+    if (step == 2 || step == 4)
+    {
+        const size_t bytes = (count - 1) * step + 1;
+        size_t j = 0;
+#if defined(OBSBOT_SSE2)
+        const __m128i mask = step == 2 ? _mm_set1_epi16(0x00ff) : _mm_set1_epi32(0xff);
+        const __m128i fill = _mm_and_si128(mask, _mm_set1_epi8(static_cast<char>(value)));
+        for (; j + 16 <= bytes; j += 16)
+        {
+            __m128i kept = _mm_andnot_si128(mask, _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + j)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + j), _mm_or_si128(kept, fill));
+        }
+#elif defined(OBSBOT_NEON)
+        const uint8x16_t mask = step == 2 ? vreinterpretq_u8_u16(vdupq_n_u16(0x00ff))
+                                          : vreinterpretq_u8_u32(vdupq_n_u32(0xff));
+        const uint8x16_t fill = vdupq_n_u8(value);
+        for (; j + 16 <= bytes; j += 16)
+        { vst1q_u8(dst + j, vbslq_u8(mask, fill, vld1q_u8(dst + j))); }
+#endif
+        i = j / step;
+    }
+#endif
+    for (; i < count; ++i)
+    { dst[i * step] = value; }
+}
+
+uint32_t sumSamples(const uint8_t *src, size_t step, size_t count)
+{
+    if (count == 0)
+    { return 0; }
+
+    uint32_t sum = 0;
+    size_t i = 0;
+#if defined(OBSBOT_SSE2) || defined(OBSBOT_NEON)
+    if (step == 1 || step == 2 || step == 4)
+    {
+        const size_t bytes = (count - 1) * step + 1;
+        size_t j = 0;
+#if defined(OBSBOT_SSE2)
+        const __m128i mask = step == 1 ? _mm_set1_epi8(-1) : step == 2 ? _mm_set1_epi16(0x00ff) : _mm_set1_epi32(0xff);
+        const __m128i zero = _mm_setzero_si128();
+        __m128i total = _mm_setzero_si128();
+        for (; j + 16 <= bytes; j += 16)
+        {
+            __m128i samples = _mm_and_si128(mask, _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + j)));
+            total = _mm_add_epi64(total, _mm_sad_epu8(samples, zero));
+        }
+        sum = static_cast<uint32_t>(_mm_cvtsi128_si32(total) + _mm_cvtsi128_si32(_mm_srli_si128(total, 8)));
+#elif defined(OBSBOT_NEON)
+        const uint8x16_t mask = step == 1 ? vdupq_n_u8(0xff)
+                                : step == 2 ? vreinterpretq_u8_u16(vdupq_n_u16(0x00ff))
+                                            : vreinterpretq_u8_u32(vdupq_n_u32(0xff));
+        uint32x4_t total = vdupq_n_u32(0);
+        for (; j + 16 <= bytes; j += 16)
+        { total = vpadalq_u16(total, vpaddlq_u8(vandq_u8(mask, vld1q_u8(src + j)))); }
+        sum = vgetq_lane_u32(total, 0) + vgetq_lane_u32(total, 1) + vgetq_lane_u32(total, 2) +
+              vgetq_lane_u32(total, 3);
+#endif
+        i = j / step;
+    }
+#endif
+    for (; i < count; ++i)
+    { sum += src[i * step]; }
+    return sum;
+}
+
+void warpRow(uint8_t *dst, const PlaneView &src, int32_t x, int32_t y, int32_t dx, int32_t dy, size_t count)
+{
+    const int32_t max_x = (src.width - 1) << 16;
+    const int32_t max_y = (src.height - 1) << 16;
+    const size_t step = static_cast<size_t>(src.step);
+    const size_t stride = static_cast<size_t>(src.stride);
+
+    /// corners and weights of up to 8 pixels, the weight is of the right or lower sample, 0..256
+    uint8_t p00[8], p01[8], p10[8], p11[8];
+    uint16_t wx[8], wy[8];
+    /// a run that stays clear of the last column and row needs neither the clamp nor the edge checks
+    const int64_t last_x = x + static_cast<int64_t>(dx) * static_cast<int64_t>(count ? count - 1 : 0);
+    const int64_t last_y = y + static_cast<int64_t>(dy) * static_cast<int64_t>(count ? count - 1 : 0);
+    const bool inside = std::min<int64_t>(x, last_x) >= 0 && std::max<int64_t>(x, last_x) < max_x &&
+                        std::min<int64_t>(y, last_y) >= 0 && std::max<int64_t>(y, last_y) < max_y;
+    auto gather = [&](size_t lane)
+    {
+        int32_t cx = inside ? x : std::min(max_x, std::max(0, x));
+        int32_t cy = inside ? y : std::min(max_y, std::max(0, y));
+        int32_t ix = cx >> 16;
+        int32_t iy = cy >> 16;
+        const uint8_t *top = src.data + static_cast<size_t>(iy) * stride + static_cast<size_t>(ix) * step;
+        /// on the last column or row the second sample is the first one again, its weight is zero there anyway
+        const uint8_t *bottom = inside || iy < src.height - 1 ? top + stride : top;
+        size_t right = inside || ix < src.width - 1 ? step : 0;
+        p00[lane] = top[0];
+        p01[lane] = top[right];
+        p10[lane] = bottom[0];
+        p11[lane] = bottom[right];
+        wx[lane] = static_cast<uint16_t>((cx >> 8) & 0xff);
+        wy[lane] = static_cast<uint16_t>((cy >> 8) & 0xff);
+        x += dx;
+        y += dy;
+    };
+
+    size_t i = 0;
+#if defined(OBSBOT_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(256);
+    const __m128i round = _mm_set1_epi16(128);
+    for (; i + 8 <= count; i += 8)
+    {
+        for (size_t lane = 0; lane < 8; ++lane)
+        { gather(lane); }
+        __m128i fx = _mm_loadu_si128(reinterpret_cast<const __m128i *>(wx));
+        __m128i fy = _mm_loadu_si128(reinterpret_cast<const __m128i *>(wy));
+        __m128i gx = _mm_sub_epi16(full, fx);
+        auto row = [&](const uint8_t *left, const uint8_t *right_samples)
+        {
+            __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(left)), zero);
+            __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(right_samples)), zero);
+            return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(a, gx), _mm_mullo_epi16(b, fx)),
+                                                round), 8);
+        };
+        __m128i top = row(p00, p01);
+        __m128i bottom = row(p10, p11);
+        __m128i out = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(top, _mm_sub_epi16(full, fy)),
+                                                                 _mm_mullo_epi16(bottom, fy)), round), 8);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(out, out));
+    }
+#elif defined(OBSBOT_NEON)
+    const uint16x8_t full = vdupq_n_u16(256);
+    for (; i + 8 <= count; i += 8)
+    {
+        for (size_t lane = 0; lane < 8; ++lane)
+        { gather(lane); }
+        uint16x8_t fx = vld1q_u16(wx);
+        uint16x8_t fy = vld1q_u16(wy);
+        uint16x8_t gx = vsubq_u16(full, fx);
+        uint16x8_t top = vrshrq_n_u16(vmlaq_u16(vmulq_u16(vmovl_u8(vld1_u8(p00)), gx), vmovl_u8(vld1_u8(p01)), fx), 8);
+        uint16x8_t bottom = vrshrq_n_u16(vmlaq_u16(vmulq_u16(vmovl_u8(vld1_u8(p10)), gx), vmovl_u8(vld1_u8(p11)), fx),
+                                         8);
+        uint16x8_t out = vmlaq_u16(vmulq_u16(top, vsubq_u16(full, fy)), bottom, fy);
+        vst1_u8(dst + i, vrshrn_n_u16(out, 8));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        gather(0);
+        uint32_t top = (p00[0] * (256u - wx[0]) + p01[0] * wx[0] + 128) >> 8;
+        uint32_t bottom = (p10[0] * (256u - wx[0]) + p11[0] * wx[0] + 128) >> 8;
+        dst[i] = static_cast<uint8_t>((top * (256u - wy[0]) + bottom * wy[0] + 128) >> 8);
+    }
+}
+
+void affineWarp(const PlaneView &src, uint8_t *dst, int32_t dst_stride, int32_t width, int32_t height,
+                const int32_t m[6])
+{
+    /// whole samples along x and whole rows down: a crop, the samples are copied as they are
+    if (m[0] == 1 << 16 && m[3] == 0 && m[1] == 0 && (m[4] & 0xffff) == 0 && (m[2] & 0xffff) == 0 &&
+        (m[5] & 0xffff) == 0 && m[2] >= 0 && m[5] >= 0 && (m[2] >> 16) + width <= src.width &&
+        (m[5] >> 16) + static_cast<int64_t>(m[4] >> 16) * (height - 1) < src.height)
+    {
+        const size_t step = static_cast<size_t>(src.step);
+        for (int32_t row = 0; row < height; ++row)
+        {
+            const uint8_t *in = src.data + static_cast<size_t>((m[5] >> 16) + (m[4] >> 16) * row) *
+                                static_cast<size_t>(src.stride) + static_cast<size_t>(m[2] >> 16) * step;
+            uint8_t *out = dst + static_cast<size_t>(row) * static_cast<size_t>(dst_stride);
+            if (step == 1)
+            {
+                std::memcpy(out, in, static_cast<size_t>(width));
+                continue;
+            }
+            for (int32_t i = 0; i < width; ++i)
+            { out[i] = in[static_cast<size_t>(i) * step]; }
+        }
+        return;
+    }
+
+    for (int32_t row = 0; row < height; ++row)
+    {
+        auto x = static_cast<int32_t>(static_cast<int64_t>(m[1]) * row + m[2]);
+        auto y = static_cast<int32_t>(static_cast<int64_t>(m[4]) * row + m[5]);
+        warpRow(dst + static_cast<size_t>(row) * static_cast<size_t>(dst_stride), src, x, y, m[0], m[3],
+                static_cast<size_t>(width));
+    }
+}
+
+bool yuvPlanes(const Frame &frame, PlaneView &y, PlaneView &u, PlaneView &v)
+{
+    const int32_t w = frame.width;
+    const int32_t h = frame.height;
+    u = PlaneView();
+    v = PlaneView();
+    switch (frame.format)
+    {
+    case RmVideoFormat::I420:
+    case RmVideoFormat::YV12:
+    {
+        int32_t stride = frame.stride > 0 ? frame.stride : w;
+        y = {frame.data, w, h, stride, 1};
+        const uint8_t *first = frame.data + static_cast<size_t>(stride) * h;
+        const uint8_t *second = first + static_cast<size_t>(stride / 2) * (h / 2);
+        u = {frame.format == RmVideoFormat::I420 ? first : second, w / 2, h / 2, stride / 2, 1};
+        v = {frame.format == RmVideoFormat::I420 ? second : first, w / 2, h / 2, stride / 2, 1};
+        return true;
+    }
+    case RmVideoFormat::NV12:
+    {
+        int32_t stride = frame.stride > 0 ? frame.stride : w;
+        y = {frame.data, w, h, stride, 1};
+        const uint8_t *uv = frame.data + static_cast<size_t>(stride) * h;
+        u = {uv, w / 2, h / 2, stride, 2};
+        v = {uv + 1, w / 2, h / 2, stride, 2};
+        return true;
+    }
+    case RmVideoFormat::YUY2:
+    case RmVideoFormat::YVYU:
+    case RmVideoFormat::UYVY:
+    case RmVideoFormat::HDYC:
+    {
+        int32_t stride = frame.stride > 0 ? frame.stride : w * 2;
+        /// byte order of one macro pixel: yuy2 Y0 U Y1 V, yvyu Y0 V Y1 U, uyvy and hdyc U Y0 V Y1
+        bool luma_first = frame.format == RmVideoFormat::YUY2 || frame.format == RmVideoFormat::YVYU;
+        y = {frame.data + (luma_first ? 0 : 1), w, h, stride, 2};
+        int32_t u_offset = frame.format == RmVideoFormat::YUY2 ? 1 : (frame.format == RmVideoFormat::YVYU ? 3 : 0);
+        int32_t v_offset = frame.format == RmVideoFormat::YUY2 ? 3 : (frame.format == RmVideoFormat::YVYU ? 1 : 2);
+        u = {frame.data + u_offset, w / 2, h, stride, 4};
+        v = {frame.data + v_offset, w / 2, h, stride, 4};
+        return true;
+    }
+    case RmVideoFormat::Y800:
+    {
+        y = {frame.data, w, h, frame.stride > 0 ? frame.stride : w, 1};
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+void PlaneScaler::prepare(const PlaneView &src, int32_t dst_width, int32_t dst_height)
+{
+    if (src.width == src_width_ && src.height == src_height_ && src.step == src_step_ && dst_width == dst_width_ &&
+        dst_height == dst_height_)
+    { return; }
+
+    src_width_ = src.width;
+    src_height_ = src.height;
+    src_step_ = src.step;
+    dst_width_ = dst_width;
+    dst_height_ = dst_height;
+
+    /// sample centers are aligned, positions are 16.16 fixed point, the last source sample is reached with weight 256
+    auto build = [](int32_t src_size, int32_t dst_size, int32_t step, std::vector<int32_t> &index,
+                    std::vector<uint16_t> &weight)
+    {
+        index.resize(static_cast<size_t>(dst_size));
+        weight.resize(static_cast<size_t>(dst_size));
+        int64_t ratio = (static_cast<int64_t>(src_size) << 16) / dst_size;
+        int64_t last = static_cast<int64_t>(src_size - 1) << 16;
+        for (int32_t i = 0; i < dst_size; ++i)
+        {
+            int64_t pos = std::min(last, std::max<int64_t>(0, i * ratio + ratio / 2 - 32768));
+            auto left = static_cast<int32_t>(pos >> 16);
+            auto frac = static_cast<uint16_t>((pos & 0xFFFF) >> 8);
+            if (left >= src_size - 1)
+            {
+                left = src_size - 2;
+                frac = 256;
+            }
+            index[static_cast<size_t>(i)] = left * step;
+            weight[static_cast<size_t>(i)] = frac;
+        }
+    };
+    build(src.width, dst_width, src.step, x_offset_, x_weight_);
+    build(src.height, dst_height, 1, y_index_, y_weight_);
+    rows_.resize(static_cast<size_t>(dst_width) * 3);
+}
+
+void PlaneScaler::horizontal(const PlaneView &src, int32_t row, uint8_t *out)
+{
+    const uint8_t *line = src.data + static_cast<size_t>(row) * static_cast<size_t>(src.stride);
+    const int32_t step = src.step;
+    for (int32_t x = 0; x < dst_width_; ++x)
+    {
+        const uint8_t *p = line + x_offset_[static_cast<size_t>(x)];
+        uint32_t w = x_weight_[static_cast<size_t>(x)];
+        out[x] = static_cast<uint8_t>((p[0] * (256 - w) + p[step] * w + 128) >> 8);
+    }
+}
+
+void PlaneScaler::scale(const PlaneView &src, uint8_t *dst, int32_t dst_stride, int32_t dst_width,
+                        int32_t dst_height, uint32_t alpha)
+{
+    if (!src.data || src.width < 2 || src.height < 2 || dst_width <= 0 || dst_height <= 0)
+    { return; }
+    prepare(src, dst_width, dst_height);
+
+    auto width = static_cast<size_t>(dst_width);
+    uint8_t *top = rows_.data();
+    uint8_t *bottom = top + width;
+    uint8_t *blend = bottom + width;
+    int32_t top_row = -1;
+    int32_t bottom_row = -1;
+
+    for (int32_t dy = 0; dy < dst_height; ++dy)
+    {
+        int32_t row = y_index_[static_cast<size_t>(dy)];
+        uint32_t wy = y_weight_[static_cast<size_t>(dy)];
+
+        /// upscaling walks the same source rows repeatedly, keep the two scaled rows around
+        if (top_row != row)
+        {
+            if (bottom_row == row)
+            {
+                std::swap(top, bottom);
+                top_row = bottom_row;
+                bottom_row = -1;
+            }
+            else
+            {
+                horizontal(src, row, top);
+                top_row = row;
+            }
+        }
+        if (wy > 0 && bottom_row != row + 1)
+        {
+            horizontal(src, row + 1, bottom);
+            bottom_row = row + 1;
+        }
+
+        uint8_t *out = dst + static_cast<size_t>(dy) * static_cast<size_t>(dst_stride);
+        if (alpha >= 256)
+        {
+            blendRow(out, top, bottom, wy, width);
+        }
+        else
+        {
+            blendRow(blend, top, bottom, wy, width);
+            blendRow(out, out, blend, alpha, width);
+        }
+    }
+}
+
+}  // namespace image_ops
+
+}  // namespace obsbot_ros
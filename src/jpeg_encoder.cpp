@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#ifdef OBSBOT_HAVE_JPEG
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+#endif
+
+#include <obsbot_ros/image_ops.hpp>
+#include <obsbot_ros/jpeg_encoder.hpp>
+
+namespace obsbot_ros
+{
+
+#ifdef OBSBOT_HAVE_JPEG
+namespace
+{
+/// libjpeg exits the process on errors by default, the encoder jumps back into compress() instead
+struct ErrorManager
+{
+    jpeg_error_mgr base;
+    std::jmp_buf jump;
+};
+
+void errorExit(j_common_ptr cinfo)
+{
+    std::longjmp(reinterpret_cast<ErrorManager *>(cinfo->err)->jump, 1);
+}
+
+void outputMessage(j_common_ptr)
+{}
+
+/// the jpeg is written straight into the caller's vector, which doubles whenever it is full
+struct Destination
+{
+    jpeg_destination_mgr base;
+    std::vector<uint8_t> *out;
+};
+
+void initDestination(j_compress_ptr cinfo)
+{
+    auto *dest = reinterpret_cast<Destination *>(cinfo->dest);
+    dest->base.next_output_byte = dest->out->data();
+    dest->base.free_in_buffer = dest->out->size();
+}
+
+boolean emptyOutputBuffer(j_compress_ptr cinfo)
+{
+    auto *dest = reinterpret_cast<Destination *>(cinfo->dest);
+    size_t used = dest->out->size();
+    dest->out->resize(used * 2);
+    dest->base.next_output_byte = dest->out->data() + used;
+    dest->base.free_in_buffer = used;
+    return TRUE;
+}
+
+void termDestination(j_compress_ptr cinfo)
+{
+    auto *dest = reinterpret_cast<Destination *>(cinfo->dest);
+    dest->out->resize(dest->out->size() - dest->base.free_in_buffer);
+}
+}
+
+struct JpegEncoder::Codec
+{
+    jpeg_compress_struct cinfo;
+    ErrorManager error;
+    Destination dest;
+    std::vector<JSAMPROW> rows[3];              /// row pointers of one row block per component
+
+    Codec()
+    {
+        cinfo.err = jpeg_std_error(&error.base);
+        error.base.error_exit = errorExit;
+        error.base.output_message = outputMessage;
+        jpeg_create_compress(&cinfo);
+        dest.base.init_destination = initDestination;
+        dest.base.empty_output_buffer = emptyOutputBuffer;
+        dest.base.term_destination = termDestination;
+        dest.out = nullptr;
+        cinfo.dest = &dest.base;
+    }
+
+    ~Codec()
+    { jpeg_destroy_compress(&cinfo); }
+};
+
+bool JpegEncoder::supported()
+{
+    return true;
+}
+#else
+struct JpegEncoder::Codec
+{};
+
+bool JpegEncoder::supported()
+{
+    return false;
+}
+#endif
+
+JpegEncoder::JpegEncoder() : codec_(std::make_unique<Codec>())
+{}
+
+JpegEncoder::~JpegEncoder() = default;
+
+bool JpegEncoder::encode(const Frame &frame, int32_t quality, std::vector<uint8_t> &out)
+{
+    out.clear();
+    if (frame.format == RmVideoFormat::MJPEG)
+    {
+        out.assign(frame.data, frame.data + frame.size);
+        ++stats_.passthrough;
+        return true;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (!compress(frame, std::min(100, std::max(1, quality)), out))
+    {
+        out.clear();
+        ++stats_.unsupported;
+        return false;
+    }
+    ++stats_.frames;
+    double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    stats_.process_us = stats_.frames == 1 ? elapsed_us : stats_.process_us + (elapsed_us - stats_.process_us) / 16.0;
+    stats_.max_process_us = std::max(stats_.max_process_us, elapsed_us);
+    return true;
+}
+
+#ifdef OBSBOT_HAVE_JPEG
+/// nothing with a destructor may live in this frame past setjmp, an error longjmps back to it
+bool JpegEncoder::compress(const Frame &frame, int32_t quality, std::vector<uint8_t> &out)
+{
+    image_ops::PlaneView planes[3];
+    if (!image_ops::yuvPlanes(frame, planes[0], planes[1], planes[2]))
+    { return false; }
+    const int components = planes[1].data && planes[2].data ? 3 : 1;
+
+    jpeg_compress_struct &cinfo = codec_->cinfo;
+    /// a quarter byte per pixel holds most pictures at usual qualities, the destination grows if not
+    out.resize(std::max<size_t>(65536, static_cast<size_t>(frame.width) * static_cast<size_t>(frame.height) / 4));
+    codec_->dest.out = &out;
+    if (setjmp(codec_->error.jump))
+    {
+        jpeg_abort_compress(&cinfo);
+        return false;
+    }
+
+    cinfo.image_width = static_cast<JDIMENSION>(frame.width);
+    cinfo.image_height = static_cast<JDIMENSION>(frame.height);
+    cinfo.input_components = components;
+    cinfo.in_color_space = components == 3 ? JCS_YCbCr : JCS_GRAYSCALE;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    cinfo.raw_data_in = TRUE;
+    /// luma against chroma: 2x2 for 4:2:0, 2x1 for the packed 4:2:2 formats
+    cinfo.comp_info[0].h_samp_factor = components == 3 ? std::max(1, planes[0].width / planes[1].width) : 1;
+    cinfo.comp_info[0].v_samp_factor = components == 3 ? std::max(1, planes[0].height / planes[1].height) : 1;
+    for (int c = 1; c < components; ++c)
+    {
+        cinfo.comp_info[c].h_samp_factor = 1;
+        cinfo.comp_info[c].v_samp_factor = 1;
+    }
+    jpeg_start_compress(&cinfo, TRUE);
+
+    /// every component is read in whole blocks; planes that are packed or narrower than that go through rows_
+    size_t scratch = 0;
+    bool gather[3] = {false, false, false};
+    for (int c = 0; c < components; ++c)
+    {
+        const jpeg_component_info &comp = cinfo.comp_info[c];
+        const size_t padded = static_cast<size_t>(comp.width_in_blocks) * DCTSIZE;
+        codec_->rows[c].resize(static_cast<size_t>(comp.v_samp_factor) * DCTSIZE);
+        gather[c] = planes[c].step != 1 || padded > static_cast<size_t>(planes[c].width);
+        if (gather[c])
+        { scratch += codec_->rows[c].size() * padded; }
+    }
+    rows_.resize(std::max(rows_.size(), scratch));
+
+    JSAMPARRAY blocks[3] = {codec_->rows[0].data(), codec_->rows[1].data(), codec_->rows[2].data()};
+    const int32_t block_rows = cinfo.max_v_samp_factor * DCTSIZE;
+    while (cinfo.next_scanline < cinfo.image_height)
+    {
+        uint8_t *next = rows_.data();
+        for (int c = 0; c < components; ++c)
+        {
+            const jpeg_component_info &comp = cinfo.comp_info[c];
+            const image_ops::PlaneView &plane = planes[c];
+            const size_t padded = static_cast<size_t>(comp.width_in_blocks) * DCTSIZE;
+            const int32_t first = static_cast<int32_t>(cinfo.next_scanline) * comp.v_samp_factor /
+                                  cinfo.max_v_samp_factor;
+            for (size_t i = 0; i < codec_->rows[c].size(); ++i)
+            {
+                /// rows past the bottom repeat the last one
+                int32_t row = std::min(plane.height - 1, first + static_cast<int32_t>(i));
+                const uint8_t *src = plane.data + static_cast<size_t>(row) * static_cast<size_t>(plane.stride);
+                if (!gather[c])
+                {
+                    codec_->rows[c][i] = const_cast<JSAMPROW>(src);
+                    continue;
+                }
+                const size_t step = static_cast<size_t>(plane.step);
+                const size_t width = std::min(padded, static_cast<size_t>(plane.width));
+                if (step == 1)
+                { std::memcpy(next, src, width); }
+                else
+                {
+                    for (size_t x = 0; x < width; ++x)
+                    { next[x] = src[x * step]; }
+                }
+                std::memset(next + width, next[width - 1], padded - width);
+                codec_->rows[c][i] = next;
+                next += padded;
+            }
+        }
+        jpeg_write_raw_data(&cinfo, blocks, static_cast<JDIMENSION>(block_rows));
+    }
+    jpeg_finish_compress(&cinfo);
+    return true;
+}
+#else
+bool JpegEncoder::compress(const Frame &, int32_t, std::vector<uint8_t> &)
+{
+    return false;
+}
+#endif
+
+}  // namespace obsbot_ros
@@ -0,0 +1,731 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+
+#ifdef OBSBOT_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef OBSBOT_HAVE_LZ4
+#include <lz4frame.h>
+#endif
+
+#include <obsbot_ros/mcap_recorder.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+constexpr uint8_t kMagic[] = {0x89, 'M', 'C', 'A', 'P', 0x30, '\r', '\n'};
+
+enum Opcode : uint8_t
+{
+    OpHeader = 0x01,
+    OpFooter = 0x02,
+    OpSchema = 0x03,
+    OpChannel = 0x04,
+    OpMessage = 0x05,
+    OpChunk = 0x06,
+    OpMessageIndex = 0x07,
+    OpChunkIndex = 0x08,
+    OpStatistics = 0x0B,
+    OpDataEnd = 0x0F,
+};
+
+enum SchemaId : uint16_t
+{
+    SchemaImage = 1,
+    SchemaCompressedImage = 2,
+    SchemaDiagnostics = 3,
+};
+
+constexpr uint16_t kSchemaCount = 3;
+
+const char *const kSeparator = "================================================================================\n";
+
+const char *const kHeaderDefinition =
+    "MSG: std_msgs/Header\n"
+    "builtin_interfaces/Time stamp\n"
+    "string frame_id\n";
+
+const char *const kTimeDefinition =
+    "MSG: builtin_interfaces/Time\n"
+    "int32 sec\n"
+    "uint32 nanosec\n";
+
+std::string definition(const char *body, std::initializer_list<const char *> dependencies)
+{
+    std::string text = body;
+    for (const char *dependency : dependencies)
+    {
+        text += kSeparator;
+        text += dependency;
+    }
+    return text;
+}
+
+/// mcap records are little endian, like the cdr written here, so values are copied as they are in memory
+template<typename T>
+void put(std::vector<uint8_t> &out, T value)
+{
+    static_assert(std::is_arithmetic<T>::value, "plain values only");
+    const auto *bytes = reinterpret_cast<const uint8_t *>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void putString(std::vector<uint8_t> &out, const std::string &value)
+{
+    put<uint32_t>(out, static_cast<uint32_t>(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+/// opcode and a length placeholder, endRecord() patches the length
+size_t beginRecord(std::vector<uint8_t> &out, Opcode opcode)
+{
+    out.push_back(opcode);
+    put<uint64_t>(out, 0);
+    return out.size();
+}
+
+void endRecord(std::vector<uint8_t> &out, size_t body)
+{
+    uint64_t length = out.size() - body;
+    std::memcpy(out.data() + body - sizeof(length), &length, sizeof(length));
+}
+
+/// cdr little endian, alignment counts from the end of the encapsulation header
+class CdrWriter
+{
+public:
+    explicit CdrWriter(std::vector<uint8_t> &out) : out_(out)
+    {
+        const uint8_t encapsulation[] = {0x00, 0x01, 0x00, 0x00};
+        out_.insert(out_.end(), encapsulation, encapsulation + sizeof(encapsulation));
+        origin_ = out_.size();
+    }
+
+    template<typename T>
+    void value(T v)
+    {
+        align(sizeof(T));
+        put(out_, v);
+    }
+
+    void string(const char *text)
+    {
+        auto length = std::strlen(text);
+        value<uint32_t>(static_cast<uint32_t>(length + 1));
+        out_.insert(out_.end(), text, text + length + 1);
+    }
+
+    void bytes(const uint8_t *data, size_t size)
+    {
+        value<uint32_t>(static_cast<uint32_t>(size));
+        out_.insert(out_.end(), data, data + size);
+    }
+
+    void header(int64_t stamp_ns, const std::string &frame_id)
+    {
+        value<int32_t>(static_cast<int32_t>(stamp_ns / 1000000000));
+        value<uint32_t>(static_cast<uint32_t>(stamp_ns % 1000000000));
+        string(frame_id.c_str());
+    }
+
+private:
+    void align(size_t size)
+    {
+        while ((out_.size() - origin_) % size)
+        { out_.push_back(0); }
+    }
+
+    std::vector<uint8_t> &out_;
+    size_t origin_ = 0;
+};
+
+const char *compressionName(McapRecorder::Compression compression)
+{
+    switch (compression)
+    {
+    case McapRecorder::Compression::Lz4:
+        return "lz4";
+    case McapRecorder::Compression::Zstd:
+        return "zstd";
+    default:
+        return "";
+    }
+}
+
+/// crc-32 (ieee) as mcap checks it, slicing by 8; the eight bytes are read little endian like everything else here
+uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size)
+{
+    struct Tables
+    {
+        Tables()
+        {
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; ++bit)
+                { value = (value >> 1) ^ (value & 1 ? 0xEDB88320u : 0); }
+                table[0][i] = value;
+            }
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                for (size_t k = 1; k < 8; ++k)
+                { table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff]; }
+            }
+        }
+
+        uint32_t table[8][256];
+    };
+    static const Tables tables;
+    const auto &t = tables.table;
+
+    crc = ~crc;
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        uint32_t lo;
+        uint32_t hi;
+        std::memcpy(&lo, data, sizeof(lo));
+        std::memcpy(&hi, data + 4, sizeof(hi));
+        lo ^= crc;
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+    for (; size > 0; ++data, --size)
+    { crc = t[0][(crc ^ *data) & 0xff] ^ (crc >> 8); }
+    return ~crc;
+}
+
+int64_t steadyNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
+
+class McapRecorder::Input : public FrameSink
+{
+public:
+    Input(McapRecorder *owner, size_t stream) : owner_(owner), stream_(stream)
+    {}
+
+    void onFrame(const FrameRef &frame) override
+    { owner_->push(stream_, frame); }
+
+    void onRelease() override
+    { owner_->release(stream_); }
+
+    bool wantsFrames() const override
+    { return owner_->recording(); }
+
+private:
+    McapRecorder *owner_;
+    size_t stream_;
+};
+
+bool McapRecorder::supported(Compression compression)
+{
+    switch (compression)
+    {
+    case Compression::None:
+        return true;
+    case Compression::Lz4:
+#ifdef OBSBOT_HAVE_LZ4
+        return true;
+#else
+        return false;
+#endif
+    case Compression::Zstd:
+#ifdef OBSBOT_HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+McapRecorder::McapRecorder(const Options &options, const std::vector<Stream> &streams) :
+    options_(options),
+    streams_(streams)
+{
+    options_.queue_depth = std::max<size_t>(1, options_.queue_depth);
+    options_.diagnostics_depth = std::max<size_t>(1, options_.diagnostics_depth);
+    options_.chunk_size = std::max<size_t>(64 << 10, options_.chunk_size);
+    if (!supported(options_.compression))
+    { options_.compression = Compression::None; }
+
+    for (size_t i = 0; i < streams_.size(); ++i)
+    {
+        inputs_.push_back(std::make_shared<Input>(this, i));
+    }
+    queue_.resize(std::max<size_t>(1, streams_.size()) * options_.queue_depth);
+    stream_counts_.assign(streams_.size(), 0);
+
+    /// image and compressed image per stream, then the diagnostics
+    size_t channels = 2 * streams_.size() + 1;
+    message_index_.resize(channels + 1);
+    channel_sequence_.assign(channels + 1, 0);
+    channel_messages_.assign(channels + 1, 0);
+}
+
+McapRecorder::~McapRecorder()
+{
+    close();
+}
+
+bool McapRecorder::open()
+{
+    file_ = std::fopen(options_.path.c_str(), "wb");
+    if (!file_)
+    {
+        error_ = "can not create " + options_.path + ": " + std::strerror(errno);
+        return false;
+    }
+    /// large sequential writes, the stdio buffer only has to cover the small records between chunks
+    std::setvbuf(file_, nullptr, _IOFBF, 1 << 20);
+    chunk_.reserve(options_.chunk_size + (options_.chunk_size >> 2));
+
+    record_.assign(kMagic, kMagic + sizeof(kMagic));
+    auto body = beginRecord(record_, OpHeader);
+    putString(record_, "ros2");
+    putString(record_, "obsbot_ros");
+    endRecord(record_, body);
+    writeOut(record_);
+
+    record_.clear();
+    const std::pair<uint16_t, std::pair<const char *, std::string>> schemas[] = {
+        {SchemaImage, {"sensor_msgs/msg/Image", definition(
+            "std_msgs/Header header\nuint32 height\nuint32 width\nstring encoding\nuint8 is_bigendian\n"
+            "uint32 step\nuint8[] data\n", {kHeaderDefinition, kTimeDefinition})}},
+        {SchemaCompressedImage, {"sensor_msgs/msg/CompressedImage", definition(
+            "std_msgs/Header header\nstring format\nuint8[] data\n", {kHeaderDefinition, kTimeDefinition})}},
+        {SchemaDiagnostics, {"diagnostic_msgs/msg/DiagnosticArray", definition(
+            "std_msgs/Header header\ndiagnostic_msgs/DiagnosticStatus[] status\n",
+            {kHeaderDefinition, kTimeDefinition,
+             "MSG: diagnostic_msgs/DiagnosticStatus\nbyte OK=0\nbyte WARN=1\nbyte ERROR=2\nbyte STALE=3\n"
+             "byte level\nstring name\nstring message\nstring hardware_id\ndiagnostic_msgs/KeyValue[] values\n",
+             "MSG: diagnostic_msgs/KeyValue\nstring key\nstring value\n"})}},
+    };
+    for (const auto &schema : schemas)
+    {
+        body = beginRecord(record_, OpSchema);
+        put<uint16_t>(record_, schema.first);
+        putString(record_, schema.second.first);
+        putString(record_, "ros2msg");
+        putString(record_, schema.second.second);
+        endRecord(record_, body);
+    }
+
+    auto channel = [this](uint16_t id, uint16_t schema, const std::string &topic)
+    {
+        auto start = beginRecord(record_, OpChannel);
+        put<uint16_t>(record_, id);
+        put<uint16_t>(record_, schema);
+        putString(record_, topic);
+        putString(record_, "cdr");
+        put<uint32_t>(record_, 0);
+        endRecord(record_, start);
+    };
+    for (size_t i = 0; i < streams_.size(); ++i)
+    {
+        channel(static_cast<uint16_t>(2 * i + 1), SchemaImage, streams_[i].topic + "/image_raw");
+        channel(static_cast<uint16_t>(2 * i + 2), SchemaCompressedImage, streams_[i].topic + "/image_raw/compressed");
+    }
+    channel(static_cast<uint16_t>(2 * streams_.size() + 1), SchemaDiagnostics, "/diagnostics");
+    /// the summary repeats schemas and channels, keep them
+    schema_records_ = record_;
+    writeOut(record_);
+
+    rate_start_ns_ = steadyNs();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = true;
+        stop_ = false;
+    }
+    thread_ = std::thread(&McapRecorder::run, this);
+    return true;
+}
+
+void McapRecorder::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+        { return; }
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+
+    flushChunk();
+    writeSummary();
+    std::fclose(file_);
+    file_ = nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+    stats_.messages = message_count_;
+    stats_.bytes_written = offset_;
+    stats_.write_errors = write_errors_;
+}
+
+void McapRecorder::writeDiagnostics(int64_t stamp_ns, const uint8_t *cdr, size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_ || stop_)
+    { return; }
+    if (diagnostics_.size() >= options_.diagnostics_depth)
+    {
+        diagnostics_.pop_front();
+        ++stats_.dropped_diagnostics;
+    }
+    diagnostics_.emplace_back(stamp_ns, std::vector<uint8_t>(cdr, cdr + size));
+    cv_.notify_one();
+}
+
+McapRecorder::Stats McapRecorder::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.queued = queue_count_;
+    return stats;
+}
+
+void McapRecorder::push(size_t stream, const FrameRef &frame)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_ || stop_)
+    { return; }
+    if (stream_counts_[stream] >= options_.queue_depth)
+    {
+        ++stats_.dropped;
+        return;
+    }
+    auto &item = queue_[(queue_head_ + queue_count_) % queue_.size()];
+    item.stream = stream;
+    item.frame = frame;
+    ++queue_count_;
+    ++stream_counts_[stream];
+    cv_.notify_one();
+}
+
+bool McapRecorder::recording() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return running_ && !stop_;
+}
+
+/// drop the queued frames of the stream and wait until the writer lets go of the one it may be encoding
+void McapRecorder::release(size_t stream)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    size_t kept = 0;
+    for (size_t i = 0; i < queue_count_; ++i)
+    {
+        auto &item = queue_[(queue_head_ + i) % queue_.size()];
+        if (item.stream == stream)
+        {
+            item.frame.reset();
+            continue;
+        }
+        if (kept != i)
+        { queue_[(queue_head_ + kept) % queue_.size()] = std::move(item); }
+        ++kept;
+    }
+    queue_count_ = kept;
+    stream_counts_[stream] = 0;
+    idle_cv_.wait(lock, [this, stream]()
+    { return busy_stream_ != stream; });
+}
+
+void McapRecorder::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        cv_.wait_for(lock, std::chrono::milliseconds(200), [this]()
+        { return stop_ || queue_count_ > 0 || !diagnostics_.empty(); });
+
+        if (!diagnostics_.empty())
+        {
+            auto entry = std::move(diagnostics_.front());
+            diagnostics_.pop_front();
+            lock.unlock();
+            auto start = beginMessage(static_cast<uint16_t>(2 * streams_.size() + 1), entry.first);
+            chunk_.insert(chunk_.end(), entry.second.begin(), entry.second.end());
+            endMessage(start);
+            lock.lock();
+        }
+        else if (queue_count_ > 0)
+        {
+            Item item = std::move(queue_[queue_head_]);
+            queue_head_ = (queue_head_ + 1) % queue_.size();
+            --queue_count_;
+            --stream_counts_[item.stream];
+            busy_stream_ = item.stream;
+            lock.unlock();
+            appendFrame(item.stream, *item.frame);
+            item.frame.reset();
+            lock.lock();
+            busy_stream_ = SIZE_MAX;
+            idle_cv_.notify_all();
+        }
+        else if (stop_)
+        {
+            break;
+        }
+
+        if (chunk_.size() >= options_.chunk_size)
+        {
+            lock.unlock();
+            flushChunk();
+            lock.lock();
+        }
+
+        /// sustained rate, measured on what reached the file
+        auto now = steadyNs();
+        if (now - rate_start_ns_ >= 1000000000)
+        {
+            stats_.write_mbps = static_cast<double>(rate_bytes_) * 1e3 / static_cast<double>(now - rate_start_ns_);
+            rate_bytes_ = 0;
+            rate_start_ns_ = now;
+        }
+        stats_.messages = message_count_;
+        stats_.bytes_written = offset_;
+        stats_.write_errors = write_errors_;
+        stats_.ratio = chunk_in_total_ ? static_cast<double>(chunk_out_total_) / static_cast<double>(chunk_in_total_)
+                                       : 1.0;
+    }
+}
+
+size_t McapRecorder::beginMessage(uint16_t channel, int64_t stamp_ns)
+{
+    auto time = static_cast<uint64_t>(std::max<int64_t>(0, stamp_ns));
+    size_t start = chunk_.size();
+    if (start == 0)
+    {
+        chunk_start_ns_ = time;
+        chunk_end_ns_ = time;
+    }
+    chunk_start_ns_ = std::min(chunk_start_ns_, time);
+    chunk_end_ns_ = std::max(chunk_end_ns_, time);
+    start_ns_ = std::min(start_ns_, time);
+    end_ns_ = std::max(end_ns_, time);
+    message_index_[channel].emplace_back(time, start);
+
+    beginRecord(chunk_, OpMessage);
+    put<uint16_t>(chunk_, channel);
+    put<uint32_t>(chunk_, channel_sequence_[channel]++);
+    put<uint64_t>(chunk_, time);
+    put<uint64_t>(chunk_, time);
+    ++channel_messages_[channel];
+    ++message_count_;
+    return start;
+}
+
+void McapRecorder::endMessage(size_t start)
+{
+    endRecord(chunk_, start + 9);
+}
+
+/// the pooled buffer goes into the chunk as the data field of the cdr message, no message object in between
+void McapRecorder::appendFrame(size_t stream, const Frame &frame)
+{
+    const auto &info = streams_[stream];
+    bool encoded = isEncoded(frame.format);
+    auto start = beginMessage(static_cast<uint16_t>(2 * stream + (encoded ? 2 : 1)), frame.stamp_ns);
+    CdrWriter cdr(chunk_);
+    cdr.header(frame.stamp_ns, info.frame_id);
+    if (encoded)
+    {
+        cdr.string(encodingName(frame.format));
+    }
+    else
+    {
+        cdr.value<uint32_t>(static_cast<uint32_t>(frame.height));
+        cdr.value<uint32_t>(static_cast<uint32_t>(frame.width));
+        cdr.string(encodingName(frame.format));
+        cdr.value<uint8_t>(0);
+        cdr.value<uint32_t>(static_cast<uint32_t>(frame.stride));
+    }
+    cdr.bytes(frame.data, frame.size);
+    endMessage(start);
+}
+
+void McapRecorder::flushChunk()
+{
+    if (chunk_.empty())
+    { return; }
+
+    const uint8_t *data = chunk_.data();
+    size_t size = chunk_.size();
+    switch (options_.compression)
+    {
+#ifdef OBSBOT_HAVE_ZSTD
+    case Compression::Zstd:
+    {
+        compressed_.resize(std::max(compressed_.size(), ZSTD_compressBound(chunk_.size())));
+        size_t written = ZSTD_compress(compressed_.data(), compressed_.size(), chunk_.data(), chunk_.size(), 1);
+        if (!ZSTD_isError(written))
+        {
+            data = compressed_.data();
+            size = written;
+        }
+        break;
+    }
+#endif
+#ifdef OBSBOT_HAVE_LZ4
+    case Compression::Lz4:
+    {
+        compressed_.resize(std::max(compressed_.size(), LZ4F_compressFrameBound(chunk_.size(), nullptr)));
+        size_t written = LZ4F_compressFrame(compressed_.data(), compressed_.size(), chunk_.data(), chunk_.size(),
+                                            nullptr);
+        if (!LZ4F_isError(written))
+        {
+            data = compressed_.data();
+            size = written;
+        }
+        break;
+    }
+#endif
+    default:
+        break;
+    }
+    const char *compression = data == chunk_.data() ? "" : compressionName(options_.compression);
+
+    ChunkIndex index;
+    index.start_ns = chunk_start_ns_;
+    index.end_ns = chunk_end_ns_;
+    index.offset = offset_;
+    index.compression = compression;
+    index.compressed_size = size;
+    index.uncompressed_size = chunk_.size();
+
+    record_.clear();
+    auto body = beginRecord(record_, OpChunk);
+    put<uint64_t>(record_, chunk_start_ns_);
+    put<uint64_t>(record_, chunk_end_ns_);
+    put<uint64_t>(record_, chunk_.size());
+    put<uint32_t>(record_, crc32(0, chunk_.data(), chunk_.size()));
+    putString(record_, compression);
+    put<uint64_t>(record_, size);
+    /// the records themselves go out without another copy
+    uint64_t length = record_.size() - body + size;
+    std::memcpy(record_.data() + body - sizeof(length), &length, sizeof(length));
+    writeOut(record_);
+    if (std::fwrite(data, 1, size, file_) != size)
+    { ++write_errors_; }
+    offset_ += size;
+    rate_bytes_ += size;
+    index.length = offset_ - index.offset;
+
+    record_.clear();
+    uint64_t index_start = offset_;
+    for (size_t channel = 0; channel < message_index_.size(); ++channel)
+    {
+        auto &entries = message_index_[channel];
+        if (entries.empty())
+        { continue; }
+        index.index_offsets.emplace_back(static_cast<uint16_t>(channel), index_start + record_.size());
+        body = beginRecord(record_, OpMessageIndex);
+        put<uint16_t>(record_, static_cast<uint16_t>(channel));
+        put<uint32_t>(record_, static_cast<uint32_t>(entries.size() * 16));
+        for (const auto &entry : entries)
+        {
+            put<uint64_t>(record_, entry.first);
+            put<uint64_t>(record_, entry.second);
+        }
+        endRecord(record_, body);
+        entries.clear();
+    }
+    index.index_length = record_.size();
+    writeOut(record_);
+
+    chunk_in_total_ += chunk_.size();
+    chunk_out_total_ += size;
+    chunk_indexes_.push_back(std::move(index));
+    chunk_.clear();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.chunks;
+    stats_.bytes_in = chunk_in_total_;
+}
+
+void McapRecorder::writeSummary()
+{
+    record_.clear();
+    auto body = beginRecord(record_, OpDataEnd);
+    put<uint32_t>(record_, 0);
+    endRecord(record_, body);
+    writeOut(record_);
+
+    uint64_t summary_start = offset_;
+    record_ = schema_records_;
+    for (const auto &index : chunk_indexes_)
+    {
+        body = beginRecord(record_, OpChunkIndex);
+        put<uint64_t>(record_, index.start_ns);
+        put<uint64_t>(record_, index.end_ns);
+        put<uint64_t>(record_, index.offset);
+        put<uint64_t>(record_, index.length);
+        put<uint32_t>(record_, static_cast<uint32_t>(index.index_offsets.size() * 10));
+        for (const auto &entry : index.index_offsets)
+        {
+            put<uint16_t>(record_, entry.first);
+            put<uint64_t>(record_, entry.second);
+        }
+        put<uint64_t>(record_, index.index_length);
+        putString(record_, index.compression);
+        put<uint64_t>(record_, index.compressed_size);
+        put<uint64_t>(record_, index.uncompressed_size);
+        endRecord(record_, body);
+    }
+
+    body = beginRecord(record_, OpStatistics);
+    put<uint64_t>(record_, message_count_);
+    put<uint16_t>(record_, kSchemaCount);
+    put<uint32_t>(record_, static_cast<uint32_t>(2 * streams_.size() + 1));
+    put<uint32_t>(record_, 0);
+    put<uint32_t>(record_, 0);
+    put<uint32_t>(record_, static_cast<uint32_t>(chunk_indexes_.size()));
+    put<uint64_t>(record_, message_count_ ? start_ns_ : 0);
+    put<uint64_t>(record_, end_ns_);
+    size_t counts = 0;
+    for (size_t channel = 1; channel < channel_messages_.size(); ++channel)
+    { counts += channel_messages_[channel] ? 1 : 0; }
+    put<uint32_t>(record_, static_cast<uint32_t>(counts * 10));
+    for (size_t channel = 1; channel < channel_messages_.size(); ++channel)
+    {
+        if (!channel_messages_[channel])
+        { continue; }
+        put<uint16_t>(record_, static_cast<uint16_t>(channel));
+        put<uint64_t>(record_, channel_messages_[channel]);
+    }
+    endRecord(record_, body);
+
+    body = beginRecord(record_, OpFooter);
+    put<uint64_t>(record_, summary_start);
+    put<uint64_t>(record_, 0);
+    put<uint32_t>(record_, 0);
+    endRecord(record_, body);
+    /// the crc covers the summary and the footer up to its own field, record_ starts with the summary
+    uint32_t crc = crc32(0, record_.data(), record_.size() - sizeof(crc));
+    std::memcpy(record_.data() + record_.size() - sizeof(crc), &crc, sizeof(crc));
+    record_.insert(record_.end(), kMagic, kMagic + sizeof(kMagic));
+    writeOut(record_);
+}
+
+void McapRecorder::writeOut(const std::vector<uint8_t> &bytes)
+{
+    if (std::fwrite(bytes.data(), 1, bytes.size(), file_) != bytes.size())
+    { ++write_errors_; }
+    offset_ += bytes.size();
+    rate_bytes_ += bytes.size();
+}
+
+}  // namespace obsbot_ros
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+
+#include <sys/stat.h>
+
+#include <obsbot_ros/media_fetcher.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+/// mkdir -p
+bool makeDirs(const std::string &path)
+{
+    for (size_t pos = 1; pos <= path.size(); ++pos)
+    {
+        if (pos != path.size() && path[pos] != '/')
+        { continue; }
+        auto part = path.substr(0, pos);
+        if (::mkdir(part.c_str(), 0755) != 0 && errno != EEXIST)
+        { return false; }
+    }
+    return true;
+}
+
+int64_t steadyNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string baseName(const std::string &path)
+{
+    auto slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+}
+
+MediaFetcher::MediaFetcher(const Options &options) : options_(options)
+{
+    options_.workers = std::max<size_t>(1, options_.workers);
+    options_.chunk_bytes = std::max<size_t>(4096, options_.chunk_bytes);
+    if (options_.source_root.empty())
+    { return; }
+    for (size_t i = 0; i < options_.workers; ++i)
+    { threads_.emplace_back(&MediaFetcher::run, this); }
+}
+
+MediaFetcher::~MediaFetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto &thread : threads_)
+    { thread.join(); }
+}
+
+void MediaFetcher::begin(uint32_t count, const std::string &name, int64_t trigger_ns)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+    jobs_.clear();
+    batch_ = Batch();
+    batch_.expected = count;
+    batch_.trigger_ns = trigger_ns;
+    if (!options_.source_root.empty())
+    {
+        batch_.directory = options_.directory + "/" + name;
+        dir_ok_ = makeDirs(batch_.directory);
+    }
+    open_ = true;
+    ++stats_.batches;
+}
+
+void MediaFetcher::add(const std::string &device_path, int64_t reported_ns)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_ || batch_.files.size() >= batch_.expected)
+    {
+        ++stats_.ignored;
+        return;
+    }
+
+    File file;
+    file.device_path = device_path;
+    file.reported_ns = reported_ns;
+    batch_.files.push_back(file);
+    size_t index = batch_.files.size() - 1;
+    if (options_.source_root.empty() || !dir_ok_)
+    {
+        /// listing only, the file is done once it is known
+        finish(index, dir_ok_, std::string(), reported_ns);
+        return;
+    }
+    jobs_.push_back({generation_, index, options_.source_root + "/" + device_path,
+                     batch_.directory + "/" + baseName(device_path)});
+    work_cv_.notify_one();
+}
+
+bool MediaFetcher::wait(std::chrono::milliseconds timeout, Batch &batch)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    bool complete = done_cv_.wait_for(lock, timeout, [this]()
+    { return batch_.done >= batch_.expected; });
+    batch = batch_;
+    open_ = false;
+    ++generation_;
+    jobs_.clear();
+    return complete;
+}
+
+void MediaFetcher::cancel()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    open_ = false;
+    ++generation_;
+    jobs_.clear();
+}
+
+MediaFetcher::Stats MediaFetcher::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void MediaFetcher::run()
+{
+    std::vector<uint8_t> buffer(options_.chunk_bytes);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        work_cv_.wait(lock, [this]()
+        { return stop_ || !jobs_.empty(); });
+        if (stop_)
+        { break; }
+
+        Job job = std::move(jobs_.front());
+        jobs_.pop_front();
+        lock.unlock();
+        uint64_t bytes = 0;
+        bool ok = copy(job, buffer, bytes);
+        int64_t now_ns = steadyNs();
+        lock.lock();
+        stats_.bytes += bytes;
+        if (open_ && job.generation == generation_)
+        { finish(job.index, ok, job.to, now_ns); }
+    }
+}
+
+/// written under a temporary name, a file in the batch directory is always complete
+bool MediaFetcher::copy(const Job &job, std::vector<uint8_t> &buffer, uint64_t &bytes)
+{
+    std::FILE *in = std::fopen(job.from.c_str(), "rb");
+    for (uint32_t attempt = 0; !in && attempt < options_.open_retries; ++attempt)
+    {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(options_.retry_ns));
+        in = std::fopen(job.from.c_str(), "rb");
+    }
+    if (!in)
+    { return false; }
+
+    const std::string part = job.to + ".part";
+    std::FILE *out = std::fopen(part.c_str(), "wb");
+    bool ok = out != nullptr;
+    size_t read = 0;
+    while (ok && (read = std::fread(buffer.data(), 1, buffer.size(), in)) > 0)
+    {
+        ok = std::fwrite(buffer.data(), 1, read, out) == read;
+        bytes += read;
+    }
+    ok = ok && std::ferror(in) == 0;
+    std::fclose(in);
+    if (out)
+    {
+        ok = std::fclose(out) == 0 && ok;
+        ok = ok && std::rename(part.c_str(), job.to.c_str()) == 0;
+        if (!ok)
+        { std::remove(part.c_str()); }
+    }
+    return ok;
+}
+
+void MediaFetcher::finish(size_t index, bool ok, const std::string &local_path, int64_t now_ns)
+{
+    File &file = batch_.files[index];
+    file.ok = ok;
+    file.local_path = ok ? local_path : std::string();
+    file.done_ns = now_ns;
+    if (ok)
+    { ++stats_.files; }
+    else
+    {
+        ++batch_.failed;
+        ++stats_.failed;
+    }
+    batch_.first_ns = batch_.done++ == 0 ? now_ns : std::min(batch_.first_ns, now_ns);
+    batch_.last_ns = std::max(batch_.last_ns, now_ns);
+    done_cv_.notify_all();
+}
+
+}  // namespace obsbot_ros
@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include <obsbot_ros/mosaic_compositor.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+MosaicCompositor::Options sanitize(MosaicCompositor::Options options)
+{
+    /// i420 needs even sizes and even offsets so every tile starts on a chroma sample
+    options.width = std::max(2, options.width & ~1);
+    options.height = std::max(2, options.height & ~1);
+    options.sources = std::max<size_t>(1, options.sources);
+    options.pip_main = std::min(options.pip_main, options.sources - 1);
+    options.pip_scale = std::min(1.0, std::max(0.05, options.pip_scale));
+    options.pip_alpha = std::min<uint32_t>(256, options.pip_alpha);
+    options.margin = std::max(0, options.margin & ~1);
+    options.pool_size = std::max<size_t>(1, options.pool_size);
+    return options;
+}
+}
+
+class MosaicCompositor::Input : public FrameSink
+{
+public:
+    Input(MosaicCompositor *owner, size_t source) : owner_(owner), source_(source)
+    {}
+
+    void onFrame(const FrameRef &frame) override
+    { owner_->store(source_, frame); }
+
+    void onRelease() override
+    { owner_->release(source_); }
+
+    bool wantsFrames() const override
+    { return owner_->demand_callback_ && owner_->demand_callback_(); }
+
+private:
+    MosaicCompositor *owner_;
+    size_t source_;
+};
+
+MosaicCompositor::MosaicCompositor(const Options &options, DemandCallback demand) :
+    options_(sanitize(options)),
+    demand_callback_(std::move(demand)),
+    pool_(options_.pool_size, frameBufferSize(RmVideoFormat::I420, options_.width, options_.height))
+{
+    for (size_t i = 0; i < options_.sources; ++i)
+    {
+        sources_.push_back(std::make_unique<Source>());
+        inputs_.push_back(std::make_shared<Input>(this, i));
+    }
+    layoutTiles();
+}
+
+void MosaicCompositor::store(size_t source, const FrameRef &frame)
+{
+    if (source >= sources_.size() || !frame)
+    { return; }
+
+    auto &slot = *sources_[source];
+    std::lock_guard<std::mutex> lock(slot.mutex);
+    slot.latest = frame;
+}
+
+void MosaicCompositor::release(size_t source)
+{
+    if (source >= sources_.size())
+    { return; }
+
+    auto &slot = *sources_[source];
+    {
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        slot.latest.reset();
+    }
+    /// waits for a compose() that is drawing this source
+    std::lock_guard<std::mutex> lock(slot.draw_mutex);
+    slot.held.reset();
+}
+
+void MosaicCompositor::layoutTiles()
+{
+    const int32_t width = options_.width;
+    const int32_t height = options_.height;
+    const auto count = static_cast<int32_t>(sources_.size());
+    order_.clear();
+
+    if (options_.layout == Layout::Grid || count == 1)
+    {
+        auto columns = static_cast<int32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+        int32_t rows = (count + columns - 1) / columns;
+        int32_t cell_width = (width / columns) & ~1;
+        int32_t cell_height = (height / rows) & ~1;
+        for (int32_t i = 0; i < count; ++i)
+        {
+            auto &source = *sources_[static_cast<size_t>(i)];
+            source.tile = {(i % columns) * cell_width, (i / columns) * cell_height, cell_width, cell_height};
+            source.alpha = 256;
+            order_.push_back(static_cast<size_t>(i));
+        }
+        return;
+    }
+
+    /// the main picture fills the frame, the others line up right to left along the bottom, then on rows above
+    auto &main = *sources_[options_.pip_main];
+    main.tile = {0, 0, width, height};
+    main.alpha = 256;
+    order_.push_back(options_.pip_main);
+
+    const int32_t margin = options_.margin;
+    int32_t inset_width = std::max(2, static_cast<int32_t>(width * options_.pip_scale) & ~1);
+    int32_t inset_height = std::max(2, static_cast<int32_t>(height * options_.pip_scale) & ~1);
+    int32_t per_row = std::max(1, (width - margin) / (inset_width + margin));
+    int32_t k = 0;
+    for (size_t i = 0; i < sources_.size(); ++i)
+    {
+        if (i == options_.pip_main)
+        { continue; }
+        auto &source = *sources_[i];
+        int32_t x = width - (k % per_row + 1) * (inset_width + margin);
+        int32_t y = height - (k / per_row + 1) * (inset_height + margin);
+        source.tile = {std::max(0, x), std::max(0, y), inset_width, inset_height};
+        source.alpha = options_.pip_alpha;
+        order_.push_back(i);
+        ++k;
+    }
+}
+
+void MosaicCompositor::clear(Frame &out) const
+{
+    auto luma = static_cast<size_t>(options_.width) * static_cast<size_t>(options_.height);
+    std::memset(out.data, 16, luma);
+    std::memset(out.data + luma, 128, luma / 2);
+}
+
+bool MosaicCompositor::draw(Source &source, Frame &out)
+{
+    const Frame &frame = *source.held;
+    image_ops::PlaneView y, u, v;
+    if (!image_ops::yuvPlanes(frame, y, u, v) || frame.width < 2 || frame.height < 2)
+    { return false; }
+
+    /// letterbox into the tile
+    const Rect &tile = source.tile;
+    int32_t width = tile.width;
+    int32_t height = tile.height;
+    if (static_cast<int64_t>(frame.width) * tile.height > static_cast<int64_t>(tile.width) * frame.height)
+    {
+        height = static_cast<int32_t>(static_cast<int64_t>(tile.width) * frame.height / frame.width);
+    }
+    else
+    {
+        width = static_cast<int32_t>(static_cast<int64_t>(tile.height) * frame.width / frame.height);
+    }
+    width = std::max(2, width & ~1);
+    height = std::max(2, height & ~1);
+    int32_t x = (tile.x + (tile.width - width) / 2) & ~1;
+    int32_t y_pos = (tile.y + (tile.height - height) / 2) & ~1;
+
+    const int32_t stride = options_.width;
+    const int32_t chroma_stride = stride / 2;
+    uint8_t *luma = out.data;
+    uint8_t *cb = luma + static_cast<size_t>(stride) * static_cast<size_t>(options_.height);
+    uint8_t *cr = cb + static_cast<size_t>(chroma_stride) * static_cast<size_t>(options_.height / 2);
+
+    source.scalers[0].scale(y, luma + static_cast<size_t>(y_pos) * stride + x, stride, width, height, source.alpha);
+    size_t chroma_offset = static_cast<size_t>(y_pos / 2) * chroma_stride + x / 2;
+    if (u.data && v.data)
+    {
+        source.scalers[1].scale(u, cb + chroma_offset, chroma_stride, width / 2, height / 2, source.alpha);
+        source.scalers[2].scale(v, cr + chroma_offset, chroma_stride, width / 2, height / 2, source.alpha);
+    }
+    else
+    {
+        /// mono source, neutral chroma under it
+        for (int32_t row = 0; row < height / 2; ++row)
+        {
+            size_t offset = chroma_offset + static_cast<size_t>(row) * chroma_stride;
+            std::memset(cb + offset, 128, static_cast<size_t>(width / 2));
+            std::memset(cr + offset, 128, static_cast<size_t>(width / 2));
+        }
+    }
+    return true;
+}
+
+FrameRef MosaicCompositor::compose(int64_t stamp_ns)
+{
+    auto start = std::chrono::steady_clock::now();
+    FrameRef out = pool_.acquire();
+    if (!out)
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        ++stats_.dropped;
+        return out;
+    }
+
+    Frame &frame = *out;
+    clear(frame);
+    uint64_t repeated = 0;
+    uint64_t unsupported = 0;
+    for (size_t index : order_)
+    {
+        auto &source = *sources_[index];
+        std::lock_guard<std::mutex> draw_lock(source.draw_mutex);
+        {
+            /// a producer in the middle of a swap keeps its frame for the next round, the last one is drawn again
+            std::unique_lock<std::mutex> lock(source.mutex, std::try_to_lock);
+            if (lock.owns_lock() && source.latest)
+            { source.held = std::move(source.latest); }
+        }
+        if (!source.held)
+        { continue; }
+
+        bool fresh = source.held->sequence + 1 != source.drawn_sequence;
+        source.drawn_sequence = source.held->sequence + 1;
+        if (!draw(source, frame))
+        {
+            if (fresh)
+            { ++unsupported; }
+        }
+        else if (!fresh)
+        {
+            ++repeated;
+        }
+    }
+
+    frame.size = frameBufferSize(RmVideoFormat::I420, options_.width, options_.height);
+    frame.width = options_.width;
+    frame.height = options_.height;
+    frame.stride = options_.width;
+    frame.format = RmVideoFormat::I420;
+    frame.sequence = sequence_++;
+    frame.keyframe = false;
+    frame.stamp_ns = stamp_ns;
+    frame.steady_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.compose_ms = stats_.composed == 0 ? elapsed_ms : stats_.compose_ms + (elapsed_ms - stats_.compose_ms) / 16.0;
+    stats_.max_compose_ms = std::max(stats_.max_compose_ms, elapsed_ms);
+    ++stats_.composed;
+    stats_.repeated += repeated;
+    stats_.unsupported += unsupported;
+    return out;
+}
+
+MosaicCompositor::Stats MosaicCompositor::stats() const
+{
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return stats_;
+}
+
+}  // namespace obsbot_ros
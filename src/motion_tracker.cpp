@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <chrono>
+
+#include <obsbot_ros/image_ops.hpp>
+#include <obsbot_ros/motion_tracker.hpp>
+
+namespace obsbot_ros
+{
+
+MotionTracker::MotionTracker(const Options &options) : options_(options)
+{
+    options_.decimation = std::max(2, options_.decimation);
+    options_.smoothing = std::min(1.0f, std::max(0.01f, options_.smoothing));
+}
+
+bool MotionTracker::process(const Frame &frame)
+{
+    image_ops::PlaneView y, u, v;
+    if (!image_ops::yuvPlanes(frame, y, u, v))
+    {
+        ++stats_.unsupported;
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ++stats_.frames;
+    int32_t width = y.width / options_.decimation;
+    int32_t height = y.height / options_.decimation;
+    if (width < 2 || height < 2)
+    { return false; }
+    if (width != grid_width_ || height != grid_height_)
+    {
+        grid_width_ = width;
+        grid_height_ = height;
+        auto cells = static_cast<size_t>(width) * static_cast<size_t>(height);
+        current_.assign(cells, 0);
+        previous_.assign(cells, 0);
+        mask_.assign(cells, 0);
+        stack_.reserve(cells);
+        have_previous_ = false;
+    }
+
+    decimate(y.data, y.stride, y.step);
+    Target measured;
+    bool found = false;
+    if (have_previous_)
+    {
+        size_t changed = image_ops::diffMask(mask_.data(), current_.data(), previous_.data(), options_.threshold,
+                                             mask_.size());
+        found = largestBlob(changed, measured);
+    }
+    std::swap(current_, previous_);
+    have_previous_ = true;
+
+    if (found)
+    {
+        ++stats_.motion_frames;
+        missed_ = 0;
+        if (target_.valid)
+        {
+            float k = options_.smoothing;
+            target_.x += k * (measured.x - target_.x);
+            target_.y += k * (measured.y - target_.y);
+            target_.x_min += k * (measured.x_min - target_.x_min);
+            target_.y_min += k * (measured.y_min - target_.y_min);
+            target_.x_max += k * (measured.x_max - target_.x_max);
+            target_.y_max += k * (measured.y_max - target_.y_max);
+            target_.score = measured.score;
+        }
+        else
+        {
+            target_ = measured;
+            target_.valid = true;
+        }
+        target_.stamp_ns = frame.stamp_ns;
+    }
+    else if (target_.valid && ++missed_ > options_.hold_frames)
+    {
+        target_.valid = false;
+    }
+
+    double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    stats_.process_us = stats_.frames == 1 ? elapsed_us : stats_.process_us + (elapsed_us - stats_.process_us) / 16.0;
+    stats_.max_process_us = std::max(stats_.max_process_us, elapsed_us);
+    return true;
+}
+
+void MotionTracker::reset()
+{
+    have_previous_ = false;
+    target_ = Target();
+    missed_ = 0;
+}
+
+/// each cell is the mean of two samples half a cell apart on the diagonal, enough to take the edge off sensor noise
+void MotionTracker::decimate(const uint8_t *data, int32_t stride, int32_t step)
+{
+    const int32_t cell = options_.decimation;
+    const size_t half_row = static_cast<size_t>(cell / 2) * static_cast<size_t>(stride);
+    const size_t half_col = static_cast<size_t>(cell / 2) * static_cast<size_t>(step);
+    const size_t col_step = static_cast<size_t>(cell) * static_cast<size_t>(step);
+    uint8_t *out = current_.data();
+    for (int32_t row = 0; row < grid_height_; ++row)
+    {
+        const uint8_t *top = data + static_cast<size_t>(row) * static_cast<size_t>(cell) * static_cast<size_t>(stride);
+        const uint8_t *middle = top + half_row + half_col;
+        for (int32_t col = 0; col < grid_width_; ++col)
+        {
+            *out++ = static_cast<uint8_t>((top[col * col_step] + middle[col * col_step] + 1) >> 1);
+        }
+    }
+}
+
+bool MotionTracker::largestBlob(size_t changed, Target &out)
+{
+    auto min_cells = static_cast<size_t>(options_.min_area * static_cast<float>(mask_.size()));
+    if (changed < std::max<size_t>(1, min_cells))
+    { return false; }
+
+    const int32_t width = grid_width_;
+    const int32_t height = grid_height_;
+    size_t best_count = 0;
+    int32_t best_box[4] = {0, 0, 0, 0};
+    int64_t best_sum_x = 0;
+    int64_t best_sum_y = 0;
+
+    /// visited cells are cleared in the mask, so every cell is pushed at most once
+    for (int32_t start = 0; start < width * height; ++start)
+    {
+        if (!mask_[static_cast<size_t>(start)])
+        { continue; }
+
+        size_t count = 0;
+        int32_t box[4] = {width, height, -1, -1};
+        int64_t sum_x = 0;
+        int64_t sum_y = 0;
+        stack_.clear();
+        stack_.push_back(start);
+        mask_[static_cast<size_t>(start)] = 0;
+        while (!stack_.empty())
+        {
+            int32_t index = stack_.back();
+            stack_.pop_back();
+            int32_t x = index % width;
+            int32_t y = index / width;
+            ++count;
+            sum_x += x;
+            sum_y += y;
+            box[0] = std::min(box[0], x);
+            box[1] = std::min(box[1], y);
+            box[2] = std::max(box[2], x);
+            box[3] = std::max(box[3], y);
+
+            const int32_t neighbours[4] = {x > 0 ? index - 1 : -1, x + 1 < width ? index + 1 : -1,
+                                           y > 0 ? index - width : -1, y + 1 < height ? index + width : -1};
+            for (int32_t next : neighbours)
+            {
+                if (next >= 0 && mask_[static_cast<size_t>(next)])
+                {
+                    mask_[static_cast<size_t>(next)] = 0;
+                    stack_.push_back(next);
+                }
+            }
+        }
+        if (count > best_count)
+        {
+            best_count = count;
+            std::copy(box, box + 4, best_box);
+            best_sum_x = sum_x;
+            best_sum_y = sum_y;
+        }
+    }
+    if (best_count < std::max<size_t>(1, min_cells))
+    { return false; }
+
+    auto w = static_cast<float>(width);
+    auto h = static_cast<float>(height);
+    out.x = (static_cast<float>(best_sum_x) / static_cast<float>(best_count) + 0.5f) / w;
+    out.y = (static_cast<float>(best_sum_y) / static_cast<float>(best_count) + 0.5f) / h;
+    out.x_min = static_cast<float>(best_box[0]) / w;
+    out.y_min = static_cast<float>(best_box[1]) / h;
+    out.x_max = static_cast<float>(best_box[2] + 1) / w;
+    out.y_max = static_cast<float>(best_box[3] + 1) / h;
+    out.score = static_cast<float>(best_count) / static_cast<float>(changed);
+    return true;
+}
+
+}  // namespace obsbot_ros
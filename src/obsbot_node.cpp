@@ -0,0 +1,2521 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+#include <rcl/error_handling.h>
+#include <rcl/timer.h>
+
+#include <obsbot_ros/obsbot_node.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+RmVideoFormat formatFromName(const std::string &name)
+{
+    if (name == "mjpeg")
+    { return RmVideoFormat::MJPEG; }
+    if (name == "h264")
+    { return RmVideoFormat::H264; }
+    if (name == "h265" || name == "hevc")
+    { return RmVideoFormat::HEVC; }
+    if (name == "yuyv" || name == "yuy2")
+    { return RmVideoFormat::YUY2; }
+    if (name == "uyvy")
+    { return RmVideoFormat::UYVY; }
+    if (name == "nv12")
+    { return RmVideoFormat::NV12; }
+    if (name == "i420")
+    { return RmVideoFormat::I420; }
+    return RmVideoFormat::Unknown;
+}
+
+/// rtsp stream resolution of the tail air, auto if the size and rate are not one of its presets
+Device::DevVideoResType streamResolution(int32_t height, int32_t fps)
+{
+    int32_t base;
+    if (height == 2160)
+    { base = 0x00; }
+    else if (height == 1080)
+    { base = 0x20; }
+    else if (height == 720)
+    { base = 0x30; }
+    else
+    { return Device::DevVideoResAuto; }
+
+    const int32_t rates[] = {30, 25, 24, 60, 50, 48};
+    for (int32_t i = 0; i < 6; ++i)
+    {
+        if (rates[i] == fps)
+        { return static_cast<Device::DevVideoResType>(base + i + 1); }
+    }
+    return Device::DevVideoResAuto;
+}
+
+TargetSelector::Mode selectionMode(const std::string &name)
+{
+    if (name == "position")
+    { return TargetSelector::Mode::Position; }
+    if (name == "central")
+    { return TargetSelector::Mode::Central; }
+    return TargetSelector::Mode::Box;
+}
+
+int64_t steadyNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
+
+ObsbotNode::ObsbotNode(const rclcpp::NodeOptions &options) :
+    rclcpp_lifecycle::LifecycleNode("obsbot", options),
+    groups_(get_node_base_interface())
+{
+    serial_ = declare_parameter<std::string>("serial", "");
+    declare_parameter<bool>("autostart", true);
+    declare_parameter<int>("discovery_timeout_ms", 3000);
+    auto control_rate = declare_parameter<double>("control.rate_hz", 30.0);
+    auto status_period = declare_parameter<int>("status.period_ms", 100);
+    auto diagnostics_period = declare_parameter<int>("diagnostics.period_ms", 1000);
+    diagnostics_full_every_ = declare_parameter<int>("diagnostics.full_every", 10);
+    declare_parameter<std::vector<std::string>>("executor.dedicated",
+                                                ExecutorLayout::Options().dedicated);
+    declare_parameter<int>("executor.shared_threads", ExecutorLayout::Options().shared_threads);
+    declare_parameter<std::string>("download.directory", "/tmp/obsbot");
+    declare_parameter<int>("video.width", 1920);
+    declare_parameter<int>("video.height", 1080);
+    declare_parameter<int>("video.fps", 30);
+    declare_parameter<std::string>("video.format", "mjpeg");
+    declare_parameter<int>("video.driver_buffers", 4);
+    declare_parameter<int>("video.pool_size", 8);
+    declare_parameter<double>("video.hfov_deg", 78.0);
+    declare_parameter<std::string>("rtsp.url", "");
+    declare_parameter<std::string>("rtsp.url_template", "rtsp://{ip}:8554/live");
+    declare_parameter<std::string>("rtsp.transport", "tcp");
+    declare_parameter<bool>("rtsp.jitter_buffer", false);
+    declare_parameter<int>("rtsp.jitter_delay_ms", 40);
+    declare_parameter<bool>("rtsp.map_timestamps", true);
+    declare_parameter<int>("rtsp.max_frame_kb", 2048);
+    auto adapt_period = declare_parameter<int>("adapt.period_ms", 1000);
+    declare_parameter<bool>("adapt.enabled", true);
+    declare_parameter<bool>("adapt.allow_h265", true);
+    declare_parameter<double>("adapt.max_loss", 0.02);
+    declare_parameter<double>("adapt.max_delay_ms", 250.0);
+    declare_parameter<double>("adapt.max_jitter_ms", 30.0);
+    auto ai_status_enabled = declare_parameter<bool>("ai_status.enabled", true);
+    auto ai_status_period = declare_parameter<int>("ai_status.period_ms", 20);
+    declare_parameter<int>("ai_status.depth", 2);
+    declare_parameter<int>("ai_status.timeout_ms", 500);
+    auto select_enabled = declare_parameter<bool>("select.enabled", true);
+    declare_parameter<std::string>("select.mode", "box");
+    declare_parameter<int>("select.target_type", Device::AiTargetAuto);
+    declare_parameter<double>("select.min_score", 0.3);
+    declare_parameter<double>("select.switch_margin", 0.25);
+    declare_parameter<int>("select.switch_frames", 5);
+    declare_parameter<double>("select.reselect_iou", 0.3);
+    declare_parameter<int>("select.memory_ms", 1500);
+    declare_parameter<int>("select.min_interval_ms", 500);
+    declare_parameter<double>("ptz.max_speed", 1.0);
+    declare_parameter<double>("ptz.acceleration", 4.0);
+    declare_parameter<int>("ptz.velocity_timeout_ms", 300);
+    declare_parameter<double>("ptz.command_rate_hz", 10.0);
+    motion_mode_ = declare_parameter<std::string>("motion.mode", "auto");
+    declare_parameter<int>("motion.decimation", 8);
+    declare_parameter<int>("motion.threshold", 20);
+    declare_parameter<double>("motion.min_area", 0.002);
+    motion_deadband_ = declare_parameter<double>("motion.deadband", 0.1);
+    motion_gain_ = declare_parameter<double>("motion.gain", 1.0);
+    motion_gimbal_speed_ = declare_parameter<double>("motion.gimbal_speed", 30.0);
+    settle_ns_ = declare_parameter<int>("motion.settle_ms", 400) * 1000000;
+    auto roi_enabled = declare_parameter<bool>("roi.enabled", false);
+    roi_type_ = declare_parameter<bool>("roi.smooth", true) ? 1 : 0;
+    roi_view_ = static_cast<int32_t>(declare_parameter<int>("roi.view", Device::ROIViewDefault));
+    declare_parameter<double>("roi.min_score", 0.3);
+    declare_parameter<double>("roi.padding", 0.15);
+    declare_parameter<double>("roi.min_size", 0.3);
+    declare_parameter<int>("roi.smoothing_ms", 400);
+    declare_parameter<double>("roi.dead_zone", 0.08);
+    declare_parameter<int>("roi.lost_ms", 2000);
+    declare_parameter<int>("roi.min_interval_ms", 250);
+    auto event_enabled = declare_parameter<bool>("event_buffer.enabled", false);
+    declare_parameter<std::string>("event_buffer.directory", "/tmp/obsbot_events");
+    declare_parameter<double>("event_buffer.pre_s", 10.0);
+    declare_parameter<double>("event_buffer.post_s", 5.0);
+    declare_parameter<int>("event_buffer.max_mb", 64);
+    trigger_events_ = declare_parameter<std::vector<int64_t>>("event_buffer.trigger_events", std::vector<int64_t>());
+    auto attitude_rate = declare_parameter<double>("attitude.rate_hz", 100.0);
+    auto stabilize_enabled = declare_parameter<bool>("stabilize.enabled", false);
+    declare_parameter<double>("stabilize.crop", 0.85);
+    declare_parameter<int>("stabilize.smoothing_ms", 500);
+    declare_parameter<double>("stabilize.max_correction_deg", 5.0);
+    declare_parameter<int>("stabilize.latency_ms", 0);
+    auto level_enabled = declare_parameter<bool>("level.enabled", false);
+    declare_parameter<double>("level.threshold_deg", 1.0);
+    declare_parameter<double>("level.max_roll_deg", 10.0);
+    auto privacy_enabled = declare_parameter<bool>("privacy.enabled", false);
+    declare_parameter<std::vector<std::string>>("privacy.regions", std::vector<std::string>());
+    declare_parameter<int>("privacy.block", 24);
+    declare_parameter<bool>("privacy.blank_without_view", true);
+    auto overlay_enabled = declare_parameter<bool>("overlay.enabled", false);
+    declare_parameter<int>("overlay.scale", 2);
+    declare_parameter<bool>("overlay.bottom", false);
+    declare_parameter<int>("overlay.background", 160);
+    auto snapshot_enabled = declare_parameter<bool>("snapshot.enabled", true);
+    declare_parameter<int>("snapshot.jpeg_quality", 90);
+    declare_parameter<int>("snapshot.timeout_ms", 1000);
+    declare_parameter<int>("snapshot.device_timeout_ms", 5000);
+    declare_parameter<std::string>("media.root", "");
+    declare_parameter<std::string>("media.directory", "/tmp/obsbot_media");
+    declare_parameter<int>("media.fetch_workers", 3);
+    declare_parameter<int>("burst.timeout_ms", 30000);
+    auto timelapse_enabled = declare_parameter<bool>("timelapse.enabled", false);
+    declare_parameter<double>("timelapse.interval_s", 60.0);
+    declare_parameter<int>("timelapse.initial_latency_ms", 3000);
+    declare_parameter<int>("timelapse.margin_ms", 200);
+    declare_parameter<int>("timelapse.timeout_ms", 10000);
+    auto power_enabled = declare_parameter<bool>("power.enabled", false);
+    declare_parameter<double>("power.idle_s", 30.0);
+    power_privacy_ = declare_parameter<std::string>("power.sleep_mode", "sleep") == "privacy";
+    declare_parameter<int>("power.check_ms", 100);
+    declare_parameter<int>("power.initial_latency_ms", 3000);
+    declare_parameter<int>("power.wake_timeout_ms", 10000);
+    declare_parameter<int>("power.device_suspend_s", 10);
+    auto thermal_enabled = declare_parameter<bool>("thermal.enabled", false);
+    declare_parameter<std::vector<std::string>>(
+        "thermal.ladder", std::vector<std::string>{"1280x720@30 medium ai", "1280x720@15 low noai",
+                                                   "640x360@15 low noai"});
+    declare_parameter<int>("thermal.check_ms", 1000);
+    declare_parameter<double>("thermal.settle_s", 20.0);
+    declare_parameter<double>("thermal.warning_hold_s", 60.0);
+    declare_parameter<double>("thermal.recover_s", 300.0);
+    declare_parameter<std::vector<int64_t>>("thermal.battery_steps", std::vector<int64_t>{30, 15, 5});
+    declare_parameter<double>("thermal.effect_s", 300.0);
+    bandwidth_ = declare_parameter<bool>("bandwidth.enabled", false);
+    declare_parameter<double>("bandwidth.priority", 1.0);
+    declare_parameter<double>("bandwidth.share", 0.8);
+    declare_parameter<std::vector<std::string>>("bandwidth.bus_limits", std::vector<std::string>());
+    declare_parameter<double>("bandwidth.mjpeg_bpp", 3.0);
+    declare_parameter<double>("bandwidth.h26x_bpp", 0.5);
+    declare_parameter<int>("bandwidth.min_fps", 5);
+    for (const char *name : {"image.brightness", "image.contrast", "image.saturation", "image.sharpness", "image.hue"})
+    {
+        declare_parameter<int>(name, -1);
+    }
+
+    /// register device changed callback, the device itself is taken on configure
+    device_ = DeviceRegistry::get().intern(serial_);
+    registry_listener_ = DeviceRegistry::get().addListener([this](DeviceRegistry::Handle device, bool in_out)
+                                                           { onDevChanged(device, in_out); });
+
+    /// control: gimbal and zoom commands
+    rclcpp::SubscriptionOptions control_opts;
+    control_opts.callback_group = groups_.get(CallbackRole::Control);
+    gimbal_angle_sub_ = create_subscription<geometry_msgs::msg::Vector3>(
+        "~/gimbal/angle_cmd", rclcpp::QoS(1),
+        std::bind(&ObsbotNode::onGimbalAngle, this, std::placeholders::_1), control_opts);
+    gimbal_speed_sub_ = create_subscription<geometry_msgs::msg::Vector3>(
+        "~/gimbal/speed_cmd", rclcpp::QoS(1),
+        std::bind(&ObsbotNode::onGimbalSpeed, this, std::placeholders::_1), control_opts);
+    zoom_sub_ = create_subscription<std_msgs::msg::Float32>(
+        "~/zoom_cmd", rclcpp::QoS(1), std::bind(&ObsbotNode::onZoom, this, std::placeholders::_1), control_opts);
+    if (select_enabled)
+    {
+        TargetSelector::Options select;
+        select.mode = selectionMode(get_parameter("select.mode").as_string());
+        select.target_type = static_cast<int32_t>(get_parameter("select.target_type").as_int());
+        select.min_score = static_cast<float>(get_parameter("select.min_score").as_double());
+        select.switch_margin = get_parameter("select.switch_margin").as_double();
+        select.switch_after =
+            static_cast<uint32_t>(std::max<int64_t>(1, get_parameter("select.switch_frames").as_int()));
+        select.reselect_iou = get_parameter("select.reselect_iou").as_double();
+        select.memory_ns = get_parameter("select.memory_ms").as_int() * 1000000;
+        select.min_interval_ns = get_parameter("select.min_interval_ms").as_int() * 1000000;
+        selector_ = std::make_unique<TargetSelector>(select);
+    }
+    if (roi_enabled)
+    {
+        AutoFramer::Options roi;
+        roi.min_score = static_cast<float>(get_parameter("roi.min_score").as_double());
+        roi.padding = static_cast<float>(get_parameter("roi.padding").as_double());
+        roi.min_size = static_cast<float>(get_parameter("roi.min_size").as_double());
+        roi.smoothing_ns = get_parameter("roi.smoothing_ms").as_int() * 1000000;
+        roi.dead_zone = static_cast<float>(get_parameter("roi.dead_zone").as_double());
+        roi.lost_ns = get_parameter("roi.lost_ms").as_int() * 1000000;
+        roi.min_interval_ns = get_parameter("roi.min_interval_ms").as_int() * 1000000;
+        framer_ = std::make_unique<AutoFramer>(roi);
+    }
+    if (selector_ || framer_)
+    {
+        detections_sub_ = create_subscription<msg::DetectionArray>(
+            "~/detections", rclcpp::QoS(1), std::bind(&ObsbotNode::onDetections, this, std::placeholders::_1),
+            control_opts);
+    }
+
+    /// digital pan/tilt of the meet series, teleop talks to the local window model
+    DigitalPtz::Options ptz;
+    ptz.max_speed = get_parameter("ptz.max_speed").as_double();
+    ptz.acceleration = get_parameter("ptz.acceleration").as_double();
+    ptz.velocity_timeout_ns = get_parameter("ptz.velocity_timeout_ms").as_int() * 1000000;
+    ptz.min_interval_ns = static_cast<int64_t>(1e9 / std::max(1.0, get_parameter("ptz.command_rate_hz").as_double()));
+    ptz_ = std::make_unique<DigitalPtz>(ptz);
+    ptz_velocity_sub_ = create_subscription<geometry_msgs::msg::Vector3>(
+        "~/ptz/velocity_cmd", rclcpp::QoS(1),
+        std::bind(&ObsbotNode::onPtzVelocity, this, std::placeholders::_1), control_opts);
+    ptz_position_sub_ = create_subscription<geometry_msgs::msg::Vector3>(
+        "~/ptz/position_cmd", rclcpp::QoS(1),
+        std::bind(&ObsbotNode::onPtzPosition, this, std::placeholders::_1), control_opts);
+    if (motion_mode_ != "off")
+    {
+        MotionTracker::Options motion;
+        motion.decimation = static_cast<int32_t>(get_parameter("motion.decimation").as_int());
+        motion.threshold = static_cast<uint8_t>(std::min<int64_t>(255, std::max<int64_t>(
+            0, get_parameter("motion.threshold").as_int())));
+        motion.min_area = static_cast<float>(get_parameter("motion.min_area").as_double());
+        motion_ = std::make_unique<MotionTracker>(motion);
+        motion_msg_.detections.resize(1);
+        motion_msg_.detections[0].track_id = 0;
+    }
+    control_period_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::duration<double>(1.0 / std::max(1.0, control_rate)));
+    control_timer_ = create_wall_timer(control_period_, std::bind(&ObsbotNode::controlTick, this),
+                                       groups_.get(CallbackRole::Control));
+    control_timer_->cancel();
+
+    /// status: gimbal attitude and cached camera status
+    gimbal_state_pub_ = create_publisher<geometry_msgs::msg::Vector3Stamped>("~/gimbal/state", rclcpp::QoS(10));
+    ptz_state_pub_ = create_publisher<geometry_msgs::msg::Vector3Stamped>("~/ptz/state", rclcpp::QoS(10));
+    motion_pub_ = create_publisher<msg::DetectionArray>("~/motion/detections", rclcpp::QoS(1));
+    status_timer_ = create_wall_timer(std::chrono::milliseconds(std::max(10, static_cast<int>(status_period))),
+                                      std::bind(&ObsbotNode::statusTick, this), groups_.get(CallbackRole::Status));
+    status_timer_->cancel();
+    diagnostics_pub_ = create_publisher<diagnostic_msgs::msg::DiagnosticArray>("/diagnostics", rclcpp::QoS(10));
+    diagnostics_timer_ = create_wall_timer(
+        std::chrono::milliseconds(std::max(100, static_cast<int>(diagnostics_period))),
+        std::bind(&ObsbotNode::diagnosticsTick, this), groups_.get(CallbackRole::Status));
+    diagnostics_timer_->cancel();
+    if (ai_status_enabled)
+    {
+        AiStatusPoller::Options poll;
+        poll.depth = static_cast<size_t>(std::max<int64_t>(1, get_parameter("ai_status.depth").as_int()));
+        poll.timeout_ns = get_parameter("ai_status.timeout_ms").as_int() * 1000000;
+        ai_poller_ = std::make_unique<AiStatusPoller>(
+            poll, std::bind(&ObsbotNode::onAiStatus, this, std::placeholders::_1, std::placeholders::_2));
+        /// on change only, late subscribers get the current state
+        ai_status_pub_ = create_publisher<msg::AiStatus>("~/ai/status",
+                                                         rclcpp::QoS(1).reliable().transient_local());
+        ai_status_timer_ = create_wall_timer(
+            std::chrono::milliseconds(std::max(5, static_cast<int>(ai_status_period))),
+            std::bind(&ObsbotNode::aiStatusTick, this), groups_.get(CallbackRole::Status));
+        ai_status_timer_->cancel();
+    }
+
+    /// capture: image topics, the capture timer is created on configure once the frame rate is known
+    image_pub_ = create_publisher<sensor_msgs::msg::Image>("~/image_raw", rclcpp::SensorDataQoS());
+    compressed_pub_ = create_publisher<sensor_msgs::msg::CompressedImage>("~/image_raw/compressed",
+                                                                          rclcpp::SensorDataQoS());
+    if (stabilize_enabled)
+    {
+        Stabilizer::Options stabilize;
+        stabilize.hfov_deg = get_parameter("video.hfov_deg").as_double();
+        stabilize.crop = get_parameter("stabilize.crop").as_double();
+        stabilize.smoothing_ns = get_parameter("stabilize.smoothing_ms").as_int() * 1000000;
+        stabilize.max_correction_deg = get_parameter("stabilize.max_correction_deg").as_double();
+        stabilize.latency_ns = get_parameter("stabilize.latency_ms").as_int() * 1000000;
+        stabilizer_ = std::make_unique<Stabilizer>(stabilize);
+        stabilized_msg_.encoding = encodingName(RmVideoFormat::I420);
+        stabilized_pub_ = create_publisher<sensor_msgs::msg::Image>("~/image_stabilized", rclcpp::SensorDataQoS());
+    }
+    if (level_enabled)
+    {
+        HorizonLeveler::Options level;
+        level.threshold_deg = get_parameter("level.threshold_deg").as_double();
+        level.max_roll_deg = get_parameter("level.max_roll_deg").as_double();
+        leveler_ = std::make_unique<HorizonLeveler>(level);
+        leveled_msg_.encoding = encodingName(RmVideoFormat::I420);
+        leveled_pub_ = create_publisher<sensor_msgs::msg::Image>("~/image_leveled", rclcpp::SensorDataQoS());
+    }
+    if (privacy_enabled)
+    {
+        PrivacyMask::Options privacy;
+        for (const auto &text : get_parameter("privacy.regions").as_string_array())
+        {
+            PrivacyMask::Region region;
+            if (PrivacyMask::parse(text, region))
+            { privacy.regions.push_back(region); }
+            else
+            { RCLCPP_ERROR(get_logger(), "ignoring malformed privacy region \"%s\"", text.c_str()); }
+        }
+        privacy.hfov_deg = get_parameter("video.hfov_deg").as_double();
+        privacy.block = static_cast<int32_t>(get_parameter("privacy.block").as_int());
+        privacy.blank_without_view = get_parameter("privacy.blank_without_view").as_bool();
+        privacy_ = std::make_unique<PrivacyMask>(privacy);
+    }
+    if (overlay_enabled)
+    {
+        TelemetryOverlay::Options overlay;
+        overlay.scale = static_cast<int32_t>(get_parameter("overlay.scale").as_int());
+        overlay.bottom = get_parameter("overlay.bottom").as_bool();
+        overlay.background = static_cast<uint8_t>(std::min<int64_t>(255, std::max<int64_t>(
+            0, get_parameter("overlay.background").as_int())));
+        overlay_ = std::make_unique<TelemetryOverlay>(overlay);
+    }
+    if (stabilizer_ || leveler_ || overlay_ || (privacy_ && privacy_->needsView()))
+    {
+        attitude_ = std::make_shared<AttitudeTrack>();
+        /// attitude at a rate well above the frame rate, status group next to the other gimbal reads
+        attitude_timer_ = create_wall_timer(
+            std::chrono::nanoseconds(static_cast<int64_t>(1e9 / std::max(1.0, attitude_rate))),
+            std::bind(&ObsbotNode::attitudeTick, this), groups_.get(CallbackRole::Status));
+        attitude_timer_->cancel();
+    }
+
+    /// housekeeping: file transfer and parameter batches, default group
+    download_srv_ = create_service<std_srvs::srv::Trigger>(
+        "~/download_image",
+        std::bind(&ObsbotNode::onDownloadImage, this, std::placeholders::_1, std::placeholders::_2),
+        rmw_qos_profile_services_default, groups_.get(CallbackRole::Housekeeping));
+    if (event_enabled)
+    {
+        EventBuffer::Options event;
+        event.directory = get_parameter("event_buffer.directory").as_string();
+        event.prefix = serial_.empty() ? get_name() : serial_;
+        event.pre_ns = static_cast<int64_t>(get_parameter("event_buffer.pre_s").as_double() * 1e9);
+        event.post_ns = static_cast<int64_t>(get_parameter("event_buffer.post_s").as_double() * 1e9);
+        auto max_mb = std::max<int64_t>(1, get_parameter("event_buffer.max_mb").as_int());
+        event.max_bytes = static_cast<size_t>(max_mb) << 20;
+        event_buffer_ = std::make_shared<EventBuffer>(event);
+        addFrameSink(event_buffer_);
+
+        rclcpp::SubscriptionOptions housekeeping_opts;
+        housekeeping_opts.callback_group = groups_.get(CallbackRole::Housekeeping);
+        event_trigger_sub_ = create_subscription<std_msgs::msg::String>(
+            "~/event_buffer/trigger", rclcpp::QoS(10), [this](const std_msgs::msg::String::SharedPtr msg)
+            { triggerEvent(msg->data.empty() ? "topic" : msg->data); }, housekeeping_opts);
+        event_dump_srv_ = create_service<std_srvs::srv::Trigger>(
+            "~/event_buffer/dump",
+            std::bind(&ObsbotNode::onEventDump, this, std::placeholders::_1, std::placeholders::_2),
+            rmw_qos_profile_services_default, groups_.get(CallbackRole::Housekeeping));
+    }
+    if (snapshot_enabled)
+    {
+        snapshot_ = std::make_shared<SnapshotSink>();
+        addFrameSink(snapshot_);
+        snapshot_srv_ = create_service<srv::Snapshot>(
+            "~/snapshot", std::bind(&ObsbotNode::onSnapshot, this, std::placeholders::_1, std::placeholders::_2),
+            rmw_qos_profile_services_default, groups_.get(CallbackRole::Housekeeping));
+    }
+    MediaFetcher::Options media;
+    media.source_root = get_parameter("media.root").as_string();
+    media.directory = get_parameter("media.directory").as_string();
+    media.workers = static_cast<size_t>(std::max<int64_t>(1, get_parameter("media.fetch_workers").as_int()));
+    media_ = std::make_unique<MediaFetcher>(media);
+    burst_srv_ = create_service<srv::Burst>(
+        "~/burst", std::bind(&ObsbotNode::onBurst, this, std::placeholders::_1, std::placeholders::_2),
+        rmw_qos_profile_services_default, groups_.get(CallbackRole::Housekeeping));
+    /// media: bursts and device photos wait seconds on the camera, housekeeping only queues them
+    media_timer_ = create_wall_timer(std::chrono::nanoseconds(0), std::bind(&ObsbotNode::mediaTick, this),
+                                     groups_.get(CallbackRole::Media));
+    media_timer_->cancel();
+    if (timelapse_enabled)
+    {
+        TimelapseScheduler::Options timelapse;
+        timelapse.interval_ns = static_cast<int64_t>(get_parameter("timelapse.interval_s").as_double() * 1e9);
+        timelapse.initial_latency_ns = get_parameter("timelapse.initial_latency_ms").as_int() * 1000000;
+        timelapse.margin_ns = get_parameter("timelapse.margin_ms").as_int() * 1000000;
+        timelapse.timeout_ns = get_parameter("timelapse.timeout_ms").as_int() * 1000000;
+        timelapse_ = std::make_unique<TimelapseScheduler>(timelapse);
+        timelapse_timer_ = create_wall_timer(std::chrono::seconds(1), std::bind(&ObsbotNode::timelapseTick, this),
+                                             groups_.get(CallbackRole::Housekeeping));
+        timelapse_timer_->cancel();
+    }
+    if (power_enabled && timelapse_)
+    { RCLCPP_WARN(get_logger(), "timelapse puts the device to sleep itself, power.enabled is ignored"); }
+    else if (power_enabled)
+    {
+        PowerManager::Options power;
+        power.idle_ns = static_cast<int64_t>(get_parameter("power.idle_s").as_double() * 1e9);
+        power.initial_latency_ns = get_parameter("power.initial_latency_ms").as_int() * 1000000;
+        power.wake_timeout_ns = get_parameter("power.wake_timeout_ms").as_int() * 1000000;
+        power_ = std::make_unique<PowerManager>(power);
+        /// latched, a consumer that starts later still learns how far ahead to wake the camera
+        wake_latency_pub_ = create_publisher<std_msgs::msg::Float32>("~/power/wake_latency_ms",
+                                                                     rclcpp::QoS(1).reliable().transient_local());
+        /// status group, so a snapshot waiting in housekeeping can wake the camera
+        power_timer_ = create_wall_timer(
+            std::chrono::milliseconds(std::max<int64_t>(10, get_parameter("power.check_ms").as_int())),
+            std::bind(&ObsbotNode::powerTick, this), groups_.get(CallbackRole::Status));
+        power_timer_->cancel();
+        power_wake_srv_ = create_service<std_srvs::srv::Trigger>(
+            "~/power/wake", std::bind(&ObsbotNode::onPowerWake, this, std::placeholders::_1, std::placeholders::_2),
+            rmw_qos_profile_services_default, groups_.get(CallbackRole::Housekeeping));
+    }
+    if (thermal_enabled)
+    {
+        /// the first rung is whatever the video parameters ask for
+        ThermalGovernor::Options thermal;
+        thermal.ladder.emplace_back();
+        for (const auto &text : get_parameter("thermal.ladder").as_string_array())
+        {
+            ThermalGovernor::Rung rung;
+            if (ThermalGovernor::parse(text, rung))
+            { thermal.ladder.push_back(rung); }
+            else
+            { RCLCPP_ERROR(get_logger(), "ignoring malformed thermal rung \"%s\"", text.c_str()); }
+        }
+        thermal.settle_ns = static_cast<int64_t>(get_parameter("thermal.settle_s").as_double() * 1e9);
+        thermal.warning_hold_ns = static_cast<int64_t>(get_parameter("thermal.warning_hold_s").as_double() * 1e9);
+        thermal.recover_ns = static_cast<int64_t>(get_parameter("thermal.recover_s").as_double() * 1e9);
+        thermal.effect_ns = static_cast<int64_t>(get_parameter("thermal.effect_s").as_double() * 1e9);
+        thermal.battery_steps.clear();
+        for (auto step : get_parameter("thermal.battery_steps").as_integer_array())
+        { thermal.battery_steps.push_back(static_cast<int32_t>(step)); }
+        thermal_ = std::make_unique<ThermalGovernor>(thermal);
+        thermal_timer_ = create_wall_timer(
+            std::chrono::milliseconds(std::max<int64_t>(100, get_parameter("thermal.check_ms").as_int())),
+            std::bind(&ObsbotNode::thermalTick, this), groups_.get(CallbackRole::Status));
+        thermal_timer_->cancel();
+    }
+    network_timer_ = create_wall_timer(std::chrono::milliseconds(std::max(200, static_cast<int>(adapt_period))),
+                                       std::bind(&ObsbotNode::networkTick, this),
+                                       groups_.get(CallbackRole::Housekeeping));
+    network_timer_->cancel();
+    param_cb_handle_ = add_on_set_parameters_callback(
+        std::bind(&ObsbotNode::onSetParameters, this, std::placeholders::_1));
+}
+
+ObsbotNode::~ObsbotNode()
+{
+    /// late ai status responses publish through members destroyed before the poller
+    ai_poller_.reset();
+    closeCapture();
+    if (dev_)
+    {
+        dev_->enableDevStatusCallback(false);
+        dev_->setDevStatusCallbackFunc(nullptr, nullptr);
+        dev_->setDevEventNotifyCallbackFunc(nullptr, nullptr);
+    }
+    DeviceRegistry::get().removeListener(registry_listener_);
+    if (bandwidth_)
+    { BandwidthPlanner::get().leave(device_); }
+}
+
+ObsbotNode::CallbackReturn ObsbotNode::on_configure(const rclcpp_lifecycle::State &)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    /// the device handle survives cleanup, only the first configure has to wait for enumeration
+    if (!dev_)
+    {
+        auto timeout = std::chrono::milliseconds(get_parameter("discovery_timeout_ms").as_int());
+        if (!waitForDevice(timeout))
+        {
+            RCLCPP_ERROR(get_logger(), "no obsbot device found%s", serial_.empty() ? "" : (" with sn " + serial_).c_str());
+            return CallbackReturn::FAILURE;
+        }
+        product_ = dev_->productType();
+        RCLCPP_INFO(get_logger(), "using device %s (sn %s, version %s)", dev_->devName().c_str(), serial_.c_str(),
+                    dev_->devVersion().c_str());
+
+        if (thermal_ && product_ != ObsbotProdTailAir)
+        {
+            RCLCPP_WARN(get_logger(), "thermal throttling reads the tail air status, disabled for this camera");
+            thermal_.reset();
+        }
+        if (thermal_)
+        {
+            /// the top rung gives the device back its own bitrate level; the rung survives later cleanups
+            sdkCall(dev_->cameraGetMainVideoBitrateLevelR(thermal_bitrate_));
+            applied_bitrate_ = thermal_bitrate_;
+            std::lock_guard<std::mutex> lock(thermal_mutex_);
+            thermal_->reset(steadyNs());
+        }
+
+        dev_->setDevStatusCallbackFunc([this](void *, const void *data)
+                                       { onDevStatusUpdated(data); }, nullptr);
+        dev_->enableDevStatusCallback(true);
+        if (product_ == ObsbotProdTailAir)
+        {
+            dev_->setDevEventNotifyCallbackFunc([this](void *, int32_t event_type, const void *result)
+                                                { onDevEvent(event_type, result); }, nullptr);
+        }
+    }
+
+    if (!diagnostics_)
+    {
+        std::lock_guard<std::mutex> lock(diagnostics_mutex_);
+        diagnostics_ = std::make_unique<DiagnosticsAggregator>(get_name(), serial_);
+    }
+
+    /// the sn does not change once a device is bound, reused messages carry it from here on
+    ai_status_msg_.header.frame_id = serial_;
+    ptz_state_msg_.header.frame_id = serial_;
+    motion_msg_.header.frame_id = serial_;
+    stabilized_msg_.header.frame_id = serial_;
+    leveled_msg_.header.frame_id = serial_;
+
+    if (!cache_.valid)
+    {
+        cache_.formats = dev_->videoFormatInfo();
+        dev_->cameraGetRangeZoomAbsoluteR(cache_.zoom_range);
+        cache_.valid = true;
+    }
+
+    /// the camera does not report its digital window, start the model and the camera from the center
+    if (hasDigitalPtz())
+    {
+        ptz_->reset(0.0, 0.0);
+        sdkCall(dev_->cameraSetPanTiltAbsolute(0.0, 0.0));
+    }
+
+    network_ = dev_->devMode() == Device::DevModeNet;
+    /// masks are drawn into raw frames only, an unmasked stream must not get out
+    if (privacy_ && (network_ || isEncoded(requestedFormat().format)))
+    {
+        RCLCPP_ERROR(get_logger(), "privacy masking needs a raw video format over usb, refusing to stream");
+        return CallbackReturn::FAILURE;
+    }
+    if (privacy_ && privacy_->needsView() && !hasMotorAngle())
+    {
+        RCLCPP_WARN(get_logger(), "this camera reports no gimbal attitude, gimbal privacy regions can not be placed%s",
+                    get_parameter("privacy.blank_without_view").as_bool() ? " and every frame is blacked out" : "");
+    }
+    if (timelapse_ && network_)
+    {
+        RCLCPP_ERROR(get_logger(), "timelapse needs usb capture, the device is in network mode");
+        return CallbackReturn::FAILURE;
+    }
+    if (power_ && network_)
+    {
+        RCLCPP_ERROR(get_logger(), "power management needs usb capture, the device is in network mode");
+        return CallbackReturn::FAILURE;
+    }
+    if (power_)
+    {
+        /// the firmware timer sends the camera to sleep soon after the stream stops, a value <= 0 leaves it awake
+        auto suspend_s = static_cast<int32_t>(get_parameter("power.device_suspend_s").as_int());
+        if (hasSuspendTime())
+        { sdkCall(dev_->cameraSetSuspendTimeU(suspend_s)); }
+        /// the meet series stays up without a stream unless told otherwise
+        if (hasDigitalPtz())
+        { sdkCall(dev_->cameraSetDisableSleepWithoutStreamU(false)); }
+    }
+    if (bandwidth_ && !network_)
+    { joinPlan(); }
+    if (network_ ? !openStream() : !openCapture())
+    {
+        /// a failed configure is not followed by a cleanup, the camera must not keep its share of the bus
+        if (bandwidth_)
+        { BandwidthPlanner::get().leave(device_); }
+        return CallbackReturn::FAILURE;
+    }
+
+    /// diagnostics keep flowing while the node is idle
+    diagnostics_pub_->on_activate();
+    control_timer_->reset();
+    status_timer_->reset();
+    diagnostics_timer_->reset();
+    logTransition("configure", start);
+    return CallbackReturn::SUCCESS;
+}
+
+ObsbotNode::CallbackReturn ObsbotNode::on_activate(const rclcpp_lifecycle::State &)
+{
+    auto start = std::chrono::steady_clock::now();
+    gimbal_state_pub_->on_activate();
+    ptz_state_pub_->on_activate();
+    motion_pub_->on_activate();
+    if (ai_poller_ && hasAiStatus())
+    {
+        /// the first response after activation is always published
+        ai_poller_->reset();
+        ai_status_pub_->on_activate();
+        ai_status_timer_->reset();
+    }
+    image_pub_->on_activate();
+    compressed_pub_->on_activate();
+    if (attitude_ && hasMotorAngle() && !network_)
+    {
+        if (stabilizer_)
+        {
+            stabilizer_->reset();
+            stabilized_pub_->on_activate();
+        }
+        if (leveler_)
+        { leveled_pub_->on_activate(); }
+        attitude_timer_->reset();
+    }
+    if (thermal_)
+    { thermal_timer_->reset(); }
+    if (network_)
+    {
+        if (!startStream())
+        {
+            deactivateEntities();
+            return CallbackReturn::FAILURE;
+        }
+        network_timer_->reset();
+        logTransition("activate", start);
+        return CallbackReturn::SUCCESS;
+    }
+    if (timelapse_)
+    {
+        /// the stream only runs around each shot, the first one is taken as soon as the device is up
+        std::lock_guard<std::mutex> lock(timelapse_mutex_);
+        timelapse_->start(steadyNs());
+        armTimelapse(0);
+        logTransition("activate", start);
+        return CallbackReturn::SUCCESS;
+    }
+
+    bool streaming;
+    {
+        std::lock_guard<std::mutex> lock(capture_mutex_);
+        streaming = capture_.start();
+        if (!streaming)
+        { RCLCPP_ERROR(get_logger(), "start streaming failed: %s", capture_.lastError().c_str()); }
+    }
+    if (!streaming)
+    {
+        deactivateEntities();
+        return CallbackReturn::FAILURE;
+    }
+    runCaptureTimer(true);
+    if (power_)
+    {
+        {
+            std::lock_guard<std::mutex> lock(power_mutex_);
+            power_->reset(steadyNs());
+        }
+        wake_latency_pub_->on_activate();
+        power_timer_->reset();
+    }
+    logTransition("activate", start);
+    return CallbackReturn::SUCCESS;
+}
+
+ObsbotNode::CallbackReturn ObsbotNode::on_deactivate(const rclcpp_lifecycle::State &)
+{
+    auto start = std::chrono::steady_clock::now();
+    deactivateEntities();
+    logTransition("deactivate", start);
+    return CallbackReturn::SUCCESS;
+}
+
+/// everything on_activate may have started, also when it failed halfway
+void ObsbotNode::deactivateEntities()
+{
+    network_timer_->cancel();
+    rtsp_.stop();
+    {
+        std::lock_guard<std::mutex> lock(timelapse_mutex_);
+        if (timelapse_timer_)
+        { timelapse_timer_->cancel(); }
+    }
+    if (power_timer_)
+    { power_timer_->cancel(); }
+    if (thermal_timer_)
+    { thermal_timer_->cancel(); }
+    runCaptureTimer(false);
+    {
+        std::lock_guard<std::mutex> lock(capture_mutex_);
+        capture_.stop();
+    }
+    if (power_)
+    {
+        /// the next activate expects a running camera
+        if (power_asleep_.exchange(false))
+        { sdkCall(dev_->cameraSetDevRunStatusR(Device::DevStatusRun)); }
+        wake_latency_pub_->on_deactivate();
+    }
+    gimbal_state_pub_->on_deactivate();
+    ptz_state_pub_->on_deactivate();
+    motion_pub_->on_deactivate();
+    if (ai_poller_)
+    {
+        ai_status_timer_->cancel();
+        ai_status_pub_->on_deactivate();
+    }
+    image_pub_->on_deactivate();
+    compressed_pub_->on_deactivate();
+    if (attitude_)
+    { attitude_timer_->cancel(); }
+    if (stabilizer_)
+    { stabilized_pub_->on_deactivate(); }
+    if (leveler_)
+    { leveled_pub_->on_deactivate(); }
+}
+
+ObsbotNode::CallbackReturn ObsbotNode::on_cleanup(const rclcpp_lifecycle::State &)
+{
+    auto start = std::chrono::steady_clock::now();
+    control_timer_->cancel();
+    status_timer_->cancel();
+    diagnostics_timer_->cancel();
+    diagnostics_pub_->on_deactivate();
+    closeCapture();
+    if (bandwidth_)
+    { BandwidthPlanner::get().leave(device_); }
+    if (selector_)
+    { selector_->reset(); }
+    if (framer_)
+    { framer_->reset(); }
+    logTransition("cleanup", start);
+    return CallbackReturn::SUCCESS;
+}
+
+ObsbotNode::CallbackReturn ObsbotNode::on_shutdown(const rclcpp_lifecycle::State &)
+{
+    control_timer_->cancel();
+    status_timer_->cancel();
+    diagnostics_timer_->cancel();
+    network_timer_->cancel();
+    if (ai_status_timer_)
+    { ai_status_timer_->cancel(); }
+    closeCapture();
+    if (bandwidth_)
+    { BandwidthPlanner::get().leave(device_); }
+    if (dev_)
+    {
+        dev_->enableDevStatusCallback(false);
+    }
+    return CallbackReturn::SUCCESS;
+}
+
+bool ObsbotNode::waitForDevice(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(dev_mutex_);
+
+    /// the plug event may have gone out before this node registered, eg. for the second camera of a rig
+    if (!dev_)
+    {
+        dev_ = DeviceRegistry::get().find(serial_);
+        if (dev_ && device_ == DeviceRegistry::kNoDevice)
+        {
+            serial_ = dev_->devSn();
+            device_ = DeviceRegistry::get().intern(serial_);
+        }
+    }
+    dev_cv_.wait_for(lock, timeout, [this]()
+    { return dev_ != nullptr; });
+    return dev_ != nullptr;
+}
+
+/// call when detect device connected or disconnected
+void ObsbotNode::onDevChanged(DeviceRegistry::Handle device, bool in_out)
+{
+    auto &registry = DeviceRegistry::get();
+    RCLCPP_INFO(get_logger(), "device sn: %s %s", registry.serial(device).c_str(),
+                in_out ? "connected" : "disconnected");
+
+    std::lock_guard<std::mutex> lock(dev_mutex_);
+    if (!in_out || dev_ || (device_ != DeviceRegistry::kNoDevice && device != device_))
+    { return; }
+
+    dev_ = registry.find(device);
+    if (dev_)
+    {
+        device_ = device;
+        serial_ = registry.serial(device);
+        dev_cv_.notify_all();
+    }
+}
+
+/// call when camera's status update, runs on the sdk thread
+void ObsbotNode::onDevStatusUpdated(const void *data)
+{
+    std::lock_guard<std::mutex> lock(status_mutex_);
+    status_ = *static_cast<const Device::CameraStatus *>(data);
+    status_valid_ = true;
+    if (product_ == ObsbotProdTailAir)
+    { camera_recording_ = status_.tail_air.media_running.record_status == 2; }
+    if (event_buffer_)
+    { event_buffer_->addStatus(now().nanoseconds(), EventBuffer::StatusCamera, &status_, sizeof(status_)); }
+}
+
+void ObsbotNode::onDevEvent(int32_t event_type, const void *result)
+{
+    RCLCPP_INFO(get_logger(), "device event %d", event_type);
+    if (event_type == Device::kEvtInfoNewMediaFile && result)
+    {
+        const auto *file = static_cast<const Device::CameraFileNotify *>(result);
+        if (file->is_image)
+        {
+            media_->add(file->file_path, steadyNs());
+            {
+                std::lock_guard<std::mutex> lock(photo_mutex_);
+                photo_path_ = file->file_path;
+                ++photo_count_;
+            }
+            photo_cv_.notify_all();
+        }
+    }
+    if (thermal_ && (event_type == Device::kEvtErrDevTempHigh || event_type == Device::kEvtErrBatLowCapacity))
+    {
+        std::lock_guard<std::mutex> lock(thermal_mutex_);
+        if (event_type == Device::kEvtErrDevTempHigh)
+        { thermal_->onTempHigh(); }
+        else
+        { thermal_->onBatteryLow(); }
+    }
+    if (!event_buffer_)
+    { return; }
+    event_buffer_->addStatus(now().nanoseconds(), EventBuffer::StatusEvent, &event_type, sizeof(event_type));
+    if (std::find(trigger_events_.begin(), trigger_events_.end(), event_type) != trigger_events_.end())
+    { triggerEvent("event_" + std::to_string(event_type)); }
+}
+
+void ObsbotNode::onGimbalAngle(const geometry_msgs::msg::Vector3::SharedPtr msg)
+{
+    pending_gimbal_.type = GimbalCommand::Angle;
+    pending_gimbal_.roll = msg->x;
+    pending_gimbal_.pitch = msg->y;
+    pending_gimbal_.yaw = msg->z;
+}
+
+void ObsbotNode::onGimbalSpeed(const geometry_msgs::msg::Vector3::SharedPtr msg)
+{
+    pending_gimbal_.type = GimbalCommand::Speed;
+    pending_gimbal_.roll = msg->x;
+    pending_gimbal_.pitch = msg->y;
+    pending_gimbal_.yaw = msg->z;
+}
+
+void ObsbotNode::onZoom(const std_msgs::msg::Float32::SharedPtr msg)
+{
+    zoom_ = msg->data;
+    pending_zoom_ = true;
+}
+
+void ObsbotNode::onPtzVelocity(const geometry_msgs::msg::Vector3::SharedPtr msg)
+{
+    ptz_->setVelocity(msg->x, msg->y, steadyNs());
+}
+
+void ObsbotNode::onPtzPosition(const geometry_msgs::msg::Vector3::SharedPtr msg)
+{
+    ptz_->setTarget(msg->x, msg->y);
+}
+
+/// detections only update the selector and the framer, the control tick decides when the camera hears about it
+void ObsbotNode::onDetections(const msg::DetectionArray::SharedPtr msg)
+{
+    bool select = selector_ && hasTargetSelection();
+    bool roi = framer_ && hasRoi();
+    if (!select && !roi)
+    { return; }
+
+    detection_boxes_.resize(msg->detections.size());
+    for (size_t i = 0; i < msg->detections.size(); ++i)
+    {
+        const auto &detection = msg->detections[i];
+        auto &box = detection_boxes_[i];
+        box.x_min = detection.x_min;
+        box.y_min = detection.y_min;
+        box.x_max = detection.x_max;
+        box.y_max = detection.y_max;
+        box.score = detection.score;
+        box.target_type = detection.target_type;
+        box.track_id = detection.track_id;
+    }
+    int64_t now_ns = steadyNs();
+    if (select)
+    { selector_->update(detection_boxes_.data(), detection_boxes_.size(), now_ns); }
+    if (roi)
+    { framer_->update(detection_boxes_.data(), detection_boxes_.size(), now_ns); }
+}
+
+/// control loop, sends only the newest command per tick so a burst of messages never builds a backlog
+void ObsbotNode::controlTick()
+{
+    auto tick = std::chrono::steady_clock::now();
+    if (last_control_tick_.time_since_epoch().count() != 0)
+    {
+        auto interval = tick - last_control_tick_;
+        if (interval > 2 * control_period_)
+        {
+            RCLCPP_WARN_THROTTLE(get_logger(), *get_clock(), 5000, "control loop late: %.1f ms (period %.1f ms)",
+                                 std::chrono::duration<double, std::milli>(interval).count(),
+                                 std::chrono::duration<double, std::milli>(control_period_).count());
+        }
+    }
+    last_control_tick_ = tick;
+
+    if (motion_)
+    { motionControl(steadyNs()); }
+
+    if (pending_gimbal_.type == GimbalCommand::Angle && hasMotorAngle())
+    {
+        sdkCall(dev_->aiSetGimbalMotorAngleR(static_cast<float>(pending_gimbal_.pitch),
+                                             static_cast<float>(pending_gimbal_.yaw),
+                                             static_cast<float>(pending_gimbal_.roll)));
+    }
+    else if (pending_gimbal_.type == GimbalCommand::Speed && hasGimbal())
+    {
+        sdkCall(dev_->aiSetGimbalSpeedCtrlR(pending_gimbal_.pitch, pending_gimbal_.yaw, pending_gimbal_.roll));
+    }
+    pending_gimbal_.type = GimbalCommand::None;
+
+    if (pending_zoom_)
+    {
+        if (sdkCall(dev_->cameraSetZoomAbsoluteR(zoom_)) == RM_RET_OK)
+        { applied_zoom_ = zoom_; }
+        pending_zoom_ = false;
+    }
+
+    TargetSelector::Command select;
+    if (selector_ && hasTargetSelection() && selector_->poll(steadyNs(), select))
+    {
+        const auto &box = select.box;
+        switch (select.mode)
+        {
+        case TargetSelector::Mode::Box:
+            sdkCall(dev_->aiSetSelectTargetByBox(box.x_min, box.y_min, box.x_max, box.y_max));
+            break;
+        case TargetSelector::Mode::Position:
+            sdkCall(dev_->aiSetSelectTargetByPos(0.5f * (box.x_min + box.x_max), 0.5f * (box.y_min + box.y_max),
+                                                 select.target_type));
+            break;
+        case TargetSelector::Mode::Central:
+            sdkCall(dev_->aiSetSelectCentralTarget(select.target_type));
+            break;
+        }
+        RCLCPP_DEBUG(get_logger(), "selected target %d at %.2f,%.2f (%lu commands, %lu updates absorbed)",
+                     box.track_id, 0.5f * (box.x_min + box.x_max), 0.5f * (box.y_min + box.y_max),
+                     static_cast<unsigned long>(selector_->stats().commands),
+                     static_cast<unsigned long>(selector_->stats().suppressed));
+    }
+
+    AutoFramer::Window window;
+    if (framer_ && hasRoi() && framer_->poll(steadyNs(), window))
+    {
+        sdkCall(dev_->cameraSetRoiTarget(roi_type_, roi_view_, window.x_min, window.y_min, window.x_max,
+                                         window.y_max));
+        view_settle_ns_ = steadyNs() + settle_ns_;
+    }
+
+    /// the model moves every tick and is published right away, the camera gets absolute positions at its own rate
+    if (hasDigitalPtz())
+    {
+        int64_t now_ns = steadyNs();
+        bool was_moving = ptz_->state().moving;
+        ptz_->step(now_ns);
+        double pan, tilt;
+        if (ptz_->poll(now_ns, pan, tilt))
+        { sdkCall(dev_->cameraSetPanTiltAbsolute(pan, tilt)); }
+
+        const auto &state = ptz_->state();
+        if ((state.moving || was_moving) && ptz_state_pub_->is_activated())
+        {
+            ptz_state_msg_.header.stamp = now();
+            ptz_state_msg_.vector.x = state.pan;
+            ptz_state_msg_.vector.y = state.tilt;
+            ptz_state_msg_.vector.z = 0.0;
+            ptz_state_pub_->publish(ptz_state_msg_);
+        }
+        /// the model lives in the control group, its counters are handed over from here
+        if (now_ns - ptz_diagnostics_ns_ >= 1000000000)
+        {
+            ptz_diagnostics_ns_ = now_ns;
+            std::lock_guard<std::mutex> lock(diagnostics_mutex_);
+            diagnostics_->updatePtz(ptz_->stats());
+        }
+    }
+}
+
+void ObsbotNode::statusTick()
+{
+    auto tick = std::chrono::steady_clock::now();
+    double elapsed = last_status_tick_.time_since_epoch().count() != 0
+                     ? std::chrono::duration<double>(tick - last_status_tick_).count() : 0.0;
+    last_status_tick_ = tick;
+
+    Device::CameraStatus status;
+    bool status_valid;
+    {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        status = status_;
+        status_valid = status_valid_;
+    }
+
+    /// another camera joined or left the bandwidth plan, or was plugged
+    if (plan_changed_.exchange(false))
+    {
+        logPlan();
+        reopenCapture();
+    }
+
+    DiagnosticsAggregator::StreamStats stream;
+    stream.captured = frames_captured_.load();
+    stream.dropped = frames_dropped_.load();
+    if (network_)
+    {
+        /// units lost on the network count as dropped frames
+        stream.dropped += rtsp_.stats().dropped_units;
+    }
+    DiagnosticsAggregator::SdkStats sdk;
+    sdk.calls = sdk_calls_.load();
+    sdk.errors = sdk_errors_.load();
+    if (elapsed > 0.0)
+    {
+        stream.fps = static_cast<double>(stream.captured - last_frames_captured_) / elapsed;
+        sdk.error_rate = static_cast<double>(sdk.errors - last_sdk_errors_) / elapsed;
+    }
+    last_frames_captured_ = stream.captured;
+    last_sdk_errors_ = sdk.errors;
+
+    bool ai_polling = ai_poller_ && hasAiStatus() && ai_status_pub_->is_activated();
+    DiagnosticsAggregator::AiPollStats ai;
+    if (ai_polling)
+    {
+        auto poll = ai_poller_->stats();
+        ai.latency_ms = poll.latency_ms;
+        ai.max_latency_ms = poll.max_latency_ms;
+        ai.timeouts = poll.timeouts;
+        ai.errors = poll.errors;
+        if (elapsed > 0.0)
+        { ai.rate_hz = static_cast<double>(poll.responses - last_ai_responses_) / elapsed; }
+        last_ai_responses_ = poll.responses;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(diagnostics_mutex_);
+        if (status_valid)
+        { diagnostics_->updateStatus(product_, status); }
+        diagnostics_->updateStream(stream);
+        diagnostics_->updateSdk(sdk);
+        if (ai_polling)
+        { diagnostics_->updateAiPoll(ai); }
+    }
+
+    if (!hasMotorAngle() || !gimbal_state_pub_->is_activated())
+    { return; }
+
+    Device::AiGimbalStateInfo info{};
+    if (sdkCall(dev_->aiGetGimbalStateR(&info)) != RM_RET_OK)
+    { return; }
+
+    geometry_msgs::msg::Vector3Stamped msg;
+    msg.header.stamp = now();
+    msg.header.frame_id = serial_;
+    msg.vector.x = info.roll_euler;
+    msg.vector.y = info.pitch_euler;
+    msg.vector.z = info.yaw_euler;
+    gimbal_state_pub_->publish(msg);
+}
+
+/// publish only what changed since the last message, with a full snapshot every diagnostics.full_every messages
+void ObsbotNode::diagnosticsTick()
+{
+    auto full_every = std::max<int64_t>(1, diagnostics_full_every_.load());
+    bool full = diagnostics_tick_count_++ % static_cast<uint32_t>(full_every) == 0;
+    {
+        std::lock_guard<std::mutex> lock(diagnostics_mutex_);
+        if (!diagnostics_->collect(diagnostics_msg_, full))
+        { return; }
+    }
+    diagnostics_msg_.header.stamp = now();
+    diagnostics_pub_->publish(diagnostics_msg_);
+}
+
+/// non blocking, the answer lands in the attitude track on the sdk thread; the track outlives late answers
+void ObsbotNode::attitudeTick()
+{
+    if (!dev_)
+    { return; }
+    dev_->aiGetGimbalStateR(nullptr, [track = attitude_](void *, const void *data)
+    {
+        if (!data)
+        { return; }
+        const auto *info = static_cast<const Device::AiGimbalStateInfo *>(data);
+        AttitudeTrack::Sample sample;
+        sample.steady_ns = steadyNs();
+        sample.roll = info->roll_euler;
+        sample.pitch = info->pitch_euler;
+        sample.yaw = info->yaw_euler;
+        track->add(sample);
+    }, nullptr, Device::NonBlock);
+}
+
+/// requests overlap, the poll period sets the sample rate even when one round trip takes longer
+void ObsbotNode::aiStatusTick()
+{
+    if (dev_)
+    { ai_poller_->poll(*dev_, steadyNs()); }
+}
+
+void ObsbotNode::onAiStatus(const Device::AiStatus &status, int64_t latency_ns)
+{
+    ai_main_mode_ = status.main_mode;
+    if (!ai_status_pub_->is_activated())
+    { return; }
+
+    auto &msg = ai_status_msg_;
+    msg.header.stamp = now();
+    msg.gesture_target = status.gesture_target;
+    msg.gesture_zoom = status.gesture_zoom;
+    msg.gesture_dynamic_zoom = status.gesture_dynamic_zoom;
+    msg.gesture_record = status.gesture_record;
+    msg.gesture_mirror = status.gesture_mirror;
+    msg.gesture_zoom_factor = status.gesture_zoom_factor;
+    msg.yaw_reverse = status.yaw_reverse;
+    msg.v_track_landscape = status.v_track_landscape;
+    msg.v_track_portrait = status.v_track_portrait;
+    msg.main_mode = status.main_mode;
+    msg.hand_track_type = status.hand_track_type;
+    msg.ai_zone_track = status.ai_zone_track;
+    msg.speed_mode = status.speed_mode;
+    msg.latency_ms = static_cast<double>(latency_ns) * 1e-6;
+    ai_status_pub_->publish(msg);
+}
+
+/// download file, only for meet, meet4k and tiny2
+void ObsbotNode::onDownloadImage(const std_srvs::srv::Trigger::Request::SharedPtr,
+                                 std_srvs::srv::Trigger::Response::SharedPtr response)
+{
+    if (!dev_ || (product_ != ObsbotProdMeet && product_ != ObsbotProdMeet4k && product_ != ObsbotProdTiny2))
+    {
+        response->success = false;
+        response->message = "file download is not supported by this product";
+        return;
+    }
+
+    auto dir = get_parameter("download.directory").as_string();
+    dev_->setLocalResourcePath(dir, dir, 0);
+    dev_->setFileDownloadCallback([this](void *, uint32_t file_type, int32_t result)
+                                  {
+                                      RCLCPP_INFO(get_logger(), "file download finished, file_type: %u result: %d",
+                                                  file_type, result);
+                                  }, nullptr);
+    response->success = dev_->startFileDownloadAsync(Device::DownloadImage0);
+    response->message = response->success ? dir : "start file download failed";
+}
+
+/// the newest frame is answered from housekeeping, a wait for the next frame or a device photo runs in the media group
+void ObsbotNode::onSnapshot(const std::shared_ptr<rmw_request_id_t> header,
+                            const srv::Snapshot::Request::SharedPtr request)
+{
+    /// a sleeping camera has only an old frame, waiting for the next one wakes it
+    bool next = request->next;
+    int64_t wake_ns = 0;
+    if (power_)
+    {
+        std::lock_guard<std::mutex> lock(power_mutex_);
+        if (power_->state() != PowerManager::State::Awake)
+        {
+            next = true;
+            wake_ns = power_->latencyEstimate();
+        }
+    }
+
+    if (!next && !request->device_photo)
+    {
+        srv::Snapshot::Response response;
+        takeSnapshot(*request, false, 0, response);
+        snapshot_srv_->send_response(*header, response);
+        return;
+    }
+    queueMediaJob([this, header, request, next, wake_ns]()
+    {
+        srv::Snapshot::Response response;
+        takeSnapshot(*request, next, wake_ns, response);
+        if (response.success && request->device_photo)
+        { response.success = takeDevicePhoto(response); }
+        snapshot_srv_->send_response(*header, response);
+    });
+}
+
+/// the newest frame of the ring or the first one after the request, the stream keeps running as it is
+void ObsbotNode::takeSnapshot(const srv::Snapshot::Request &request, bool next, int64_t wake_ns,
+                              srv::Snapshot::Response &response)
+{
+    bool jpeg = request.format.empty() || request.format == "jpeg";
+    if (!jpeg && request.format != "raw")
+    {
+        response.success = false;
+        response.message = "format must be jpeg or raw";
+        return;
+    }
+
+    FrameRef frame;
+    if (next)
+    {
+        auto timeout = std::chrono::milliseconds(std::max<int64_t>(1, get_parameter("snapshot.timeout_ms").as_int()) +
+                                                 wake_ns / 1000000);
+        frame = snapshot_->next(steadyNs(), timeout);
+    }
+    else
+    { frame = snapshot_->latest(); }
+    if (!frame)
+    {
+        response.success = false;
+        response.message = "no frame, the stream is not running";
+        return;
+    }
+
+    if (jpeg)
+    {
+        int32_t quality = request.quality > 0 ? request.quality
+                                              : static_cast<int32_t>(get_parameter("snapshot.jpeg_quality").as_int());
+        bool encoded;
+        {
+            std::lock_guard<std::mutex> lock(jpeg_mutex_);
+            encoded = jpeg_.encode(*frame, quality, response.compressed.data);
+        }
+        if (!encoded)
+        {
+            response.success = false;
+            response.message = std::string("can not encode ") + encodingName(frame->format) + " as jpeg" +
+                               (JpegEncoder::supported() || isEncoded(frame->format) ? "" : ", built without libjpeg");
+            return;
+        }
+        response.compressed.header.stamp = rclcpp::Time(frame->stamp_ns);
+        response.compressed.header.frame_id = serial_;
+        response.compressed.format = "jpeg";
+    }
+    else
+    {
+        if (isEncoded(frame->format))
+        {
+            response.success = false;
+            response.message = std::string("the stream is ") + encodingName(frame->format) +
+                               ", raw needs a raw video format";
+            return;
+        }
+        auto &image = response.image;
+        image.header.stamp = rclcpp::Time(frame->stamp_ns);
+        image.header.frame_id = serial_;
+        image.width = static_cast<uint32_t>(frame->width);
+        image.height = static_cast<uint32_t>(frame->height);
+        image.encoding = encodingName(frame->format);
+        image.step = static_cast<uint32_t>(frame->stride);
+        image.data.assign(frame->data, frame->data + frame->size);
+    }
+    response.success = true;
+}
+
+bool ObsbotNode::takeDevicePhoto(srv::Snapshot::Response &response)
+{
+    if (!dev_ || product_ != ObsbotProdTailAir)
+    {
+        response.message = "device photos are only supported by the tail air";
+        return false;
+    }
+
+    uint64_t seen;
+    {
+        std::lock_guard<std::mutex> lock(photo_mutex_);
+        seen = photo_count_;
+    }
+    if (sdkCall(dev_->cameraSetTakePhotosR(1, 0)) != RM_RET_OK)
+    {
+        response.message = "take photo failed";
+        return false;
+    }
+    {
+        auto timeout = std::chrono::milliseconds(get_parameter("snapshot.device_timeout_ms").as_int());
+        std::unique_lock<std::mutex> lock(photo_mutex_);
+        if (!photo_cv_.wait_for(lock, timeout, [this, seen] { return photo_count_ != seen; }))
+        {
+            response.message = "the device reported no new photo";
+            return false;
+        }
+        response.device_path = photo_path_;
+    }
+
+    /// the card is only reachable when it is mounted on this host, eg. over mtp or as mass storage
+    auto root = get_parameter("media.root").as_string();
+    if (root.empty())
+    { return true; }
+    auto *file = std::fopen((root + "/" + response.device_path).c_str(), "rb");
+    if (!file)
+    {
+        response.message = "can not open " + root + "/" + response.device_path;
+        return false;
+    }
+    bool ok = std::fseek(file, 0, SEEK_END) == 0;
+    long size = ok ? std::ftell(file) : -1;
+    ok = size >= 0 && std::fseek(file, 0, SEEK_SET) == 0;
+    if (ok)
+    {
+        auto &data = response.device_data;
+        data.resize(static_cast<size_t>(size));
+        ok = std::fread(data.data(), 1, data.size(), file) == data.size();
+    }
+    std::fclose(file);
+    if (!ok)
+    { response.message = "reading " + root + "/" + response.device_path + " failed"; }
+    return ok;
+}
+
+void ObsbotNode::onBurst(const std::shared_ptr<rmw_request_id_t> header, const srv::Burst::Request::SharedPtr request)
+{
+    queueMediaJob([this, header, request]()
+    {
+        srv::Burst::Response response;
+        takeBurst(*request, response);
+        burst_srv_->send_response(*header, response);
+    });
+}
+
+/// retrieval overlaps the burst: every photo is copied as soon as the device reports it
+void ObsbotNode::takeBurst(const srv::Burst::Request &request, srv::Burst::Response &response)
+{
+    if (!dev_ || product_ != ObsbotProdTailAir)
+    {
+        response.success = false;
+        response.message = "burst mode is only supported by the tail air";
+        return;
+    }
+    if (request.count == 0 || request.count > 0xFFFE)
+    {
+        response.success = false;
+        response.message = "count must be 1..65534";
+        return;
+    }
+
+    char stamp[32];
+    std::time_t seconds = std::time(nullptr);
+    std::tm parts{};
+    localtime_r(&seconds, &parts);
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &parts);
+    std::string name = (serial_.empty() ? std::string(get_name()) : serial_) + "_burst_" + stamp;
+
+    /// the batch is open before the trigger, the first photo can be reported before the call returns
+    int64_t trigger_ns = steadyNs();
+    media_->begin(request.count, name, trigger_ns);
+    if (sdkCall(dev_->cameraSetTakePhotosR(2, request.count)) != RM_RET_OK)
+    {
+        media_->cancel();
+        response.success = false;
+        response.message = "start burst failed";
+        return;
+    }
+
+    MediaFetcher::Batch batch;
+    bool complete = media_->wait(std::chrono::milliseconds(get_parameter("burst.timeout_ms").as_int()), batch);
+    for (const auto &file : batch.files)
+    {
+        response.device_paths.push_back(file.device_path);
+        if (file.ok && !file.local_path.empty())
+        { response.files.push_back(file.local_path); }
+    }
+    response.first_ms = batch.done ? (batch.first_ns - trigger_ns) / 1e6 : 0.0;
+    response.last_ms = batch.done ? (batch.last_ns - trigger_ns) / 1e6 : 0.0;
+    response.success = complete && batch.failed == 0;
+    if (!complete)
+    { response.message = "timed out with " + std::to_string(batch.done) + " of " + std::to_string(batch.expected); }
+    else if (batch.failed)
+    { response.message = std::to_string(batch.failed) + " photos could not be copied"; }
+    else
+    { response.message = batch.directory.empty() ? "listed only, media.root is not set" : batch.directory; }
+    RCLCPP_INFO(get_logger(), "burst of %u: %u on the host, first after %.0f ms, last after %.0f ms", request.count,
+                batch.done - batch.failed, response.first_ms, response.last_ms);
+}
+
+void ObsbotNode::queueMediaJob(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(media_jobs_mutex_);
+        media_jobs_.push_back(std::move(job));
+    }
+    media_timer_->reset();
+}
+
+void ObsbotNode::mediaTick()
+{
+    /// cancelled first, a job queued meanwhile resets it again
+    media_timer_->cancel();
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::lock_guard<std::mutex> lock(media_jobs_mutex_);
+            if (media_jobs_.empty())
+            { return; }
+            job = std::move(media_jobs_.front());
+            media_jobs_.pop_front();
+        }
+        job();
+    }
+}
+
+void ObsbotNode::onEventDump(const std_srvs::srv::Trigger::Request::SharedPtr,
+                             std_srvs::srv::Trigger::Response::SharedPtr response)
+{
+    auto dir = triggerEvent("service");
+    response->success = !dir.empty();
+    response->message = response->success ? dir : "event buffer is empty";
+}
+
+std::string ObsbotNode::triggerEvent(const std::string &reason)
+{
+    auto dir = event_buffer_->trigger(reason, now().nanoseconds());
+    if (dir.empty())
+    {
+        RCLCPP_WARN(get_logger(), "event %s: buffer is empty, nothing written", reason.c_str());
+        return dir;
+    }
+    RCLCPP_INFO(get_logger(), "event %s: writing %.1f s of history to %s", reason.c_str(),
+                event_buffer_->stats().buffered_s, dir.c_str());
+    return dir;
+}
+
+/// parameter batches are applied in the housekeeping group, one sdk call per changed value
+rcl_interfaces::msg::SetParametersResult ObsbotNode::onSetParameters(const std::vector<rclcpp::Parameter> &params)
+{
+    rcl_interfaces::msg::SetParametersResult result;
+    result.successful = true;
+    for (const auto &param : params)
+    {
+        if (!dev_ || param.get_name().rfind("image.", 0) != 0 ||
+            param.get_type() != rclcpp::ParameterType::PARAMETER_INTEGER)
+        { continue; }
+
+        auto value = static_cast<int32_t>(param.as_int());
+        if (value < 0)
+        { continue; }
+
+        int32_t ret = RM_RET_OK;
+        const auto &name = param.get_name();
+        if (name == "image.brightness")
+        { ret = sdkCall(dev_->cameraSetImageBrightnessR(value)); }
+        else if (name == "image.contrast")
+        { ret = sdkCall(dev_->cameraSetImageContrastR(value)); }
+        else if (name == "image.saturation")
+        { ret = sdkCall(dev_->cameraSetImageSaturationR(value)); }
+        else if (name == "image.sharpness")
+        { ret = sdkCall(dev_->cameraSetImageSharpR(value)); }
+        else if (name == "image.hue")
+        { ret = sdkCall(dev_->cameraSetImageHueR(value)); }
+
+        if (ret != RM_RET_OK)
+        {
+            result.successful = false;
+            result.reason += "failed to set " + name + "; ";
+        }
+    }
+
+    /// the copies follow a batch only once it is taken
+    if (result.successful)
+    {
+        for (const auto &param : params)
+        { cacheParameter(param); }
+    }
+    return result;
+}
+
+void ObsbotNode::cacheParameter(const rclcpp::Parameter &param)
+{
+    const auto &name = param.get_name();
+    if (name == "diagnostics.full_every")
+    { diagnostics_full_every_ = param.as_int(); }
+    else if (name == "motion.settle_ms")
+    { settle_ns_ = std::max<int64_t>(0, param.as_int()) * 1000000; }
+    else if (name == "motion.deadband")
+    { motion_deadband_ = param.as_double(); }
+    else if (name == "motion.gain")
+    { motion_gain_ = param.as_double(); }
+    else if (name == "motion.gimbal_speed")
+    { motion_gimbal_speed_ = param.as_double(); }
+    else if (name == "power.sleep_mode")
+    { power_privacy_ = param.as_string() == "privacy"; }
+}
+
+void ObsbotNode::captureTick()
+{
+    std::lock_guard<std::mutex> lock(capture_mutex_);
+    if (!capture_.isStreaming())
+    { return; }
+
+    auto frame = pool_->acquire();
+    if (!frame)
+    {
+        /// every buffer is still held downstream, leave the frame to the driver and count it
+        ++frames_dropped_;
+        return;
+    }
+
+    uint64_t dropped = capture_.dropped();
+    if (!capture_.grab(*frame, 100))
+    {
+        frames_dropped_ += capture_.dropped() - dropped;
+        return;
+    }
+
+    frame->stamp_ns = now().nanoseconds();
+    ++frames_captured_;
+    if (power_)
+    {
+        std::lock_guard<std::mutex> lock(power_mutex_);
+        power_->onFrame(frame->steady_ns);
+    }
+    if (timelapse_)
+    {
+        /// frames before the planned time only measure how long the wake took
+        std::lock_guard<std::mutex> lock(timelapse_mutex_);
+        if (!timelapse_->onFrame(frame->steady_ns))
+        { return; }
+    }
+    if (privacy_)
+    { maskFrame(*frame); }
+    /// before the overlay: its stamp changes every frame and would read as motion
+    if (motionFed())
+    { trackMotion(*frame); }
+    if (overlay_)
+    { drawOverlay(*frame); }
+    publishFrame(*frame);
+    for (const auto &sink : sinks_)
+    { sink->onFrame(frame); }
+    if (stabilizer_ && stabilized_pub_->is_activated())
+    { publishStabilized(*frame); }
+    if (leveler_ && leveled_pub_->is_activated() && leveled_pub_->get_subscription_count() > 0)
+    { publishLeveled(*frame); }
+    if (frame->steady_ns - stage_diagnostics_ns_ >= 1000000000)
+    {
+        stage_diagnostics_ns_ = frame->steady_ns;
+        updateStageDiagnostics();
+    }
+    if (timelapse_)
+    {
+        /// the shot is out, the stream stops here and housekeeping puts the device back to sleep
+        runCaptureTimer(false);
+        capture_.stop();
+        std::lock_guard<std::mutex> lock(timelapse_mutex_);
+        armTimelapse(0);
+    }
+}
+
+void ObsbotNode::timelapseTick()
+{
+    using Phase = TimelapseScheduler::Phase;
+    int64_t now_ns = steadyNs();
+    Phase phase;
+    {
+        std::lock_guard<std::mutex> lock(timelapse_mutex_);
+        timelapse_timer_->cancel();
+        phase = timelapse_->phase();
+        if (phase == Phase::Sleeping && now_ns < timelapse_->wakeAt())
+        {
+            armTimelapse(timelapse_->wakeAt() - now_ns);
+            return;
+        }
+        if (phase == Phase::Waking && now_ns < timelapse_->deadline())
+        {
+            armTimelapse(timelapse_->deadline() - now_ns);
+            return;
+        }
+    }
+
+    if (phase == Phase::Sleeping)
+    {
+        /// the latency is measured from here, the wake call itself is part of it
+        sdkCall(dev_->cameraSetDevRunStatusR(Device::DevStatusRun));
+        {
+            std::lock_guard<std::mutex> lock(capture_mutex_);
+            if (!capture_.start())
+            { RCLCPP_WARN(get_logger(), "timelapse: start streaming failed: %s", capture_.lastError().c_str()); }
+        }
+        std::lock_guard<std::mutex> lock(timelapse_mutex_);
+        timelapse_->onWake(now_ns);
+        armTimelapse(timelapse_->deadline() - steadyNs());
+        runCaptureTimer(true);
+        return;
+    }
+
+    if (phase == Phase::Waking)
+    {
+        runCaptureTimer(false);
+        std::lock_guard<std::mutex> lock(capture_mutex_);
+        capture_.stop();
+    }
+    sdkCall(dev_->cameraSetDevRunStatusR(Device::DevStatusSleep));
+
+    std::lock_guard<std::mutex> lock(timelapse_mutex_);
+    const auto &stats = timelapse_->stats();
+    if (timelapse_->phase() == Phase::Waking)
+    { RCLCPP_WARN(get_logger(), "timelapse: no frame within the timeout, shot missed"); }
+    else
+    {
+        RCLCPP_INFO(get_logger(), "timelapse shot %lu: wake to first frame %.0f ms (lead %.0f ms), %.0f ms late, "
+                    "streamed %.0f ms", static_cast<unsigned long>(stats.shots), stats.latency_ms, stats.estimate_ms,
+                    stats.late_ms, stats.streaming_ms);
+    }
+    timelapse_->onSleep(steadyNs());
+    armTimelapse(timelapse_->wakeAt() - steadyNs());
+}
+
+/// demand is polled, a wake costs one check period on top of the device's own latency
+void ObsbotNode::powerTick()
+{
+    bool demand = image_pub_->get_subscription_count() > 0 || compressed_pub_->get_subscription_count() > 0 ||
+                  (stabilized_pub_ && stabilized_pub_->get_subscription_count() > 0) ||
+                  (leveled_pub_ && leveled_pub_->get_subscription_count() > 0) || motionFed();
+    for (const auto &sink : sinks_)
+    { demand = demand || sink->wantsFrames(); }
+
+    PowerManager::Action action;
+    int64_t estimate_ns;
+    {
+        std::lock_guard<std::mutex> lock(power_mutex_);
+        action = power_->update(demand, steadyNs());
+        estimate_ns = power_->latencyEstimate();
+        const auto &stats = power_->stats();
+        if (stats.samples != power_samples_)
+        {
+            power_samples_ = stats.samples;
+            std_msgs::msg::Float32 latency;
+            latency.data = static_cast<float>(estimate_ns / 1e6);
+            wake_latency_pub_->publish(latency);
+            RCLCPP_INFO(get_logger(), "power: awake, wake to first frame %.0f ms (max %.0f ms, %lu wakes)",
+                        stats.latency_ms, stats.max_latency_ms, static_cast<unsigned long>(stats.wakes));
+        }
+    }
+
+    if (action == PowerManager::Action::Sleep)
+    {
+        runCaptureTimer(false);
+        {
+            std::lock_guard<std::mutex> lock(capture_mutex_);
+            capture_.stop();
+        }
+        power_asleep_ = true;
+        bool privacy = power_privacy_;
+        sdkCall(dev_->cameraSetDevRunStatusR(privacy ? Device::DevStatusPrivacy : Device::DevStatusSleep));
+        RCLCPP_INFO(get_logger(), "power: nothing wants frames, camera %s", privacy ? "in privacy mode" : "asleep");
+    }
+    else if (action == PowerManager::Action::Wake)
+    {
+        /// the latency is measured from here, the wake call itself is part of it; a retry starts over
+        sdkCall(dev_->cameraSetDevRunStatusR(Device::DevStatusRun));
+        {
+            std::lock_guard<std::mutex> lock(capture_mutex_);
+            capture_.stop();
+            if (!capture_.start())
+            { RCLCPP_WARN(get_logger(), "power: start streaming failed: %s", capture_.lastError().c_str()); }
+        }
+        power_asleep_ = false;
+        runCaptureTimer(true);
+        RCLCPP_INFO(get_logger(), "power: waking the camera, first frame expected in %.0f ms", estimate_ns / 1e6);
+    }
+}
+
+/// every decision is logged with its cause, and again with its effect once the governor has measured it
+void ObsbotNode::thermalTick()
+{
+    Device::CameraStatus status;
+    {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        if (!status_valid_)
+        { return; }
+        status = status_;
+    }
+
+    int64_t now_ns = steadyNs();
+    uint64_t frames = frames_captured_.load();
+    ThermalGovernor::Reading reading;
+    reading.lens_temp = status.tail_air.misc_status.lens_temp_status;
+    reading.cpu_temp = status.tail_air.misc_status.cpu_temp_status;
+    reading.capacity = status.tail_air.online_status.bat_online ? status.tail_air.battery.capacity : -1;
+    reading.charging = status.tail_air.battery.charging || status.tail_air.misc_status.adapter_plugin;
+    if (thermal_tick_ns_ > 0 && now_ns > thermal_tick_ns_)
+    { reading.fps = static_cast<double>(frames - thermal_frames_) * 1e9 / (now_ns - thermal_tick_ns_); }
+    thermal_frames_ = frames;
+    thermal_tick_ns_ = now_ns;
+
+    bool changed, measured;
+    ThermalGovernor::Rung rung;
+    ThermalGovernor::Decision decision;
+    ThermalGovernor::Effect effect;
+    size_t count;
+    {
+        std::lock_guard<std::mutex> lock(thermal_mutex_);
+        changed = thermal_->update(reading, now_ns);
+        measured = thermal_->effect(now_ns, effect);
+        rung = thermal_->current();
+        decision = thermal_->decision();
+        count = thermal_->rungCount();
+    }
+
+    if (measured)
+    {
+        const auto &before = effect.decision.reading;
+        RCLCPP_INFO(get_logger(), "thermal: rung %zu -> %zu after %.0f s: lens %s -> %s, cpu %s -> %s, "
+                    "battery %d -> %d %% (drain %.1f -> %.1f %%/h), %.1f -> %.1f fps", effect.decision.from,
+                    effect.decision.to, effect.after_ns / 1e9, ThermalGovernor::tempName(before.lens_temp),
+                    ThermalGovernor::tempName(effect.reading.lens_temp), ThermalGovernor::tempName(before.cpu_temp),
+                    ThermalGovernor::tempName(effect.reading.cpu_temp), before.capacity, effect.reading.capacity,
+                    effect.decision.drain_pct_h, effect.drain_pct_h, before.fps, effect.reading.fps);
+    }
+    if (!changed)
+    { return; }
+
+    RCLCPP_WARN(get_logger(), "thermal: rung %zu -> %zu of %zu (%s): %s; lens %s, cpu %s, battery %d %%%s, %.1f fps",
+                decision.from, decision.to, count, ThermalGovernor::format(rung).c_str(), decision.reason.c_str(),
+                ThermalGovernor::tempName(reading.lens_temp), ThermalGovernor::tempName(reading.cpu_temp),
+                reading.capacity, reading.charging ? " charging" : "", reading.fps);
+    applyThermal(rung, decision.to == 0);
+}
+
+void ObsbotNode::applyThermal(const ThermalGovernor::Rung &rung, bool top)
+{
+    auto bitrate = top ? thermal_bitrate_ : rung.bitrate;
+    if (bitrate != applied_bitrate_)
+    {
+        sdkCall(dev_->cameraSetMainVideoBitrateLevelR(bitrate));
+        applied_bitrate_ = bitrate;
+    }
+    bool switch_ai;
+    {
+        std::lock_guard<std::mutex> lock(thermal_mutex_);
+        switch_ai = thermal_->switchAi(rung.ai, ai_main_mode_.load() != Device::AiTrackNormal);
+    }
+    if (switch_ai)
+    { sdkCall(dev_->aiSetEnabledR(rung.ai)); }
+    reopenCapture();
+}
+
+void ObsbotNode::reopenCapture()
+{
+    /// the stream adapter owns the rtsp encoding
+    if (network_)
+    { return; }
+
+    auto format = captureFormat();
+    bool streaming;
+    {
+        std::lock_guard<std::mutex> lock(capture_mutex_);
+        if (!capture_.isOpen() || (format.width == capture_format_.width &&
+                                   format.height == capture_format_.height && format.fps == capture_format_.fps))
+        { return; }
+        streaming = capture_.isStreaming();
+    }
+    runCaptureTimer(false);
+    {
+        std::lock_guard<std::mutex> lock(capture_mutex_);
+        capture_.stop();
+    }
+    if (!openCapture())
+    { return; }
+    /// asleep or between timelapse shots, the next start streams the new format
+    if (!streaming)
+    { return; }
+    {
+        std::lock_guard<std::mutex> lock(capture_mutex_);
+        if (!capture_.start())
+        { RCLCPP_WARN(get_logger(), "restart streaming failed: %s", capture_.lastError().c_str()); }
+    }
+    runCaptureTimer(true);
+}
+
+void ObsbotNode::joinPlan()
+{
+    BandwidthPlanner::Options options;
+    options.share = get_parameter("bandwidth.share").as_double();
+    options.mjpeg_bpp = get_parameter("bandwidth.mjpeg_bpp").as_double();
+    options.h26x_bpp = get_parameter("bandwidth.h26x_bpp").as_double();
+    options.min_fps = static_cast<int32_t>(get_parameter("bandwidth.min_fps").as_int());
+    for (const auto &text : get_parameter("bandwidth.bus_limits").as_string_array())
+    {
+        int32_t bus;
+        double mbps;
+        if (BandwidthPlanner::parseLimit(text, bus, mbps))
+        { options.bus_limits[bus] = mbps; }
+        else
+        { RCLCPP_ERROR(get_logger(), "ignoring malformed bus limit \"%s\"", text.c_str()); }
+    }
+
+    BandwidthPlanner::Camera camera;
+    camera.video_path = dev_->videoDevPath();
+    camera.priority = get_parameter("bandwidth.priority").as_double();
+    camera.requested = requestedFormat();
+    camera.formats = cache_.formats;
+    auto &planner = BandwidthPlanner::get();
+    planner.setOptions(options);
+    planner.join(device_, camera, [this]()
+                 { plan_changed_ = true; });
+    logPlan();
+}
+
+void ObsbotNode::logPlan()
+{
+    BandwidthPlanner::Assignment plan;
+    if (!BandwidthPlanner::get().assignment(device_, plan))
+    { return; }
+    const auto &format = plan.mode.format;
+    if (plan.port.bus < 0)
+    {
+        RCLCPP_WARN(get_logger(), "bandwidth plan: usb topology of %s unknown, %dx%d@%d %s unplanned",
+                    dev_->videoDevPath().c_str(), format.width, format.height, format.fps,
+                    encodingName(format.format));
+        return;
+    }
+    if (plan.fits)
+    {
+        RCLCPP_INFO(get_logger(), "bandwidth plan: %dx%d@%d %s, %.0f Mbps; bus %d (%s, port %s, link %.0f Mbps) "
+                    "%.0f of %.0f Mbps", format.width, format.height, format.fps, encodingName(format.format),
+                    plan.mode.mbps, plan.port.bus, plan.port.controller.c_str(), plan.port.devpath.c_str(),
+                    plan.port.link_mbps, plan.bus_used_mbps, plan.bus_budget_mbps);
+    }
+    else
+    {
+        RCLCPP_WARN(get_logger(), "bandwidth plan: %dx%d@%d %s, %.0f Mbps; bus %d (%s, port %s, link %.0f Mbps) "
+                    "overcommitted even at the lightest modes, %.0f of %.0f Mbps", format.width, format.height,
+                    format.fps, encodingName(format.format), plan.mode.mbps, plan.port.bus,
+                    plan.port.controller.c_str(), plan.port.devpath.c_str(), plan.port.link_mbps,
+                    plan.bus_used_mbps, plan.bus_budget_mbps);
+    }
+}
+
+void ObsbotNode::onPowerWake(const std_srvs::srv::Trigger::Request::SharedPtr,
+                             std_srvs::srv::Trigger::Response::SharedPtr response)
+{
+    /// the next check wakes a sleeping camera; held until it should be up, the consumer has the idle time from there
+    std::lock_guard<std::mutex> lock(power_mutex_);
+    power_->hold(steadyNs() + power_->latencyEstimate());
+    bool awake = power_->state() == PowerManager::State::Awake;
+    char message[96];
+    std::snprintf(message, sizeof(message), "%s, wake latency %.0f ms", awake ? "awake" : "waking",
+                  power_->latencyEstimate() / 1e6);
+    response->success = true;
+    response->message = message;
+}
+
+/// the timer is made once with the scheduler, every shot only sets its period and restarts it
+void ObsbotNode::armTimelapse(int64_t delay_ns)
+{
+    int64_t old_period;
+    if (rcl_timer_exchange_period(timelapse_timer_->get_timer_handle().get(), std::max<int64_t>(0, delay_ns),
+                                  &old_period) != RCL_RET_OK)
+    {
+        RCLCPP_WARN(get_logger(), "timelapse: can not set the timer: %s", rcl_get_error_string().str);
+        rcl_reset_error();
+    }
+    timelapse_timer_->reset();
+}
+
+/// only while someone watches, the camera path starts over when the topic is picked up again
+void ObsbotNode::publishStabilized(const Frame &frame)
+{
+    if (stabilized_pub_->get_subscription_count() == 0)
+    {
+        stabilizer_->reset();
+        return;
+    }
+
+    auto out = stabilizer_->process(frame, *attitude_);
+    if (!out)
+    {
+        if (stabilizer_->stats().unsupported)
+        {
+            RCLCPP_WARN_ONCE(get_logger(), "stabilization needs a raw video format, %s is encoded",
+                             encodingName(frame.format));
+        }
+        return;
+    }
+    stabilized_msg_.header.stamp = rclcpp::Time(out->stamp_ns);
+    stabilized_msg_.width = static_cast<uint32_t>(out->width);
+    stabilized_msg_.height = static_cast<uint32_t>(out->height);
+    stabilized_msg_.step = static_cast<uint32_t>(out->stride);
+    stabilized_msg_.data.assign(out->data, out->data + out->size);
+    stabilized_pub_->publish(stabilized_msg_);
+}
+
+void ObsbotNode::publishLeveled(const Frame &frame)
+{
+    auto out = leveler_->process(frame, *attitude_);
+    if (!out)
+    {
+        if (leveler_->stats().unsupported)
+        {
+            RCLCPP_WARN_ONCE(get_logger(), "horizon leveling needs a raw video format, %s is encoded",
+                             encodingName(frame.format));
+        }
+        return;
+    }
+    leveled_msg_.header.stamp = rclcpp::Time(out->stamp_ns);
+    leveled_msg_.width = static_cast<uint32_t>(out->width);
+    leveled_msg_.height = static_cast<uint32_t>(out->height);
+    leveled_msg_.step = static_cast<uint32_t>(out->stride);
+    leveled_msg_.data.assign(out->data, out->data + out->size);
+    leveled_pub_->publish(leveled_msg_);
+}
+
+/// about once a second; the stages keep their counters unlocked, so they are read here and not in the status group
+void ObsbotNode::updateStageDiagnostics()
+{
+    MotionTracker::Stats motion;
+    if (motion_)
+    {
+        std::lock_guard<std::mutex> lock(motion_mutex_);
+        motion = motion_->stats();
+    }
+    std::lock_guard<std::mutex> lock(diagnostics_mutex_);
+    if (stabilizer_)
+    { diagnostics_->updateStabilizer(stabilizer_->stats()); }
+    if (leveler_)
+    { diagnostics_->updateLeveler(leveler_->stats()); }
+    if (overlay_)
+    { diagnostics_->updateOverlay(overlay_->stats()); }
+    if (motion_)
+    { diagnostics_->updateMotion(motion); }
+}
+
+/// before the frame is published or seen by any sink; gimbal regions follow the attitude at capture time
+void ObsbotNode::maskFrame(Frame &frame)
+{
+    PrivacyMask::View view;
+    AttitudeTrack::Sample sample;
+    if (attitude_ && attitude_->at(frame.steady_ns, 100000000, sample))
+    {
+        view.valid = true;
+        view.roll = sample.roll;
+        view.pitch = sample.pitch;
+        view.yaw = sample.yaw;
+        view.zoom = applied_zoom_.load();
+    }
+    privacy_->apply(frame, view);
+}
+
+/// after the privacy masks, so nothing hides the stamp; only characters that changed are drawn again
+void ObsbotNode::drawOverlay(Frame &frame)
+{
+    char text[64];
+    std::time_t seconds = static_cast<std::time_t>(frame.stamp_ns / 1000000000);
+    std::tm parts{};
+    gmtime_r(&seconds, &parts);
+    size_t length = std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &parts);
+    std::snprintf(text + length, sizeof(text) - length, ".%03dZ #%llu",
+                  static_cast<int>(frame.stamp_ns / 1000000 % 1000), static_cast<unsigned long long>(frame.sequence));
+    overlay_->setLine(0, text);
+
+    bool recording = camera_recording_.load() || (event_buffer_ && event_buffer_->stats().dumping);
+    std::snprintf(text, sizeof(text), "SN %s ZOOM %.2fX%s", serial_.c_str(), static_cast<double>(applied_zoom_.load()),
+                  recording ? " REC" : "");
+    overlay_->setLine(1, text);
+
+    AttitudeTrack::Sample sample;
+    if (attitude_ && attitude_->at(frame.steady_ns, 100000000, sample))
+    {
+        std::snprintf(text, sizeof(text), "R %+6.1f P %+6.1f Y %+6.1f", static_cast<double>(sample.roll),
+                      static_cast<double>(sample.pitch), static_cast<double>(sample.yaw));
+        overlay_->setLine(2, text);
+    }
+    else
+    {
+        overlay_->setLine(2, "GIMBAL --");
+    }
+    if (!overlay_->apply(frame))
+    {
+        RCLCPP_WARN_ONCE(get_logger(), "the overlay needs a raw video format, %s is encoded",
+                         encodingName(frame.format));
+    }
+}
+
+/// on the masked frame without the overlay; differencing only makes sense for a still view, frames taken while it
+/// moves restart the tracker
+void ObsbotNode::trackMotion(const Frame &frame)
+{
+    MotionTracker::Target target;
+    {
+        std::lock_guard<std::mutex> lock(motion_mutex_);
+        if (steadyNs() < view_settle_ns_.load())
+        {
+            motion_->reset();
+            motion_target_ = motion_->target();
+            return;
+        }
+        if (!motion_->process(frame))
+        {
+            RCLCPP_WARN_ONCE(get_logger(), "motion tracking needs a raw video format, %s is encoded",
+                             encodingName(frame.format));
+            return;
+        }
+        motion_target_ = motion_->target();
+        target = motion_target_;
+    }
+
+    if (!target.valid || !motion_pub_->is_activated())
+    { return; }
+    motion_msg_.header.stamp = rclcpp::Time(target.stamp_ns);
+    auto &detection = motion_msg_.detections[0];
+    detection.x_min = target.x_min;
+    detection.y_min = target.y_min;
+    detection.x_max = target.x_max;
+    detection.y_max = target.y_max;
+    detection.score = target.score;
+    motion_pub_->publish(motion_msg_);
+}
+
+/// teleop wins: the tracker only commands the view in ticks without a gimbal message
+void ObsbotNode::motionControl(int64_t now_ns)
+{
+    if (!motionActive() || pending_gimbal_.type != GimbalCommand::None)
+    { return; }
+
+    MotionTracker::Target target;
+    {
+        std::lock_guard<std::mutex> lock(motion_mutex_);
+        target = motion_target_;
+    }
+
+    double deadband = motion_deadband_;
+    double error_x = target.valid ? target.x - 0.5 : 0.0;
+    double error_y = target.valid ? target.y - 0.5 : 0.0;
+    bool centered = std::fabs(error_x) < deadband && std::fabs(error_y) < deadband;
+    int64_t settle_ns = settle_ns_;
+
+    if (hasDigitalPtz())
+    {
+        if (target.valid && !centered)
+        {
+            double gain = 2.0 * motion_gain_;
+            ptz_->setVelocity(gain * error_x, gain * error_y, now_ns);
+            view_settle_ns_ = now_ns + settle_ns;
+        }
+    }
+    else if (hasGimbal())
+    {
+        if (target.valid && !centered)
+        {
+            double speed = 2.0 * motion_gimbal_speed_;
+            pending_gimbal_.type = GimbalCommand::Speed;
+            pending_gimbal_.pitch = -speed * error_y;
+            pending_gimbal_.yaw = speed * error_x;
+            pending_gimbal_.roll = 0.0;
+            motion_driving_ = true;
+            view_settle_ns_ = now_ns + settle_ns;
+        }
+        else if (motion_driving_)
+        {
+            pending_gimbal_.type = GimbalCommand::Speed;
+            pending_gimbal_.pitch = pending_gimbal_.yaw = pending_gimbal_.roll = 0.0;
+            motion_driving_ = false;
+        }
+    }
+    else if (framer_ && hasRoi() && target.valid)
+    {
+        DetectionBox box;
+        box.x_min = target.x_min;
+        box.y_min = target.y_min;
+        box.x_max = target.x_max;
+        box.y_max = target.y_max;
+        box.score = 1.0f;
+        framer_->update(&box, 1, now_ns);
+    }
+}
+
+/// auto: products without onboard tracking, and a tail air whose ai reports that it does not track
+bool ObsbotNode::motionActive() const
+{
+    if (motion_mode_ == "on")
+    { return true; }
+    if (motion_mode_ != "auto")
+    { return false; }
+    if (product_ == ObsbotProdMeet || product_ == ObsbotProdMeet4k || product_ == ObsbotProdHDMIBox ||
+        product_ == ObsbotProdMe)
+    { return true; }
+    return product_ == ObsbotProdTailAir && ai_main_mode_.load() == Device::AiTrackNormal;
+}
+
+/// an encoded capture never reaches the tracker, it neither tracks nor keeps the camera awake
+bool ObsbotNode::motionFed() const
+{
+    return motion_ && capture_raw_.load() && motionActive();
+}
+
+void ObsbotNode::onAccessUnit(const AccessUnit &au, RtpDepacketizer::Codec codec, int64_t stamp_ns)
+{
+    auto frame = pool_->acquire();
+    if (!frame || au.size > frame->capacity)
+    {
+        ++frames_dropped_;
+        return;
+    }
+
+    std::memcpy(frame->data, au.data, au.size);
+    frame->size = au.size;
+    frame->format = codec == RtpDepacketizer::Codec::H264 ? RmVideoFormat::H264 : RmVideoFormat::HEVC;
+    frame->keyframe = au.keyframe;
+    frame->sequence = stream_sequence_++;
+    frame->stamp_ns = stamp_ns;
+    frame->steady_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    ++frames_captured_;
+    publishFrame(*frame);
+    for (const auto &sink : sinks_)
+    { sink->onFrame(frame); }
+}
+
+void ObsbotNode::publishFrame(const Frame &frame)
+{
+    if (isEncoded(frame.format))
+    {
+        if (compressed_pub_->get_subscription_count() == 0)
+        { return; }
+        compressed_msg_.header.stamp = rclcpp::Time(frame.stamp_ns);
+        compressed_msg_.format = encodingName(frame.format);
+        compressed_msg_.data.assign(frame.data, frame.data + frame.size);
+        compressed_pub_->publish(compressed_msg_);
+        return;
+    }
+
+    if (image_pub_->get_subscription_count() == 0)
+    { return; }
+    image_msg_.header.stamp = rclcpp::Time(frame.stamp_ns);
+    image_msg_.width = static_cast<uint32_t>(frame.width);
+    image_msg_.height = static_cast<uint32_t>(frame.height);
+    image_msg_.step = static_cast<uint32_t>(frame.stride);
+    image_msg_.data.assign(frame.data, frame.data + frame.size);
+    image_pub_->publish(image_msg_);
+}
+
+V4l2Capture::Format ObsbotNode::requestedFormat()
+{
+    V4l2Capture::Format format;
+    format.width = static_cast<int32_t>(get_parameter("video.width").as_int());
+    format.height = static_cast<int32_t>(get_parameter("video.height").as_int());
+    format.fps = static_cast<int32_t>(get_parameter("video.fps").as_int());
+    format.format = formatFromName(get_parameter("video.format").as_string());
+    return format;
+}
+
+V4l2Capture::Format ObsbotNode::captureFormat()
+{
+    auto format = requestedFormat();
+    BandwidthPlanner::Assignment plan;
+    if (bandwidth_ && BandwidthPlanner::get().assignment(device_, plan))
+    { format = plan.mode.format; }
+    if (!thermal_)
+    { return format; }
+
+    /// the lighter of the two
+    std::lock_guard<std::mutex> lock(thermal_mutex_);
+    const auto &rung = thermal_->current();
+    if (rung.width > 0 &&
+        static_cast<int64_t>(rung.width) * rung.height < static_cast<int64_t>(format.width) * format.height)
+    {
+        format.width = rung.width;
+        format.height = rung.height;
+    }
+    if (rung.fps > 0)
+    { format.fps = std::min(format.fps, rung.fps); }
+    return format;
+}
+
+/// reuses the open video node and the frame pool when the requested format did not change
+bool ObsbotNode::openCapture()
+{
+#ifdef _WIN32
+    RCLCPP_ERROR(get_logger(), "video capture is only implemented for v4l2");
+    return false;
+#else
+    auto format = captureFormat();
+    bool supported = cache_.formats.empty();
+    for (const auto &info : cache_.formats)
+    {
+        if (info.format_ == format.format && info.width_ == format.width && info.height_ == format.height)
+        {
+            supported = true;
+            break;
+        }
+    }
+    if (!supported)
+    {
+        RCLCPP_WARN(get_logger(), "%dx%d %s is not listed by the device, asking the driver anyway", format.width,
+                    format.height, encodingName(format.format));
+    }
+
+    std::lock_guard<std::mutex> lock(capture_mutex_);
+    bool reuse = capture_.isOpen() && capture_format_.width == format.width &&
+                 capture_format_.height == format.height && capture_format_.fps == format.fps &&
+                 capture_format_.format == format.format;
+    if (!reuse)
+    {
+        capture_format_ = format;
+        auto driver_buffers = static_cast<uint32_t>(get_parameter("video.driver_buffers").as_int());
+        if (!capture_.open(dev_->videoDevPath(), capture_format_, driver_buffers))
+        {
+            RCLCPP_ERROR(get_logger(), "open %s failed: %s", dev_->videoDevPath().c_str(),
+                         capture_.lastError().c_str());
+            return false;
+        }
+        /// remember the request, not what the driver picked, so the next configure can compare
+        capture_format_ = format;
+    }
+    capture_raw_ = !isEncoded(capture_format_.format);
+    if (motion_ && !capture_raw_)
+    {
+        RCLCPP_WARN(get_logger(), "motion tracking needs a raw video format, %s is encoded and the tracker stays idle",
+                    encodingName(capture_format_.format));
+    }
+
+    auto frame_size = capture_.frameSize();
+    auto pool_size = static_cast<size_t>(std::max<int64_t>(2, get_parameter("video.pool_size").as_int()));
+    if (!pool_ || pool_->capacity() < frame_size || pool_->count() != pool_size)
+    {
+        releaseSinks();
+        pool_ = std::make_unique<FramePool>(pool_size, frame_size);
+        image_msg_.data.reserve(frame_size);
+        compressed_msg_.data.reserve(frame_size);
+    }
+
+    image_msg_.header.frame_id = serial_;
+    image_msg_.encoding = encodingName(capture_.format().format);
+    compressed_msg_.header.frame_id = serial_;
+    compressed_msg_.format = encodingName(capture_.format().format);
+
+    std::lock_guard<std::mutex> lock(capture_timer_mutex_);
+    if (!capture_timer_ || !reuse)
+    {
+        auto period = std::chrono::duration<double>(0.5 / std::max(1, capture_.format().fps));
+        capture_timer_ = create_wall_timer(std::chrono::duration_cast<std::chrono::nanoseconds>(period),
+                                           std::bind(&ObsbotNode::captureTick, this),
+                                           groups_.get(CallbackRole::Capture));
+        capture_timer_->cancel();
+    }
+    return true;
+#endif
+}
+
+/// network mode: switch the device to rtsp and prepare the client, the stream itself starts on activate
+bool ObsbotNode::openStream()
+{
+    auto format = requestedFormat();
+    auto encoder = Device::DevVideoEncoderAuto;
+    if (format.format == RmVideoFormat::H264)
+    { encoder = Device::DevVideoEncoderH264; }
+    else if (format.format == RmVideoFormat::HEVC)
+    { encoder = Device::DevVideoEncoderH265; }
+
+    /// the first rung is what the parameters ask for, the adapter only steps down from it
+    StreamAdapter::Options adapt;
+    adapt.adapt = get_parameter("adapt.enabled").as_bool();
+    adapt.loss_high = get_parameter("adapt.max_loss").as_double();
+    adapt.loss_low = adapt.loss_high / 10.0;
+    adapt.delay_high_ms = get_parameter("adapt.max_delay_ms").as_double();
+    adapt.delay_low_ms = adapt.delay_high_ms / 3.0;
+    adapt.jitter_high_ms = get_parameter("adapt.max_jitter_ms").as_double();
+    adapt.jitter_low_ms = adapt.jitter_high_ms / 3.0;
+    auto ladder = StreamAdapter::defaultLadder(streamResolution(format.height, format.fps), encoder,
+                                               get_parameter("adapt.allow_h265").as_bool());
+    if (!adapt.adapt)
+    { ladder[0].bitrate = Device::DevVideoBitLevelDefault; }
+    adapter_ = std::make_unique<StreamAdapter>(ladder, adapt);
+    rung_applied_ = false;
+    applyRung(adapter_->current());
+
+    if (sdkCall(dev_->cameraSetSelectNdiOrRtspR(Device::RtspEnabledAndNdiDisabled)) != RM_RET_OK)
+    {
+        RCLCPP_ERROR(get_logger(), "enable rtsp on the device failed");
+        return false;
+    }
+
+    rtsp_options_.url = streamUrl();
+    if (rtsp_options_.url.empty())
+    {
+        RCLCPP_ERROR(get_logger(), "device has no ip address, set rtsp.url");
+        return false;
+    }
+    rtsp_options_.tcp = get_parameter("rtsp.transport").as_string() != "udp";
+    rtsp_options_.jitter_buffer = get_parameter("rtsp.jitter_buffer").as_bool();
+    rtsp_options_.jitter_delay_ms = static_cast<int32_t>(get_parameter("rtsp.jitter_delay_ms").as_int());
+    rtsp_options_.map_timestamps = get_parameter("rtsp.map_timestamps").as_bool();
+    auto max_frame_kb = std::max<int64_t>(64, get_parameter("rtsp.max_frame_kb").as_int());
+    rtsp_options_.max_au_size = static_cast<size_t>(max_frame_kb) * 1024;
+
+    auto pool_size = static_cast<size_t>(std::max<int64_t>(2, get_parameter("video.pool_size").as_int()));
+    if (!pool_ || pool_->capacity() < rtsp_options_.max_au_size || pool_->count() != pool_size)
+    {
+        releaseSinks();
+        pool_ = std::make_unique<FramePool>(pool_size, rtsp_options_.max_au_size);
+        compressed_msg_.data.reserve(rtsp_options_.max_au_size);
+    }
+    compressed_msg_.header.frame_id = serial_;
+    RCLCPP_INFO(get_logger(), "network mode, receiving %s", rtsp_options_.url.c_str());
+    return true;
+}
+
+bool ObsbotNode::startStream()
+{
+    if (!rtsp_.start(rtsp_options_, std::bind(&ObsbotNode::onAccessUnit, this, std::placeholders::_1,
+                                              std::placeholders::_2, std::placeholders::_3)))
+    {
+        RCLCPP_ERROR(get_logger(), "start rtsp failed: %s", rtsp_.lastError().c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ObsbotNode::applyRung(const StreamAdapter::Rung &rung)
+{
+    bool reopen = false;
+    if (rung.encoder != Device::DevVideoEncoderAuto && (!rung_applied_ || rung.encoder != applied_rung_.encoder))
+    {
+        sdkCall(dev_->cameraSetNdiRtspEncoderFormatR(rung.encoder));
+        reopen = true;
+    }
+    if (!rung_applied_ || rung.resolution != applied_rung_.resolution)
+    {
+        sdkCall(dev_->cameraSetNdiRtspResolutionR(rung.resolution));
+        reopen = true;
+    }
+    if (!rung_applied_ || rung.bitrate != applied_rung_.bitrate)
+    { sdkCall(dev_->cameraSetNdiRtspBitrateLevelR(rung.bitrate)); }
+    applied_rung_ = rung;
+    rung_applied_ = true;
+    return reopen;
+}
+
+/// the rtsp session is reopened when the resolution or the encoder changes, the sdp describes the old stream
+void ObsbotNode::networkTick()
+{
+    auto stats = rtsp_.stats();
+    auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (adapter_->update(stats, now_ns))
+    {
+        const auto &sample = adapter_->sample();
+        RCLCPP_INFO(get_logger(), "stream rung %zu/%zu (loss %.1f %%, delay %.0f ms, jitter %.1f ms, %.0f kbps)",
+                    adapter_->rung() + 1, adapter_->rungCount(), 100.0 * sample.loss, sample.delay_ms,
+                    sample.jitter_ms, sample.rx_kbps);
+        if (applyRung(adapter_->current()))
+        {
+            rtsp_.stop();
+            startStream();
+        }
+    }
+
+    DiagnosticsAggregator::NetworkStats network;
+    network.connected = stats.connected;
+    network.rx_kbps = adapter_->sample().rx_kbps;
+    network.loss = adapter_->sample().loss;
+    network.jitter_ms = stats.jitter_ms;
+    network.delay_ms = stats.delay_ms;
+    network.reconnects = stats.reconnects;
+    network.rung = adapter_->rung();
+    network.rung_count = adapter_->rungCount();
+    std::lock_guard<std::mutex> lock(diagnostics_mutex_);
+    diagnostics_->updateNetwork(network);
+}
+
+/// rtsp.url if set, otherwise rtsp.url_template with {ip} replaced by the wired or else the wireless address
+std::string ObsbotNode::streamUrl()
+{
+    auto url = get_parameter("rtsp.url").as_string();
+    if (!url.empty())
+    { return url; }
+
+    auto ip = dev_->devWiredIp();
+    if (ip.empty() || ip == "0.0.0.0")
+    { ip = dev_->devWirelessIp(); }
+    if (ip.empty() || ip == "0.0.0.0")
+    { return ""; }
+
+    /// an ipv6 literal goes in brackets, the port follows it
+    if (ip.find(':') != std::string::npos)
+    { ip = "[" + ip + "]"; }
+    url = get_parameter("rtsp.url_template").as_string();
+    auto pos = url.find("{ip}");
+    if (pos != std::string::npos)
+    { url.replace(pos, 4, ip); }
+    return url;
+}
+
+/// the timer is replaced when the capture opens at another rate, eg. from a parameter change or a new plan
+void ObsbotNode::runCaptureTimer(bool run)
+{
+    std::lock_guard<std::mutex> lock(capture_timer_mutex_);
+    if (!capture_timer_)
+    { return; }
+    if (run)
+    { capture_timer_->reset(); }
+    else
+    { capture_timer_->cancel(); }
+}
+
+void ObsbotNode::closeCapture()
+{
+    rtsp_.stop();
+    runCaptureTimer(false);
+    std::lock_guard<std::mutex> lock(capture_mutex_);
+    capture_.close();
+    releaseSinks();
+    pool_.reset();
+}
+
+void ObsbotNode::addFrameSink(std::shared_ptr<FrameSink> sink)
+{
+    sinks_.push_back(std::move(sink));
+}
+
+void ObsbotNode::releaseSinks()
+{
+    for (const auto &sink : sinks_)
+    { sink->onRelease(); }
+}
+
+void ObsbotNode::logTransition(const char *transition, std::chrono::steady_clock::time_point start)
+{
+    RCLCPP_INFO(get_logger(), "%s took %.1f ms", transition,
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+int32_t ObsbotNode::sdkCall(int32_t ret)
+{
+    ++sdk_calls_;
+    if (ret != RM_RET_OK)
+    { ++sdk_errors_; }
+    return ret;
+}
+
+/// tiny series and tail air have a mechanical gimbal
+bool ObsbotNode::hasGimbal() const
+{
+    return product_ == ObsbotProdTiny || product_ == ObsbotProdTiny4k || product_ == ObsbotProdTiny2 ||
+           product_ == ObsbotProdTailAir;
+}
+
+/// only tiny2 and tail air accept absolute motor angles
+bool ObsbotNode::hasMotorAngle() const
+{
+    return product_ == ObsbotProdTiny2 || product_ == ObsbotProdTailAir;
+}
+
+/// aiGetAiStatusR is answered by the tiny series and tail air
+bool ObsbotNode::hasAiStatus() const
+{
+    return product_ == ObsbotProdTiny || product_ == ObsbotProdTiny4k || product_ == ObsbotProdTiny2 ||
+           product_ == ObsbotProdTailAir;
+}
+
+/// meet and meet4k move a digital window instead of a gimbal
+bool ObsbotNode::hasDigitalPtz() const
+{
+    return product_ == ObsbotProdMeet || product_ == ObsbotProdMeet4k;
+}
+
+/// the automatic sleep timer of the tiny and meet series
+bool ObsbotNode::hasSuspendTime() const
+{
+    return product_ == ObsbotProdTiny || product_ == ObsbotProdTiny4k || product_ == ObsbotProdTiny2 ||
+           product_ == ObsbotProdMeet || product_ == ObsbotProdMeet4k;
+}
+
+/// digital roi framing is a tail air feature
+bool ObsbotNode::hasRoi() const
+{
+    return product_ == ObsbotProdTailAir;
+}
+
+/// the target selection calls belong to the remo v3 ai protocol of tiny2 and tail air
+bool ObsbotNode::hasTargetSelection() const
+{
+    return product_ == ObsbotProdTiny2 || product_ == ObsbotProdTailAir;
+}
+
+}  // namespace obsbot_ros
@@ -0,0 +1,89 @@
+#include <algorithm>
+
+#include <obsbot_ros/power_manager.hpp>
+
+namespace obsbot_ros
+{
+
+PowerManager::PowerManager(const Options &options) : options_(options)
+{
+    options_.idle_ns = std::max<int64_t>(0, options_.idle_ns);
+    options_.history = std::max<size_t>(1, options_.history);
+    latencies_.reserve(options_.history);
+}
+
+void PowerManager::reset(int64_t now_ns)
+{
+    state_ = State::Awake;
+    last_demand_ns_ = now_ns;
+}
+
+PowerManager::Action PowerManager::update(bool demand, int64_t now_ns)
+{
+    demand = demand || now_ns < hold_until_ns_;
+    switch (state_)
+    {
+    case State::Awake:
+        if (demand)
+        {
+            /// the idle time of a hold starts where the hold ends
+            last_demand_ns_ = std::max(now_ns, hold_until_ns_);
+            return Action::None;
+        }
+        if (now_ns - last_demand_ns_ < options_.idle_ns)
+        { return Action::None; }
+        state_ = State::Asleep;
+        sleep_ns_ = now_ns;
+        ++stats_.sleeps;
+        return Action::Sleep;
+    case State::Asleep:
+        if (!demand)
+        { return Action::None; }
+        state_ = State::Waking;
+        stats_.asleep_s += (now_ns - sleep_ns_) / 1e9;
+        wake_ns_ = now_ns;
+        retry_ns_ = now_ns;
+        ++stats_.wakes;
+        return Action::Wake;
+    case State::Waking:
+        /// demand may be gone again, the camera still comes up and idles out from its first frame
+        if (now_ns - retry_ns_ < options_.wake_timeout_ns)
+        { return Action::None; }
+        retry_ns_ = now_ns;
+        ++stats_.wake_retries;
+        return Action::Wake;
+    }
+    return Action::None;
+}
+
+void PowerManager::hold(int64_t until_ns)
+{
+    hold_until_ns_ = std::max(hold_until_ns_, until_ns);
+}
+
+void PowerManager::onFrame(int64_t frame_ns)
+{
+    if (state_ != State::Waking)
+    { return; }
+
+    state_ = State::Awake;
+    last_demand_ns_ = frame_ns;
+    int64_t latency = frame_ns - wake_ns_;
+    if (latencies_.size() < options_.history)
+    { latencies_.push_back(latency); }
+    else
+    { latencies_[next_latency_] = latency; }
+    next_latency_ = (next_latency_ + 1) % options_.history;
+    ++stats_.samples;
+    stats_.latency_ms = latency / 1e6;
+    stats_.max_latency_ms = std::max(stats_.max_latency_ms, stats_.latency_ms);
+}
+
+int64_t PowerManager::latencyEstimate() const
+{
+    if (latencies_.empty())
+    { return options_.initial_latency_ns; }
+    return std::max<int64_t>(0, *std::max_element(latencies_.begin(), latencies_.end()));
+}
+
+}  // namespace obsbot_ros
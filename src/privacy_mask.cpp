@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+
+#include <obsbot_ros/image_ops.hpp>
+#include <obsbot_ros/privacy_mask.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+constexpr double kPi = 3.14159265358979323846;
+
+struct Vec3
+{
+    double x, y, z;
+};
+
+/// same axes as the stabilizer: x right, y down, z forward; positive yaw turns right, positive pitch up
+Vec3 rotateY(const Vec3 &v, double deg)
+{
+    double c = std::cos(deg * kPi / 180.0), s = std::sin(deg * kPi / 180.0);
+    return {c * v.x + s * v.z, v.y, -s * v.x + c * v.z};
+}
+
+Vec3 rotateX(const Vec3 &v, double deg)
+{
+    double c = std::cos(deg * kPi / 180.0), s = std::sin(deg * kPi / 180.0);
+    return {v.x, c * v.y - s * v.z, s * v.y + c * v.z};
+}
+
+Vec3 rotateZ(const Vec3 &v, double deg)
+{
+    double c = std::cos(deg * kPi / 180.0), s = std::sin(deg * kPi / 180.0);
+    return {c * v.x - s * v.y, s * v.x + c * v.y, v.z};
+}
+}
+
+bool PrivacyMask::parse(const std::string &text, Region &out)
+{
+    std::istringstream in(text);
+    std::string mode, space;
+    if (!(in >> mode >> space))
+    { return false; }
+    if (mode == "black")
+    { out.mode = Mode::Black; }
+    else if (mode == "pixelate")
+    { out.mode = Mode::Pixelate; }
+    else
+    { return false; }
+    if (space == "image")
+    { out.space = Space::Image; }
+    else if (space == "gimbal")
+    { out.space = Space::Gimbal; }
+    else
+    { return false; }
+
+    out.points.clear();
+    std::string pair;
+    while (in >> pair)
+    {
+        Point point;
+        char comma = 0;
+        std::istringstream values(pair);
+        if (!(values >> point.x >> comma >> point.y) || comma != ',')
+        { return false; }
+        out.points.push_back(point);
+    }
+    return out.points.size() >= 3;
+}
+
+PrivacyMask::PrivacyMask(const Options &options) : options_(options)
+{
+    options_.block = std::max(2, options_.block);
+    options_.hfov_deg = std::min(170.0, std::max(10.0, options_.hfov_deg));
+    size_t points = 0;
+    for (const auto &region : options_.regions)
+    {
+        needs_view_ |= region.space == Space::Gimbal;
+        points = std::max(points, region.points.size());
+    }
+    polygon_.reserve(points);
+    crossings_.reserve(points);
+}
+
+bool PrivacyMask::apply(Frame &frame, const View &view)
+{
+    image_ops::PlaneView y, u, v;
+    if (!image_ops::yuvPlanes(frame, y, u, v))
+    {
+        ++stats_.unsupported;
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ++stats_.frames;
+    /// the views point into the frame, the same bytes are written through its own pointer
+    auto plane = [&frame, &y](const image_ops::PlaneView &view, uint8_t black)
+    {
+        Plane out;
+        out.data = frame.data + (view.data - frame.data);
+        out.width = view.width;
+        out.height = view.height;
+        out.stride = view.stride;
+        out.step = view.step;
+        out.scale_x = static_cast<double>(view.width) / y.width;
+        out.scale_y = static_cast<double>(view.height) / y.height;
+        out.black = black;
+        return out;
+    };
+    Plane planes[3] = {plane(y, 0), Plane(), Plane()};
+    size_t count = 1;
+    if (u.data && v.data)
+    {
+        planes[1] = plane(u, 128);
+        planes[2] = plane(v, 128);
+        count = 3;
+    }
+
+    if (needs_view_ && !view.valid && options_.blank_without_view)
+    {
+        ++stats_.blanked;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Plane &p = planes[i];
+            for (int32_t row = 0; row < p.height; ++row)
+            {
+                image_ops::fillSamples(p.data + static_cast<size_t>(row) * static_cast<size_t>(p.stride), p.black,
+                                       static_cast<size_t>(p.step), static_cast<size_t>(p.width));
+            }
+        }
+    }
+    else
+    {
+        for (const auto &region : options_.regions)
+        {
+            if ((region.space == Space::Gimbal && !view.valid) || !project(region, view, y.width, y.height))
+            { continue; }
+            for (size_t i = 0; i < count; ++i)
+            { fill(planes[i], region.mode); }
+        }
+    }
+
+    double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    stats_.process_us = stats_.frames == 1 ? elapsed_us : stats_.process_us + (elapsed_us - stats_.process_us) / 16.0;
+    stats_.max_process_us = std::max(stats_.max_process_us, elapsed_us);
+    return true;
+}
+
+bool PrivacyMask::project(const Region &region, const View &view, int32_t width, int32_t height)
+{
+    polygon_.clear();
+    if (region.space == Space::Image)
+    {
+        for (const auto &point : region.points)
+        { polygon_.push_back({point.x * static_cast<float>(width), point.y * static_cast<float>(height)}); }
+        return true;
+    }
+
+    /// pinhole through the camera attitude; a corner behind the camera goes far out on its side
+    const double f = 0.5 * width / std::tan(0.5 * options_.hfov_deg * kPi / 180.0) * std::max(1.0f, view.zoom);
+    const double cx = 0.5 * width;
+    const double cy = 0.5 * height;
+    bool visible = false;
+    for (const auto &point : region.points)
+    {
+        Vec3 dir = rotateY(rotateX({0.0, 0.0, 1.0}, point.y), point.x);
+        Vec3 cam = rotateZ(rotateX(rotateY(dir, -view.yaw), -view.pitch), -view.roll);
+        visible |= cam.z > 0.0;
+        double z = std::max(1e-3, cam.z);
+        double x = std::min(1e6, std::max(-1e6, cx + f * cam.x / z));
+        double y = std::min(1e6, std::max(-1e6, cy + f * cam.y / z));
+        polygon_.push_back({static_cast<float>(x), static_cast<float>(y)});
+    }
+    return visible;
+}
+
+void PrivacyMask::crossings(const Plane &plane, int32_t row)
+{
+    crossings_.clear();
+    const double center = row + 0.5;
+    for (size_t i = 0, j = polygon_.size() - 1; i < polygon_.size(); j = i++)
+    {
+        double ay = polygon_[j].y * plane.scale_y;
+        double by = polygon_[i].y * plane.scale_y;
+        if ((ay <= center) == (by <= center))
+        { continue; }
+        double x = polygon_[j].x + (center - ay) / (by - ay) * (polygon_[i].x - polygon_[j].x);
+        crossings_.push_back(static_cast<float>(x * plane.scale_x));
+    }
+    std::sort(crossings_.begin(), crossings_.end());
+}
+
+void PrivacyMask::fill(const Plane &plane, Mode mode)
+{
+    float min_x = polygon_[0].x, max_x = min_x, min_y = polygon_[0].y, max_y = min_y;
+    for (const auto &point : polygon_)
+    {
+        min_x = std::min(min_x, point.x);
+        max_x = std::max(max_x, point.x);
+        min_y = std::min(min_y, point.y);
+        max_y = std::max(max_y, point.y);
+    }
+    const int32_t first_row = std::max(0, static_cast<int32_t>(std::floor(min_y * plane.scale_y)));
+    const int32_t last_row = std::min(plane.height - 1, static_cast<int32_t>(std::ceil(max_y * plane.scale_y)));
+    if (first_row > last_row || max_x * plane.scale_x < 0.0 || min_x * plane.scale_x >= plane.width)
+    { return; }
+
+    const size_t step = static_cast<size_t>(plane.step);
+    const int32_t block = std::max(1, static_cast<int32_t>(std::lround(options_.block * plane.scale_x)));
+    const int32_t block_rows = std::max(1, static_cast<int32_t>(std::lround(options_.block * plane.scale_y)));
+    const int32_t first_block = std::max(0, static_cast<int32_t>(min_x * plane.scale_x)) / block;
+    const int32_t last_block = std::min(plane.width - 1, static_cast<int32_t>(max_x * plane.scale_x)) / block;
+    int32_t averaged = -1;                      /// block row the averages are of
+
+    for (int32_t row = first_row; row <= last_row; ++row)
+    {
+        crossings(plane, row);
+        uint8_t *line = plane.data + static_cast<size_t>(row) * static_cast<size_t>(plane.stride);
+        for (size_t i = 0; i + 1 < crossings_.size(); i += 2)
+        {
+            /// pixels whose centers are inside the span
+            int32_t x0 = std::max(0, static_cast<int32_t>(std::ceil(crossings_[i] - 0.5f)));
+            int32_t x1 = std::min(plane.width - 1, static_cast<int32_t>(std::floor(crossings_[i + 1] - 0.5f)));
+            if (x0 > x1)
+            { continue; }
+            if (mode == Mode::Black)
+            {
+                image_ops::fillSamples(line + static_cast<size_t>(x0) * step, plane.black, step,
+                                       static_cast<size_t>(x1 - x0 + 1));
+                continue;
+            }
+
+            /// the averages of a block row are taken before its first span is written
+            if (row / block_rows != averaged)
+            {
+                averaged = row / block_rows;
+                int32_t top = averaged * block_rows;
+                averages(plane, top, std::min(block_rows, plane.height - top), block, first_block, last_block);
+            }
+            for (int32_t x = x0; x <= x1;)
+            {
+                int32_t end = std::min(x1, (x / block + 1) * block - 1);
+                image_ops::fillSamples(line + static_cast<size_t>(x) * step, averages_[x / block - first_block],
+                                       step, static_cast<size_t>(end - x + 1));
+                x = end + 1;
+            }
+        }
+    }
+}
+
+void PrivacyMask::averages(const Plane &plane, int32_t row, int32_t rows, int32_t block, int32_t first, int32_t last)
+{
+    const size_t step = static_cast<size_t>(plane.step);
+    averages_.resize(static_cast<size_t>(last - first + 1));
+    for (int32_t column = first; column <= last; ++column)
+    {
+        int32_t x = column * block;
+        int32_t width = std::min(block, plane.width - x);
+        uint32_t sum = 0;
+        for (int32_t i = 0; i < rows; ++i)
+        {
+            sum += image_ops::sumSamples(plane.data + static_cast<size_t>(row + i) * static_cast<size_t>(plane.stride) +
+                                         static_cast<size_t>(x) * step, step, static_cast<size_t>(width));
+        }
+        uint32_t samples = static_cast<uint32_t>(width * rows);
+        averages_[static_cast<size_t>(column - first)] = static_cast<uint8_t>((sum + samples / 2) / samples);
+    }
+}
+
+}  // namespace obsbot_ros
@@ -0,0 +1,76 @@
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <lifecycle_msgs/msg/state.hpp>
+#include <rclcpp/rclcpp.hpp>
+
+#include <obsbot_ros/executor_layout.hpp>
+#include <obsbot_ros/obsbot_node.hpp>
+#include <obsbot_ros/rig_node.hpp>
+
+int main(int argc, char **argv)
+{
+    rclcpp::init(argc, argv);
+
+    auto rig = std::make_shared<obsbot_ros::RigNode>();
+    auto serials = rig->findCameras();
+    if (serials.empty())
+    {
+        RCLCPP_ERROR(rig->get_logger(), "no cameras for the rig");
+        rclcpp::shutdown();
+        return 1;
+    }
+    rig->setCameras(serials);
+
+    /// one driver node per camera, named obsbot_<index>, each with its own executor layout
+    std::vector<std::shared_ptr<obsbot_ros::ObsbotNode>> cameras;
+    std::vector<std::unique_ptr<obsbot_ros::ExecutorLayout>> layouts;
+    for (size_t i = 0; i < serials.size(); ++i)
+    {
+        auto options = rclcpp::NodeOptions()
+            .arguments({"--ros-args", "-r", "__node:=obsbot_" + std::to_string(i)})
+            .parameter_overrides({rclcpp::Parameter("serial", serials[i])});
+        auto camera = std::make_shared<obsbot_ros::ObsbotNode>(options);
+        for (auto &sink : rig->inputs(i))
+        {
+            camera->addFrameSink(sink);
+        }
+
+        if (camera->get_parameter("autostart").as_bool() &&
+            camera->configure().id() == lifecycle_msgs::msg::State::PRIMARY_STATE_INACTIVE)
+        {
+            camera->activate();
+        }
+
+        layouts.push_back(std::make_unique<obsbot_ros::ExecutorLayout>(
+            obsbot_ros::ExecutorLayout::optionsFromParameters(camera->get_node_parameters_interface())));
+        layouts.back()->add(camera->callbackGroups());
+        cameras.push_back(camera);
+    }
+
+    std::vector<std::thread> threads;
+    for (auto &layout : layouts)
+    {
+        threads.emplace_back([&layout]()
+                             { layout->spin(); });
+    }
+    rclcpp::spin(rig);
+
+    for (auto &layout : layouts)
+    {
+        layout->cancel();
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    /// the cameras hand their frames back to the rig's synchronizer and compositor, so they go first
+    layouts.clear();
+    cameras.clear();
+    rig.reset();
+    rclcpp::shutdown();
+    return 0;
+}
@@ -0,0 +1,323 @@
+#include <algorithm>
+#include <condition_variable>
+#include <ctime>
+#include <mutex>
+
+#include <obsbot_ros/device_registry.hpp>
+#include <obsbot_ros/rig_node.hpp>
+
+namespace obsbot_ros
+{
+
+RigNode::RigNode(const rclcpp::NodeOptions &options) :
+    rclcpp::Node("obsbot_rig", options)
+{
+    declare_parameter<std::vector<std::string>>("serials", std::vector<std::string>());
+    declare_parameter<int>("discovery_timeout_ms", 3000);
+    declare_parameter<int>("discovery_quiet_ms", 500);
+    declare_parameter<double>("sync.tolerance_ms", 10.0);
+    declare_parameter<int>("sync.queue_depth", 4);
+    declare_parameter<bool>("mosaic.enabled", false);
+    declare_parameter<std::string>("mosaic.layout", "grid");
+    declare_parameter<int>("mosaic.width", 1280);
+    declare_parameter<int>("mosaic.height", 720);
+    declare_parameter<double>("mosaic.fps", 15.0);
+    declare_parameter<int>("mosaic.pip_main", 0);
+    declare_parameter<double>("mosaic.pip_scale", 0.25);
+    declare_parameter<double>("mosaic.pip_alpha", 1.0);
+    declare_parameter<bool>("record.enabled", false);
+    declare_parameter<std::string>("record.directory", "/tmp");
+    declare_parameter<std::string>("record.compression", "zstd");
+    declare_parameter<int>("record.chunk_mb", 8);
+    declare_parameter<int>("record.queue_depth", 4);
+    auto diagnostics_period = declare_parameter<int>("diagnostics.period_ms", 1000);
+
+    bundle_pub_ = create_publisher<msg::FrameBundle>("~/bundle", rclcpp::SensorDataQoS());
+    bundle_timer_ = create_wall_timer(std::chrono::nanoseconds(0), std::bind(&RigNode::bundleTick, this));
+    bundle_timer_->cancel();
+    diagnostics_pub_ = create_publisher<diagnostic_msgs::msg::DiagnosticArray>("/diagnostics", rclcpp::QoS(10));
+    diagnostics_timer_ = create_wall_timer(
+        std::chrono::milliseconds(std::max(100, static_cast<int>(diagnostics_period))),
+        std::bind(&RigNode::diagnosticsTick, this));
+
+    diagnostics_msg_.status.resize(1);
+    diagnostics_msg_.status[0].name = std::string(get_name()) + ": sync";
+}
+
+/// without a list every device that shows up during discovery joins, sorted by SN so the order is stable
+std::vector<std::string> RigNode::findCameras()
+{
+    auto serials = get_parameter("serials").as_string_array();
+    if (!serials.empty())
+    { return serials; }
+
+    /// the registry starts the sdk enumeration, every device that arrives restarts the quiet time
+    std::mutex mutex;
+    std::condition_variable arrived;
+    size_t arrivals = 0;
+    auto &registry = DeviceRegistry::get();
+    auto listener = registry.addListener([&](DeviceRegistry::Handle, bool in_out)
+    {
+        if (!in_out)
+        { return; }
+        std::lock_guard<std::mutex> lock(mutex);
+        ++arrivals;
+        arrived.notify_all();
+    });
+    bool found = !registry.serials().empty();
+
+    auto now = std::chrono::steady_clock::now();
+    auto deadline = now + std::chrono::milliseconds(get_parameter("discovery_timeout_ms").as_int());
+    auto quiet = std::chrono::milliseconds(std::max<int64_t>(0, get_parameter("discovery_quiet_ms").as_int()));
+    std::unique_lock<std::mutex> lock(mutex);
+    while (rclcpp::ok() && now < deadline)
+    {
+        /// short waits until the first device, so a shutdown is seen
+        auto seen = arrivals;
+        auto until = std::min(deadline, now + (found ? quiet : std::chrono::milliseconds(100)));
+        if (!arrived.wait_until(lock, until, [&]()
+                                { return arrivals != seen; }) && found)
+        { break; }
+        found = found || arrivals > 0;
+        now = std::chrono::steady_clock::now();
+    }
+    lock.unlock();
+    registry.removeListener(listener);
+    return registry.serials();
+}
+
+void RigNode::setCameras(const std::vector<std::string> &serials)
+{
+    serials_ = serials;
+
+    FrameSynchronizer::Options options;
+    options.streams = serials.size();
+    options.queue_depth = static_cast<size_t>(std::max<int64_t>(1, get_parameter("sync.queue_depth").as_int()));
+    options.tolerance_ns = static_cast<int64_t>(get_parameter("sync.tolerance_ms").as_double() * 1e6);
+    /// the cameras stream for the synchronizer only while someone listens to the bundles
+    auto ready = [this]()
+    { bundle_timer_->reset(); };
+    auto demand = [this]()
+    { return bundle_pub_->get_subscription_count() > 0; };
+    synchronizer_ = std::make_unique<FrameSynchronizer>(options, ready, demand);
+
+    bundle_msg_.serials = serials;
+    bundle_msg_.images.resize(serials.size());
+    bundle_msg_.compressed.resize(serials.size());
+    for (size_t i = 0; i < serials.size(); ++i)
+    {
+        bundle_msg_.images[i].header.frame_id = serials[i];
+        bundle_msg_.compressed[i].header.frame_id = serials[i];
+    }
+    RCLCPP_INFO(get_logger(), "rig of %zu cameras, tolerance %.1f ms", serials.size(), options.tolerance_ns * 1e-6);
+
+    if (get_parameter("record.enabled").as_bool())
+    { startRecording(); }
+
+    if (!get_parameter("mosaic.enabled").as_bool())
+    { return; }
+
+    MosaicCompositor::Options mosaic;
+    mosaic.layout = get_parameter("mosaic.layout").as_string() == "pip" ? MosaicCompositor::Layout::PictureInPicture
+                                                                        : MosaicCompositor::Layout::Grid;
+    mosaic.width = static_cast<int32_t>(get_parameter("mosaic.width").as_int());
+    mosaic.height = static_cast<int32_t>(get_parameter("mosaic.height").as_int());
+    mosaic.sources = serials.size();
+    mosaic.pip_main = static_cast<size_t>(std::max<int64_t>(0, get_parameter("mosaic.pip_main").as_int()));
+    mosaic.pip_scale = get_parameter("mosaic.pip_scale").as_double();
+    mosaic.pip_alpha = static_cast<uint32_t>(std::max(0.0, get_parameter("mosaic.pip_alpha").as_double()) * 256.0);
+    mosaic_pub_ = create_publisher<sensor_msgs::msg::Image>("~/mosaic", rclcpp::SensorDataQoS());
+    mosaic_ = std::make_unique<MosaicCompositor>(mosaic, [this]()
+                                                 { return mosaic_pub_->get_subscription_count() > 0; });
+
+    mosaic_msg_.header.frame_id = "mosaic";
+    mosaic_msg_.encoding = encodingName(RmVideoFormat::I420);
+    mosaic_msg_.width = static_cast<uint32_t>(mosaic_->options().width);
+    mosaic_msg_.height = static_cast<uint32_t>(mosaic_->options().height);
+    mosaic_msg_.step = mosaic_msg_.width;
+    auto fps = std::max(1.0, get_parameter("mosaic.fps").as_double());
+    mosaic_timer_ = create_wall_timer(std::chrono::nanoseconds(static_cast<int64_t>(1e9 / fps)),
+                                      std::bind(&RigNode::mosaicTick, this));
+    RCLCPP_INFO(get_logger(), "mosaic %dx%d at %.1f fps", mosaic.width, mosaic.height, fps);
+}
+
+std::vector<std::shared_ptr<FrameSink>> RigNode::inputs(size_t index) const
+{
+    std::vector<std::shared_ptr<FrameSink>> sinks{synchronizer_->input(index)};
+    if (mosaic_)
+    { sinks.push_back(mosaic_->input(index)); }
+    if (recorder_)
+    { sinks.push_back(recorder_->input(index)); }
+    return sinks;
+}
+
+void RigNode::startRecording()
+{
+    McapRecorder::Options record;
+    auto compression = get_parameter("record.compression").as_string();
+    record.compression = compression == "lz4" ? McapRecorder::Compression::Lz4
+                       : compression == "none" ? McapRecorder::Compression::None : McapRecorder::Compression::Zstd;
+    if (!McapRecorder::supported(record.compression))
+    {
+        RCLCPP_WARN(get_logger(), "%s compression is not available in this build, recording uncompressed",
+                    compression.c_str());
+    }
+    record.chunk_size = static_cast<size_t>(std::max<int64_t>(1, get_parameter("record.chunk_mb").as_int())) << 20;
+    record.queue_depth = static_cast<size_t>(std::max<int64_t>(1, get_parameter("record.queue_depth").as_int()));
+
+    char stamp[32];
+    std::time_t seconds = std::time(nullptr);
+    std::tm parts{};
+    localtime_r(&seconds, &parts);
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &parts);
+    record.path = get_parameter("record.directory").as_string() + "/" + get_name() + "_" + stamp + ".mcap";
+
+    std::vector<McapRecorder::Stream> streams;
+    for (size_t i = 0; i < serials_.size(); ++i)
+    {
+        streams.push_back({"/obsbot_" + std::to_string(i), serials_[i]});
+    }
+    recorder_ = std::make_unique<McapRecorder>(record, streams);
+    if (!recorder_->open())
+    {
+        RCLCPP_ERROR(get_logger(), "recording disabled: %s", recorder_->lastError().c_str());
+        recorder_.reset();
+        return;
+    }
+
+    /// status goes in as it arrives on the wire, it is never deserialized
+    diagnostics_sub_ = create_subscription<diagnostic_msgs::msg::DiagnosticArray>(
+        "/diagnostics", rclcpp::QoS(50), [this](const std::shared_ptr<rclcpp::SerializedMessage> msg)
+        {
+            const auto &raw = msg->get_rcl_serialized_message();
+            recorder_->writeDiagnostics(now().nanoseconds(), raw.buffer, raw.buffer_length);
+        });
+
+    diagnostics_msg_.status.resize(2);
+    diagnostics_msg_.status[1].name = std::string(get_name()) + ": record";
+    diagnostics_msg_.status[1].hardware_id = "rig";
+    RCLCPP_INFO(get_logger(), "recording to %s", record.path.c_str());
+}
+
+/// the capture threads only wake the timer, the copies and the publish happen here
+void RigNode::bundleTick()
+{
+    /// cancelled first, a set completed meanwhile resets it again
+    bundle_timer_->cancel();
+    while (synchronizer_->take([this](const FrameRef *frames, size_t count, int64_t skew_ns)
+                               { publishBundle(frames, count, skew_ns); }))
+    {}
+}
+
+/// the message buffers keep their capacity between sets
+void RigNode::publishBundle(const FrameRef *frames, size_t count, int64_t skew_ns)
+{
+    if (bundle_pub_->get_subscription_count() == 0)
+    { return; }
+
+    int64_t earliest = frames[0]->stamp_ns;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto &frame = *frames[i];
+        earliest = std::min(earliest, frame.stamp_ns);
+        auto &image = bundle_msg_.images[i];
+        auto &compressed = bundle_msg_.compressed[i];
+        if (isEncoded(frame.format))
+        {
+            compressed.header.stamp = rclcpp::Time(frame.stamp_ns);
+            compressed.format = encodingName(frame.format);
+            compressed.data.assign(frame.data, frame.data + frame.size);
+            image.data.clear();
+        }
+        else
+        {
+            image.header.stamp = rclcpp::Time(frame.stamp_ns);
+            image.encoding = encodingName(frame.format);
+            image.width = static_cast<uint32_t>(frame.width);
+            image.height = static_cast<uint32_t>(frame.height);
+            image.step = static_cast<uint32_t>(frame.stride);
+            image.data.assign(frame.data, frame.data + frame.size);
+            compressed.data.clear();
+        }
+    }
+    bundle_msg_.header.stamp = rclcpp::Time(earliest);
+    bundle_msg_.skew_ms = static_cast<double>(skew_ns) * 1e-6;
+    bundle_pub_->publish(bundle_msg_);
+}
+
+/// composing costs a few ms per frame, it only runs while someone watches
+void RigNode::mosaicTick()
+{
+    if (mosaic_pub_->get_subscription_count() == 0)
+    { return; }
+
+    auto stamp = now();
+    FrameRef frame = mosaic_->compose(stamp.nanoseconds());
+    if (!frame)
+    { return; }
+
+    mosaic_msg_.header.stamp = stamp;
+    mosaic_msg_.data.assign(frame->data, frame->data + frame->size);
+    mosaic_pub_->publish(mosaic_msg_);
+}
+
+void RigNode::diagnosticsTick()
+{
+    if (!synchronizer_)
+    { return; }
+
+    auto stats = synchronizer_->stats();
+    auto mosaic = mosaic_ ? mosaic_->stats() : MosaicCompositor::Stats();
+    auto &status = diagnostics_msg_.status[0];
+    status.hardware_id = "rig";
+    status.level = stats.frames > 0 && stats.match_rate < 0.5 ? diagnostic_msgs::msg::DiagnosticStatus::WARN
+                                                              : diagnostic_msgs::msg::DiagnosticStatus::OK;
+    status.message = stats.sets > 0 ? "matching" : "no sets";
+    status.values.resize(mosaic_ ? 10 : 7);
+    const std::pair<const char *, std::string> values[] = {
+        {"sets", std::to_string(stats.sets)},
+        {"unmatched", std::to_string(stats.unmatched)},
+        {"overflows", std::to_string(stats.overflows)},
+        {"dropped sets", std::to_string(stats.dropped_sets)},
+        {"match rate %", std::to_string(static_cast<int>(100.0 * stats.match_rate + 0.5))},
+        {"mean skew ms", std::to_string(stats.mean_skew_ns * 1e-6)},
+        {"max skew ms", std::to_string(static_cast<double>(stats.max_skew_ns) * 1e-6)},
+        {"mosaic frames", std::to_string(mosaic.composed)},
+        {"mosaic compose ms", std::to_string(mosaic.compose_ms)},
+        {"mosaic unsupported", std::to_string(mosaic.unsupported)},
+    };
+    for (size_t i = 0; i < status.values.size(); ++i)
+    {
+        status.values[i].key = values[i].first;
+        status.values[i].value = values[i].second;
+    }
+
+    if (recorder_)
+    {
+        auto record = recorder_->stats();
+        auto &entry = diagnostics_msg_.status[1];
+        entry.level = record.dropped > recorded_dropped_ || record.write_errors > 0
+                      ? diagnostic_msgs::msg::DiagnosticStatus::WARN : diagnostic_msgs::msg::DiagnosticStatus::OK;
+        entry.message = record.write_errors > 0 ? "write errors" : "recording";
+        recorded_dropped_ = record.dropped;
+        const std::pair<const char *, std::string> record_values[] = {
+            {"messages", std::to_string(record.messages)},
+            {"dropped", std::to_string(record.dropped)},
+            {"dropped diagnostics", std::to_string(record.dropped_diagnostics)},
+            {"write MB/s", std::to_string(record.write_mbps)},
+            {"written MB", std::to_string(static_cast<double>(record.bytes_written) / (1 << 20))},
+            {"compression ratio", std::to_string(record.ratio)},
+            {"queued", std::to_string(record.queued)},
+        };
+        entry.values.resize(sizeof(record_values) / sizeof(record_values[0]));
+        for (size_t i = 0; i < entry.values.size(); ++i)
+        {
+            entry.values[i].key = record_values[i].first;
+            entry.values[i].value = record_values[i].second;
+        }
+    }
+    diagnostics_msg_.header.stamp = now();
+    diagnostics_pub_->publish(diagnostics_msg_);
+}
+
+}  // namespace obsbot_ros
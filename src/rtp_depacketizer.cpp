@@ -0,0 +1,480 @@
+#include <cstring>
+
+#include <obsbot_ros/rtp_depacketizer.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+constexpr uint8_t kStartCode[] = {0, 0, 0, 1};
+
+/// H.264 nal unit types
+constexpr uint8_t kH264Idr = 5;
+constexpr uint8_t kH264Sps = 7;
+constexpr uint8_t kH264Pps = 8;
+constexpr uint8_t kH264StapA = 24;
+constexpr uint8_t kH264FuA = 28;
+
+/// H.265 nal unit types
+constexpr uint8_t kH265IrapFirst = 16;
+constexpr uint8_t kH265IrapLast = 23;
+constexpr uint8_t kH265Vps = 32;
+constexpr uint8_t kH265Sps = 33;
+constexpr uint8_t kH265Pps = 34;
+constexpr uint8_t kH265Ap = 48;
+constexpr uint8_t kH265Fu = 49;
+
+inline uint16_t readU16(const uint8_t *p)
+{
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+inline uint32_t readU32(const uint8_t *p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+/// sequence number distance with wrap around, positive if b is after a
+inline int16_t seqDiff(uint16_t a, uint16_t b)
+{
+    return static_cast<int16_t>(static_cast<uint16_t>(b - a));
+}
+}
+
+bool RtpPacket::parse(const uint8_t *data, size_t size, RtpPacket &out)
+{
+    if (size < 12 || (data[0] >> 6) != 2)
+    { return false; }
+
+    bool padding = (data[0] & 0x20) != 0;
+    bool extension = (data[0] & 0x10) != 0;
+    size_t csrc_count = data[0] & 0x0F;
+
+    out.marker = (data[1] & 0x80) != 0;
+    out.payload_type = data[1] & 0x7F;
+    out.sequence = readU16(data + 2);
+    out.timestamp = readU32(data + 4);
+    out.ssrc = readU32(data + 8);
+
+    size_t offset = 12 + csrc_count * 4;
+    if (extension)
+    {
+        if (offset + 4 > size)
+        { return false; }
+        offset += 4 + static_cast<size_t>(readU16(data + offset + 2)) * 4;
+    }
+
+    size_t end = size;
+    if (padding)
+    {
+        if (size == 0 || data[size - 1] > size)
+        { return false; }
+        end -= data[size - 1];
+    }
+
+    if (offset > end)
+    { return false; }
+
+    out.payload = data + offset;
+    out.payload_size = end - offset;
+    return true;
+}
+
+RtpJitterBuffer::RtpJitterBuffer(size_t depth, size_t packet_size, int64_t max_delay_ns) :
+    max_delay_ns_(max_delay_ns),
+    slots_(depth)
+{
+    for (auto &slot : slots_)
+    { slot.data.resize(packet_size); }
+    ahead_.data.resize(packet_size);
+}
+
+void RtpJitterBuffer::store(Slot &slot, const uint8_t *data, size_t size, uint16_t sequence, int64_t arrival_ns)
+{
+    if (size > slot.data.size())
+    { slot.data.resize(size); }
+    std::memcpy(slot.data.data(), data, size);
+    slot.size = size;
+    slot.sequence = sequence;
+    slot.arrival_ns = arrival_ns;
+}
+
+bool RtpJitterBuffer::push(const uint8_t *data, size_t size, int64_t arrival_ns)
+{
+    if (size < 12)
+    { return false; }
+
+    /// the caller skipped pop() after a jump, what is still queued before it is lost
+    if (ahead_.used)
+    {
+        skipped_ += static_cast<uint64_t>(seqDiff(next_, ahead_.sequence));
+        for (auto &slot : slots_)
+        { slot.used = false; }
+        count_ = 0;
+        placeAhead();
+    }
+
+    uint16_t sequence = readU16(data + 2);
+    if (!started_)
+    {
+        started_ = true;
+        next_ = sequence;
+    }
+
+    int16_t ahead = seqDiff(next_, sequence);
+    if (ahead < 0)
+    { return false; }
+
+    /// too far ahead for the window, it waits aside until pop() has released everything before it
+    if (static_cast<size_t>(ahead) >= slots_.size())
+    {
+        store(ahead_, data, size, sequence, arrival_ns);
+        ahead_.used = true;
+        return true;
+    }
+
+    auto &slot = slots_[sequence % slots_.size()];
+    if (slot.used && slot.sequence == sequence)
+    { return false; }
+
+    store(slot, data, size, sequence, arrival_ns);
+    if (!slot.used)
+    { ++count_; }
+    slot.used = true;
+    return true;
+}
+
+bool RtpJitterBuffer::pop(RtpPacket &packet, int64_t &arrival_ns, int64_t now_ns)
+{
+    while (count_ > 0 || ahead_.used)
+    {
+        if (count_ == 0)
+        {
+            /// nothing left before the jump, the stream continues from there
+            placeAhead();
+            continue;
+        }
+
+        auto &slot = slots_[next_ % slots_.size()];
+        if (slot.used && slot.sequence == next_)
+        {
+            slot.used = false;
+            --count_;
+            ++next_;
+            arrival_ns = slot.arrival_ns;
+            if (RtpPacket::parse(slot.data.data(), slot.size, packet))
+            { return true; }
+            continue;
+        }
+
+        /// next_ is missing, give up on it once the oldest waiting packet is old enough; at once before a jump
+        if (!ahead_.used)
+        {
+            int64_t oldest = now_ns;
+            for (const auto &other : slots_)
+            {
+                if (other.used && other.arrival_ns < oldest)
+                { oldest = other.arrival_ns; }
+            }
+            if (now_ns - oldest < max_delay_ns_)
+            { return false; }
+        }
+
+        ++next_;
+        ++skipped_;
+    }
+    return false;
+}
+
+void RtpJitterBuffer::placeAhead()
+{
+    next_ = ahead_.sequence;
+    auto &slot = slots_[ahead_.sequence % slots_.size()];
+    std::swap(slot.data, ahead_.data);
+    slot.size = ahead_.size;
+    slot.sequence = ahead_.sequence;
+    slot.arrival_ns = ahead_.arrival_ns;
+    slot.used = true;
+    ++count_;
+    ahead_.used = false;
+}
+
+void RtpJitterBuffer::reset()
+{
+    for (auto &slot : slots_)
+    { slot.used = false; }
+    ahead_.used = false;
+    count_ = 0;
+    started_ = false;
+}
+
+RtpDepacketizer::RtpDepacketizer(Codec codec, size_t max_au_size) :
+    codec_(codec),
+    max_au_size_(max_au_size)
+{
+    for (auto &buffer : buffers_)
+    { buffer.data.resize(max_au_size); }
+}
+
+void RtpDepacketizer::setParameterSets(const std::vector<uint8_t> &annexb)
+{
+    parameter_sets_ = annexb;
+}
+
+void RtpDepacketizer::push(const RtpPacket &packet)
+{
+    /// the unit handed out by next() is free again
+    lent_ = kBufferCount;
+
+    /// a gap poisons the unit it falls into
+    if (have_sequence_ && packet.sequence != static_cast<uint16_t>(last_sequence_ + 1))
+    {
+        int16_t gap = seqDiff(last_sequence_, packet.sequence);
+        if (gap <= 0)
+        { return; }
+        lost_ += static_cast<uint64_t>(gap - 1);
+        current().corrupt = true;
+        in_fragment_ = false;
+    }
+    have_sequence_ = true;
+    last_sequence_ = packet.sequence;
+
+    if (current().size > 0 && packet.timestamp != current().timestamp)
+    { finish(); }
+    if (current().size == 0)
+    { current().timestamp = packet.timestamp; }
+
+    bool ok = codec_ == Codec::H264 ? handleH264(packet) : handleH265(packet);
+    if (!ok)
+    { current().corrupt = true; }
+
+    if (packet.marker)
+    { finish(); }
+}
+
+bool RtpDepacketizer::next(AccessUnit &au)
+{
+    if (ready_count_ == 0)
+    { return false; }
+
+    lent_ = ready_[0];
+    for (size_t i = 1; i < ready_count_; ++i)
+    { ready_[i - 1] = ready_[i]; }
+    --ready_count_;
+
+    const auto &buffer = buffers_[lent_];
+    au.data = buffer.data.data();
+    au.size = buffer.size;
+    au.rtp_timestamp = buffer.timestamp;
+    au.keyframe = buffer.keyframe;
+    return true;
+}
+
+void RtpDepacketizer::finish()
+{
+    auto &buffer = current();
+    if (buffer.size > 0 && !buffer.corrupt)
+    {
+        /// nobody drained the queue, the oldest unit makes room
+        if (ready_count_ + 2 > kBufferCount)
+        {
+            for (size_t i = 1; i < ready_count_; ++i)
+            { ready_[i - 1] = ready_[i]; }
+            --ready_count_;
+            ++dropped_;
+        }
+        ready_[ready_count_++] = current_;
+
+        for (size_t i = 0; i < kBufferCount; ++i)
+        {
+            bool busy = i == lent_;
+            for (size_t r = 0; r < ready_count_ && !busy; ++r)
+            { busy = ready_[r] == i; }
+            if (!busy)
+            {
+                current_ = i;
+                break;
+            }
+        }
+    }
+    else if (buffer.size > 0)
+    {
+        ++dropped_;
+    }
+
+    auto &next = current();
+    next.size = 0;
+    next.keyframe = false;
+    next.has_parameter_sets = false;
+    next.corrupt = false;
+    in_fragment_ = false;
+}
+
+void RtpDepacketizer::appendBytes(const uint8_t *data, size_t size)
+{
+    if (current().size + size > max_au_size_)
+    {
+        current().corrupt = true;
+        return;
+    }
+    std::memcpy(current().data.data() + current().size, data, size);
+    current().size += size;
+}
+
+void RtpDepacketizer::appendStartCode()
+{
+    appendBytes(kStartCode, sizeof(kStartCode));
+}
+
+void RtpDepacketizer::appendNal(const uint8_t *nal, size_t size)
+{
+    if (size == 0)
+    { return; }
+    inspectNal(nal[0]);
+    appendStartCode();
+    appendBytes(nal, size);
+}
+
+/// track keyframes and in-band parameter sets, prepend the sdp ones to keyframes that come without
+void RtpDepacketizer::inspectNal(uint8_t header0)
+{
+    bool keyframe, parameter_set;
+    if (codec_ == Codec::H264)
+    {
+        uint8_t type = header0 & 0x1F;
+        keyframe = type == kH264Idr;
+        parameter_set = type == kH264Sps || type == kH264Pps;
+    }
+    else
+    {
+        uint8_t type = (header0 >> 1) & 0x3F;
+        keyframe = type >= kH265IrapFirst && type <= kH265IrapLast;
+        parameter_set = type == kH265Vps || type == kH265Sps || type == kH265Pps;
+    }
+
+    if (parameter_set)
+    { current().has_parameter_sets = true; }
+    if (keyframe && !current().keyframe)
+    {
+        current().keyframe = true;
+        if (!current().has_parameter_sets && !parameter_sets_.empty())
+        {
+            appendBytes(parameter_sets_.data(), parameter_sets_.size());
+            current().has_parameter_sets = true;
+        }
+    }
+}
+
+bool RtpDepacketizer::handleH264(const RtpPacket &packet)
+{
+    const uint8_t *p = packet.payload;
+    size_t size = packet.payload_size;
+    if (size < 1)
+    { return false; }
+
+    uint8_t type = p[0] & 0x1F;
+    if (type >= 1 && type <= 23)
+    {
+        appendNal(p, size);
+        return true;
+    }
+
+    if (type == kH264StapA)
+    {
+        size_t offset = 1;
+        while (offset + 2 <= size)
+        {
+            size_t nal_size = readU16(p + offset);
+            offset += 2;
+            if (offset + nal_size > size)
+            { return false; }
+            appendNal(p + offset, nal_size);
+            offset += nal_size;
+        }
+        return true;
+    }
+
+    if (type == kH264FuA)
+    {
+        if (size < 2)
+        { return false; }
+        bool start = (p[1] & 0x80) != 0;
+        if (start)
+        {
+            uint8_t header = static_cast<uint8_t>((p[0] & 0xE0) | (p[1] & 0x1F));
+            inspectNal(header);
+            appendStartCode();
+            appendBytes(&header, 1);
+            in_fragment_ = true;
+        }
+        else if (!in_fragment_)
+        {
+            return false;
+        }
+        appendBytes(p + 2, size - 2);
+        if (p[1] & 0x40)
+        { in_fragment_ = false; }
+        return true;
+    }
+
+    return false;
+}
+
+bool RtpDepacketizer::handleH265(const RtpPacket &packet)
+{
+    const uint8_t *p = packet.payload;
+    size_t size = packet.payload_size;
+    if (size < 2)
+    { return false; }
+
+    uint8_t type = (p[0] >> 1) & 0x3F;
+    if (type < kH265Ap)
+    {
+        appendNal(p, size);
+        return true;
+    }
+
+    if (type == kH265Ap)
+    {
+        size_t offset = 2;
+        while (offset + 2 <= size)
+        {
+            size_t nal_size = readU16(p + offset);
+            offset += 2;
+            if (offset + nal_size > size)
+            { return false; }
+            appendNal(p + offset, nal_size);
+            offset += nal_size;
+        }
+        return true;
+    }
+
+    if (type == kH265Fu)
+    {
+        if (size < 3)
+        { return false; }
+        bool start = (p[2] & 0x80) != 0;
+        if (start)
+        {
+            uint8_t header[2] = {static_cast<uint8_t>((p[0] & 0x81) | ((p[2] & 0x3F) << 1)), p[1]};
+            inspectNal(header[0]);
+            appendStartCode();
+            appendBytes(header, 2);
+            in_fragment_ = true;
+        }
+        else if (!in_fragment_)
+        {
+            return false;
+        }
+        appendBytes(p + 3, size - 3);
+        if (p[2] & 0x40)
+        { in_fragment_ = false; }
+        return true;
+    }
+
+    return false;
+}
+
+}  // namespace obsbot_ros
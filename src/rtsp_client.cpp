@@ -0,0 +1,892 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <obsbot_ros/rtsp_client.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+constexpr int32_t kPollSliceMs = 100;
+constexpr int32_t kMaxReconnectMs = 10000;
+constexpr size_t kMaxUdpPacket = 65536;
+constexpr size_t kDefaultMtu = 1500;
+constexpr size_t kMaxRtspMessage = 65536;
+
+int64_t systemNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool startsWithNoCase(const std::string &s, size_t pos, const char *prefix)
+{
+    size_t n = std::strlen(prefix);
+    return s.size() >= pos + n && strncasecmp(s.c_str() + pos, prefix, n) == 0;
+}
+
+/// value of a header in a response, empty if missing
+std::string headerValue(const std::string &response, const char *name)
+{
+    size_t pos = 0;
+    while ((pos = response.find("\r\n", pos)) != std::string::npos)
+    {
+        pos += 2;
+        if (startsWithNoCase(response, pos, name) && response.size() > pos + std::strlen(name) &&
+            response[pos + std::strlen(name)] == ':')
+        {
+            size_t begin = response.find_first_not_of(' ', pos + std::strlen(name) + 1);
+            size_t end = response.find("\r\n", begin);
+            return begin == std::string::npos ? "" : response.substr(begin, end - begin);
+        }
+    }
+    return "";
+}
+
+int32_t statusCode(const std::string &response)
+{
+    int code = 0;
+    if (std::sscanf(response.c_str(), "RTSP/1.0 %d", &code) != 1)
+    { return 0; }
+    return code;
+}
+
+/// decode standard base64, stops at the first character outside the alphabet
+std::vector<uint8_t> base64Decode(const std::string &in)
+{
+    std::vector<uint8_t> out;
+    uint32_t acc = 0;
+    int bits = 0;
+    for (char c : in)
+    {
+        int v;
+        if (c >= 'A' && c <= 'Z')
+        { v = c - 'A'; }
+        else if (c >= 'a' && c <= 'z')
+        { v = c - 'a' + 26; }
+        else if (c >= '0' && c <= '9')
+        { v = c - '0' + 52; }
+        else if (c == '+')
+        { v = 62; }
+        else if (c == '/')
+        { v = 63; }
+        else
+        { break; }
+        acc = (acc << 6) | static_cast<uint32_t>(v);
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            out.push_back(static_cast<uint8_t>(acc >> bits));
+        }
+    }
+    return out;
+}
+
+/// append comma separated base64 nal units in Annex-B format
+void appendParameterSets(const std::string &list, std::vector<uint8_t> &annexb)
+{
+    size_t pos = 0;
+    while (pos < list.size())
+    {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos)
+        { end = list.size(); }
+        auto nal = base64Decode(list.substr(pos, end - pos));
+        if (!nal.empty())
+        {
+            annexb.insert(annexb.end(), {0, 0, 0, 1});
+            annexb.insert(annexb.end(), nal.begin(), nal.end());
+        }
+        pos = end + 1;
+    }
+}
+
+/// value of key=value inside an fmtp line, empty if missing
+std::string fmtpValue(const std::string &fmtp, const char *key)
+{
+    std::string pattern = std::string(key) + "=";
+    size_t pos = 0;
+    while ((pos = fmtp.find(pattern, pos)) != std::string::npos)
+    {
+        if (pos == 0 || fmtp[pos - 1] == ' ' || fmtp[pos - 1] == ';')
+        {
+            size_t begin = pos + pattern.size();
+            size_t end = fmtp.find(';', begin);
+            auto value = fmtp.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+            value.erase(value.find_last_not_of(" \r\n") + 1);
+            return value;
+        }
+        pos += pattern.size();
+    }
+    return "";
+}
+
+bool waitReadable(int fd, int32_t timeout_ms)
+{
+    pollfd pfd{fd, POLLIN, 0};
+    int ret;
+    do
+    {
+        ret = poll(&pfd, 1, timeout_ms);
+    } while (ret == -1 && errno == EINTR);
+    return ret > 0;
+}
+
+void closeFd(int &fd)
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+}
+}
+
+struct RtspClient::Session
+{
+    int fd = -1;                                /// rtsp connection, also carries interleaved rtp
+    int rtp_fd = -1;                            /// udp transport only
+    int rtcp_fd = -1;
+    uint32_t cseq = 0;
+    std::string id;
+    int32_t timeout_s = 60;
+    std::string control_url;
+    uint8_t payload_type = 96;
+    uint8_t rtp_channel = 0;
+    uint32_t clock_rate = 90000;
+    RtpDepacketizer::Codec codec = RtpDepacketizer::Codec::H264;
+    std::unique_ptr<RtpDepacketizer> depacketizer;
+    std::unique_ptr<RtpJitterBuffer> jitter;
+
+    /// bytes read from the rtsp connection but not consumed yet
+    std::vector<uint8_t> rx;
+    size_t rx_pos = 0;
+    std::vector<uint8_t> packet;
+    bool broken = false;                        /// the server closed the connection
+
+    /// rtp clock to system clock, offset is the smallest arrival - rtp time seen so far
+    bool mapped = false;
+    uint32_t last_rtp = 0;
+    int64_t rtp_ticks = 0;
+    int64_t offset_ns = 0;
+    int64_t last_mapped_arrival_ns = 0;
+    int64_t delay_ns = 0;                       /// smoothed arrival - mapped time
+
+    /// interarrival jitter
+    bool have_transit = false;
+    int64_t last_arrival_ns = 0;
+    uint32_t last_arrival_rtp = 0;
+    double interarrival_jitter = 0.0;           /// rtp units
+
+    std::chrono::steady_clock::time_point last_keepalive;
+    std::chrono::steady_clock::time_point last_packet;
+};
+
+RtspClient::~RtspClient()
+{
+    stop();
+}
+
+bool RtspClient::parseUrl(const std::string &url, std::string &host, uint16_t &port)
+{
+    const std::string scheme = "rtsp://";
+    if (url.compare(0, scheme.size(), scheme) != 0)
+    { return false; }
+    auto authority_end = std::min(url.find('/', scheme.size()), url.size());
+    auto authority = url.substr(scheme.size(), authority_end - scheme.size());
+    auto at = authority.rfind('@');
+    if (at != std::string::npos)
+    { authority = authority.substr(at + 1); }
+
+    std::string port_text;
+    if (!authority.empty() && authority[0] == '[')
+    {
+        auto bracket = authority.find(']');
+        if (bracket == std::string::npos)
+        { return false; }
+        host = authority.substr(1, bracket - 1);
+        if (bracket + 1 < authority.size())
+        {
+            if (authority[bracket + 1] != ':')
+            { return false; }
+            port_text = authority.substr(bracket + 2);
+        }
+    }
+    else if (authority.find(':') != authority.rfind(':'))
+    {
+        /// an ipv6 literal without brackets can not carry a port
+        host = authority;
+    }
+    else
+    {
+        auto colon = authority.find(':');
+        host = authority.substr(0, colon);
+        if (colon != std::string::npos)
+        { port_text = authority.substr(colon + 1); }
+    }
+
+    port = 554;
+    if (!port_text.empty())
+    {
+        if (port_text.size() > 5 || port_text.find_first_not_of("0123456789") != std::string::npos)
+        { return false; }
+        auto value = std::atoi(port_text.c_str());
+        if (value > 65535)
+        { return false; }
+        port = static_cast<uint16_t>(value);
+    }
+    return !host.empty() && port != 0;
+}
+
+bool RtspClient::start(const Options &options, AccessUnitCallback callback)
+{
+    if (running_)
+    { return false; }
+
+    if (!parseUrl(options.url, host_, port_))
+    {
+        setError("bad rtsp url: " + options.url);
+        return false;
+    }
+
+    options_ = options;
+    callback_ = std::move(callback);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_ = Stats();
+    }
+    running_ = true;
+    thread_ = std::thread(&RtspClient::run, this);
+    return true;
+}
+
+void RtspClient::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        /// ends a connect at once and makes reads see the end of the stream, sending stays possible for TEARDOWN
+        if (control_fd_ >= 0)
+        { ::shutdown(control_fd_, SHUT_RD); }
+    }
+    if (thread_.joinable())
+    { thread_.join(); }
+}
+
+RtspClient::Stats RtspClient::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+std::string RtspClient::lastError() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return last_error_;
+}
+
+void RtspClient::setError(const std::string &error)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    last_error_ = error;
+}
+
+/// session loop, every failure ends in a reconnect with a growing delay
+void RtspClient::run()
+{
+    int32_t delay_ms = std::max(kPollSliceMs, options_.reconnect_ms);
+    bool first = true;
+    while (running_)
+    {
+        if (!first)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stats_.reconnects;
+        }
+        first = false;
+
+        Session session;
+        if (connect(session))
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stats_.connected = true;
+            }
+            delay_ms = std::max(kPollSliceMs, options_.reconnect_ms);
+            receive(session);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stats_.connected = false;
+            }
+        }
+        teardown(session);
+
+        for (int32_t waited = 0; running_ && waited < delay_ms; waited += kPollSliceMs)
+        { std::this_thread::sleep_for(std::chrono::milliseconds(kPollSliceMs)); }
+        delay_ms = std::min(kMaxReconnectMs, delay_ms * 2);
+    }
+}
+
+bool RtspClient::connect(Session &session)
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = nullptr;
+    if (getaddrinfo(host_.c_str(), std::to_string(port_).c_str(), &hints, &result) != 0 || !result)
+    {
+        setError("can not resolve " + host_);
+        return false;
+    }
+    for (auto *ai = result; ai && session.fd < 0; ai = ai->ai_next)
+    {
+        session.fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (session.fd < 0)
+        { continue; }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_)
+            {
+                closeFd(session.fd);
+                break;
+            }
+            control_fd_ = session.fd;
+        }
+        timeval tv{options_.timeout_ms / 1000, (options_.timeout_ms % 1000) * 1000};
+        setsockopt(session.fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        if (::connect(session.fd, ai->ai_addr, ai->ai_addrlen) != 0)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            control_fd_ = -1;
+            closeFd(session.fd);
+        }
+    }
+    freeaddrinfo(result);
+    if (session.fd < 0)
+    {
+        if (running_)
+        { setError("can not connect to " + host_ + ":" + std::to_string(port_) + ": " + std::strerror(errno)); }
+        return false;
+    }
+    int one = 1;
+    setsockopt(session.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    std::string response;
+    if (!request(session, "DESCRIBE", options_.url, "Accept: application/sdp\r\n", response))
+    { return false; }
+
+    /// media level attributes of the first video stream
+    auto body_pos = response.find("\r\n\r\n");
+    auto sdp = body_pos == std::string::npos ? std::string() : response.substr(body_pos + 4);
+    auto base = headerValue(response, "Content-Base");
+    if (base.empty())
+    { base = options_.url; }
+    std::string control, fmtp, encoding;
+    bool in_video = false;
+    size_t pos = 0;
+    while (pos < sdp.size())
+    {
+        auto end = sdp.find('\n', pos);
+        auto line = sdp.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        pos = end == std::string::npos ? sdp.size() : end + 1;
+        if (!line.empty() && line.back() == '\r')
+        { line.pop_back(); }
+
+        if (line.compare(0, 2, "m=") == 0)
+        {
+            if (in_video)
+            { break; }
+            in_video = line.compare(0, 8, "m=video ") == 0;
+            unsigned port, pt;
+            if (in_video && std::sscanf(line.c_str(), "m=video %u RTP/AVP %u", &port, &pt) == 2)
+            { session.payload_type = static_cast<uint8_t>(pt); }
+            continue;
+        }
+        if (!in_video)
+        { continue; }
+
+        char name[32] = {};
+        unsigned pt, rate;
+        if (std::sscanf(line.c_str(), "a=rtpmap:%u %31[^/]/%u", &pt, name, &rate) == 3 && pt == session.payload_type)
+        {
+            encoding = name;
+            session.clock_rate = rate;
+        }
+        else if (line.compare(0, 10, "a=control:") == 0)
+        {
+            control = line.substr(10);
+        }
+        else if (line.compare(0, 7, "a=fmtp:") == 0)
+        {
+            fmtp = line.substr(line.find(' ') == std::string::npos ? line.size() : line.find(' ') + 1);
+        }
+    }
+
+    std::vector<uint8_t> parameter_sets;
+    if (strcasecmp(encoding.c_str(), "H264") == 0)
+    {
+        session.codec = RtpDepacketizer::Codec::H264;
+        appendParameterSets(fmtpValue(fmtp, "sprop-parameter-sets"), parameter_sets);
+    }
+    else if (strcasecmp(encoding.c_str(), "H265") == 0)
+    {
+        session.codec = RtpDepacketizer::Codec::H265;
+        appendParameterSets(fmtpValue(fmtp, "sprop-vps"), parameter_sets);
+        appendParameterSets(fmtpValue(fmtp, "sprop-sps"), parameter_sets);
+        appendParameterSets(fmtpValue(fmtp, "sprop-pps"), parameter_sets);
+    }
+    else
+    {
+        setError("no h264 or h265 video in the stream description");
+        return false;
+    }
+    if (session.clock_rate == 0)
+    { session.clock_rate = 90000; }
+
+    if (control.empty() || control == "*")
+    { session.control_url = base; }
+    else if (control.compare(0, 7, "rtsp://") == 0)
+    { session.control_url = control; }
+    else
+    { session.control_url = base + (base.back() == '/' ? "" : "/") + control; }
+
+    session.depacketizer = std::make_unique<RtpDepacketizer>(session.codec, options_.max_au_size);
+    session.depacketizer->setParameterSets(parameter_sets);
+    if (options_.jitter_buffer)
+    {
+        /// slots are sized for the path mtu, a larger packet (interleaved ones may reach 64 KiB) grows its slot
+        int mtu = 0;
+        socklen_t mtu_len = sizeof(mtu);
+        if (getsockopt(session.fd, IPPROTO_IP, IP_MTU, &mtu, &mtu_len) != 0 &&
+            getsockopt(session.fd, IPPROTO_IPV6, IPV6_MTU, &mtu, &mtu_len) != 0)
+        { mtu = 0; }
+        session.jitter = std::make_unique<RtpJitterBuffer>(std::max<uint32_t>(2, options_.jitter_depth),
+                                                           mtu > 0 ? static_cast<size_t>(mtu) : kDefaultMtu,
+                                                           static_cast<int64_t>(options_.jitter_delay_ms) * 1000000);
+    }
+    session.packet.resize(kMaxUdpPacket);
+
+    std::string transport;
+    if (options_.tcp)
+    {
+        transport = "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n";
+    }
+    else
+    {
+        /// rtp on an even port and rtcp on the next one, as most servers expect
+        for (int attempt = 0; attempt < 16 && session.rtcp_fd < 0; ++attempt)
+        {
+            closeFd(session.rtp_fd);
+            session.rtp_fd = socket(AF_INET, SOCK_DGRAM, 0);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_ANY);
+            socklen_t len = sizeof(addr);
+            if (session.rtp_fd < 0 || bind(session.rtp_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+                getsockname(session.rtp_fd, reinterpret_cast<sockaddr *>(&addr), &len) != 0)
+            { continue; }
+            uint16_t port = ntohs(addr.sin_port);
+            if (port % 2 != 0)
+            { continue; }
+            session.rtcp_fd = socket(AF_INET, SOCK_DGRAM, 0);
+            addr.sin_port = htons(static_cast<uint16_t>(port + 1));
+            if (session.rtcp_fd >= 0 && bind(session.rtcp_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+            { closeFd(session.rtcp_fd); }
+        }
+        if (session.rtcp_fd < 0)
+        {
+            setError("can not bind udp ports");
+            return false;
+        }
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        getsockname(session.rtp_fd, reinterpret_cast<sockaddr *>(&addr), &len);
+        auto port = ntohs(addr.sin_port);
+        transport = "Transport: RTP/AVP;unicast;client_port=" + std::to_string(port) + "-" + std::to_string(port + 1) +
+                    "\r\n";
+        int size = 4 << 20;
+        setsockopt(session.rtp_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+
+    if (!request(session, "SETUP", session.control_url, transport, response))
+    { return false; }
+
+    /// Session: id[;timeout=n]
+    auto session_header = headerValue(response, "Session");
+    auto semicolon = session_header.find(';');
+    session.id = session_header.substr(0, semicolon);
+    auto timeout_pos = session_header.find("timeout=");
+    if (timeout_pos != std::string::npos)
+    { session.timeout_s = std::max(2, std::atoi(session_header.c_str() + timeout_pos + 8)); }
+    auto reply_transport = headerValue(response, "Transport");
+    auto interleaved = reply_transport.find("interleaved=");
+    if (interleaved != std::string::npos)
+    { session.rtp_channel = static_cast<uint8_t>(std::atoi(reply_transport.c_str() + interleaved + 12)); }
+
+    if (!request(session, "PLAY", base, "Range: npt=0.000-\r\n", response))
+    { return false; }
+
+    session.last_keepalive = std::chrono::steady_clock::now();
+    session.last_packet = session.last_keepalive;
+    return true;
+}
+
+/// receive until the stream stops, times out or stop() is called
+bool RtspClient::receive(Session &session)
+{
+    auto timeout = std::chrono::milliseconds(options_.timeout_ms);
+    auto keepalive = std::chrono::seconds(std::max(1, session.timeout_s / 2));
+
+    while (running_)
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now - session.last_keepalive > keepalive)
+        {
+            /// the reply is skipped by the readers below
+            std::string message = "GET_PARAMETER " + session.control_url + " RTSP/1.0\r\nCSeq: " +
+                                  std::to_string(++session.cseq) + "\r\nSession: " + session.id + "\r\n\r\n";
+            if (send(session.fd, message.data(), message.size(), MSG_NOSIGNAL) < 0)
+            {
+                setError(std::string("keepalive failed: ") + std::strerror(errno));
+                return false;
+            }
+            session.last_keepalive = now;
+        }
+        if (now - session.last_packet > timeout)
+        {
+            setError("no video packets for " + std::to_string(options_.timeout_ms) + " ms");
+            return false;
+        }
+
+        if (options_.tcp)
+        {
+            uint8_t channel = 0;
+            if (!readPacket(session, session.packet, channel))
+            {
+                if (session.broken)
+                { return false; }
+                continue;
+            }
+            if (channel == session.rtp_channel)
+            { handlePacket(session, session.packet.data(), session.packet.size(), systemNs()); }
+            continue;
+        }
+
+        pollfd pfds[2] = {{session.rtp_fd, POLLIN, 0}, {session.fd, POLLIN, 0}};
+        int32_t slice = session.jitter ? std::min(kPollSliceMs, std::max(1, options_.jitter_delay_ms / 2))
+                                       : kPollSliceMs;
+        int ret = poll(pfds, 2, slice);
+        if (ret < 0 && errno != EINTR)
+        {
+            setError(std::string("poll failed: ") + std::strerror(errno));
+            return false;
+        }
+        if (ret > 0 && (pfds[1].revents & POLLIN))
+        {
+            /// only keepalive replies arrive here, drop them
+            uint8_t discard[4096];
+            if (recv(session.fd, discard, sizeof(discard), 0) <= 0)
+            {
+                if (running_)
+                { setError("server closed the connection"); }
+                return false;
+            }
+        }
+        if (ret > 0 && (pfds[0].revents & POLLIN))
+        {
+            auto n = recv(session.rtp_fd, session.packet.data(), kMaxUdpPacket, 0);
+            if (n > 0)
+            { handlePacket(session, session.packet.data(), static_cast<size_t>(n), systemNs()); }
+        }
+        else if (session.jitter)
+        {
+            /// nothing arrived, packets waiting for a lost predecessor may be due
+            handlePacket(session, nullptr, 0, systemNs());
+        }
+    }
+    return true;
+}
+
+void RtspClient::teardown(Session &session)
+{
+    if (session.fd >= 0 && !session.id.empty())
+    {
+        std::string message = "TEARDOWN " + session.control_url + " RTSP/1.0\r\nCSeq: " +
+                              std::to_string(++session.cseq) + "\r\nSession: " + session.id + "\r\n\r\n";
+        send(session.fd, message.data(), message.size(), MSG_NOSIGNAL);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        control_fd_ = -1;
+    }
+    closeFd(session.fd);
+    closeFd(session.rtp_fd);
+    closeFd(session.rtcp_fd);
+}
+
+bool RtspClient::request(Session &session, const char *method, const std::string &url, const std::string &headers,
+                         std::string &response)
+{
+    auto cseq = ++session.cseq;
+    std::string message = std::string(method) + " " + url + " RTSP/1.0\r\nCSeq: " + std::to_string(cseq) +
+                          "\r\nUser-Agent: obsbot_ros\r\n";
+    if (!session.id.empty())
+    { message += "Session: " + session.id + "\r\n"; }
+    message += headers + "\r\n";
+    if (send(session.fd, message.data(), message.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(message.size()))
+    {
+        setError(std::string(method) + " send failed: " + std::strerror(errno));
+        return false;
+    }
+
+    /// interleaved data may come before the reply, readPacket() skips it and leaves the reply in rx
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options_.timeout_ms);
+    while (running_ && std::chrono::steady_clock::now() < deadline)
+    {
+        auto begin = session.rx.begin() + static_cast<long>(session.rx_pos);
+        const char terminator[] = "\r\n\r\n";
+        auto header_end = std::search(begin, session.rx.end(), terminator, terminator + 4);
+        if (header_end != session.rx.end() && session.rx[session.rx_pos] != '$')
+        {
+            std::string header(begin, header_end + 4);
+            auto length = static_cast<size_t>(std::max(0, std::atoi(headerValue(header, "Content-Length").c_str())));
+            auto total = header.size() + length;
+            if (session.rx.size() - session.rx_pos >= total)
+            {
+                response.assign(reinterpret_cast<const char *>(session.rx.data() + session.rx_pos), total);
+                session.rx_pos += total;
+                if (headerValue(response, "CSeq") != std::to_string(cseq))
+                { continue; }
+                auto code = statusCode(response);
+                if (code != 200)
+                {
+                    setError(std::string(method) + " failed with status " + std::to_string(code));
+                    return false;
+                }
+                return true;
+            }
+        }
+
+        uint8_t channel;
+        if (session.rx_pos < session.rx.size() && session.rx[session.rx_pos] == '$')
+        {
+            readPacket(session, session.packet, channel);
+            continue;
+        }
+        if (session.rx.size() - session.rx_pos > kMaxRtspMessage)
+        {
+            setError(std::string(method) + " reply too large");
+            return false;
+        }
+
+        if (session.rx_pos > 0)
+        {
+            session.rx.erase(session.rx.begin(), session.rx.begin() + static_cast<long>(session.rx_pos));
+            session.rx_pos = 0;
+        }
+        if (!waitReadable(session.fd, kPollSliceMs))
+        { continue; }
+        uint8_t buf[4096];
+        auto n = recv(session.fd, buf, sizeof(buf), 0);
+        if (n <= 0)
+        {
+            if (running_)
+            { setError(std::string(method) + ": server closed the connection"); }
+            return false;
+        }
+        session.rx.insert(session.rx.end(), buf, buf + n);
+    }
+    if (running_)
+    { setError(std::string(method) + " timed out"); }
+    return false;
+}
+
+/// next interleaved frame from the rtsp connection, rtsp replies in between are dropped
+bool RtspClient::readPacket(Session &session, std::vector<uint8_t> &packet, uint8_t &channel)
+{
+    while (true)
+    {
+        size_t available = session.rx.size() - session.rx_pos;
+        const uint8_t *p = session.rx.data() + session.rx_pos;
+        if (available >= 4 && p[0] == '$')
+        {
+            size_t length = (static_cast<size_t>(p[2]) << 8) | p[3];
+            if (available >= 4 + length)
+            {
+                channel = p[1];
+                packet.assign(p + 4, p + 4 + length);
+                session.rx_pos += 4 + length;
+                return true;
+            }
+        }
+        else if (available > 0 && p[0] != '$')
+        {
+            /// a keepalive reply, skip it once its header and body are complete
+            const char terminator[] = "\r\n\r\n";
+            auto begin = session.rx.begin() + static_cast<long>(session.rx_pos);
+            auto header_end = std::search(begin, session.rx.end(), terminator, terminator + 4);
+            bool lost = false;
+            if (header_end != session.rx.end())
+            {
+                std::string header(begin, header_end + 4);
+                /// a negative or overflowing length comes out huge and is refused with the rest
+                auto length = std::strtoull(headerValue(header, "Content-Length").c_str(), nullptr, 10);
+                if (header.size() > kMaxRtspMessage || length > kMaxRtspMessage - header.size())
+                { lost = true; }
+                else if (available >= header.size() + length)
+                {
+                    session.rx_pos += header.size() + length;
+                    continue;
+                }
+            }
+            else if (available > kMaxRtspMessage)
+            { lost = true; }
+            if (lost)
+            {
+                /// lost framing or a body no keepalive reply has, resync on the next '$'
+                auto dollar = std::find(begin + 1, session.rx.end(), '$');
+                session.rx_pos = static_cast<size_t>(dollar - session.rx.begin());
+                continue;
+            }
+        }
+
+        if (session.rx_pos > 0)
+        {
+            session.rx.erase(session.rx.begin(), session.rx.begin() + static_cast<long>(session.rx_pos));
+            session.rx_pos = 0;
+        }
+        if (!waitReadable(session.fd, kPollSliceMs))
+        { return false; }
+        size_t old_size = session.rx.size();
+        session.rx.resize(old_size + kMaxUdpPacket);
+        auto n = recv(session.fd, session.rx.data() + old_size, kMaxUdpPacket, 0);
+        session.rx.resize(old_size + static_cast<size_t>(std::max<ssize_t>(0, n)));
+        if (n <= 0)
+        {
+            if (running_)
+            { setError("server closed the connection"); }
+            session.broken = true;
+            return false;
+        }
+    }
+}
+
+void RtspClient::handlePacket(Session &session, const uint8_t *data, size_t size, int64_t arrival_ns)
+{
+    if (size >= 12)
+    {
+        /// interarrival jitter in rtp units (RFC 3550 6.4.1), taken in arrival order before any reordering
+        uint32_t rtp_timestamp = (static_cast<uint32_t>(data[4]) << 24) | (static_cast<uint32_t>(data[5]) << 16) |
+                                 (static_cast<uint32_t>(data[6]) << 8) | data[7];
+        if (session.have_transit)
+        {
+            double d = static_cast<double>(arrival_ns - session.last_arrival_ns) * 1e-9 * session.clock_rate -
+                       static_cast<int32_t>(rtp_timestamp - session.last_arrival_rtp);
+            session.interarrival_jitter += (std::abs(d) - session.interarrival_jitter) / 16.0;
+        }
+        session.have_transit = true;
+        session.last_arrival_ns = arrival_ns;
+        session.last_arrival_rtp = rtp_timestamp;
+    }
+
+    if (size > 0)
+    {
+        session.last_packet = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.packets;
+        stats_.bytes += size;
+        stats_.jitter_ms = session.interarrival_jitter * 1000.0 / session.clock_rate;
+    }
+
+    if (!session.jitter)
+    {
+        RtpPacket packet;
+        if (RtpPacket::parse(data, size, packet))
+        { deliver(session, packet, arrival_ns); }
+        return;
+    }
+
+    if (size > 0)
+    { session.jitter->push(data, size, arrival_ns); }
+    RtpPacket packet;
+    int64_t packet_arrival_ns;
+    while (session.jitter->pop(packet, packet_arrival_ns, arrival_ns))
+    { deliver(session, packet, packet_arrival_ns); }
+}
+
+void RtspClient::deliver(Session &session, const RtpPacket &packet, int64_t arrival_ns)
+{
+    if (packet.payload_type != session.payload_type)
+    { return; }
+
+    auto mapped_ns = mapTimestamp(session, packet.timestamp, arrival_ns);
+    session.delay_ns += (arrival_ns - mapped_ns - session.delay_ns) / 16;
+    auto stamp_ns = options_.map_timestamps ? mapped_ns : arrival_ns;
+    session.depacketizer->push(packet);
+
+    uint64_t units = 0;
+    AccessUnit au;
+    while (session.depacketizer->next(au))
+    {
+        /// units completed by a timestamp change belong to an earlier rtp time
+        auto au_stamp_ns = stamp_ns;
+        if (options_.map_timestamps && au.rtp_timestamp != packet.timestamp)
+        { au_stamp_ns = mapTimestamp(session, au.rtp_timestamp, arrival_ns); }
+        callback_(au, session.codec, au_stamp_ns);
+        ++units;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.units += units;
+    stats_.lost = session.depacketizer->lostPackets() + (session.jitter ? session.jitter->skipped() : 0);
+    stats_.dropped_units = session.depacketizer->droppedUnits();
+    stats_.delay_ms = static_cast<double>(session.delay_ns) * 1e-6;
+}
+
+/**
+ * rtp time is unwrapped and moved onto the system clock with the smallest offset seen, ie. the packet that waited the
+ * least in the network. The offset may grow by 100 ppm of elapsed time so clock drift between camera and host does
+ * not pin it to an old minimum. Always tracked, the delay statistic is measured against it.
+ */
+int64_t RtspClient::mapTimestamp(Session &session, uint32_t rtp_timestamp, int64_t arrival_ns)
+{
+    if (!session.mapped)
+    {
+        session.mapped = true;
+        session.last_rtp = rtp_timestamp;
+        session.rtp_ticks = 0;
+        session.offset_ns = arrival_ns;
+        session.last_mapped_arrival_ns = arrival_ns;
+        return arrival_ns;
+    }
+
+    int64_t ticks = session.rtp_ticks + static_cast<int32_t>(rtp_timestamp - session.last_rtp);
+    int64_t rtp_ns = ticks * 1000000000LL / session.clock_rate;
+    if (static_cast<int32_t>(rtp_timestamp - session.last_rtp) > 0)
+    {
+        session.last_rtp = rtp_timestamp;
+        session.rtp_ticks = ticks;
+
+        int64_t elapsed_ns = arrival_ns - session.last_mapped_arrival_ns;
+        session.last_mapped_arrival_ns = arrival_ns;
+        session.offset_ns = std::min(arrival_ns - rtp_ns, session.offset_ns + std::max<int64_t>(0, elapsed_ns) / 10000);
+    }
+    return rtp_ns + session.offset_ns;
+}
+
+}  // namespace obsbot_ros
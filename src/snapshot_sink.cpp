@@ -0,0 +1,67 @@
+#include <obsbot_ros/snapshot_sink.hpp>
+
+namespace obsbot_ros
+{
+
+void SnapshotSink::onFrame(const FrameRef &frame)
+{
+    FrameRef previous;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        /// the old buffer goes back to the pool outside the lock
+        previous = std::move(latest_);
+        latest_ = frame;
+        ++stats_.frames;
+        if (waiters_ == 0)
+        { return; }
+    }
+    cv_.notify_all();
+}
+
+void SnapshotSink::onRelease()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        latest_.reset();
+        ++released_;
+    }
+    cv_.notify_all();
+}
+
+bool SnapshotSink::wantsFrames() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return waiters_ > 0;
+}
+
+FrameRef SnapshotSink::latest()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.requests;
+    return latest_;
+}
+
+FrameRef SnapshotSink::next(int64_t after_ns, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++stats_.requests;
+    const uint64_t released = released_;
+    ++waiters_;
+    bool found = cv_.wait_for(lock, timeout, [this, after_ns, released]
+                              { return released_ != released || (latest_ && latest_->steady_ns > after_ns); });
+    --waiters_;
+    if (!found || released_ != released)
+    {
+        ++stats_.timeouts;
+        return FrameRef();
+    }
+    return latest_;
+}
+
+SnapshotSink::Stats SnapshotSink::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+}  // namespace obsbot_ros
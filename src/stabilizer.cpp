@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include <obsbot_ros/stabilizer.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+constexpr double kPi = 3.14159265358979323846;
+
+/// into -180..180
+double wrapDeg(double angle)
+{
+    angle = std::fmod(angle + 180.0, 360.0);
+    return angle < 0.0 ? angle + 180.0 : angle - 180.0;
+}
+
+/// c = a * b, 3x3 row major
+void multiply(const double a[9], const double b[9], double c[9])
+{
+    for (int32_t r = 0; r < 3; ++r)
+    {
+        for (int32_t col = 0; col < 3; ++col)
+        { c[r * 3 + col] = a[r * 3] * b[col] + a[r * 3 + 1] * b[3 + col] + a[r * 3 + 2] * b[6 + col]; }
+    }
+}
+
+int32_t toFixed(double value)
+{
+    /// far outside the plane is as good as the edge, and keeps the row interpolation inside 32 bits
+    return static_cast<int32_t>(std::lround(std::min(1e4, std::max(-1e4, value)) * 65536.0));
+}
+}
+
+AttitudeTrack::AttitudeTrack(size_t capacity) : ring_(std::max<size_t>(2, capacity))
+{
+}
+
+void AttitudeTrack::add(const Sample &sample)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ring_[next_] = sample;
+    next_ = (next_ + 1) % ring_.size();
+    count_ = std::min(count_ + 1, ring_.size());
+}
+
+bool AttitudeTrack::at(int64_t steady_ns, int64_t max_gap_ns, Sample &out) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (count_ == 0)
+    { return false; }
+
+    /// newest first, the frame is usually a few samples behind
+    const size_t size = ring_.size();
+    const Sample *later = nullptr;
+    for (size_t i = 0; i < count_; ++i)
+    {
+        const Sample &sample = ring_[(next_ + size - 1 - i) % size];
+        if (sample.steady_ns > steady_ns)
+        {
+            later = &sample;
+            continue;
+        }
+        if (steady_ns - sample.steady_ns > max_gap_ns)
+        { break; }
+        if (!later || later->steady_ns - sample.steady_ns > 2 * max_gap_ns)
+        {
+            out = sample;
+            return true;
+        }
+        float t = static_cast<float>(steady_ns - sample.steady_ns) /
+                  static_cast<float>(later->steady_ns - sample.steady_ns);
+        out.steady_ns = steady_ns;
+        out.roll = sample.roll + t * static_cast<float>(wrapDeg(later->roll - sample.roll));
+        out.pitch = sample.pitch + t * static_cast<float>(wrapDeg(later->pitch - sample.pitch));
+        out.yaw = sample.yaw + t * static_cast<float>(wrapDeg(later->yaw - sample.yaw));
+        return true;
+    }
+
+    /// every sample is newer than the frame
+    if (later && later->steady_ns - steady_ns <= max_gap_ns)
+    {
+        out = *later;
+        return true;
+    }
+    return false;
+}
+
+Stabilizer::Stabilizer(const Options &options) : options_(options)
+{
+    options_.crop = std::min(1.0, std::max(0.5, options_.crop));
+    options_.hfov_deg = std::min(170.0, std::max(10.0, options_.hfov_deg));
+    options_.grid = std::max(4, options_.grid);
+    options_.pool_size = std::max<size_t>(1, options_.pool_size);
+}
+
+FrameRef Stabilizer::process(const Frame &frame, const AttitudeTrack &track)
+{
+    image_ops::PlaneView y, u, v;
+    if (!image_ops::yuvPlanes(frame, y, u, v))
+    {
+        ++stats_.unsupported;
+        return FrameRef();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (y.width != in_width_ || y.height != in_height_)
+    {
+        /// a smaller pool can only go once every buffer of it is back
+        size_t needed = frameBufferSize(RmVideoFormat::I420, std::max(2, static_cast<int32_t>(y.width * options_.crop)),
+                                        std::max(2, static_cast<int32_t>(y.height * options_.crop)));
+        if (pool_ && pool_->capacity() < needed && pool_->available() != pool_->count())
+        {
+            ++stats_.dropped;
+            return FrameRef();
+        }
+        prepare(y.width, y.height);
+    }
+    FrameRef out = pool_->acquire();
+    if (!out)
+    {
+        ++stats_.dropped;
+        return out;
+    }
+    ++stats_.frames;
+
+    double roll = 0.0, pitch = 0.0, yaw = 0.0;
+    if (!residual(frame.steady_ns, track, roll, pitch, yaw))
+    { ++stats_.no_attitude; }
+    stats_.correction_deg = std::max(std::fabs(roll), std::max(std::fabs(pitch), std::fabs(yaw)));
+
+    /// source ray of an output ray: R^T with R = Ry(yaw) Rx(pitch) Rz(roll), x right, y down, z forward
+    const double cr = std::cos(roll * kPi / 180.0), sr = std::sin(roll * kPi / 180.0);
+    const double cp = std::cos(pitch * kPi / 180.0), sp = std::sin(pitch * kPi / 180.0);
+    const double cy = std::cos(yaw * kPi / 180.0), sy = std::sin(yaw * kPi / 180.0);
+    const double ry[9] = {cy, 0.0, sy, 0.0, 1.0, 0.0, -sy, 0.0, cy};
+    const double rx[9] = {1.0, 0.0, 0.0, 0.0, cp, -sp, 0.0, sp, cp};
+    const double rz[9] = {cr, -sr, 0.0, sr, cr, 0.0, 0.0, 0.0, 1.0};
+    double ryx[9], rotation[9];
+    multiply(ry, rx, ryx);
+    multiply(ryx, rz, rotation);
+    const double rt[9] = {rotation[0], rotation[3], rotation[6],
+                          rotation[1], rotation[4], rotation[7],
+                          rotation[2], rotation[5], rotation[8]};
+
+    /// K R^T K^-1, with the crop offset folded in so the maps start at the output origin
+    const double f = 0.5 * in_width_ / std::tan(0.5 * options_.hfov_deg * kPi / 180.0);
+    const double cx = 0.5 * (in_width_ - 1);
+    const double cyc = 0.5 * (in_height_ - 1);
+    const double k[9] = {f, 0.0, cx, 0.0, f, cyc, 0.0, 0.0, 1.0};
+    const double ox = 0.5 * (in_width_ - out_width_);
+    const double oy = 0.5 * (in_height_ - out_height_);
+    const double k_inv[9] = {1.0 / f, 0.0, (ox - cx) / f, 0.0, 1.0 / f, (oy - cyc) / f, 0.0, 0.0, 1.0};
+    double krt[9], h[9];
+    multiply(k, rt, krt);
+    multiply(krt, k_inv, h);
+
+    Frame &target = *out;
+    const size_t luma_size = static_cast<size_t>(out_width_) * static_cast<size_t>(out_height_);
+    const size_t chroma_size = luma_size / 4;
+    uint8_t *out_u = target.data + luma_size;
+    uint8_t *out_v = out_u + chroma_size;
+    buildMap(luma_, h, 1.0, 1.0);
+    warp(luma_, y, target.data, out_width_);
+    if (u.data && v.data)
+    {
+        buildMap(chroma_, h, static_cast<double>(u.width) / y.width, static_cast<double>(u.height) / y.height);
+        warp(chroma_, u, out_u, out_width_ / 2);
+        warp(chroma_, v, out_v, out_width_ / 2);
+    }
+    else
+    {
+        std::memset(out_u, 128, 2 * chroma_size);
+    }
+
+    target.size = frameBufferSize(RmVideoFormat::I420, out_width_, out_height_);
+    target.width = out_width_;
+    target.height = out_height_;
+    target.stride = out_width_;
+    target.format = RmVideoFormat::I420;
+    target.sequence = frame.sequence;
+    target.keyframe = false;
+    target.stamp_ns = frame.stamp_ns;
+    target.steady_ns = frame.steady_ns;
+
+    double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    stats_.process_us = stats_.frames == 1 ? elapsed_us : stats_.process_us + (elapsed_us - stats_.process_us) / 16.0;
+    stats_.max_process_us = std::max(stats_.max_process_us, elapsed_us);
+    return out;
+}
+
+void Stabilizer::reset()
+{
+    have_path_ = false;
+}
+
+void Stabilizer::prepare(int32_t width, int32_t height)
+{
+    in_width_ = width;
+    in_height_ = height;
+    /// even, so the i420 chroma covers the picture exactly
+    out_width_ = std::max(2, static_cast<int32_t>(width * options_.crop) & ~1);
+    out_height_ = std::max(2, static_cast<int32_t>(height * options_.crop) & ~1);
+
+    const int32_t grid = options_.grid;
+    auto size = [grid](PlaneMap &map, int32_t plane_width, int32_t plane_height, double out_scale)
+    {
+        map.width = plane_width;
+        map.height = plane_height;
+        map.out_scale = out_scale;
+        /// one node past the last pixel, every span is a full grid wide
+        map.nodes_x = (plane_width + grid - 1) / grid + 1;
+        map.nodes_y = (plane_height + grid - 1) / grid + 1;
+        map.x.assign(static_cast<size_t>(map.nodes_x) * static_cast<size_t>(map.nodes_y), 0);
+        map.y.assign(map.x.size(), 0);
+    };
+    size(luma_, out_width_, out_height_, 1.0);
+    size(chroma_, out_width_ / 2, out_height_ / 2, 0.5);
+
+    size_t capacity = frameBufferSize(RmVideoFormat::I420, out_width_, out_height_);
+    if (!pool_ || pool_->capacity() < capacity)
+    { pool_.reset(new FramePool(options_.pool_size, capacity)); }
+}
+
+bool Stabilizer::residual(int64_t steady_ns, const AttitudeTrack &track, double &roll, double &pitch, double &yaw)
+{
+    AttitudeTrack::Sample sample;
+    if (!track.at(steady_ns + options_.latency_ns, options_.max_gap_ns, sample))
+    { return false; }
+
+    /// a long gap or a clock going backwards starts the path over at the current attitude
+    int64_t dt = steady_ns - path_ns_;
+    if (!have_path_ || dt < 0 || dt > 1000000000)
+    {
+        have_path_ = true;
+        path_roll_ = sample.roll;
+        path_pitch_ = sample.pitch;
+        path_yaw_ = sample.yaw;
+    }
+    else if (options_.smoothing_ns > 0)
+    {
+        double alpha = 1.0 - std::exp(-static_cast<double>(dt) / static_cast<double>(options_.smoothing_ns));
+        path_roll_ = wrapDeg(path_roll_ + alpha * wrapDeg(sample.roll - path_roll_));
+        path_pitch_ = wrapDeg(path_pitch_ + alpha * wrapDeg(sample.pitch - path_pitch_));
+        path_yaw_ = wrapDeg(path_yaw_ + alpha * wrapDeg(sample.yaw - path_yaw_));
+    }
+    path_ns_ = steady_ns;
+
+    const double limit = options_.max_correction_deg;
+    roll = std::min(limit, std::max(-limit, wrapDeg(sample.roll - path_roll_)));
+    pitch = std::min(limit, std::max(-limit, wrapDeg(sample.pitch - path_pitch_)));
+    yaw = std::min(limit, std::max(-limit, wrapDeg(sample.yaw - path_yaw_)));
+    return true;
+}
+
+void Stabilizer::buildMap(PlaneMap &map, const double h[9], double scale_x, double scale_y) const
+{
+    const double grid = options_.grid / map.out_scale;
+    size_t node = 0;
+    for (int32_t j = 0; j < map.nodes_y; ++j)
+    {
+        const double ly = j * grid;
+        for (int32_t i = 0; i < map.nodes_x; ++i, ++node)
+        {
+            const double lx = i * grid;
+            const double w = h[6] * lx + h[7] * ly + h[8];
+            /// behind the camera, only reachable with absurd angles; any edge will do
+            const double inv = w > 1e-6 ? 1.0 / w : 1e6;
+            map.x[node] = toFixed((h[0] * lx + h[1] * ly + h[2]) * inv * scale_x);
+            map.y[node] = toFixed((h[3] * lx + h[4] * ly + h[5]) * inv * scale_y);
+        }
+    }
+}
+
+void Stabilizer::warp(const PlaneMap &map, const image_ops::PlaneView &src, uint8_t *dst, int32_t stride) const
+{
+    const int32_t grid = options_.grid;
+    for (int32_t row = 0; row < map.height; ++row)
+    {
+        const int32_t j = row / grid;
+        const int64_t fy = row % grid;
+        const int32_t *top_x = map.x.data() + static_cast<size_t>(j) * static_cast<size_t>(map.nodes_x);
+        const int32_t *top_y = map.y.data() + static_cast<size_t>(j) * static_cast<size_t>(map.nodes_x);
+        const int32_t *bottom_x = top_x + map.nodes_x;
+        const int32_t *bottom_y = top_y + map.nodes_x;
+        auto node = [&](int32_t i, int32_t &x, int32_t &y)
+        {
+            x = static_cast<int32_t>(top_x[i] + (static_cast<int64_t>(bottom_x[i]) - top_x[i]) * fy / grid);
+            y = static_cast<int32_t>(top_y[i] + (static_cast<int64_t>(bottom_y[i]) - top_y[i]) * fy / grid);
+        };
+
+        uint8_t *line = dst + static_cast<size_t>(row) * static_cast<size_t>(stride);
+        int32_t left_x, left_y;
+        node(0, left_x, left_y);
+        for (int32_t i = 0; i * grid < map.width; ++i)
+        {
+            int32_t right_x, right_y;
+            node(i + 1, right_x, right_y);
+            const size_t count = static_cast<size_t>(std::min(grid, map.width - i * grid));
+            image_ops::warpRow(line + i * grid, src, left_x, left_y, (right_x - left_x) / grid,
+                               (right_y - left_y) / grid, count);
+            left_x = right_x;
+            left_y = right_y;
+        }
+    }
+}
+
+}  // namespace obsbot_ros
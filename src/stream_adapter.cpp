@@ -0,0 +1,134 @@
+#include <algorithm>
+
+#include <obsbot_ros/stream_adapter.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+/// next smaller preset at the same frame rate, auto if there is none
+Device::DevVideoResType smallerResolution(Device::DevVideoResType res)
+{
+    if (res >= Device::DevVideoRes4KP30 && res <= Device::DevVideoRes4KP48)
+    { return static_cast<Device::DevVideoResType>(res + 0x20); }
+    if (res >= Device::DevVideoRes1080P30 && res <= Device::DevVideoRes1080P48)
+    { return static_cast<Device::DevVideoResType>(res + 0x10); }
+    return Device::DevVideoResAuto;
+}
+}
+
+std::vector<StreamAdapter::Rung> StreamAdapter::defaultLadder(Device::DevVideoResType top,
+                                                              Device::DevVideoEncoderFormat encoder, bool allow_h265)
+{
+    std::vector<Rung> ladder;
+    auto res = top;
+    bool h265_added = false;
+    while (true)
+    {
+        /// a smaller resolution starts at medium, its high rung would cost as much as the low rung above
+        if (ladder.empty())
+        { ladder.push_back({res, Device::DevVideoBitLevelHigh, encoder}); }
+        ladder.push_back({res, Device::DevVideoBitLevelMedium, encoder});
+        ladder.push_back({res, Device::DevVideoBitLevelLow, encoder});
+
+        if (allow_h265 && !h265_added && encoder == Device::DevVideoEncoderH264)
+        {
+            encoder = Device::DevVideoEncoderH265;
+            ladder.push_back({res, Device::DevVideoBitLevelLow, encoder});
+            h265_added = true;
+        }
+
+        res = smallerResolution(res);
+        if (res == Device::DevVideoResAuto)
+        { break; }
+    }
+    return ladder;
+}
+
+StreamAdapter::StreamAdapter(std::vector<Rung> ladder, const Options &options) :
+    ladder_(std::move(ladder)),
+    options_(options)
+{
+    if (ladder_.empty())
+    { ladder_.emplace_back(); }
+}
+
+bool StreamAdapter::update(const RtspClient::Stats &stats, int64_t now_ns)
+{
+    /// first call, or the client restarted and its counters with it
+    if (!have_last_ || stats.packets < last_.packets || now_ns <= last_ns_)
+    {
+        have_last_ = true;
+        last_ = stats;
+        last_ns_ = now_ns;
+        return false;
+    }
+
+    double dt = static_cast<double>(now_ns - last_ns_) * 1e-9;
+    auto packets = stats.packets - last_.packets;
+    auto lost = stats.lost > last_.lost ? stats.lost - last_.lost : 0;
+    sample_.rx_kbps = static_cast<double>(stats.bytes - last_.bytes) * 8.0 / 1000.0 / dt;
+    sample_.loss = packets + lost > 0 ? static_cast<double>(lost) / static_cast<double>(packets + lost) : 0.0;
+    sample_.jitter_ms = stats.jitter_ms;
+    sample_.delay_ms = stats.delay_ms;
+    last_ = stats;
+    last_ns_ = now_ns;
+
+    /// a reconnecting client says nothing about the encoding, and a fresh change has not settled yet
+    if (!options_.adapt || !stats.connected || now_ns - changed_ns_ < options_.settle_ns)
+    {
+        bad_ = 0;
+        good_ = 0;
+        return false;
+    }
+
+    bool stalled = packets == 0;
+    bool bad = stalled || sample_.loss > options_.loss_high || sample_.delay_ms > options_.delay_high_ms ||
+               sample_.jitter_ms > options_.jitter_high_ms;
+    bool good = !stalled && sample_.loss <= options_.loss_low && sample_.delay_ms < options_.delay_low_ms &&
+                sample_.jitter_ms < options_.jitter_low_ms;
+
+    if (bad)
+    {
+        good_ = 0;
+        if (++bad_ < options_.degrade_after || rung_ + 1 >= ladder_.size())
+        { return false; }
+        if (probing_)
+        { backoff_ = std::min(options_.max_backoff, backoff_ * 2); }
+        change(rung_ + 1, now_ns);
+        probing_ = false;
+        return true;
+    }
+
+    if (!good)
+    {
+        bad_ = 0;
+        good_ = 0;
+        return false;
+    }
+
+    bad_ = 0;
+    ++good_;
+    if (probing_ && good_ >= options_.upgrade_after)
+    {
+        /// the probe held, the next one may come at the normal pace
+        probing_ = false;
+        backoff_ = 1;
+    }
+    if (rung_ == 0 || good_ < options_.upgrade_after * backoff_)
+    { return false; }
+    change(rung_ - 1, now_ns);
+    probing_ = true;
+    return true;
+}
+
+void StreamAdapter::change(size_t rung, int64_t now_ns)
+{
+    rung_ = rung;
+    changed_ns_ = now_ns;
+    bad_ = 0;
+    good_ = 0;
+}
+
+}  // namespace obsbot_ros
@@ -0,0 +1,140 @@
+#include <algorithm>
+
+#include <obsbot_ros/target_selector.hpp>
+
+namespace obsbot_ros
+{
+
+double iou(const DetectionBox &a, const DetectionBox &b)
+{
+    double width = std::min(a.x_max, b.x_max) - std::max(a.x_min, b.x_min);
+    double height = std::min(a.y_max, b.y_max) - std::max(a.y_min, b.y_min);
+    if (width <= 0.0 || height <= 0.0)
+    { return 0.0; }
+
+    double overlap = width * height;
+    double area_a = static_cast<double>(a.x_max - a.x_min) * (a.y_max - a.y_min);
+    double area_b = static_cast<double>(b.x_max - b.x_min) * (b.y_max - b.y_min);
+    return overlap / (area_a + area_b - overlap);
+}
+
+TargetSelector::TargetSelector(const Options &options) : options_(options)
+{
+    options_.switch_after = std::max<uint32_t>(1, options_.switch_after);
+}
+
+void TargetSelector::update(const Box *boxes, size_t count, int64_t now_ns)
+{
+    ++stats_.updates;
+    if (tracking_ && now_ns - last_seen_ns_ > options_.memory_ns)
+    {
+        tracking_ = false;
+        challenger_ = 0;
+        ++stats_.lost;
+    }
+
+    /// the selected target in this frame, and the best eligible candidate
+    const Box *match = nullptr;
+    double match_overlap = 0.0;
+    const Box *best = nullptr;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Box &box = boxes[i];
+        if (box.score < options_.min_score ||
+            (options_.target_type >= 0 && box.target_type >= 0 && box.target_type != options_.target_type))
+        { continue; }
+
+        if (tracking_)
+        {
+            double overlap;
+            if (target_.track_id >= 0 && box.track_id >= 0)
+            { overlap = box.track_id == target_.track_id ? 2.0 : 0.0; }
+            else
+            { overlap = iou(box, target_); }
+            if (overlap >= options_.match_iou && overlap > match_overlap)
+            {
+                match = &box;
+                match_overlap = overlap;
+            }
+        }
+        if (!best || box.score > best->score)
+        { best = &box; }
+    }
+
+    if (!tracking_)
+    {
+        if (best)
+        { select(*best, now_ns); }
+        return;
+    }
+
+    if (match)
+    {
+        target_ = *match;
+        last_seen_ns_ = now_ns;
+    }
+
+    /// a hidden target keeps its last score, so a challenger still has to win clearly and for a while
+    if (best && best != match && best->score > target_.score * (1.0 + options_.switch_margin))
+    {
+        if (++challenger_ >= options_.switch_after)
+        {
+            ++stats_.switches;
+            select(*best, now_ns);
+            return;
+        }
+    }
+    else
+    {
+        challenger_ = 0;
+    }
+
+    if (!match)
+    { return; }
+    if (!pending_ && sent_valid_ && iou(target_, sent_) < options_.reselect_iou)
+    { queue(); }
+    else
+    { ++stats_.suppressed; }
+}
+
+bool TargetSelector::poll(int64_t now_ns, Command &command)
+{
+    if (!pending_ || (stats_.commands > 0 && now_ns - last_command_ns_ < options_.min_interval_ns))
+    { return false; }
+
+    command.mode = options_.mode;
+    command.box = target_;
+    command.target_type = target_.target_type >= 0 ? target_.target_type : options_.target_type;
+    sent_ = target_;
+    sent_valid_ = true;
+    pending_ = false;
+    last_command_ns_ = now_ns;
+    ++stats_.commands;
+    return true;
+}
+
+void TargetSelector::reset()
+{
+    tracking_ = false;
+    challenger_ = 0;
+    pending_ = false;
+    sent_valid_ = false;
+}
+
+void TargetSelector::select(const Box &box, int64_t now_ns)
+{
+    target_ = box;
+    tracking_ = true;
+    last_seen_ns_ = now_ns;
+    challenger_ = 0;
+    queue();
+}
+
+void TargetSelector::queue()
+{
+    if (pending_)
+    { ++stats_.coalesced; }
+    pending_ = true;
+}
+
+}  // namespace obsbot_ros
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <chrono>
+
+#include <obsbot_ros/image_ops.hpp>
+#include <obsbot_ros/telemetry_overlay.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+/// 5x7 glyphs of ' ' to '_', five columns each, bit 0 is the top row
+const uint8_t kFont[64][5] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5f, 0x00, 0x00}, {0x00, 0x07, 0x00, 0x07, 0x00},  /// ' ' ! "
+    {0x14, 0x7f, 0x14, 0x7f, 0x14}, {0x24, 0x2a, 0x7f, 0x2a, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62},  /// # $ %
+    {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00}, {0x00, 0x1c, 0x22, 0x41, 0x00},  /// & ' (
+    {0x00, 0x41, 0x22, 0x1c, 0x00}, {0x14, 0x08, 0x3e, 0x08, 0x14}, {0x08, 0x08, 0x3e, 0x08, 0x08},  /// ) * +
+    {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x60, 0x60, 0x00, 0x00},  /// , - .
+    {0x20, 0x10, 0x08, 0x04, 0x02}, {0x3e, 0x51, 0x49, 0x45, 0x3e}, {0x00, 0x42, 0x7f, 0x40, 0x00},  /// / 0 1
+    {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4b, 0x31}, {0x18, 0x14, 0x12, 0x7f, 0x10},  /// 2 3 4
+    {0x27, 0x45, 0x45, 0x45, 0x39}, {0x3c, 0x4a, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03},  /// 5 6 7
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1e}, {0x00, 0x36, 0x36, 0x00, 0x00},  /// 8 9 :
+    {0x00, 0x56, 0x36, 0x00, 0x00}, {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14},  /// ; < =
+    {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06}, {0x32, 0x49, 0x79, 0x41, 0x3e},  /// > ? @
+    {0x7e, 0x11, 0x11, 0x11, 0x7e}, {0x7f, 0x49, 0x49, 0x49, 0x36}, {0x3e, 0x41, 0x41, 0x41, 0x22},  /// A B C
+    {0x7f, 0x41, 0x41, 0x22, 0x1c}, {0x7f, 0x49, 0x49, 0x49, 0x41}, {0x7f, 0x09, 0x09, 0x09, 0x01},  /// D E F
+    {0x3e, 0x41, 0x49, 0x49, 0x7a}, {0x7f, 0x08, 0x08, 0x08, 0x7f}, {0x00, 0x41, 0x7f, 0x41, 0x00},  /// G H I
+    {0x20, 0x40, 0x41, 0x3f, 0x01}, {0x7f, 0x08, 0x14, 0x22, 0x41}, {0x7f, 0x40, 0x40, 0x40, 0x40},  /// J K L
+    {0x7f, 0x02, 0x0c, 0x02, 0x7f}, {0x7f, 0x04, 0x08, 0x10, 0x7f}, {0x3e, 0x41, 0x41, 0x41, 0x3e},  /// M N O
+    {0x7f, 0x09, 0x09, 0x09, 0x06}, {0x3e, 0x41, 0x51, 0x21, 0x5e}, {0x7f, 0x09, 0x19, 0x29, 0x46},  /// P Q R
+    {0x46, 0x49, 0x49, 0x49, 0x31}, {0x01, 0x01, 0x7f, 0x01, 0x01}, {0x3f, 0x40, 0x40, 0x40, 0x3f},  /// S T U
+    {0x1f, 0x20, 0x40, 0x20, 0x1f}, {0x3f, 0x40, 0x38, 0x40, 0x3f}, {0x63, 0x14, 0x08, 0x14, 0x63},  /// V W X
+    {0x07, 0x08, 0x70, 0x08, 0x07}, {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7f, 0x41, 0x41, 0x00},  /// Y Z [
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7f, 0x00}, {0x04, 0x02, 0x01, 0x02, 0x04},  /// \ ] ^
+    {0x40, 0x40, 0x40, 0x40, 0x40},                                                                  /// _
+};
+
+/// a glyph cell is 6x9 font pixels: the glyph, one column to its left and one row above and below
+constexpr int32_t kCellWidth = 6;
+constexpr int32_t kCellHeight = 9;
+constexpr uint8_t kInk = 235;
+constexpr uint8_t kBox = 16;
+
+/// blendMask on samples step bytes apart
+void blendStrided(uint8_t *dst, size_t step, const uint8_t *src, const uint8_t *alpha, size_t count)
+{
+    if (step == 1)
+    {
+        image_ops::blendMask(dst, src, alpha, count);
+        return;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t w = alpha[i] + (alpha[i] >> 7);
+        dst[i * step] = static_cast<uint8_t>((dst[i * step] * (256 - w) + src[i] * w + 128) >> 8);
+    }
+}
+}
+
+TelemetryOverlay::TelemetryOverlay(const Options &options) : options_(options)
+{
+    options_.scale = std::max(1, options_.scale);
+    options_.margin = std::max(0, options_.margin);
+    options_.max_chars = std::max<size_t>(1, options_.max_chars);
+    cell_width_ = kCellWidth * options_.scale;
+    cell_height_ = kCellHeight * options_.scale;
+
+    const size_t cell = static_cast<size_t>(cell_width_) * static_cast<size_t>(cell_height_);
+    atlas_luma_.resize(64 * cell);
+    atlas_alpha_.resize(64 * cell);
+    for (size_t g = 0; g < 64; ++g)
+    {
+        for (int32_t row = 0; row < cell_height_; ++row)
+        {
+            int32_t font_row = row / options_.scale - 1;
+            for (int32_t col = 0; col < cell_width_; ++col)
+            {
+                int32_t font_col = col / options_.scale - 1;
+                bool ink = font_row >= 0 && font_row < 7 && font_col >= 0 && ((kFont[g][font_col] >> font_row) & 1);
+                size_t at = g * cell + static_cast<size_t>(row) * static_cast<size_t>(cell_width_) +
+                            static_cast<size_t>(col);
+                atlas_luma_[at] = ink ? kInk : kBox;
+                atlas_alpha_[at] = ink ? 255 : options_.background;
+            }
+        }
+    }
+
+    const size_t line_width = options_.max_chars * static_cast<size_t>(cell_width_);
+    lines_.resize(options_.lines);
+    for (auto &line : lines_)
+    {
+        line.text.assign(options_.max_chars, '\0');
+        line.luma.assign(line_width * static_cast<size_t>(cell_height_), kBox);
+        line.alpha.assign(line.luma.size(), 0);
+        line.chroma_alpha.assign(line.luma.size() / 2, 0);
+    }
+    grey_.assign(line_width / 2, 128);
+}
+
+size_t TelemetryOverlay::glyph(char c)
+{
+    if (c >= 'a' && c <= 'z')
+    { c = static_cast<char>(c - 'a' + 'A'); }
+    if (c < ' ' || c > '_')
+    { c = '?'; }
+    return static_cast<size_t>(c - ' ');
+}
+
+void TelemetryOverlay::setLine(size_t line, const char *text)
+{
+    if (line >= lines_.size())
+    { return; }
+    Line &out = lines_[line];
+    size_t length = 0;
+    for (; text && text[length] && length < options_.max_chars; ++length)
+    {
+        if (out.text[length] != text[length])
+        { drawCell(out, length, text[length]); }
+    }
+    out.length = length;
+}
+
+/// cells stay in the line buffer when the text gets shorter, they are just not blended
+void TelemetryOverlay::drawCell(Line &line, size_t index, char c)
+{
+    const size_t width = static_cast<size_t>(cell_width_);
+    const size_t line_width = options_.max_chars * width;
+    const size_t cell = width * static_cast<size_t>(cell_height_);
+    const size_t g = glyph(c);
+    for (size_t row = 0; row < static_cast<size_t>(cell_height_); ++row)
+    {
+        size_t from = g * cell + row * width;
+        size_t to = row * line_width + index * width;
+        std::copy_n(atlas_luma_.begin() + from, width, line.luma.begin() + to);
+        std::copy_n(atlas_alpha_.begin() + from, width, line.alpha.begin() + to);
+        /// chroma covers two luma columns, it takes the stronger one
+        for (size_t col = 0; col < width / 2; ++col)
+        {
+            line.chroma_alpha[row * line_width / 2 + index * width / 2 + col] =
+                std::max(line.alpha[to + 2 * col], line.alpha[to + 2 * col + 1]);
+        }
+    }
+    line.text[index] = c;
+    ++stats_.cells_drawn;
+}
+
+bool TelemetryOverlay::apply(Frame &frame)
+{
+    image_ops::PlaneView y, u, v;
+    if (!image_ops::yuvPlanes(frame, y, u, v))
+    {
+        ++stats_.unsupported;
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ++stats_.frames;
+    const int32_t block_height = static_cast<int32_t>(lines_.size()) * cell_height_;
+    /// even, so the box starts on a chroma sample
+    const int32_t x0 = options_.margin & ~1;
+    const int32_t y0 = std::max(0, options_.bottom ? y.height - options_.margin - block_height : options_.margin) & ~1;
+    const size_t line_width = options_.max_chars * static_cast<size_t>(cell_width_);
+    /// the views point into the frame, the same bytes are written through its own pointer
+    auto data = [&frame](const image_ops::PlaneView &view)
+    { return frame.data + (view.data - frame.data); };
+
+    for (size_t index = 0; index < lines_.size(); ++index)
+    {
+        const Line &line = lines_[index];
+        const int32_t top = y0 + static_cast<int32_t>(index) * cell_height_;
+        const int32_t width = std::min(static_cast<int32_t>(line.length) * cell_width_, y.width - x0);
+        if (width <= 0 || top >= y.height)
+        { continue; }
+
+        const int32_t rows = std::min(cell_height_, y.height - top);
+        uint8_t *luma = data(y) + static_cast<size_t>(top) * static_cast<size_t>(y.stride) +
+                        static_cast<size_t>(x0) * static_cast<size_t>(y.step);
+        for (int32_t row = 0; row < rows; ++row)
+        {
+            size_t at = static_cast<size_t>(row) * line_width;
+            blendStrided(luma + static_cast<size_t>(row) * static_cast<size_t>(y.stride), static_cast<size_t>(y.step),
+                         line.luma.data() + at, line.alpha.data() + at, static_cast<size_t>(width));
+        }
+        if (!u.data || !v.data)
+        { continue; }
+
+        /// 4:2:0 chroma takes every other row of the line, 4:2:2 chroma all of them
+        const int32_t vertical = y.height / u.height;
+        const int32_t chroma_top = top / vertical;
+        const int32_t chroma_rows = std::min((rows + vertical - 1) / vertical, u.height - chroma_top);
+        const size_t chroma_width = static_cast<size_t>(width / 2);
+        for (int32_t row = 0; row < chroma_rows; ++row)
+        {
+            const uint8_t *alpha = line.chroma_alpha.data() + static_cast<size_t>(row * vertical) * line_width / 2;
+            size_t offset = static_cast<size_t>(chroma_top + row) * static_cast<size_t>(u.stride) +
+                            static_cast<size_t>(x0 / 2) * static_cast<size_t>(u.step);
+            blendStrided(data(u) + offset, static_cast<size_t>(u.step), grey_.data(), alpha, chroma_width);
+            blendStrided(data(v) + offset, static_cast<size_t>(v.step), grey_.data(), alpha, chroma_width);
+        }
+    }
+
+    double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    stats_.process_us = stats_.frames == 1 ? elapsed_us : stats_.process_us + (elapsed_us - stats_.process_us) / 16.0;
+    stats_.max_process_us = std::max(stats_.max_process_us, elapsed_us);
+    return true;
+}
+
+}  // namespace obsbot_ros
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <sstream>
+
+#include <obsbot_ros/thermal_governor.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+
+const char *const kBitrateNames[] = {"default", "low", "medium", "high"};
+
+const char *const kTempNames[] = {"normal", "warning", "error"};
+
+}  // namespace
+
+bool ThermalGovernor::parse(const std::string &text, Rung &out)
+{
+    std::istringstream in(text);
+    std::string size, bitrate, ai;
+    if (!(in >> size >> bitrate >> ai))
+    { return false; }
+
+    char x = 0, at = 0;
+    std::istringstream values(size);
+    if (!(values >> out.width >> x >> out.height >> at >> out.fps) || x != 'x' || at != '@' || out.width <= 0 ||
+        out.height <= 0 || out.fps <= 0)
+    { return false; }
+
+    auto name = std::find(std::begin(kBitrateNames), std::end(kBitrateNames), bitrate);
+    if (name == std::end(kBitrateNames))
+    { return false; }
+    out.bitrate = static_cast<Device::DevVideoBitLevelType>(name - std::begin(kBitrateNames));
+
+    if (ai != "ai" && ai != "noai")
+    { return false; }
+    out.ai = ai == "ai";
+    return true;
+}
+
+const char *ThermalGovernor::tempName(int32_t status)
+{
+    return kTempNames[std::min(2, std::max(0, status))];
+}
+
+std::string ThermalGovernor::format(const Rung &rung)
+{
+    std::ostringstream out;
+    if (rung.width > 0)
+    { out << rung.width << 'x' << rung.height << '@' << rung.fps; }
+    else
+    { out << "configured"; }
+    out << ' ' << kBitrateNames[std::min<size_t>(rung.bitrate, 3)] << ' ' << (rung.ai ? "ai" : "noai");
+    return out.str();
+}
+
+ThermalGovernor::ThermalGovernor(const Options &options) : options_(options)
+{
+    if (options_.ladder.empty())
+    { options_.ladder.emplace_back(); }
+    options_.effect_ns = std::max<int64_t>(1000000000, options_.effect_ns);
+}
+
+void ThermalGovernor::reset(int64_t now_ns)
+{
+    rung_ = 0;
+    thermal_rung_ = 0;
+    battery_floor_ = 0;
+    temp_event_ = false;
+    battery_event_ = false;
+    hot_since_ns_ = -1;
+    hot_stepped_ = false;
+    normal_since_ns_ = now_ns;
+    step_ns_ = now_ns;
+    capacity_.clear();
+    pending_ = false;
+    ready_ = false;
+}
+
+bool ThermalGovernor::update(const Reading &reading, int64_t now_ns)
+{
+    last_ = reading;
+    if (reading.capacity >= 0)
+    {
+        capacity_.emplace_back(now_ns, reading.capacity);
+        while (capacity_.front().first < now_ns - 2 * options_.effect_ns)
+        { capacity_.pop_front(); }
+    }
+
+    const size_t lowest = options_.ladder.size() - 1;
+    std::ostringstream reason;
+
+    /// temperature: the hotter of lens and cpu, a reported event counts as an error
+    int32_t temp = std::max(reading.lens_temp, reading.cpu_temp);
+    const char *source = reading.lens_temp >= reading.cpu_temp ? "lens" : "cpu";
+    if (temp_event_)
+    {
+        temp = 2;
+        source = "device";
+        temp_event_ = false;
+    }
+    temp = std::min(2, std::max(0, temp));
+    if (temp > 0)
+    {
+        normal_since_ns_ = -1;
+        if (hot_since_ns_ < 0)
+        {
+            hot_since_ns_ = now_ns;
+            hot_stepped_ = false;
+        }
+        /// an error steps at once and then once per settle time, a warning once it has lasted
+        bool step = temp == 2 ? !hot_stepped_ || now_ns - step_ns_ >= options_.settle_ns
+                              : now_ns - std::max(hot_since_ns_, step_ns_) >= options_.warning_hold_ns;
+        if (step && thermal_rung_ < lowest)
+        {
+            ++thermal_rung_;
+            step_ns_ = now_ns;
+            hot_stepped_ = true;
+            reason << source << " temperature " << tempName(temp);
+            if (temp == 1)
+            { reason << " for " << (now_ns - hot_since_ns_) / 1000000000 << " s"; }
+        }
+    }
+    else
+    {
+        hot_since_ns_ = -1;
+        if (normal_since_ns_ < 0)
+        { normal_since_ns_ = now_ns; }
+        if (thermal_rung_ > 0 && now_ns - std::max(normal_since_ns_, step_ns_) >= options_.recover_ns)
+        {
+            --thermal_rung_;
+            step_ns_ = now_ns;
+            reason << "temperature normal for " << (now_ns - normal_since_ns_) / 1000000000 << " s";
+        }
+    }
+
+    /// battery: the floor only rises while discharging and drops as soon as the camera charges
+    if (reading.charging)
+    {
+        if (battery_floor_ > 0)
+        { reason << (reason.tellp() > 0 ? ", " : "") << "charging"; }
+        battery_floor_ = 0;
+        battery_event_ = false;
+    }
+    else
+    {
+        size_t floor = 0;
+        if (battery_event_)
+        { floor = lowest; }
+        else if (reading.capacity >= 0)
+        {
+            for (size_t i = 0; i < options_.battery_steps.size(); ++i)
+            {
+                if (reading.capacity <= options_.battery_steps[i])
+                { floor = i + 1; }
+            }
+        }
+        floor = std::min(floor, lowest);
+        if (floor > battery_floor_)
+        {
+            battery_floor_ = floor;
+            reason << (reason.tellp() > 0 ? ", " : "");
+            if (battery_event_)
+            { reason << "device reported low battery"; }
+            else
+            { reason << "battery " << reading.capacity << " %"; }
+        }
+    }
+
+    size_t target = std::max(thermal_rung_, battery_floor_);
+    if (target == rung_)
+    { return false; }
+
+    if (pending_)
+    { finish(now_ns); }
+    decision_.from = rung_;
+    decision_.to = target;
+    decision_.reason = reason.str();
+    decision_.at_ns = now_ns;
+    decision_.reading = reading;
+    decision_.drain_pct_h = drain(now_ns - options_.effect_ns);
+    pending_ = true;
+    if (target > rung_)
+    { ++stats_.steps_down; }
+    else
+    { ++stats_.steps_up; }
+    rung_ = target;
+    return true;
+}
+
+void ThermalGovernor::onTempHigh()
+{
+    temp_event_ = true;
+    ++stats_.temp_events;
+}
+
+void ThermalGovernor::onBatteryLow()
+{
+    battery_event_ = true;
+    ++stats_.battery_events;
+}
+
+bool ThermalGovernor::effect(int64_t now_ns, Effect &out)
+{
+    if (pending_ && now_ns - decision_.at_ns >= options_.effect_ns)
+    { finish(now_ns); }
+    if (!ready_)
+    { return false; }
+    out = effect_;
+    ready_ = false;
+    return true;
+}
+
+bool ThermalGovernor::switchAi(bool ai, bool tracking)
+{
+    if (ai == ai_)
+    { return false; }
+    if (!ai)
+    { ai_saved_ = tracking; }
+    ai_ = ai;
+    return !ai || ai_saved_;
+}
+
+double ThermalGovernor::drain(int64_t since_ns) const
+{
+    auto first = std::find_if(capacity_.begin(), capacity_.end(), [since_ns](const std::pair<int64_t, int32_t> &s)
+                              { return s.first >= since_ns; });
+    if (first == capacity_.end() || capacity_.back().first <= first->first)
+    { return 0.0; }
+    double hours = (capacity_.back().first - first->first) / 3.6e12;
+    return (first->second - capacity_.back().second) / hours;
+}
+
+void ThermalGovernor::finish(int64_t now_ns)
+{
+    effect_.decision = decision_;
+    effect_.after_ns = now_ns - decision_.at_ns;
+    effect_.reading = last_;
+    effect_.drain_pct_h = drain(decision_.at_ns);
+    pending_ = false;
+    ready_ = true;
+}
+
+}  // namespace obsbot_ros
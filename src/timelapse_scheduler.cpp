@@ -0,0 +1,86 @@
+#include <algorithm>
+
+#include <obsbot_ros/timelapse_scheduler.hpp>
+
+namespace obsbot_ros
+{
+
+TimelapseScheduler::TimelapseScheduler(const Options &options) : options_(options)
+{
+    options_.interval_ns = std::max<int64_t>(1000000, options_.interval_ns);
+    options_.history = std::max<size_t>(1, options_.history);
+    latencies_.reserve(options_.history);
+    stats_.estimate_ms = latencyEstimate() / 1e6;
+}
+
+void TimelapseScheduler::start(int64_t now_ns)
+{
+    phase_ = Phase::Sleeping;
+    shot_ns_ = now_ns + latencyEstimate() + options_.margin_ns;
+}
+
+int64_t TimelapseScheduler::wakeAt() const
+{
+    return shot_ns_ - latencyEstimate() - options_.margin_ns;
+}
+
+void TimelapseScheduler::onWake(int64_t now_ns)
+{
+    phase_ = Phase::Waking;
+    wake_ns_ = now_ns;
+    measured_ = false;
+}
+
+bool TimelapseScheduler::onFrame(int64_t frame_ns)
+{
+    if (phase_ != Phase::Waking)
+    { return false; }
+
+    if (!measured_)
+    {
+        measured_ = true;
+        int64_t latency = frame_ns - wake_ns_;
+        if (latencies_.size() < options_.history)
+        { latencies_.push_back(latency); }
+        else
+        { latencies_[next_latency_] = latency; }
+        next_latency_ = (next_latency_ + 1) % options_.history;
+        stats_.latency_ms = latency / 1e6;
+        stats_.max_latency_ms = std::max(stats_.max_latency_ms, stats_.latency_ms);
+        stats_.estimate_ms = latencyEstimate() / 1e6;
+    }
+    if (frame_ns < shot_ns_)
+    { return false; }
+
+    phase_ = Phase::Shot;
+    ++stats_.shots;
+    stats_.late_ms = (frame_ns - shot_ns_) / 1e6;
+    stats_.streaming_ms = (frame_ns - wake_ns_) / 1e6;
+    return true;
+}
+
+void TimelapseScheduler::onSleep(int64_t now_ns)
+{
+    if (phase_ == Phase::Waking)
+    { ++stats_.missed; }
+    phase_ = Phase::Sleeping;
+
+    /// the next slot on the grid that a wake issued now can still reach
+    shot_ns_ += options_.interval_ns;
+    int64_t earliest = now_ns + latencyEstimate() + options_.margin_ns;
+    if (shot_ns_ < earliest)
+    {
+        int64_t skipped = (earliest - shot_ns_ + options_.interval_ns - 1) / options_.interval_ns;
+        shot_ns_ += skipped * options_.interval_ns;
+        stats_.missed += static_cast<uint64_t>(skipped);
+    }
+}
+
+int64_t TimelapseScheduler::latencyEstimate() const
+{
+    if (latencies_.empty())
+    { return options_.initial_latency_ns; }
+    return std::max<int64_t>(0, *std::max_element(latencies_.begin(), latencies_.end()));
+}
+
+}  // namespace obsbot_ros
@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <linux/videodev2.h>
+
+#include <obsbot_ros/v4l2_capture.hpp>
+
+namespace obsbot_ros
+{
+
+namespace
+{
+int xioctl(int fd, unsigned long request, void *arg)
+{
+    int ret;
+    do
+    {
+        ret = ioctl(fd, request, arg);
+    } while (ret == -1 && errno == EINTR);
+    return ret;
+}
+}
+
+V4l2Capture::~V4l2Capture()
+{
+    close();
+}
+
+bool V4l2Capture::open(const std::string &path, Format &format, uint32_t buffer_count)
+{
+    close();
+    if (!negotiate(path, format, buffer_count))
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool V4l2Capture::negotiate(const std::string &path, Format &format, uint32_t buffer_count)
+{
+    fd_ = ::open(path.c_str(), O_RDWR | O_NONBLOCK);
+    if (fd_ < 0)
+    { return fail("open " + path); }
+
+    v4l2_format fmt{};
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt.fmt.pix.width = static_cast<uint32_t>(format.width);
+    fmt.fmt.pix.height = static_cast<uint32_t>(format.height);
+    fmt.fmt.pix.pixelformat = toFourcc(format.format);
+    fmt.fmt.pix.field = V4L2_FIELD_ANY;
+    if (xioctl(fd_, VIDIOC_S_FMT, &fmt) < 0)
+    { return fail("VIDIOC_S_FMT"); }
+
+    format.width = static_cast<int32_t>(fmt.fmt.pix.width);
+    format.height = static_cast<int32_t>(fmt.fmt.pix.height);
+    format.format = fromFourcc(fmt.fmt.pix.pixelformat);
+    /// planar formats may pad their lines, the frame is wrapped with the driver's stride and size
+    stride_ = static_cast<int32_t>(fmt.fmt.pix.bytesperline);
+    frame_size_ = std::max<size_t>(fmt.fmt.pix.sizeimage, frameBufferSize(format.format, format.width, format.height));
+    dropped_ = 0;
+
+    v4l2_streamparm parm{};
+    parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    parm.parm.capture.timeperframe.numerator = 1;
+    parm.parm.capture.timeperframe.denominator = static_cast<uint32_t>(format.fps);
+    if (xioctl(fd_, VIDIOC_S_PARM, &parm) == 0 && parm.parm.capture.timeperframe.numerator != 0)
+    {
+        format.fps = static_cast<int32_t>(parm.parm.capture.timeperframe.denominator /
+                                          parm.parm.capture.timeperframe.numerator);
+    }
+
+    v4l2_requestbuffers req{};
+    req.count = buffer_count;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(fd_, VIDIOC_REQBUFS, &req) < 0 || req.count == 0)
+    { return fail("VIDIOC_REQBUFS"); }
+
+    buffers_.resize(req.count);
+    for (uint32_t i = 0; i < req.count; ++i)
+    {
+        v4l2_buffer buf{};
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        if (xioctl(fd_, VIDIOC_QUERYBUF, &buf) < 0)
+        { return fail("VIDIOC_QUERYBUF"); }
+
+        buffers_[i].length = buf.length;
+        buffers_[i].start = mmap(nullptr, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, buf.m.offset);
+        if (buffers_[i].start == MAP_FAILED)
+        {
+            buffers_[i].start = nullptr;
+            return fail("mmap");
+        }
+    }
+
+    format_ = format;
+    return true;
+}
+
+void V4l2Capture::close()
+{
+    stop();
+    for (auto &buffer : buffers_)
+    {
+        if (buffer.start)
+        { munmap(buffer.start, buffer.length); }
+    }
+    buffers_.clear();
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool V4l2Capture::start()
+{
+    if (fd_ < 0)
+    { return false; }
+    if (streaming_)
+    { return true; }
+
+    for (uint32_t i = 0; i < buffers_.size(); ++i)
+    {
+        v4l2_buffer buf{};
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        if (xioctl(fd_, VIDIOC_QBUF, &buf) < 0)
+        { return fail("VIDIOC_QBUF"); }
+    }
+
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(fd_, VIDIOC_STREAMON, &type) < 0)
+    { return fail("VIDIOC_STREAMON"); }
+    streaming_ = true;
+    return true;
+}
+
+/// STREAMOFF returns every buffer to user space, start() queues them again
+void V4l2Capture::stop()
+{
+    if (!streaming_)
+    { return; }
+
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    xioctl(fd_, VIDIOC_STREAMOFF, &type);
+    streaming_ = false;
+}
+
+bool V4l2Capture::grab(Frame &out, int timeout_ms)
+{
+    if (!streaming_)
+    { return false; }
+
+    pollfd pfd{fd_, POLLIN, 0};
+    int ret = poll(&pfd, 1, timeout_ms);
+    if (ret <= 0)
+    { return false; }
+
+    v4l2_buffer buf{};
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(fd_, VIDIOC_DQBUF, &buf) < 0)
+    { return errno == EAGAIN ? false : fail("VIDIOC_DQBUF"); }
+
+    /// the buffer goes back to the driver either way, a frame too large for the pool is only counted
+    bool copied = buf.bytesused <= out.capacity;
+    if (!copied)
+    { ++dropped_; }
+    else
+    {
+        std::memcpy(out.data, buffers_[buf.index].start, buf.bytesused);
+        out.size = buf.bytesused;
+        out.width = format_.width;
+        out.height = format_.height;
+        out.stride = stride_;
+        out.format = format_.format;
+        out.sequence = buf.sequence;
+        out.keyframe = format_.format == RmVideoFormat::MJPEG || (buf.flags & V4L2_BUF_FLAG_KEYFRAME) != 0;
+        out.steady_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    if (xioctl(fd_, VIDIOC_QBUF, &buf) < 0)
+    { return fail("VIDIOC_QBUF"); }
+    return copied;
+}
+
+uint32_t V4l2Capture::toFourcc(RmVideoFormat format)
+{
+    switch (format)
+    {
+    case RmVideoFormat::MJPEG:
+        return V4L2_PIX_FMT_MJPEG;
+    case RmVideoFormat::H264:
+        return V4L2_PIX_FMT_H264;
+    case RmVideoFormat::HEVC:
+        return V4L2_PIX_FMT_HEVC;
+    case RmVideoFormat::YUY2:
+        return V4L2_PIX_FMT_YUYV;
+    case RmVideoFormat::YVYU:
+        return V4L2_PIX_FMT_YVYU;
+    case RmVideoFormat::UYVY:
+        return V4L2_PIX_FMT_UYVY;
+    case RmVideoFormat::NV12:
+        return V4L2_PIX_FMT_NV12;
+    case RmVideoFormat::I420:
+        return V4L2_PIX_FMT_YUV420;
+    case RmVideoFormat::YV12:
+        return V4L2_PIX_FMT_YVU420;
+    case RmVideoFormat::Y800:
+        return V4L2_PIX_FMT_GREY;
+    default:
+        return 0;
+    }
+}
+
+RmVideoFormat V4l2Capture::fromFourcc(uint32_t fourcc)
+{
+    switch (fourcc)
+    {
+    case V4L2_PIX_FMT_MJPEG:
+        return RmVideoFormat::MJPEG;
+    case V4L2_PIX_FMT_H264:
+        return RmVideoFormat::H264;
+    case V4L2_PIX_FMT_HEVC:
+        return RmVideoFormat::HEVC;
+    case V4L2_PIX_FMT_YUYV:
+        return RmVideoFormat::YUY2;
+    case V4L2_PIX_FMT_YVYU:
+        return RmVideoFormat::YVYU;
+    case V4L2_PIX_FMT_UYVY:
+        return RmVideoFormat::UYVY;
+    case V4L2_PIX_FMT_NV12:
+        return RmVideoFormat::NV12;
+    case V4L2_PIX_FMT_YUV420:
+        return RmVideoFormat::I420;
+    case V4L2_PIX_FMT_YVU420:
+        return RmVideoFormat::YV12;
+    case V4L2_PIX_FMT_GREY:
+        return RmVideoFormat::Y800;
+    default:
+        return RmVideoFormat::Unknown;
+    }
+}
+
+bool V4l2Capture::fail(const std::string &what)
+{
+    last_error_ = what + ": " + std::strerror(errno);
+    return false;
+}
+
+}  // namespace obsbot_ros
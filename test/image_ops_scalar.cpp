@@ -0,0 +1,4 @@
+/// the kernels once more without simd and in their own namespace, so one test binary holds both builds
+#define OBSBOT_SCALAR_ONLY
+#define image_ops image_ops_scalar
+#include "../src/image_ops.cpp"
@@ -0,0 +1,36 @@
+#include <obsbot_ros/devs.hpp>
+
+/// libdev stand-in for the tests that need the device registry: no device is ever connected or plugged in
+
+Devices &Devices::get()
+{
+    static Devices devices;
+    return devices;
+}
+
+Devices::Devices() : d_ptr(nullptr)
+{}
+
+Devices::~Devices()
+{}
+
+void Devices::setDevChangedCallback(devChangedCallback, void *)
+{}
+
+std::shared_ptr<Device> Devices::getDevBySn(const std::string &)
+{
+    return nullptr;
+}
+
+std::list<std::shared_ptr<Device>> Devices::getDevList()
+{
+    return {};
+}
+
+Device::~Device()
+{}
+
+std::string Device::devSn()
+{
+    return "";
+}
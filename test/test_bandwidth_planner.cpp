@@ -0,0 +1,179 @@
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <obsbot_ros/bandwidth_planner.hpp>
+
+namespace obsbot_ros
+{
+namespace
+{
+
+V4l2Capture::Format format(int32_t width, int32_t height, int32_t fps, RmVideoFormat pixel_format)
+{
+    V4l2Capture::Format out;
+    out.width = width;
+    out.height = height;
+    out.fps = fps;
+    out.format = pixel_format;
+    return out;
+}
+
+/// an mjpeg 1080p30 request on a camera listing 1080p and 720p at 5 to 30 fps, on the given bus
+BandwidthPlanner::Camera camera(int32_t bus, double priority)
+{
+    BandwidthPlanner::Camera out;
+    out.priority = priority;
+    out.requested = format(1920, 1080, 30, RmVideoFormat::MJPEG);
+    out.formats = {Device::VideoFormatInfo(1920, 1080, 5, 30, RmVideoFormat::MJPEG),
+                   Device::VideoFormatInfo(1280, 720, 5, 30, RmVideoFormat::MJPEG),
+                   Device::VideoFormatInfo(640, 480, 5, 30, RmVideoFormat::YUY2)};
+    out.port.bus = bus;
+    out.port.bus_mbps = 480.0;
+    return out;
+}
+
+bool sameMode(const BandwidthPlanner::Mode &mode, int32_t width, int32_t height, int32_t fps)
+{
+    return mode.format.width == width && mode.format.height == height && mode.format.fps == fps;
+}
+
+TEST(BandwidthPlannerTest, ParsesBusLimits)
+{
+    int32_t bus = 0;
+    double mbps = 0.0;
+    ASSERT_TRUE(BandwidthPlanner::parseLimit("3 250.5", bus, mbps));
+    EXPECT_EQ(bus, 3);
+    EXPECT_DOUBLE_EQ(mbps, 250.5);
+    EXPECT_FALSE(BandwidthPlanner::parseLimit("3", bus, mbps));
+    EXPECT_FALSE(BandwidthPlanner::parseLimit("0 100", bus, mbps));
+    EXPECT_FALSE(BandwidthPlanner::parseLimit("2 -1", bus, mbps));
+    EXPECT_FALSE(BandwidthPlanner::parseLimit("bus 100", bus, mbps));
+}
+
+TEST(BandwidthPlannerTest, EstimatesTheBandwidthOfAFormat)
+{
+    BandwidthPlanner::Options options;
+    /// raw formats are exact, 2 bytes a pixel plus the overhead
+    EXPECT_NEAR(BandwidthPlanner::bandwidth(format(640, 480, 30, RmVideoFormat::YUY2), options), 162.2, 0.01);
+    EXPECT_NEAR(BandwidthPlanner::bandwidth(format(1920, 1080, 30, RmVideoFormat::MJPEG), options), 205.29, 0.01);
+    EXPECT_NEAR(BandwidthPlanner::bandwidth(format(1920, 1080, 30, RmVideoFormat::H264), options), 34.21, 0.01);
+}
+
+TEST(BandwidthPlannerTest, OffersListedModesOfTheRequestedFormatBestFirst)
+{
+    BandwidthPlanner::Options options;
+    auto modes = BandwidthPlanner::candidates(camera(1, 1.0), options);
+    /// 30, 15 and 7 fps of both mjpeg sizes, the yuy2 size is another format
+    ASSERT_EQ(modes.size(), 6u);
+    EXPECT_TRUE(sameMode(modes.front(), 1920, 1080, 30));
+    EXPECT_DOUBLE_EQ(modes.front().quality, 1.0);
+    EXPECT_TRUE(sameMode(modes.back(), 1280, 720, 7));
+    for (size_t i = 1; i < modes.size(); ++i)
+    { EXPECT_GE(modes[i - 1].quality, modes[i].quality); }
+
+    /// nothing listed at or below the request, the request itself is the only mode
+    auto small = camera(1, 1.0);
+    small.requested = format(320, 240, 30, RmVideoFormat::MJPEG);
+    modes = BandwidthPlanner::candidates(small, options);
+    ASSERT_EQ(modes.size(), 1u);
+    EXPECT_TRUE(sameMode(modes.front(), 320, 240, 30));
+
+    /// the minimum rate cuts the halving short
+    options.min_fps = 10;
+    EXPECT_EQ(BandwidthPlanner::candidates(camera(1, 1.0), options).size(), 4u);
+}
+
+TEST(BandwidthPlannerTest, SplitsABusByPriority)
+{
+    BandwidthPlanner::Options options;
+    /// 384 Mbps of the usb2 bus: two 1080p30 streams do not fit, the higher priority keeps its request
+    auto result = BandwidthPlanner::solve({camera(1, 1.0), camera(1, 2.0)}, options);
+    ASSERT_EQ(result.size(), 2u);
+    EXPECT_TRUE(sameMode(result[0].mode, 1920, 1080, 15));
+    EXPECT_TRUE(sameMode(result[1].mode, 1920, 1080, 30));
+    for (const auto &assignment : result)
+    {
+        EXPECT_TRUE(assignment.fits);
+        EXPECT_DOUBLE_EQ(assignment.bus_budget_mbps, 384.0);
+        EXPECT_NEAR(assignment.bus_used_mbps, result[0].mode.mbps + result[1].mode.mbps, 1e-9);
+        EXPECT_LE(assignment.bus_used_mbps, assignment.bus_budget_mbps);
+    }
+
+    /// cameras on another bus do not share the budget
+    result = BandwidthPlanner::solve({camera(1, 1.0), camera(2, 2.0)}, options);
+    EXPECT_TRUE(sameMode(result[0].mode, 1920, 1080, 30));
+    EXPECT_TRUE(sameMode(result[1].mode, 1920, 1080, 30));
+}
+
+TEST(BandwidthPlannerTest, TheLinkOfTheCameraCapsItsModes)
+{
+    BandwidthPlanner::Options options;
+    auto slow = camera(1, 1.0);
+    slow.port.link_mbps = 100.0;
+    auto result = BandwidthPlanner::solve({slow}, options);
+    EXPECT_TRUE(result[0].fits);
+    EXPECT_TRUE(sameMode(result[0].mode, 1920, 1080, 7));
+
+    /// a full speed link carries none of them
+    slow.port.link_mbps = 12.0;
+    result = BandwidthPlanner::solve({slow}, options);
+    EXPECT_FALSE(result[0].fits);
+    EXPECT_TRUE(sameMode(result[0].mode, 1280, 720, 7));
+}
+
+TEST(BandwidthPlannerTest, AnOvercommittedBusFallsBackToTheLightestModes)
+{
+    BandwidthPlanner::Options options;
+    options.bus_limits[1] = 30.0;
+    auto result = BandwidthPlanner::solve({camera(1, 1.0), camera(1, 1.0)}, options);
+    for (const auto &assignment : result)
+    {
+        EXPECT_FALSE(assignment.fits);
+        EXPECT_TRUE(sameMode(assignment.mode, 1280, 720, 7));
+        EXPECT_DOUBLE_EQ(assignment.bus_budget_mbps, 30.0);
+    }
+}
+
+TEST(BandwidthPlannerTest, AnUnknownBusKeepsTheRequest)
+{
+    BandwidthPlanner::Options options;
+    auto result = BandwidthPlanner::solve({camera(-1, 1.0), camera(-1, 1.0)}, options);
+    for (const auto &assignment : result)
+    {
+        EXPECT_TRUE(assignment.fits);
+        EXPECT_TRUE(sameMode(assignment.mode, 1920, 1080, 30));
+        EXPECT_DOUBLE_EQ(assignment.bus_budget_mbps, 0.0);
+    }
+}
+
+TEST(BandwidthPlannerTest, CamerasJoinAndLeaveThePlan)
+{
+    auto &planner = BandwidthPlanner::get();
+    BandwidthPlanner::Assignment assignment;
+    EXPECT_FALSE(planner.assignment(1, assignment));
+
+    /// no such video node, the camera is planned without a bus
+    auto member = camera(-1, 1.0);
+    member.video_path = "/nonexistent/video0";
+    size_t calls = 0;
+    planner.join(1, member, [&calls]()
+                 { ++calls; });
+    planner.join(2, member, nullptr);
+    ASSERT_TRUE(planner.assignment(1, assignment));
+    EXPECT_TRUE(sameMode(assignment.mode, 1920, 1080, 30));
+    EXPECT_EQ(assignment.port.bus, -1);
+    planner.replan();
+    EXPECT_EQ(calls, 0u);
+
+    planner.leave(1);
+    EXPECT_FALSE(planner.assignment(1, assignment));
+    EXPECT_TRUE(planner.assignment(2, assignment));
+    planner.leave(2);
+    planner.leave(2);
+    EXPECT_FALSE(planner.assignment(2, assignment));
+}
+
+}  // namespace
+}  // namespace obsbot_ros
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <rclcpp/rclcpp.hpp>
+
+#include <obsbot_ros/executor_layout.hpp>
+
+namespace obsbot_ros
+{
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::chrono::milliseconds kControlPeriod(20);
+constexpr std::chrono::milliseconds kSdkLatency(200);
+
+/// stands in for the sdk, every call blocks like a round trip to a busy camera
+class SlowDevice
+{
+public:
+    explicit SlowDevice(std::chrono::milliseconds latency) : latency_(latency)
+    {}
+
+    int32_t call()
+    {
+        ++calls_;
+        std::this_thread::sleep_for(latency_);
+        return 0;
+    }
+
+    uint64_t calls() const
+    { return calls_; }
+
+private:
+    std::chrono::milliseconds latency_;
+    std::atomic<uint64_t> calls_{0};
+};
+
+/**
+ * @brief  The roles of the driver in small. Status and housekeeping block on the device, a parameter batch blocks
+ *         inside the on-set callback with the parameter lock held, and the control tick only reads values the
+ *         callback cached, like the driver's control loop.
+ */
+class LayoutNode : public rclcpp::Node
+{
+public:
+    explicit LayoutNode(SlowDevice &device) :
+        rclcpp::Node("executor_layout_test"), device_(device), groups_(get_node_base_interface())
+    {
+        declare_parameter<double>("motion.gain", 1.0);
+        declare_parameter<int>("image.brightness", -1);
+        declare_parameter<int>("image.contrast", -1);
+        param_cb_handle_ = add_on_set_parameters_callback(
+            [this](const std::vector<rclcpp::Parameter> &params)
+            {
+                for (const auto &param : params)
+                {
+                    if (param.get_name() == "motion.gain")
+                    { gain_ = param.as_double(); }
+                    else
+                    { device_.call(); }
+                }
+                ++batches_;
+                rcl_interfaces::msg::SetParametersResult result;
+                result.successful = true;
+                return result;
+            });
+
+        control_timer_ = create_wall_timer(kControlPeriod, [this]()
+                                           { controlTick(); }, groups_.get(CallbackRole::Control));
+        status_timer_ = create_wall_timer(std::chrono::milliseconds(10), [this]()
+                                          { device_.call(); }, groups_.get(CallbackRole::Status));
+        housekeeping_timer_ = create_wall_timer(std::chrono::milliseconds(10), [this]()
+                                                { device_.call(); }, groups_.get(CallbackRole::Housekeeping));
+    }
+
+    const CallbackGroups &callbackGroups() const
+    { return groups_; }
+
+    uint64_t batches() const
+    { return batches_; }
+
+    /// longest interval between two control ticks and the number of ticks
+    void controlStats(Clock::duration &max_interval, size_t &ticks)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        max_interval = max_interval_;
+        ticks = ticks_;
+    }
+
+private:
+    void controlTick()
+    {
+        auto tick = Clock::now();
+        std::lock_guard<std::mutex> lock(mutex_);
+        applied_gain_ = gain_.load();
+        if (ticks_ > 0)
+        { max_interval_ = std::max(max_interval_, tick - last_tick_); }
+        last_tick_ = tick;
+        ++ticks_;
+    }
+
+    SlowDevice &device_;
+    CallbackGroups groups_;
+    std::atomic<double> gain_{1.0};
+    double applied_gain_ = 1.0;
+    std::atomic<uint64_t> batches_{0};
+    std::mutex mutex_;
+    Clock::time_point last_tick_;
+    Clock::duration max_interval_{};
+    size_t ticks_ = 0;
+    rclcpp::TimerBase::SharedPtr control_timer_;
+    rclcpp::TimerBase::SharedPtr status_timer_;
+    rclcpp::TimerBase::SharedPtr housekeeping_timer_;
+    rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr param_cb_handle_;
+};
+
+class ExecutorLayoutTest : public ::testing::TestWithParam<std::vector<std::string>>
+{
+protected:
+    static void SetUpTestSuite()
+    { rclcpp::init(0, nullptr); }
+
+    static void TearDownTestSuite()
+    { rclcpp::shutdown(); }
+};
+
+TEST_P(ExecutorLayoutTest, ControlKeepsItsPeriodWhileSdkCallsAndParameterBatchesBlock)
+{
+    SlowDevice device(kSdkLatency);
+    auto node = std::make_shared<LayoutNode>(device);
+
+    ExecutorLayout::Options options;
+    options.dedicated = GetParam();
+    options.shared_threads = 2;
+    ExecutorLayout layout(options);
+    ASSERT_TRUE(layout.isDedicated(CallbackRole::Control));
+    layout.add(node->callbackGroups());
+    std::thread spinner([&layout]()
+                        { layout.spin(); });
+
+    /// parameter batches from outside the executor, the way the parameter service hands them to the node
+    auto end = Clock::now() + std::chrono::milliseconds(1500);
+    std::thread batches([&node, end]()
+    {
+        int32_t value = 0;
+        while (Clock::now() < end)
+        {
+            node->set_parameters({rclcpp::Parameter("image.brightness", ++value),
+                                  rclcpp::Parameter("image.contrast", value),
+                                  rclcpp::Parameter("motion.gain", 0.5 + value % 2)});
+        }
+    });
+    batches.join();
+    layout.cancel();
+    spinner.join();
+
+    Clock::duration max_interval;
+    size_t ticks;
+    node->controlStats(max_interval, ticks);
+    EXPECT_GT(device.calls(), 5u);
+    EXPECT_GT(node->batches(), 2u);
+    /// the driver warns above two periods; a slow call sitting in front of a tick would take kSdkLatency
+    EXPECT_LT(max_interval, 2 * kControlPeriod)
+        << std::chrono::duration_cast<std::chrono::milliseconds>(max_interval).count() << " ms";
+    EXPECT_GT(ticks, static_cast<size_t>(0.7 * 1500 / kControlPeriod.count()));
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Layouts, ExecutorLayoutTest,
+    ::testing::Values(std::vector<std::string>{"capture", "control", "status", "media", "housekeeping"},
+                      std::vector<std::string>{"control"}));
+
+TEST(CallbackRoleTest, NamesMatchTheExecutorParameter)
+{
+    EXPECT_STREQ(callbackRoleName(CallbackRole::Capture), "capture");
+    EXPECT_STREQ(callbackRoleName(CallbackRole::Control), "control");
+    EXPECT_STREQ(callbackRoleName(CallbackRole::Status), "status");
+    EXPECT_STREQ(callbackRoleName(CallbackRole::Media), "media");
+    EXPECT_STREQ(callbackRoleName(CallbackRole::Housekeeping), "housekeeping");
+}
+
+}  // namespace
+}  // namespace obsbot_ros
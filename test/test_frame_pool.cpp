@@ -0,0 +1,123 @@
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <obsbot_ros/frame_pool.hpp>
+
+namespace obsbot_ros
+{
+namespace
+{
+
+TEST(FramePoolTest, HandsOutEveryBufferOnceThenAnEmptyHandle)
+{
+    FramePool pool(3, 100);
+    EXPECT_EQ(pool.count(), 3u);
+    EXPECT_EQ(pool.capacity(), 128u);
+
+    std::vector<FrameRef> frames;
+    for (int i = 0; i < 3; ++i)
+    {
+        frames.push_back(pool.acquire());
+        ASSERT_TRUE(frames.back());
+        EXPECT_EQ(frames.back()->capacity, pool.capacity());
+        EXPECT_EQ(frames.back()->size, 0u);
+        /// aligned for the simd stages
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(frames.back()->data) % 64, 0u);
+    }
+    EXPECT_NE(frames[0]->data, frames[1]->data);
+    EXPECT_EQ(pool.available(), 0u);
+    EXPECT_FALSE(pool.acquire());
+
+    frames.pop_back();
+    EXPECT_EQ(pool.available(), 1u);
+    EXPECT_TRUE(pool.acquire());
+    EXPECT_EQ(pool.available(), 1u);
+}
+
+TEST(FramePoolTest, TheLastHandleReturnsTheBuffer)
+{
+    FramePool pool(2, 64);
+    auto first = pool.acquire();
+    first->size = 10;
+
+    FrameRef copy = first;
+    FrameRef assigned;
+    assigned = copy;
+    EXPECT_EQ(copy.get(), first.get());
+    EXPECT_EQ(assigned.get(), first.get());
+
+    FrameRef moved = std::move(first);
+    EXPECT_FALSE(first);
+    EXPECT_EQ(moved->size, 10u);
+
+    copy.reset();
+    assigned.reset();
+    EXPECT_EQ(pool.available(), 1u);
+    moved.reset();
+    EXPECT_EQ(pool.available(), 2u);
+
+    /// a reused buffer starts empty
+    EXPECT_EQ(pool.acquire()->size, 0u);
+}
+
+TEST(FramePoolTest, HandlesKeepTheBuffersOfADestroyedPool)
+{
+    auto pool = std::make_unique<FramePool>(2, 64);
+    auto frame = pool->acquire();
+    frame->size = 3;
+    frame->data[2] = 7;
+    FrameRef copy = frame;
+
+    /// eg. the capture was reopened with another size while a service held the last frame
+    pool.reset();
+    EXPECT_EQ(frame->data[2], 7);
+    frame.reset();
+    EXPECT_EQ(copy->size, 3u);
+}
+
+TEST(FramePoolTest, HandlesCanBeSharedAcrossThreads)
+{
+    FramePool pool(4, 64);
+    auto frame = pool.acquire();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&frame]()
+        {
+            for (int i = 0; i < 10000; ++i)
+            {
+                FrameRef copy = frame;
+                FrameRef other = copy;
+            }
+        });
+    }
+    for (auto &thread : threads)
+    { thread.join(); }
+    EXPECT_EQ(pool.available(), 3u);
+    frame.reset();
+    EXPECT_EQ(pool.available(), 4u);
+}
+
+TEST(FramePoolTest, SizesAndNamesFormats)
+{
+    EXPECT_EQ(frameBufferSize(RmVideoFormat::I420, 640, 480), 640u * 480 * 3 / 2);
+    EXPECT_EQ(frameBufferSize(RmVideoFormat::Y800, 640, 480), 640u * 480);
+    EXPECT_EQ(frameBufferSize(RmVideoFormat::YUY2, 640, 480), 640u * 480 * 2);
+    EXPECT_EQ(frameBufferSize(RmVideoFormat::MJPEG, 640, 480), 640u * 480 * 2);
+    EXPECT_EQ(frameBufferSize(RmVideoFormat::RGB24, 640, 480), 640u * 480 * 3);
+    EXPECT_EQ(frameBufferSize(RmVideoFormat::Unknown, 640, 480), 0u);
+
+    EXPECT_STREQ(encodingName(RmVideoFormat::MJPEG), "jpeg");
+    EXPECT_STREQ(encodingName(RmVideoFormat::YUY2), "yuv422_yuy2");
+    EXPECT_STREQ(encodingName(RmVideoFormat::P010), "");
+    EXPECT_TRUE(isEncoded(RmVideoFormat::H264));
+    EXPECT_FALSE(isEncoded(RmVideoFormat::NV12));
+}
+
+}  // namespace
+}  // namespace obsbot_ros
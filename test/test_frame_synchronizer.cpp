@@ -0,0 +1,194 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <obsbot_ros/frame_synchronizer.hpp>
+
+namespace obsbot_ros
+{
+namespace
+{
+
+constexpr int64_t kMs = 1000000;
+
+class FrameSynchronizerTest : public ::testing::Test
+{
+protected:
+    FrameSynchronizerTest() : pool_(32, 64)
+    {}
+
+    FrameRef frame(int64_t stamp_ns)
+    {
+        auto ref = pool_.acquire();
+        ref->stamp_ns = stamp_ns;
+        return ref;
+    }
+
+    /// stamps of every set waiting in the synchronizer, in order
+    std::vector<std::vector<int64_t>> takeAll(FrameSynchronizer &synchronizer)
+    {
+        std::vector<std::vector<int64_t>> sets;
+        while (synchronizer.take([&sets](const FrameRef *frames, size_t count, int64_t)
+        {
+            std::vector<int64_t> stamps;
+            for (size_t i = 0; i < count; ++i)
+            { stamps.push_back(frames[i]->stamp_ns); }
+            sets.push_back(stamps);
+        }))
+        {}
+        return sets;
+    }
+
+    FramePool pool_;
+};
+
+TEST_F(FrameSynchronizerTest, MatchesFramesWithinTheTolerance)
+{
+    FrameSynchronizer::Options options;
+    options.streams = 2;
+    options.tolerance_ns = 5 * kMs;
+    size_t ready = 0;
+    FrameSynchronizer synchronizer(options, [&ready]()
+                                   { ++ready; });
+
+    synchronizer.push(0, frame(100 * kMs));
+    synchronizer.push(1, frame(103 * kMs));
+    EXPECT_EQ(ready, 1u);
+    synchronizer.push(0, frame(133 * kMs));
+    synchronizer.push(1, frame(134 * kMs));
+    EXPECT_EQ(ready, 2u);
+
+    EXPECT_EQ(takeAll(synchronizer), (std::vector<std::vector<int64_t>>{{100 * kMs, 103 * kMs},
+                                                                         {133 * kMs, 134 * kMs}}));
+    auto stats = synchronizer.stats();
+    EXPECT_EQ(stats.sets, 2u);
+    EXPECT_EQ(stats.last_skew_ns, 1 * kMs);
+    EXPECT_EQ(stats.max_skew_ns, 3 * kMs);
+    EXPECT_DOUBLE_EQ(stats.match_rate, 1.0);
+    /// every reference went back to the pool
+    EXPECT_EQ(pool_.available(), pool_.count());
+}
+
+TEST_F(FrameSynchronizerTest, DropsFramesThatCanNotBeMatched)
+{
+    FrameSynchronizer::Options options;
+    options.streams = 3;
+    options.tolerance_ns = 5 * kMs;
+    FrameSynchronizer synchronizer(options, nullptr);
+
+    /// stream 2 missed the first frame, the heads of 0 and 1 are too old for its first one
+    synchronizer.push(0, frame(100 * kMs));
+    synchronizer.push(1, frame(101 * kMs));
+    synchronizer.push(0, frame(133 * kMs));
+    synchronizer.push(1, frame(132 * kMs));
+    synchronizer.push(2, frame(134 * kMs));
+
+    EXPECT_EQ(takeAll(synchronizer), (std::vector<std::vector<int64_t>>{{133 * kMs, 132 * kMs, 134 * kMs}}));
+    EXPECT_EQ(synchronizer.stats().unmatched, 2u);
+    EXPECT_EQ(pool_.available(), pool_.count());
+}
+
+TEST_F(FrameSynchronizerTest, BoundsTheQueuesAndTheWaitingSets)
+{
+    FrameSynchronizer::Options options;
+    options.streams = 2;
+    options.queue_depth = 2;
+    options.set_depth = 2;
+    options.tolerance_ns = 5 * kMs;
+    FrameSynchronizer synchronizer(options, nullptr);
+
+    /// stream 1 is silent, stream 0 overflows its queue
+    for (int64_t i = 0; i < 4; ++i)
+    { synchronizer.push(0, frame(i * 33 * kMs)); }
+    EXPECT_EQ(synchronizer.stats().overflows, 2u);
+
+    /// nobody takes the sets, the oldest make room for the newest
+    for (int64_t i = 2; i < 6; ++i)
+    {
+        if (i >= 4)
+        { synchronizer.push(0, frame(i * 33 * kMs)); }
+        synchronizer.push(1, frame(i * 33 * kMs + kMs));
+    }
+    auto stats = synchronizer.stats();
+    EXPECT_EQ(stats.sets, 4u);
+    EXPECT_EQ(stats.dropped_sets, 2u);
+    EXPECT_EQ(takeAll(synchronizer), (std::vector<std::vector<int64_t>>{{132 * kMs, 133 * kMs},
+                                                                         {165 * kMs, 166 * kMs}}));
+    EXPECT_EQ(pool_.available(), pool_.count());
+}
+
+TEST_F(FrameSynchronizerTest, ReleaseDropsTheStreamAndTheWaitingSets)
+{
+    FrameSynchronizer::Options options;
+    options.streams = 2;
+    options.tolerance_ns = 5 * kMs;
+    FrameSynchronizer synchronizer(options, nullptr);
+
+    synchronizer.push(0, frame(100 * kMs));
+    synchronizer.push(1, frame(100 * kMs));
+    synchronizer.push(0, frame(133 * kMs));
+    synchronizer.input(1)->onRelease();
+    EXPECT_EQ(pool_.available(), pool_.count() - 1);
+    EXPECT_TRUE(takeAll(synchronizer).empty());
+    synchronizer.release(0);
+    EXPECT_EQ(pool_.available(), pool_.count());
+}
+
+TEST_F(FrameSynchronizerTest, ReleaseWaitsForASetBeingTaken)
+{
+    FrameSynchronizer::Options options;
+    options.streams = 2;
+    options.tolerance_ns = 5 * kMs;
+    FrameSynchronizer synchronizer(options, nullptr);
+    synchronizer.push(0, frame(100 * kMs));
+    synchronizer.push(1, frame(100 * kMs));
+
+    std::atomic<bool> inside{false};
+    std::atomic<bool> released{false};
+    std::atomic<bool> released_inside{true};
+    std::thread consumer([&]()
+    {
+        synchronizer.take([&](const FrameRef *, size_t, int64_t)
+        {
+            inside = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            released_inside = released.load();
+        });
+    });
+    while (!inside)
+    { std::this_thread::yield(); }
+
+    /// matching goes on while the set is out
+    synchronizer.push(0, frame(133 * kMs));
+    synchronizer.push(1, frame(133 * kMs));
+    EXPECT_EQ(synchronizer.stats().sets, 2u);
+
+    synchronizer.release(1);
+    released = true;
+    consumer.join();
+    EXPECT_FALSE(released_inside);
+    EXPECT_EQ(pool_.available(), pool_.count());
+}
+
+TEST_F(FrameSynchronizerTest, InputsWantFramesOnlyOnDemand)
+{
+    FrameSynchronizer::Options options;
+    options.streams = 2;
+    FrameSynchronizer idle(options, nullptr);
+    EXPECT_FALSE(idle.input(0)->wantsFrames());
+
+    bool listening = false;
+    FrameSynchronizer synchronizer(options, nullptr, [&listening]()
+                                   { return listening; });
+    EXPECT_FALSE(synchronizer.input(1)->wantsFrames());
+    listening = true;
+    EXPECT_TRUE(synchronizer.input(0)->wantsFrames());
+    EXPECT_TRUE(synchronizer.input(1)->wantsFrames());
+}
+
+}  // namespace
+}  // namespace obsbot_ros
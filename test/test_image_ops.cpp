@@ -0,0 +1,260 @@
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <obsbot_ros/image_ops.hpp>
+
+/// the scalar build of the same kernels, see image_ops_scalar.cpp
+#undef OBSBOT_IMAGE_OPS_HPP
+#define image_ops image_ops_scalar
+#include <obsbot_ros/image_ops.hpp>
+#undef image_ops
+
+namespace obsbot_ros
+{
+namespace
+{
+
+namespace simd = image_ops;
+namespace scalar = image_ops_scalar;
+
+/// lengths around the 8 and 16 wide blocks, so every kernel runs its tail as well
+const std::vector<size_t> kCounts = {0, 1, 7, 8, 9, 15, 16, 17, 31, 33, 63, 65, 127, 333};
+
+/// first byte offsets, the kernels load and store unaligned
+const std::vector<size_t> kOffsets = {0, 1, 3};
+
+std::vector<uint8_t> randomBytes(size_t size, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<uint8_t> bytes(size);
+    for (auto &b : bytes)
+    { b = static_cast<uint8_t>(byte(rng)); }
+    return bytes;
+}
+
+/// a plane of random samples with a stride that leaves the rows unaligned
+struct Plane
+{
+    Plane(int32_t width, int32_t height, int32_t step, uint32_t seed) :
+        bytes(randomBytes(static_cast<size_t>(height) * static_cast<size_t>(width * step + 3) + 1, seed))
+    {
+        view.data = bytes.data() + 1;
+        view.width = width;
+        view.height = height;
+        view.stride = width * step + 3;
+        view.step = step;
+    }
+
+    std::vector<uint8_t> bytes;
+    image_ops::PlaneView view;
+};
+
+scalar::PlaneView scalarView(const simd::PlaneView &view)
+{
+    return {view.data, view.width, view.height, view.stride, view.step};
+}
+
+TEST(ImageOpsTest, BlendRowMatchesScalar)
+{
+    for (size_t count : kCounts)
+    {
+        for (size_t offset : kOffsets)
+        {
+            for (uint32_t weight : {0u, 1u, 37u, 128u, 255u, 256u})
+            {
+                auto a = randomBytes(count + 4, static_cast<uint32_t>(count));
+                auto b = randomBytes(count + 4, static_cast<uint32_t>(count + 1));
+                std::vector<uint8_t> out(count + 4, 0), expected(count + 4, 0);
+                simd::blendRow(out.data() + offset, a.data() + 1, b.data() + offset, weight, count);
+                scalar::blendRow(expected.data() + offset, a.data() + 1, b.data() + offset, weight, count);
+                ASSERT_EQ(out, expected) << "count " << count << " offset " << offset << " weight " << weight;
+
+                /// in place over the first row, the way the scaler blends over its destination
+                auto in_place = a;
+                auto in_place_expected = a;
+                simd::blendRow(in_place.data() + 1, in_place.data() + 1, b.data(), weight, count);
+                scalar::blendRow(in_place_expected.data() + 1, in_place_expected.data() + 1, b.data(), weight, count);
+                ASSERT_EQ(in_place, in_place_expected) << "count " << count << " weight " << weight;
+            }
+        }
+    }
+}
+
+TEST(ImageOpsTest, BlendMaskMatchesScalarAndKeepsTheEnds)
+{
+    for (size_t count : kCounts)
+    {
+        for (size_t offset : kOffsets)
+        {
+            auto dst = randomBytes(count + 4, static_cast<uint32_t>(count));
+            auto src = randomBytes(count + 4, static_cast<uint32_t>(count + 1));
+            auto alpha = randomBytes(count + 4, static_cast<uint32_t>(count + 2));
+            /// every third sample transparent, every third opaque
+            for (size_t i = 0; i < alpha.size(); ++i)
+            { alpha[i] = i % 3 == 0 ? 0 : (i % 3 == 1 ? 255 : alpha[i]); }
+
+            auto out = dst;
+            auto expected = dst;
+            simd::blendMask(out.data() + offset, src.data() + 1, alpha.data() + offset, count);
+            scalar::blendMask(expected.data() + offset, src.data() + 1, alpha.data() + offset, count);
+            ASSERT_EQ(out, expected) << "count " << count << " offset " << offset;
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (alpha[offset + i] == 0)
+                { ASSERT_EQ(out[offset + i], dst[offset + i]); }
+                else if (alpha[offset + i] == 255)
+                { ASSERT_EQ(out[offset + i], src[1 + i]); }
+            }
+        }
+    }
+}
+
+TEST(ImageOpsTest, DiffMaskMatchesScalar)
+{
+    for (size_t count : kCounts)
+    {
+        for (size_t offset : kOffsets)
+        {
+            for (int threshold : {0, 1, 17, 128, 254, 255})
+            {
+                auto a = randomBytes(count + 4, static_cast<uint32_t>(count));
+                auto b = randomBytes(count + 4, static_cast<uint32_t>(count + 1));
+                /// a few equal samples and differences right at the threshold
+                for (size_t i = 0; i + 1 < count; i += 5)
+                {
+                    b[offset + i] = a[1 + i];
+                    b[offset + i + 1] = static_cast<uint8_t>(std::min(255, a[2 + i] + threshold));
+                }
+                std::vector<uint8_t> mask(count + 4, 7), expected(count + 4, 7);
+                auto set = simd::diffMask(mask.data() + offset, a.data() + 1, b.data() + offset,
+                                          static_cast<uint8_t>(threshold), count);
+                auto expected_set = scalar::diffMask(expected.data() + offset, a.data() + 1, b.data() + offset,
+                                                     static_cast<uint8_t>(threshold), count);
+                ASSERT_EQ(mask, expected) << "count " << count << " threshold " << threshold;
+                ASSERT_EQ(set, expected_set) << "count " << count << " threshold " << threshold;
+            }
+        }
+    }
+}
+
+TEST(ImageOpsTest, FillAndSumSamplesMatchScalar)
+{
+    for (size_t count : kCounts)
+    {
+        for (size_t step : {1u, 2u, 3u, 4u})
+        {
+            for (size_t offset : kOffsets)
+            {
+                auto bytes = randomBytes(count * step + 8, static_cast<uint32_t>(count * step));
+                ASSERT_EQ(simd::sumSamples(bytes.data() + offset, step, count),
+                          scalar::sumSamples(bytes.data() + offset, step, count))
+                    << "count " << count << " step " << step << " offset " << offset;
+
+                /// the bytes between the samples and after the last one are kept
+                auto filled = bytes;
+                auto expected = bytes;
+                simd::fillSamples(filled.data() + offset, 0xa5, step, count);
+                scalar::fillSamples(expected.data() + offset, 0xa5, step, count);
+                ASSERT_EQ(filled, expected) << "count " << count << " step " << step << " offset " << offset;
+            }
+        }
+    }
+
+    /// white samples, the sum of a long row must not wrap in a lane
+    std::vector<uint8_t> white(4 * 4096, 255);
+    EXPECT_EQ(simd::sumSamples(white.data(), 4, 4096), 255u * 4096u);
+    EXPECT_EQ(simd::sumSamples(white.data(), 1, white.size()), 255u * white.size());
+}
+
+TEST(ImageOpsTest, WarpRowMatchesScalarInsideAndAcrossTheEdges)
+{
+    for (int32_t step : {1, 2, 4})
+    {
+        Plane plane(37, 23, step, static_cast<uint32_t>(step));
+        /// start, step per pixel: inside, sloped, mirrored, leaving the plane on every side
+        const int32_t runs[][4] = {
+            {2 << 16, 3 << 16, 1 << 15, 1 << 12},
+            {(5 << 16) + 0x1234, (4 << 16) + 0x8000, 0xe000, 0x2100},
+            {(30 << 16) + 77, (20 << 16) + 5, -(1 << 16) - 3, -0x3000},
+            {-(3 << 16), -(2 << 16), 3 << 15, 1 << 15},
+            {(35 << 16) + 0xff00, (21 << 16) + 0xff00, 1 << 14, 1 << 14},
+        };
+        for (size_t count : kCounts)
+        {
+            for (const auto &run : runs)
+            {
+                std::vector<uint8_t> out(count + 1, 0), expected(count + 1, 0);
+                simd::warpRow(out.data() + 1, plane.view, run[0], run[1], run[2], run[3], count);
+                scalar::warpRow(expected.data() + 1, scalarView(plane.view), run[0], run[1], run[2], run[3], count);
+                ASSERT_EQ(out, expected) << "step " << step << " count " << count << " start " << run[0];
+            }
+        }
+    }
+}
+
+TEST(ImageOpsTest, AffineWarpMatchesScalar)
+{
+    for (int32_t step : {1, 2})
+    {
+        Plane plane(61, 45, step, static_cast<uint32_t>(10 + step));
+        /// a small rotation about the center, and a crop by whole samples that is copied
+        const int32_t rotation[6] = {65437, -3617, (2 << 16) + 0x4321, 3617, 65437, (1 << 16) + 0x1111};
+        const int32_t crop[6] = {1 << 16, 0, 3 << 16, 0, 1 << 16, 2 << 16};
+        for (const int32_t *m : {rotation, crop})
+        {
+            const int32_t width = 53;
+            const int32_t height = 39;
+            const int32_t stride = width + 5;
+            std::vector<uint8_t> out(static_cast<size_t>(stride * height), 0), expected(out.size(), 0);
+            simd::affineWarp(plane.view, out.data(), stride, width, height, m);
+            scalar::affineWarp(scalarView(plane.view), expected.data(), stride, width, height, m);
+            ASSERT_EQ(out, expected) << "step " << step;
+        }
+
+        std::vector<uint8_t> copied(53 * 39);
+        simd::affineWarp(plane.view, copied.data(), 53, 53, 39, crop);
+        EXPECT_EQ(copied[0], plane.view.data[2 * plane.view.stride + 3 * step]);
+        EXPECT_EQ(copied[53 * 38 + 52], plane.view.data[40 * plane.view.stride + 55 * step]);
+    }
+}
+
+TEST(ImageOpsTest, PlaneScalerMatchesScalarAtEveryAlpha)
+{
+    /// odd sizes up and down, the destination rectangle starts at an odd byte of a wider plane
+    const int32_t sizes[][4] = {{33, 19, 64, 37}, {64, 48, 31, 17}, {17, 9, 17, 9}, {101, 57, 40, 101}};
+    for (int32_t step : {1, 2})
+    {
+        for (const auto &size : sizes)
+        {
+            Plane plane(size[0], size[1], step, static_cast<uint32_t>(size[0] + step));
+            for (uint32_t alpha : {0u, 1u, 100u, 255u, 256u})
+            {
+                const int32_t stride = size[2] + 7;
+                auto background = randomBytes(static_cast<size_t>(stride * (size[3] + 1)), alpha);
+                auto out = background;
+                auto expected = background;
+                simd::PlaneScaler scaler;
+                scalar::PlaneScaler scalar_scaler;
+                /// twice through the same scaler, the kept tables must give the same picture
+                for (int pass = 0; pass < 2; ++pass)
+                {
+                    out = background;
+                    scaler.scale(plane.view, out.data() + stride + 3, stride, size[2], size[3], alpha);
+                }
+                scalar_scaler.scale(scalarView(plane.view), expected.data() + stride + 3, stride, size[2], size[3],
+                                    alpha);
+                ASSERT_EQ(out, expected) << size[0] << "x" << size[1] << " to " << size[2] << "x" << size[3]
+                                         << " step " << step << " alpha " << alpha;
+                if (alpha == 0)
+                { ASSERT_EQ(out, background); }
+            }
+        }
+    }
+}
+
+}  // namespace
+}  // namespace obsbot_ros
@@ -0,0 +1,440 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#ifdef OBSBOT_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef OBSBOT_HAVE_LZ4
+#include <lz4frame.h>
+#endif
+
+#include <obsbot_ros/mcap_recorder.hpp>
+
+namespace obsbot_ros
+{
+namespace
+{
+
+const uint8_t kMagic[] = {0x89, 'M', 'C', 'A', 'P', 0x30, '\r', '\n'};
+
+/// bit by bit, independent of the table driven crc of the recorder
+uint32_t referenceCrc(const uint8_t *data, size_t size)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit)
+        { crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320u : 0); }
+    }
+    return ~crc;
+}
+
+/// little endian fields of one record body, fails the test instead of reading past the end
+class Reader
+{
+public:
+    Reader(const uint8_t *data, size_t size) : data_(data), size_(size)
+    {}
+
+    template <typename T>
+    T value()
+    {
+        T out{};
+        if (take(sizeof(T)))
+        { std::memcpy(&out, data_ + pos_ - sizeof(T), sizeof(T)); }
+        return out;
+    }
+
+    std::string string()
+    {
+        auto length = value<uint32_t>();
+        if (!take(length))
+        { return {}; }
+        return std::string(reinterpret_cast<const char *>(data_ + pos_ - length), length);
+    }
+
+    const uint8_t *bytes(size_t size)
+    { return take(size) ? data_ + pos_ - size : nullptr; }
+
+    size_t pos() const
+    { return pos_; }
+
+    size_t left() const
+    { return size_ - pos_; }
+
+private:
+    bool take(size_t size)
+    {
+        EXPECT_LE(size, size_ - pos_) << "record ends early";
+        if (size > size_ - pos_)
+        {
+            pos_ = size_;
+            return false;
+        }
+        pos_ += size;
+        return true;
+    }
+
+    const uint8_t *data_;
+    size_t size_;
+    size_t pos_ = 0;
+};
+
+struct Record
+{
+    uint8_t opcode = 0;
+    uint64_t offset = 0;                        /// of the opcode
+    uint64_t length = 0;                        /// of the body
+    const uint8_t *body = nullptr;
+};
+
+/// the record at offset, opcode 0 if it does not fit
+Record recordAt(const std::vector<uint8_t> &bytes, uint64_t offset)
+{
+    Record record;
+    if (offset + 9 > bytes.size())
+    { return record; }
+    std::memcpy(&record.length, bytes.data() + offset + 1, sizeof(record.length));
+    if (record.length > bytes.size() - offset - 9)
+    { return record; }
+    record.opcode = bytes[offset];
+    record.offset = offset;
+    record.body = bytes.data() + offset + 9;
+    return record;
+}
+
+std::vector<uint8_t> decompress(const std::string &compression, const uint8_t *data, size_t size,
+                                size_t uncompressed_size)
+{
+    std::vector<uint8_t> out(uncompressed_size);
+    if (compression.empty())
+    {
+        out.assign(data, data + size);
+        return out;
+    }
+#ifdef OBSBOT_HAVE_ZSTD
+    if (compression == "zstd")
+    {
+        size_t written = ZSTD_decompress(out.data(), out.size(), data, size);
+        EXPECT_FALSE(ZSTD_isError(written));
+        out.resize(ZSTD_isError(written) ? 0 : written);
+        return out;
+    }
+#endif
+#ifdef OBSBOT_HAVE_LZ4
+    if (compression == "lz4")
+    {
+        LZ4F_dctx *context = nullptr;
+        EXPECT_FALSE(LZ4F_isError(LZ4F_createDecompressionContext(&context, LZ4F_VERSION)));
+        size_t written = 0;
+        size_t read = 0;
+        while (read < size && written < out.size())
+        {
+            size_t out_size = out.size() - written;
+            size_t in_size = size - read;
+            size_t hint = LZ4F_decompress(context, out.data() + written, &out_size, data + read, &in_size, nullptr);
+            EXPECT_FALSE(LZ4F_isError(hint));
+            if (LZ4F_isError(hint))
+            { break; }
+            written += out_size;
+            read += in_size;
+        }
+        LZ4F_freeDecompressionContext(context);
+        out.resize(written);
+        return out;
+    }
+#endif
+    ADD_FAILURE() << "chunk compressed with " << compression;
+    return {};
+}
+
+/// whether this test can read back what the recorder writes
+bool readable(McapRecorder::Compression compression)
+{
+    switch (compression)
+    {
+    case McapRecorder::Compression::None:
+        return true;
+#ifdef OBSBOT_HAVE_ZSTD
+    case McapRecorder::Compression::Zstd:
+        return McapRecorder::supported(compression);
+#endif
+#ifdef OBSBOT_HAVE_LZ4
+    case McapRecorder::Compression::Lz4:
+        return McapRecorder::supported(compression);
+#endif
+    default:
+        return false;
+    }
+}
+
+struct Message
+{
+    uint16_t channel = 0;
+    uint64_t log_time = 0;
+    std::vector<uint8_t> data;
+};
+
+class McapRecorderTest : public testing::TestWithParam<McapRecorder::Compression>
+{
+};
+
+TEST(McapCrcTest, ReferenceCrcIsCrc32)
+{
+    const char check[] = "123456789";
+    EXPECT_EQ(referenceCrc(reinterpret_cast<const uint8_t *>(check), 9), 0xCBF43926u);
+}
+
+TEST_P(McapRecorderTest, WritesAFileThatReadsBack)
+{
+    if (!readable(GetParam()))
+    { GTEST_SKIP() << "compression not in this build"; }
+
+    McapRecorder::Options options;
+    options.path = testing::TempDir() + "mcap_recorder_test.mcap";
+    options.compression = GetParam();
+    options.chunk_size = 0;                     /// the smallest chunks, a few frames each
+    options.queue_depth = 16;
+    McapRecorder recorder(options, {{"/cam0", "cam0_link"}, {"/cam1", "cam1_link"}});
+    ASSERT_TRUE(recorder.open()) << recorder.lastError();
+
+    /// raw frames on the first camera, mjpeg on the second, their bytes a pattern of the sequence
+    FramePool pool(16, 160 * 120 * 3 / 2);
+    std::vector<std::vector<uint8_t>> sent[2];
+    auto send = [&](size_t stream, RmVideoFormat format, size_t size, uint64_t sequence)
+    {
+        auto frame = pool.acquire();
+        ASSERT_TRUE(frame);
+        frame->format = format;
+        frame->width = 160;
+        frame->height = 120;
+        frame->stride = 160;
+        frame->size = size;
+        frame->sequence = sequence;
+        frame->stamp_ns = static_cast<int64_t>(1000000 + sequence * 1000);
+        for (size_t i = 0; i < size; ++i)
+        { frame->data[i] = static_cast<uint8_t>(i * 7 + sequence * 13 + stream); }
+        sent[stream].emplace_back(frame->data, frame->data + size);
+        recorder.input(stream)->onFrame(frame);
+    };
+    for (uint64_t i = 0; i < 6; ++i)
+    { send(0, RmVideoFormat::I420, 160 * 120 * 3 / 2, i); }
+    for (uint64_t i = 0; i < 4; ++i)
+    { send(1, RmVideoFormat::MJPEG, 5000 + i, i); }
+    for (uint8_t i = 0; i < 3; ++i)
+    {
+        const uint8_t cdr[] = {0x00, 0x01, 0x00, 0x00, i, 0x42};
+        recorder.writeDiagnostics(2000000 + i, cdr, sizeof(cdr));
+    }
+    recorder.close();
+    auto stats = recorder.stats();
+    EXPECT_EQ(stats.dropped, 0u);
+    EXPECT_EQ(stats.messages, 13u);
+    EXPECT_GE(stats.chunks, 2u);
+
+    std::vector<uint8_t> bytes;
+    {
+        std::FILE *file = std::fopen(options.path.c_str(), "rb");
+        ASSERT_NE(file, nullptr);
+        uint8_t buffer[65536];
+        size_t read;
+        while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+        { bytes.insert(bytes.end(), buffer, buffer + read); }
+        std::fclose(file);
+    }
+    std::remove(options.path.c_str());
+    ASSERT_GT(bytes.size(), 2 * sizeof(kMagic) + 29);
+    EXPECT_EQ(stats.bytes_written, bytes.size());
+
+    /// magic on both ends, the header right after the leading one
+    EXPECT_EQ(std::memcmp(bytes.data(), kMagic, sizeof(kMagic)), 0);
+    EXPECT_EQ(std::memcmp(bytes.data() + bytes.size() - sizeof(kMagic), kMagic, sizeof(kMagic)), 0);
+    auto header = recordAt(bytes, sizeof(kMagic));
+    ASSERT_EQ(header.opcode, 0x01);
+    {
+        Reader reader(header.body, header.length);
+        EXPECT_EQ(reader.string(), "ros2");
+        EXPECT_EQ(reader.string(), "obsbot_ros");
+        EXPECT_EQ(reader.left(), 0u);
+    }
+
+    /// the footer points at the summary and carries its crc
+    uint64_t footer_offset = bytes.size() - sizeof(kMagic) - 29;
+    auto footer = recordAt(bytes, footer_offset);
+    ASSERT_EQ(footer.opcode, 0x02);
+    ASSERT_EQ(footer.length, 20u);
+    Reader footer_reader(footer.body, footer.length);
+    auto summary_start = footer_reader.value<uint64_t>();
+    EXPECT_EQ(footer_reader.value<uint64_t>(), 0u);
+    auto summary_crc = footer_reader.value<uint32_t>();
+    ASSERT_LT(summary_start, footer_offset);
+    EXPECT_EQ(summary_crc, referenceCrc(bytes.data() + summary_start, footer_offset + 25 - summary_start));
+
+    /// the data section ends with DataEnd right before the summary
+    {
+        uint64_t offset = sizeof(kMagic);
+        Record record;
+        while (offset < summary_start)
+        {
+            record = recordAt(bytes, offset);
+            ASSERT_NE(record.opcode, 0) << "broken record at " << offset;
+            offset += 9 + record.length;
+        }
+        EXPECT_EQ(offset, summary_start);
+        EXPECT_EQ(record.opcode, 0x0F);
+    }
+
+    /// summary: schemas, channels, one chunk index per chunk and the statistics
+    std::vector<Record> chunk_indexes;
+    std::map<uint16_t, std::string> topics;
+    Record statistics;
+    for (uint64_t offset = summary_start; offset < footer_offset;)
+    {
+        auto record = recordAt(bytes, offset);
+        ASSERT_NE(record.opcode, 0) << "broken summary record at " << offset;
+        if (record.opcode == 0x04)
+        {
+            Reader reader(record.body, record.length);
+            auto id = reader.value<uint16_t>();
+            reader.value<uint16_t>();
+            topics[id] = reader.string();
+        }
+        else if (record.opcode == 0x08)
+        {
+            chunk_indexes.push_back(record);
+        }
+        else if (record.opcode == 0x0B)
+        {
+            statistics = record;
+        }
+        offset += 9 + record.length;
+    }
+    EXPECT_EQ(topics[1], "/cam0/image_raw");
+    EXPECT_EQ(topics[4], "/cam1/image_raw/compressed");
+    EXPECT_EQ(topics[5], "/diagnostics");
+    EXPECT_EQ(chunk_indexes.size(), stats.chunks);
+
+    std::vector<Message> messages;
+    for (const auto &index_record : chunk_indexes)
+    {
+        Reader index(index_record.body, index_record.length);
+        auto start_ns = index.value<uint64_t>();
+        auto end_ns = index.value<uint64_t>();
+        auto chunk_offset = index.value<uint64_t>();
+        auto chunk_length = index.value<uint64_t>();
+        auto offsets_size = index.value<uint32_t>();
+        std::map<uint16_t, uint64_t> index_offsets;
+        for (uint32_t i = 0; i < offsets_size / 10; ++i)
+        {
+            auto channel = index.value<uint16_t>();
+            index_offsets[channel] = index.value<uint64_t>();
+        }
+        auto index_length = index.value<uint64_t>();
+        auto compression = index.string();
+        auto compressed_size = index.value<uint64_t>();
+        auto uncompressed_size = index.value<uint64_t>();
+        EXPECT_EQ(index.left(), 0u);
+
+        /// the chunk the index points at, with the same sizes
+        auto chunk = recordAt(bytes, chunk_offset);
+        ASSERT_EQ(chunk.opcode, 0x06) << "chunk index points at " << chunk_offset;
+        EXPECT_EQ(chunk_length, 9 + chunk.length);
+        Reader reader(chunk.body, chunk.length);
+        EXPECT_EQ(reader.value<uint64_t>(), start_ns);
+        EXPECT_EQ(reader.value<uint64_t>(), end_ns);
+        EXPECT_EQ(reader.value<uint64_t>(), uncompressed_size);
+        auto crc = reader.value<uint32_t>();
+        EXPECT_EQ(reader.string(), compression);
+        EXPECT_EQ(reader.value<uint64_t>(), compressed_size);
+        EXPECT_EQ(reader.left(), compressed_size);
+        if (GetParam() != McapRecorder::Compression::None)
+        { EXPECT_FALSE(compression.empty()); }
+        auto records = decompress(compression, reader.bytes(compressed_size), compressed_size, uncompressed_size);
+        ASSERT_EQ(records.size(), uncompressed_size);
+        EXPECT_EQ(crc, referenceCrc(records.data(), records.size()));
+
+        /// message indexes follow the chunk, every entry points at a message of its channel
+        uint64_t indexes_length = 0;
+        for (const auto &entry : index_offsets)
+        {
+            auto message_index = recordAt(bytes, entry.second);
+            ASSERT_EQ(message_index.opcode, 0x07) << "message index of channel " << entry.first;
+            EXPECT_GE(message_index.offset, chunk_offset + chunk_length);
+            indexes_length += 9 + message_index.length;
+            Reader entries(message_index.body, message_index.length);
+            EXPECT_EQ(entries.value<uint16_t>(), entry.first);
+            auto count = entries.value<uint32_t>() / 16;
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                auto time = entries.value<uint64_t>();
+                auto message = recordAt(records, entries.value<uint64_t>());
+                ASSERT_EQ(message.opcode, 0x05);
+                Reader fields(message.body, message.length);
+                EXPECT_EQ(fields.value<uint16_t>(), entry.first);
+                fields.value<uint32_t>();
+                EXPECT_EQ(fields.value<uint64_t>(), time);
+            }
+        }
+        EXPECT_EQ(indexes_length, index_length);
+
+        for (uint64_t offset = 0; offset < records.size();)
+        {
+            auto record = recordAt(records, offset);
+            ASSERT_EQ(record.opcode, 0x05) << "chunk record at " << offset;
+            Reader fields(record.body, record.length);
+            Message message;
+            message.channel = fields.value<uint16_t>();
+            fields.value<uint32_t>();
+            message.log_time = fields.value<uint64_t>();
+            EXPECT_EQ(fields.value<uint64_t>(), message.log_time);
+            EXPECT_GE(message.log_time, start_ns);
+            EXPECT_LE(message.log_time, end_ns);
+            auto data = fields.bytes(fields.left());
+            message.data.assign(data, data + record.length - 22);
+            messages.push_back(std::move(message));
+            offset += 9 + record.length;
+        }
+    }
+
+    /// every message made it, in order per channel, the frame bytes at the end of the cdr
+    std::map<uint16_t, std::vector<const Message *>> by_channel;
+    for (const auto &message : messages)
+    { by_channel[message.channel].push_back(&message); }
+    ASSERT_EQ(by_channel[1].size(), 6u);
+    ASSERT_EQ(by_channel[4].size(), 4u);
+    ASSERT_EQ(by_channel[5].size(), 3u);
+    for (auto channel : {std::make_pair<uint16_t, size_t>(1, 0), std::make_pair<uint16_t, size_t>(4, 1)})
+    {
+        for (size_t i = 0; i < sent[channel.second].size(); ++i)
+        {
+            const auto &data = by_channel[channel.first][i]->data;
+            const auto &frame = sent[channel.second][i];
+            ASSERT_GE(data.size(), frame.size() + 4);
+            uint32_t length;
+            std::memcpy(&length, data.data() + data.size() - frame.size() - 4, sizeof(length));
+            EXPECT_EQ(length, frame.size());
+            EXPECT_TRUE(std::equal(frame.begin(), frame.end(), data.end() - static_cast<ptrdiff_t>(frame.size())))
+                << "frame " << i << " of channel " << channel.first;
+            EXPECT_EQ(by_channel[channel.first][i]->log_time, 1000000 + i * 1000);
+        }
+    }
+    EXPECT_EQ(by_channel[5][2]->data, (std::vector<uint8_t>{0x00, 0x01, 0x00, 0x00, 2, 0x42}));
+
+    ASSERT_EQ(statistics.opcode, 0x0B);
+    Reader counts(statistics.body, statistics.length);
+    EXPECT_EQ(counts.value<uint64_t>(), messages.size());
+}
+
+INSTANTIATE_TEST_SUITE_P(Compressions, McapRecorderTest,
+                         testing::Values(McapRecorder::Compression::None, McapRecorder::Compression::Zstd,
+                                         McapRecorder::Compression::Lz4));
+
+}  // namespace
+}  // namespace obsbot_ros
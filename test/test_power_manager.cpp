@@ -0,0 +1,140 @@
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include <obsbot_ros/power_manager.hpp>
+
+namespace obsbot_ros
+{
+namespace
+{
+
+constexpr int64_t kMs = 1000000;
+constexpr int64_t kS = 1000 * kMs;
+
+using Action = PowerManager::Action;
+using State = PowerManager::State;
+
+PowerManager::Options options()
+{
+    PowerManager::Options options;
+    options.idle_ns = 30 * kS;
+    options.initial_latency_ns = 3 * kS;
+    options.wake_timeout_ns = 10 * kS;
+    options.history = 3;
+    return options;
+}
+
+/// asleep as of now_ns, after the idle time without demand
+void sleepAt(PowerManager &power, int64_t now_ns)
+{
+    power.reset(now_ns - 30 * kS);
+    ASSERT_EQ(power.update(false, now_ns), Action::Sleep);
+}
+
+TEST(PowerManagerTest, SleepsAfterTheIdleTimeWithoutDemand)
+{
+    PowerManager power(options());
+    power.reset(0);
+    EXPECT_EQ(power.state(), State::Awake);
+    EXPECT_EQ(power.update(false, 29 * kS), Action::None);
+
+    /// demand restarts the idle time
+    EXPECT_EQ(power.update(true, 20 * kS), Action::None);
+    EXPECT_EQ(power.update(false, 49 * kS), Action::None);
+    EXPECT_EQ(power.update(false, 50 * kS), Action::Sleep);
+    EXPECT_EQ(power.state(), State::Asleep);
+    EXPECT_EQ(power.stats().sleeps, 1u);
+
+    /// asleep without demand nothing happens, frames of the old stream are not a wake
+    EXPECT_EQ(power.update(false, 60 * kS), Action::None);
+    power.onFrame(60 * kS);
+    EXPECT_EQ(power.state(), State::Asleep);
+    EXPECT_EQ(power.stats().samples, 0u);
+}
+
+TEST(PowerManagerTest, WakesOnDemandAndIsAwakeWithTheFirstFrame)
+{
+    PowerManager power(options());
+    sleepAt(power, 100 * kS);
+    EXPECT_EQ(power.update(true, 140 * kS), Action::Wake);
+    EXPECT_EQ(power.state(), State::Waking);
+    EXPECT_EQ(power.stats().wakes, 1u);
+    EXPECT_DOUBLE_EQ(power.stats().asleep_s, 40.0);
+
+    /// waking, demand or not, nothing more until the first frame
+    EXPECT_EQ(power.update(true, 141 * kS), Action::None);
+    EXPECT_EQ(power.update(false, 142 * kS), Action::None);
+    power.onFrame(140 * kS + 1800 * kMs);
+    EXPECT_EQ(power.state(), State::Awake);
+    EXPECT_EQ(power.stats().samples, 1u);
+    EXPECT_DOUBLE_EQ(power.stats().latency_ms, 1800.0);
+
+    /// the idle time counts from the first frame, not from the last demand
+    EXPECT_EQ(power.update(false, 171 * kS), Action::None);
+    EXPECT_EQ(power.update(false, 171 * kS + 800 * kMs), Action::Sleep);
+}
+
+TEST(PowerManagerTest, IssuesTheWakeAgainAfterTheTimeout)
+{
+    PowerManager power(options());
+    sleepAt(power, 0);
+    EXPECT_EQ(power.update(true, 10 * kS), Action::Wake);
+    EXPECT_EQ(power.update(true, 19 * kS), Action::None);
+    EXPECT_EQ(power.update(true, 20 * kS), Action::Wake);
+    EXPECT_EQ(power.update(false, 29 * kS), Action::None);
+    EXPECT_EQ(power.update(false, 30 * kS), Action::Wake);
+    EXPECT_EQ(power.stats().wakes, 1u);
+    EXPECT_EQ(power.stats().wake_retries, 2u);
+
+    /// the latency is measured from the first wake call, retries included
+    power.onFrame(32 * kS);
+    EXPECT_DOUBLE_EQ(power.stats().latency_ms, 22000.0);
+    EXPECT_EQ(power.latencyEstimate(), 22 * kS);
+}
+
+TEST(PowerManagerTest, HoldKeepsTheCameraAwakeAndWakesIt)
+{
+    PowerManager power(options());
+    power.reset(0);
+    power.hold(50 * kS);
+    EXPECT_EQ(power.update(false, 45 * kS), Action::None);
+    /// the idle time starts where the hold ends
+    EXPECT_EQ(power.update(false, 79 * kS), Action::None);
+    EXPECT_EQ(power.update(false, 80 * kS), Action::Sleep);
+
+    /// a later hold wakes the sleeping camera, an earlier one does not shorten it
+    power.hold(200 * kS);
+    power.hold(150 * kS);
+    EXPECT_EQ(power.update(false, 190 * kS), Action::Wake);
+    power.onFrame(192 * kS);
+    EXPECT_EQ(power.update(false, 195 * kS), Action::None);
+    EXPECT_EQ(power.update(false, 229 * kS), Action::None);
+    EXPECT_EQ(power.update(false, 230 * kS), Action::Sleep);
+}
+
+TEST(PowerManagerTest, LatencyEstimateIsTheLongestOfTheRecentWakes)
+{
+    PowerManager power(options());
+    EXPECT_EQ(power.latencyEstimate(), 3 * kS);
+
+    int64_t now = 0;
+    for (int64_t latency : {1000 * kMs, 2500 * kMs, 700 * kMs, 600 * kMs, 500 * kMs, 400 * kMs})
+    {
+        now += 100 * kS;
+        sleepAt(power, now);
+        ASSERT_EQ(power.update(true, now + kS), Action::Wake);
+        power.onFrame(now + kS + latency);
+        ASSERT_EQ(power.state(), State::Awake);
+        if (latency == 2500 * kMs)
+        { EXPECT_EQ(power.latencyEstimate(), 2500 * kMs); }
+    }
+    /// the history holds the last 3 wakes
+    EXPECT_EQ(power.latencyEstimate(), 600 * kMs);
+    EXPECT_EQ(power.stats().samples, 6u);
+    EXPECT_DOUBLE_EQ(power.stats().latency_ms, 400.0);
+    EXPECT_DOUBLE_EQ(power.stats().max_latency_ms, 2500.0);
+}
+
+}  // namespace
+}  // namespace obsbot_ros
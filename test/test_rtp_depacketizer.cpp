@@ -0,0 +1,182 @@
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <obsbot_ros/rtp_depacketizer.hpp>
+
+namespace obsbot_ros
+{
+namespace
+{
+
+constexpr int64_t kMs = 1000000;
+
+std::vector<uint8_t> rtpPacket(uint16_t sequence, uint32_t timestamp, bool marker, const std::vector<uint8_t> &payload)
+{
+    std::vector<uint8_t> packet = {0x80, static_cast<uint8_t>((marker ? 0x80 : 0) | 96),
+                                   static_cast<uint8_t>(sequence >> 8), static_cast<uint8_t>(sequence),
+                                   static_cast<uint8_t>(timestamp >> 24), static_cast<uint8_t>(timestamp >> 16),
+                                   static_cast<uint8_t>(timestamp >> 8), static_cast<uint8_t>(timestamp),
+                                   0, 0, 0, 1};
+    packet.insert(packet.end(), payload.begin(), payload.end());
+    return packet;
+}
+
+std::vector<uint16_t> drain(RtpJitterBuffer &buffer, int64_t now_ns)
+{
+    std::vector<uint16_t> sequences;
+    RtpPacket packet;
+    int64_t arrival_ns;
+    while (buffer.pop(packet, arrival_ns, now_ns))
+    { sequences.push_back(packet.sequence); }
+    return sequences;
+}
+
+TEST(RtpPacketTest, ParsesTheFixedHeader)
+{
+    auto data = rtpPacket(0xfffe, 0x01020304, true, {0x65, 1, 2});
+    RtpPacket packet;
+    ASSERT_TRUE(RtpPacket::parse(data.data(), data.size(), packet));
+    EXPECT_EQ(packet.payload_type, 96);
+    EXPECT_TRUE(packet.marker);
+    EXPECT_EQ(packet.sequence, 0xfffe);
+    EXPECT_EQ(packet.timestamp, 0x01020304u);
+    EXPECT_EQ(packet.payload_size, 3u);
+
+    data[0] = 0x40;
+    EXPECT_FALSE(RtpPacket::parse(data.data(), data.size(), packet));
+}
+
+TEST(RtpJitterBufferTest, ReordersAndDropsDuplicates)
+{
+    RtpJitterBuffer buffer(8, 64, 40 * kMs);
+    for (uint16_t sequence : {10, 12, 11, 11, 13})
+    {
+        auto data = rtpPacket(sequence, 0, false, {1});
+        buffer.push(data.data(), data.size(), 0);
+    }
+    EXPECT_EQ(drain(buffer, 0), (std::vector<uint16_t>{10, 11, 12, 13}));
+    EXPECT_EQ(buffer.skipped(), 0u);
+
+    auto late = rtpPacket(12, 0, false, {1});
+    EXPECT_FALSE(buffer.push(late.data(), late.size(), 0));
+}
+
+TEST(RtpJitterBufferTest, SkipsAMissingPacketAfterTheDelay)
+{
+    RtpJitterBuffer buffer(8, 64, 40 * kMs);
+    for (uint16_t sequence : {1, 3, 4})
+    {
+        auto data = rtpPacket(sequence, 0, false, {1});
+        buffer.push(data.data(), data.size(), 0);
+    }
+    EXPECT_EQ(drain(buffer, 10 * kMs), (std::vector<uint16_t>{1}));
+    EXPECT_EQ(drain(buffer, 40 * kMs), (std::vector<uint16_t>{3, 4}));
+    EXPECT_EQ(buffer.skipped(), 1u);
+}
+
+TEST(RtpJitterBufferTest, DrainsTheQueueInOrderBeforeAJump)
+{
+    RtpJitterBuffer buffer(8, 64, 40 * kMs);
+    for (uint16_t sequence : {100, 102, 103})
+    {
+        auto data = rtpPacket(sequence, 0, false, {1});
+        buffer.push(data.data(), data.size(), 0);
+    }
+    EXPECT_EQ(drain(buffer, 0), (std::vector<uint16_t>{100}));
+
+    /// far beyond the window, eg. the camera restarted its sequence; the queue is not thrown away
+    auto jump = rtpPacket(5000, 0, false, {1});
+    ASSERT_TRUE(buffer.push(jump.data(), jump.size(), 0));
+    EXPECT_EQ(drain(buffer, 0), (std::vector<uint16_t>{102, 103, 5000}));
+    EXPECT_EQ(buffer.skipped(), 1u);
+
+    for (uint16_t sequence : {5002, 5001})
+    {
+        auto data = rtpPacket(sequence, 0, false, {1});
+        buffer.push(data.data(), data.size(), 0);
+    }
+    EXPECT_EQ(drain(buffer, 0), (std::vector<uint16_t>{5001, 5002}));
+}
+
+TEST(RtpJitterBufferTest, GrowsASlotForALargePacket)
+{
+    RtpJitterBuffer buffer(4, 16, 40 * kMs);
+    std::vector<uint8_t> payload(3000);
+    for (size_t i = 0; i < payload.size(); ++i)
+    { payload[i] = static_cast<uint8_t>(i); }
+    auto data = rtpPacket(7, 0, false, payload);
+    ASSERT_TRUE(buffer.push(data.data(), data.size(), 0));
+
+    RtpPacket packet;
+    int64_t arrival_ns;
+    ASSERT_TRUE(buffer.pop(packet, arrival_ns, 0));
+    ASSERT_EQ(packet.payload_size, payload.size());
+    EXPECT_EQ(std::vector<uint8_t>(packet.payload, packet.payload + packet.payload_size), payload);
+}
+
+class RtpDepacketizerTest : public ::testing::Test
+{
+protected:
+    void push(uint16_t sequence, uint32_t timestamp, bool marker, const std::vector<uint8_t> &payload)
+    {
+        data_ = rtpPacket(sequence, timestamp, marker, payload);
+        RtpPacket packet;
+        ASSERT_TRUE(RtpPacket::parse(data_.data(), data_.size(), packet));
+        depacketizer_.push(packet);
+    }
+
+    std::vector<std::vector<uint8_t>> units()
+    {
+        std::vector<std::vector<uint8_t>> out;
+        AccessUnit au;
+        while (depacketizer_.next(au))
+        {
+            out.emplace_back(au.data, au.data + au.size);
+            keyframes_.push_back(au.keyframe);
+        }
+        return out;
+    }
+
+    RtpDepacketizer depacketizer_{RtpDepacketizer::Codec::H264, 1 << 16};
+    std::vector<uint8_t> data_;
+    std::vector<bool> keyframes_;
+};
+
+TEST_F(RtpDepacketizerTest, ReassemblesFragmentsAndPutsParameterSetsInFront)
+{
+    depacketizer_.setParameterSets({0, 0, 0, 1, 0x67, 0xaa, 0, 0, 0, 1, 0x68, 0xbb});
+
+    /// FU-A of an idr slice: indicator 28, start and end bits on the header
+    push(1, 3000, false, {0x7c, 0x85, 1, 2});
+    push(2, 3000, false, {0x7c, 0x05, 3});
+    push(3, 3000, true, {0x7c, 0x45, 4});
+    auto out = units();
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_TRUE(keyframes_[0]);
+    EXPECT_EQ(out[0], (std::vector<uint8_t>{0, 0, 0, 1, 0x67, 0xaa, 0, 0, 0, 1, 0x68, 0xbb,
+                                            0, 0, 0, 1, 0x65, 1, 2, 3, 4}));
+
+    /// STAP-A with two non-idr slices
+    push(4, 6000, true, {0x18, 0, 2, 0x41, 9, 0, 2, 0x41, 8});
+    out = units();
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_FALSE(keyframes_[1]);
+    EXPECT_EQ(out[0], (std::vector<uint8_t>{0, 0, 0, 1, 0x41, 9, 0, 0, 0, 1, 0x41, 8}));
+}
+
+TEST_F(RtpDepacketizerTest, DropsAUnitWithALostPacket)
+{
+    push(1, 3000, false, {0x7c, 0x81, 1});
+    push(3, 3000, true, {0x7c, 0x41, 3});
+    push(4, 6000, true, {0x41, 7});
+    auto out = units();
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(out[0], (std::vector<uint8_t>{0, 0, 0, 1, 0x41, 7}));
+    EXPECT_EQ(depacketizer_.lostPackets(), 1u);
+    EXPECT_EQ(depacketizer_.droppedUnits(), 1u);
+}
+
+}  // namespace
+}  // namespace obsbot_ros
@@ -0,0 +1,317 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <obsbot_ros/rtsp_client.hpp>
+
+namespace obsbot_ros
+{
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief  Stands in for the camera on the loopback: one connection, DESCRIBE / SETUP / PLAY answered for an h264
+ *         stream, then the scripted rtp packets interleaved on channel 0. It keeps reading until the client hangs up
+ *         and notes every method it saw.
+ */
+class LoopbackServer
+{
+public:
+    /// interleaved: sent after the PLAY reply, in front of the packets
+    explicit LoopbackServer(std::vector<std::vector<uint8_t>> packets, bool silent = false,
+                            std::string interleaved = "") :
+        packets_(std::move(packets)), silent_(silent), interleaved_(std::move(interleaved))
+    {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+        listen(listen_fd_, 1);
+        getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&addr), &len);
+        port_ = ntohs(addr.sin_port);
+        thread_ = std::thread(&LoopbackServer::run, this);
+    }
+
+    ~LoopbackServer()
+    {
+        done_ = true;
+        thread_.join();
+        close(listen_fd_);
+    }
+
+    std::string url() const
+    { return "rtsp://127.0.0.1:" + std::to_string(port_) + "/live"; }
+
+    std::vector<std::string> methods()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return methods_;
+    }
+
+private:
+    void run()
+    {
+        pollfd pfd{listen_fd_, POLLIN, 0};
+        while (!done_ && poll(&pfd, 1, 50) <= 0)
+        {}
+        if (done_)
+        { return; }
+        int fd = accept(listen_fd_, nullptr, nullptr);
+        std::string rx;
+        char buf[4096];
+        while (!done_)
+        {
+            pollfd cfd{fd, POLLIN, 0};
+            if (poll(&cfd, 1, 50) <= 0)
+            { continue; }
+            auto n = recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0)
+            { break; }
+            rx.append(buf, static_cast<size_t>(n));
+            size_t end;
+            while ((end = rx.find("\r\n\r\n")) != std::string::npos)
+            {
+                auto message = rx.substr(0, end + 4);
+                rx.erase(0, end + 4);
+                answer(fd, message);
+            }
+        }
+        close(fd);
+    }
+
+    void answer(int fd, const std::string &message)
+    {
+        auto method = message.substr(0, message.find(' '));
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            methods_.push_back(method);
+        }
+        if (silent_)
+        { return; }
+
+        auto cseq_pos = message.find("CSeq: ") + 6;
+        auto cseq = message.substr(cseq_pos, message.find("\r\n", cseq_pos) - cseq_pos);
+        std::string reply = "RTSP/1.0 200 OK\r\nCSeq: " + cseq + "\r\n";
+        if (method == "DESCRIBE")
+        {
+            std::string sdp = "v=0\r\no=- 0 0 IN IP4 127.0.0.1\r\ns=live\r\nt=0 0\r\n"
+                              "m=video 0 RTP/AVP 96\r\na=rtpmap:96 H264/90000\r\n"
+                              "a=fmtp:96 packetization-mode=1;sprop-parameter-sets=Z0I=,aM4=\r\n"
+                              "a=control:track1\r\n";
+            reply += "Content-Base: " + url() + "/\r\nContent-Type: application/sdp\r\nContent-Length: " +
+                     std::to_string(sdp.size()) + "\r\n\r\n" + sdp;
+        }
+        else if (method == "SETUP")
+        {
+            reply += "Session: 1234;timeout=60\r\nTransport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n\r\n";
+        }
+        else
+        {
+            reply += "Session: 1234\r\n\r\n";
+        }
+        send(fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+
+        if (method == "PLAY")
+        {
+            send(fd, interleaved_.data(), interleaved_.size(), MSG_NOSIGNAL);
+            for (const auto &packet : packets_)
+            {
+                uint8_t header[4] = {'$', 0, static_cast<uint8_t>(packet.size() >> 8),
+                                     static_cast<uint8_t>(packet.size())};
+                send(fd, header, sizeof(header), MSG_NOSIGNAL);
+                send(fd, packet.data(), packet.size(), MSG_NOSIGNAL);
+            }
+        }
+    }
+
+    std::vector<std::vector<uint8_t>> packets_;
+    bool silent_;
+    std::string interleaved_;
+    int listen_fd_ = -1;
+    uint16_t port_ = 0;
+    std::atomic<bool> done_{false};
+    std::thread thread_;
+    std::mutex mutex_;
+    std::vector<std::string> methods_;
+};
+
+std::vector<uint8_t> rtpPacket(uint16_t sequence, uint32_t timestamp, bool marker, const std::vector<uint8_t> &payload)
+{
+    std::vector<uint8_t> packet = {0x80, static_cast<uint8_t>((marker ? 0x80 : 0) | 96),
+                                   static_cast<uint8_t>(sequence >> 8), static_cast<uint8_t>(sequence),
+                                   static_cast<uint8_t>(timestamp >> 24), static_cast<uint8_t>(timestamp >> 16),
+                                   static_cast<uint8_t>(timestamp >> 8), static_cast<uint8_t>(timestamp),
+                                   0, 0, 0, 1};
+    packet.insert(packet.end(), payload.begin(), payload.end());
+    return packet;
+}
+
+/// collects the access units from the receive thread
+class Receiver
+{
+public:
+    RtspClient::AccessUnitCallback callback()
+    {
+        return [this](const AccessUnit &au, RtpDepacketizer::Codec, int64_t)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            units_.emplace_back(au.data, au.data + au.size);
+            keyframes_.push_back(au.keyframe);
+            cv_.notify_all();
+        };
+    }
+
+    bool waitFor(size_t count)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return cv_.wait_for(lock, std::chrono::seconds(3), [this, count]()
+                            { return units_.size() >= count; });
+    }
+
+    std::vector<std::vector<uint8_t>> units()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return units_;
+    }
+
+    std::vector<bool> keyframes()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return keyframes_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::vector<uint8_t>> units_;
+    std::vector<bool> keyframes_;
+};
+
+TEST(RtspClientTest, ParsesUrls)
+{
+    std::string host;
+    uint16_t port = 0;
+    ASSERT_TRUE(RtspClient::parseUrl("rtsp://192.168.1.20:8554/live", host, port));
+    EXPECT_EQ(host, "192.168.1.20");
+    EXPECT_EQ(port, 8554);
+    ASSERT_TRUE(RtspClient::parseUrl("rtsp://user@camera.local", host, port));
+    EXPECT_EQ(host, "camera.local");
+    EXPECT_EQ(port, 554);
+    ASSERT_TRUE(RtspClient::parseUrl("rtsp://[fe80::1%25eth0]:8554/live", host, port));
+    EXPECT_EQ(host, "fe80::1%25eth0");
+    EXPECT_EQ(port, 8554);
+    ASSERT_TRUE(RtspClient::parseUrl("rtsp://[::1]/live", host, port));
+    EXPECT_EQ(host, "::1");
+    EXPECT_EQ(port, 554);
+    ASSERT_TRUE(RtspClient::parseUrl("rtsp://fd00::20/live", host, port));
+    EXPECT_EQ(host, "fd00::20");
+    EXPECT_EQ(port, 554);
+
+    EXPECT_FALSE(RtspClient::parseUrl("http://camera/live", host, port));
+    EXPECT_FALSE(RtspClient::parseUrl("rtsp://[::1/live", host, port));
+    EXPECT_FALSE(RtspClient::parseUrl("rtsp://[::1]x/live", host, port));
+    EXPECT_FALSE(RtspClient::parseUrl("rtsp://camera:70000/live", host, port));
+    EXPECT_FALSE(RtspClient::parseUrl("rtsp://:8554/live", host, port));
+}
+
+class RtspLoopbackTest : public ::testing::TestWithParam<bool>
+{};
+
+TEST_P(RtspLoopbackTest, ReceivesAccessUnitsAndTearsDownOnStop)
+{
+    /// an idr slice in three fragments, the second and third swapped on the wire, then a single slice
+    std::vector<std::vector<uint8_t>> packets = {
+        rtpPacket(1, 3000, false, {0x7c, 0x85, 1, 2}),
+        rtpPacket(3, 3000, true, {0x7c, 0x45, 4}),
+        rtpPacket(2, 3000, false, {0x7c, 0x05, 3}),
+        rtpPacket(4, 6000, true, {0x41, 9}),
+    };
+    bool jitter_buffer = GetParam();
+    if (!jitter_buffer)
+    { std::swap(packets[1], packets[2]); }
+    LoopbackServer server(packets);
+
+    Receiver receiver;
+    RtspClient client;
+    RtspClient::Options options;
+    options.url = server.url();
+    options.jitter_buffer = jitter_buffer;
+    ASSERT_TRUE(client.start(options, receiver.callback()));
+    ASSERT_TRUE(receiver.waitFor(2)) << client.lastError();
+
+    auto units = receiver.units();
+    EXPECT_EQ(units[0], (std::vector<uint8_t>{0, 0, 0, 1, 0x67, 0x42, 0, 0, 0, 1, 0x68, 0xce,
+                                              0, 0, 0, 1, 0x65, 1, 2, 3, 4}));
+    EXPECT_EQ(units[1], (std::vector<uint8_t>{0, 0, 0, 1, 0x41, 9}));
+    EXPECT_TRUE(receiver.keyframes()[0]);
+    EXPECT_FALSE(receiver.keyframes()[1]);
+    auto stats = client.stats();
+    EXPECT_TRUE(stats.connected);
+    EXPECT_EQ(stats.packets, 4u);
+    EXPECT_EQ(stats.lost, 0u);
+
+    client.stop();
+    EXPECT_FALSE(client.isRunning());
+    auto until = Clock::now() + std::chrono::seconds(1);
+    while (server.methods().back() != "TEARDOWN" && Clock::now() < until)
+    { std::this_thread::sleep_for(std::chrono::milliseconds(10)); }
+    EXPECT_EQ(server.methods(), (std::vector<std::string>{"DESCRIBE", "SETUP", "PLAY", "TEARDOWN"}));
+    EXPECT_EQ(client.lastError(), "");
+}
+
+INSTANTIATE_TEST_SUITE_P(JitterBuffer, RtspLoopbackTest, ::testing::Bool());
+
+TEST(RtspClientTest, ResyncsAfterAReplyWithAnImpossibleBody)
+{
+    /// a keepalive reply claiming a body far beyond any rtsp message, the packets right behind it must get through
+    LoopbackServer server({rtpPacket(1, 3000, true, {0x41, 1}), rtpPacket(2, 6000, true, {0x41, 2})}, false,
+                          "RTSP/1.0 200 OK\r\nCSeq: 9\r\nContent-Length: 99999999999\r\n\r\n");
+    Receiver receiver;
+    RtspClient client;
+    RtspClient::Options options;
+    options.url = server.url();
+    ASSERT_TRUE(client.start(options, receiver.callback()));
+    ASSERT_TRUE(receiver.waitFor(2)) << client.lastError();
+    EXPECT_EQ(receiver.units()[1], (std::vector<uint8_t>{0, 0, 0, 1, 0x41, 2}));
+    client.stop();
+}
+
+TEST(RtspClientTest, StopsPromptlyWhileARequestIsPending)
+{
+    LoopbackServer server({}, true);
+    Receiver receiver;
+    RtspClient client;
+    RtspClient::Options options;
+    options.url = server.url();
+    options.timeout_ms = 10000;
+    ASSERT_TRUE(client.start(options, receiver.callback()));
+    auto until = Clock::now() + std::chrono::seconds(3);
+    while (server.methods().empty() && Clock::now() < until)
+    { std::this_thread::sleep_for(std::chrono::milliseconds(10)); }
+
+    auto begin = Clock::now();
+    client.stop();
+    EXPECT_LT(Clock::now() - begin, std::chrono::milliseconds(500));
+    EXPECT_EQ(client.lastError(), "");
+}
+
+}  // namespace
+}  // namespace obsbot_ros
@@ -0,0 +1,239 @@
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <obsbot_ros/stream_adapter.hpp>
+
+namespace obsbot_ros
+{
+namespace
+{
+
+constexpr int64_t kSecond = 1000000000;
+
+/// one update interval of a scripted link
+struct Step
+{
+    double loss = 0.0;
+    double delay_ms = 20.0;
+    double jitter_ms = 2.0;
+    uint64_t packets = 500;                     /// received in the interval, 0 is a stall
+};
+
+const Step kGood{};
+const Step kLossy{0.05, 20.0, 2.0, 500};
+const Step kSlow{0.0, 400.0, 2.0, 500};
+const Step kJittery{0.0, 20.0, 50.0, 500};
+const Step kStalled{0.0, 20.0, 2.0, 0};
+const Step kMiddling{0.01, 150.0, 20.0, 500};   /// between the low and the high marks
+
+/**
+ * @brief  Feeds the adapter client counters built from a trace, one sample a second, and notes the rung after every
+ *         sample. Starts well past the settle time of the initial rung.
+ */
+class TraceRunner
+{
+public:
+    explicit TraceRunner(StreamAdapter &adapter) : adapter_(adapter)
+    {
+        stats_.connected = true;
+        adapter_.update(stats_, now_ns_);
+    }
+
+    std::vector<size_t> run(const Step &step, size_t samples)
+    {
+        std::vector<size_t> rungs;
+        for (size_t i = 0; i < samples; ++i)
+        {
+            now_ns_ += kSecond;
+            auto lost = static_cast<uint64_t>(step.loss * static_cast<double>(step.packets) / (1.0 - step.loss));
+            stats_.packets += step.packets;
+            stats_.bytes += step.packets * 1200;
+            stats_.lost += lost;
+            stats_.delay_ms = step.delay_ms;
+            stats_.jitter_ms = step.jitter_ms;
+            if (adapter_.update(stats_, now_ns_))
+            { ++changes_; }
+            rungs.push_back(adapter_.rung());
+        }
+        return rungs;
+    }
+
+    /// the client restarted, its counters with it
+    void restart(bool connected)
+    {
+        stats_ = RtspClient::Stats();
+        stats_.connected = connected;
+    }
+
+    /// the samples within the settle time after a change, they must not change the rung
+    void settle(const Step &step)
+    {
+        auto rung = adapter_.rung();
+        EXPECT_EQ(run(step, 2), std::vector<size_t>(2, rung));
+    }
+
+    size_t changes() const
+    { return changes_; }
+
+private:
+    StreamAdapter &adapter_;
+    RtspClient::Stats stats_;
+    int64_t now_ns_ = 100 * kSecond;
+    size_t changes_ = 0;
+};
+
+StreamAdapter::Options testOptions()
+{
+    StreamAdapter::Options options;
+    options.degrade_after = 2;
+    options.upgrade_after = 5;
+    options.max_backoff = 4;
+    options.settle_ns = 3 * kSecond;
+    return options;
+}
+
+std::vector<StreamAdapter::Rung> fourRungs()
+{
+    return std::vector<StreamAdapter::Rung>(4);
+}
+
+TEST(StreamAdapterTest, DefaultLadderStepsBitrateThenCodecThenResolution)
+{
+    auto ladder = StreamAdapter::defaultLadder(Device::DevVideoRes4KP30, Device::DevVideoEncoderH264, true);
+    ASSERT_EQ(ladder.size(), 8u);
+    EXPECT_EQ(ladder[0].resolution, Device::DevVideoRes4KP30);
+    EXPECT_EQ(ladder[0].bitrate, Device::DevVideoBitLevelHigh);
+    EXPECT_EQ(ladder[2].bitrate, Device::DevVideoBitLevelLow);
+    EXPECT_EQ(ladder[2].encoder, Device::DevVideoEncoderH264);
+    EXPECT_EQ(ladder[3].encoder, Device::DevVideoEncoderH265);
+    EXPECT_EQ(ladder[4].resolution, Device::DevVideoRes1080P30);
+    EXPECT_EQ(ladder[4].bitrate, Device::DevVideoBitLevelMedium);
+    EXPECT_EQ(ladder[7].resolution, Device::DevVideoRes720P30);
+    EXPECT_EQ(ladder[7].bitrate, Device::DevVideoBitLevelLow);
+
+    EXPECT_EQ(StreamAdapter::defaultLadder(Device::DevVideoRes720P30, Device::DevVideoEncoderH265, true).size(), 3u);
+}
+
+TEST(StreamAdapterTest, StepsDownOneRungPerBadRunAfterTheSettleTime)
+{
+    StreamAdapter adapter(fourRungs(), testOptions());
+    TraceRunner trace(adapter);
+
+    /// two bad samples step down, the next two are ignored while the change settles
+    EXPECT_EQ(trace.run(kLossy, 7), (std::vector<size_t>{0, 1, 1, 1, 1, 2, 2}));
+    EXPECT_EQ(trace.run(kSlow, 5), (std::vector<size_t>{2, 2, 3, 3, 3}));
+    /// the bottom rung holds however bad the link gets
+    EXPECT_EQ(trace.run(kStalled, 10), std::vector<size_t>(10, 3));
+    EXPECT_EQ(trace.changes(), 3u);
+}
+
+TEST(StreamAdapterTest, EveryHighMarkCountsAsBad)
+{
+    for (const auto &step : {kLossy, kSlow, kJittery, kStalled})
+    {
+        StreamAdapter adapter(fourRungs(), testOptions());
+        TraceRunner trace(adapter);
+        EXPECT_EQ(trace.run(step, 2).back(), 1u);
+    }
+}
+
+TEST(StreamAdapterTest, HoldsBetweenTheMarks)
+{
+    StreamAdapter adapter(fourRungs(), testOptions());
+    TraceRunner trace(adapter);
+    trace.run(kLossy, 2);
+    ASSERT_EQ(adapter.rung(), 1u);
+
+    /// neither bad enough to step down nor good enough to probe up
+    EXPECT_EQ(trace.run(kMiddling, 60), std::vector<size_t>(60, 1));
+
+    /// a middling sample breaks a run of good ones, and a run of bad ones
+    for (int i = 0; i < 10; ++i)
+    {
+        trace.run(kGood, 4);
+        trace.run(kMiddling, 1);
+        trace.run(kLossy, 1);
+        trace.run(kMiddling, 1);
+    }
+    EXPECT_EQ(adapter.rung(), 1u);
+    EXPECT_EQ(trace.changes(), 1u);
+}
+
+TEST(StreamAdapterTest, RecoversWithBackoffAfterAFailedProbe)
+{
+    StreamAdapter adapter(fourRungs(), testOptions());
+    TraceRunner trace(adapter);
+    trace.run(kLossy, 2);
+    trace.settle(kLossy);
+    trace.run(kLossy, 2);
+    ASSERT_EQ(adapter.rung(), 2u);
+
+    /// upgrade_after good samples probe one rung up
+    trace.settle(kGood);
+    auto rungs = trace.run(kGood, 5);
+    EXPECT_EQ(rungs[3], 2u);
+    EXPECT_EQ(rungs[4], 1u);
+
+    /// the probe fails at once: back down, the next probe waits twice as long
+    trace.settle(kLossy);
+    trace.run(kLossy, 2);
+    ASSERT_EQ(adapter.rung(), 2u);
+    trace.settle(kGood);
+    rungs = trace.run(kGood, 10);
+    EXPECT_EQ(rungs[8], 2u);
+    EXPECT_EQ(rungs[9], 1u);
+
+    /// this probe holds, the backoff is cleared and the next rung comes at the normal pace
+    trace.settle(kGood);
+    rungs = trace.run(kGood, 5);
+    EXPECT_EQ(rungs[3], 1u);
+    EXPECT_EQ(rungs[4], 0u);
+    EXPECT_EQ(trace.changes(), 6u);
+}
+
+TEST(StreamAdapterTest, BackoffStopsAtItsLimit)
+{
+    StreamAdapter adapter(fourRungs(), testOptions());
+    TraceRunner trace(adapter);
+    trace.run(kLossy, 2);
+    trace.settle(kLossy);
+    trace.run(kLossy, 2);
+    ASSERT_EQ(adapter.rung(), 2u);
+
+    /// every probe fails; the wait doubles up to max_backoff times upgrade_after
+    for (size_t wait : {5u, 10u, 20u, 20u, 20u})
+    {
+        trace.settle(kGood);
+        auto rungs = trace.run(kGood, wait);
+        EXPECT_EQ(rungs[wait - 2], 2u) << wait;
+        EXPECT_EQ(rungs[wait - 1], 1u) << wait;
+        trace.settle(kLossy);
+        trace.run(kLossy, 2);
+        ASSERT_EQ(adapter.rung(), 2u);
+    }
+}
+
+TEST(StreamAdapterTest, IgnoresRestartsDisconnectsAndMeasureOnly)
+{
+    StreamAdapter adapter(fourRungs(), testOptions());
+    TraceRunner trace(adapter);
+
+    /// restarted counters are taken as the new base, not as a drop in traffic
+    trace.restart(true);
+    EXPECT_EQ(trace.run(kGood, 1), std::vector<size_t>(1, 0));
+    trace.restart(false);
+    EXPECT_EQ(trace.run(kStalled, 10), std::vector<size_t>(10, 0));
+
+    auto options = testOptions();
+    options.adapt = false;
+    StreamAdapter measuring(fourRungs(), options);
+    TraceRunner measured(measuring);
+    EXPECT_EQ(measured.run(kLossy, 10), std::vector<size_t>(10, 0));
+    EXPECT_NEAR(measuring.sample().loss, 0.05, 0.001);
+    EXPECT_NEAR(measuring.sample().rx_kbps, 500 * 1200 * 8 / 1000.0, 1e-6);
+}
+
+}  // namespace
+}  // namespace obsbot_ros
@@ -0,0 +1,233 @@
+#include <cstdint>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <obsbot_ros/thermal_governor.hpp>
+
+namespace obsbot_ros
+{
+namespace
+{
+
+constexpr int64_t kS = 1000000000;
+
+/// the full capture and three lighter rungs, the last two without ai
+ThermalGovernor::Options options()
+{
+    ThermalGovernor::Options options;
+    options.ladder.emplace_back();
+    for (const char *text : {"1920x1080@30 medium ai", "1280x720@30 low noai", "640x360@15 low noai"})
+    {
+        ThermalGovernor::Rung rung;
+        EXPECT_TRUE(ThermalGovernor::parse(text, rung)) << text;
+        options.ladder.push_back(rung);
+    }
+    options.settle_ns = 20 * kS;
+    options.warning_hold_ns = 60 * kS;
+    options.recover_ns = 300 * kS;
+    options.battery_steps = {30, 15};
+    options.effect_ns = 100 * kS;
+    return options;
+}
+
+ThermalGovernor::Reading reading(int32_t lens, int32_t cpu, int32_t capacity = -1, bool charging = false)
+{
+    ThermalGovernor::Reading out;
+    out.lens_temp = lens;
+    out.cpu_temp = cpu;
+    out.capacity = capacity;
+    out.charging = charging;
+    return out;
+}
+
+TEST(ThermalGovernorTest, ParsesAndFormatsRungs)
+{
+    ThermalGovernor::Rung rung;
+    ASSERT_TRUE(ThermalGovernor::parse("1280x720@25 high noai", rung));
+    EXPECT_EQ(rung.width, 1280);
+    EXPECT_EQ(rung.height, 720);
+    EXPECT_EQ(rung.fps, 25);
+    EXPECT_EQ(rung.bitrate, Device::DevVideoBitLevelHigh);
+    EXPECT_FALSE(rung.ai);
+    EXPECT_EQ(ThermalGovernor::format(rung), "1280x720@25 high noai");
+    EXPECT_EQ(ThermalGovernor::format(ThermalGovernor::Rung()), "configured default ai");
+
+    for (const char *text : {"", "1280x720@25 high", "1280x720 high ai", "1280y720@25 high ai", "0x720@25 high ai",
+                             "1280x720@25 huge ai", "1280x720@25 high maybe"})
+    { EXPECT_FALSE(ThermalGovernor::parse(text, rung)) << '"' << text << '"'; }
+}
+
+TEST(ThermalGovernorTest, ErrorStepsDownAtOnceAndOncePerSettleTime)
+{
+    ThermalGovernor governor(options());
+    governor.reset(0);
+    EXPECT_FALSE(governor.update(reading(0, 0), 10 * kS));
+
+    ASSERT_TRUE(governor.update(reading(0, 2), 20 * kS));
+    EXPECT_EQ(governor.rung(), 1u);
+    EXPECT_EQ(governor.decision().from, 0u);
+    EXPECT_EQ(governor.decision().to, 1u);
+    EXPECT_EQ(governor.decision().reason, "cpu temperature error");
+
+    EXPECT_FALSE(governor.update(reading(0, 2), 39 * kS));
+    ASSERT_TRUE(governor.update(reading(2, 2), 40 * kS));
+    EXPECT_EQ(governor.rung(), 2u);
+    EXPECT_EQ(governor.decision().reason, "lens temperature error");
+    ASSERT_TRUE(governor.update(reading(2, 0), 60 * kS));
+    EXPECT_EQ(governor.rung(), 3u);
+    /// the lightest rung is the floor
+    EXPECT_FALSE(governor.update(reading(2, 0), 80 * kS));
+    EXPECT_EQ(governor.rung(), 3u);
+    EXPECT_EQ(governor.stats().steps_down, 3u);
+}
+
+TEST(ThermalGovernorTest, WarningStepsDownOnceItHasLasted)
+{
+    ThermalGovernor governor(options());
+    governor.reset(0);
+    EXPECT_FALSE(governor.update(reading(1, 0), 100 * kS));
+    EXPECT_FALSE(governor.update(reading(1, 0), 159 * kS));
+    ASSERT_TRUE(governor.update(reading(1, 0), 160 * kS));
+    EXPECT_EQ(governor.rung(), 1u);
+    EXPECT_EQ(governor.decision().reason, "lens temperature warning for 60 s");
+
+    /// the next step needs another full hold from the last one
+    EXPECT_FALSE(governor.update(reading(1, 0), 219 * kS));
+    EXPECT_TRUE(governor.update(reading(1, 0), 220 * kS));
+    EXPECT_EQ(governor.rung(), 2u);
+
+    /// a normal reading in between starts the warning over
+    EXPECT_FALSE(governor.update(reading(0, 0), 230 * kS));
+    EXPECT_FALSE(governor.update(reading(0, 1), 240 * kS));
+    EXPECT_FALSE(governor.update(reading(0, 1), 299 * kS));
+    EXPECT_TRUE(governor.update(reading(0, 1), 300 * kS));
+    EXPECT_EQ(governor.rung(), 3u);
+}
+
+TEST(ThermalGovernorTest, StepsBackUpOneRungPerRunOfNormalReadings)
+{
+    ThermalGovernor governor(options());
+    governor.reset(0);
+    ASSERT_TRUE(governor.update(reading(2, 0), 0));
+    ASSERT_TRUE(governor.update(reading(2, 0), 20 * kS));
+    ASSERT_EQ(governor.rung(), 2u);
+
+    /// hysteresis: normal readings cut short by a warning do not count
+    EXPECT_FALSE(governor.update(reading(0, 0), 30 * kS));
+    EXPECT_FALSE(governor.update(reading(0, 0), 320 * kS));
+    EXPECT_FALSE(governor.update(reading(1, 0), 325 * kS));
+    EXPECT_FALSE(governor.update(reading(0, 0), 330 * kS));
+    EXPECT_FALSE(governor.update(reading(0, 0), 629 * kS));
+    ASSERT_TRUE(governor.update(reading(0, 0), 630 * kS));
+    EXPECT_EQ(governor.rung(), 1u);
+    EXPECT_EQ(governor.decision().reason, "temperature normal for 300 s");
+
+    /// the next rung up needs another run from the last step
+    EXPECT_FALSE(governor.update(reading(0, 0), 929 * kS));
+    ASSERT_TRUE(governor.update(reading(0, 0), 930 * kS));
+    EXPECT_EQ(governor.rung(), 0u);
+    EXPECT_EQ(governor.stats().steps_up, 2u);
+    EXPECT_FALSE(governor.update(reading(0, 0), 2000 * kS));
+}
+
+TEST(ThermalGovernorTest, BatteryPutsAFloorUnderTheRungUntilItCharges)
+{
+    ThermalGovernor governor(options());
+    governor.reset(0);
+    EXPECT_FALSE(governor.update(reading(0, 0, 40), 10 * kS));
+    ASSERT_TRUE(governor.update(reading(0, 0, 30), 20 * kS));
+    EXPECT_EQ(governor.rung(), 1u);
+    EXPECT_EQ(governor.decision().reason, "battery 30 %");
+    ASSERT_TRUE(governor.update(reading(0, 0, 15), 30 * kS));
+    EXPECT_EQ(governor.rung(), 2u);
+
+    /// the floor does not drop on a higher reading while discharging, only when charging
+    EXPECT_FALSE(governor.update(reading(0, 0, 40), 40 * kS));
+    ASSERT_TRUE(governor.update(reading(0, 0, 15, true), 50 * kS));
+    EXPECT_EQ(governor.rung(), 0u);
+    EXPECT_EQ(governor.decision().reason, "charging");
+
+    /// the device event takes the lowest rung, whatever the capacity
+    governor.onBatteryLow();
+    ASSERT_TRUE(governor.update(reading(0, 0, 80), 60 * kS));
+    EXPECT_EQ(governor.rung(), 3u);
+    EXPECT_EQ(governor.decision().reason, "device reported low battery");
+    EXPECT_EQ(governor.stats().battery_events, 1u);
+}
+
+TEST(ThermalGovernorTest, TempEventCountsAsAnErrorReading)
+{
+    ThermalGovernor governor(options());
+    governor.reset(0);
+    governor.onTempHigh();
+    ASSERT_TRUE(governor.update(reading(0, 0), 10 * kS));
+    EXPECT_EQ(governor.rung(), 1u);
+    EXPECT_EQ(governor.decision().reason, "device temperature error");
+    EXPECT_EQ(governor.stats().temp_events, 1u);
+    /// one event, one error reading
+    EXPECT_FALSE(governor.update(reading(0, 0), 40 * kS));
+}
+
+TEST(ThermalGovernorTest, MeasuresTheEffectOfEveryDecision)
+{
+    ThermalGovernor governor(options());
+    governor.reset(0);
+    ThermalGovernor::Effect effect;
+    EXPECT_FALSE(governor.update(reading(0, 0, 90), 0));
+    EXPECT_FALSE(governor.update(reading(0, 0, 80), 100 * kS));
+    ASSERT_TRUE(governor.update(reading(0, 2, 70), 200 * kS));
+    EXPECT_NEAR(governor.decision().drain_pct_h, 360.0, 1e-9);
+    EXPECT_FALSE(governor.effect(250 * kS, effect));
+
+    EXPECT_FALSE(governor.update(reading(0, 0, 69), 250 * kS));
+    EXPECT_FALSE(governor.update(reading(0, 0, 68), 300 * kS));
+    ASSERT_TRUE(governor.effect(300 * kS, effect));
+    EXPECT_EQ(effect.decision.to, 1u);
+    EXPECT_EQ(effect.after_ns, 100 * kS);
+    EXPECT_EQ(effect.reading.cpu_temp, 0);
+    EXPECT_NEAR(effect.drain_pct_h, 72.0, 1e-9);
+    /// once per decision
+    EXPECT_FALSE(governor.effect(400 * kS, effect));
+
+    /// a decision cut short by the next one is measured up to it
+    ASSERT_TRUE(governor.update(reading(0, 2, 68), 310 * kS));
+    ASSERT_TRUE(governor.update(reading(0, 2, 68), 330 * kS));
+    ASSERT_TRUE(governor.effect(330 * kS, effect));
+    EXPECT_EQ(effect.decision.to, 2u);
+    EXPECT_EQ(effect.after_ns, 20 * kS);
+}
+
+TEST(ThermalGovernorTest, RestoresTheAiOnlyIfItTrackedBefore)
+{
+    ThermalGovernor governor(options());
+    governor.reset(0);
+    /// rungs that keep the ai change nothing
+    EXPECT_FALSE(governor.switchAi(true, true));
+
+    /// tracking when throttling began, off and on again
+    EXPECT_TRUE(governor.switchAi(false, true));
+    EXPECT_FALSE(governor.switchAi(false, false));
+    EXPECT_TRUE(governor.switchAi(true, false));
+
+    /// not tracking, turned off all the same but left off when the rung allows it again
+    EXPECT_TRUE(governor.switchAi(false, false));
+    EXPECT_FALSE(governor.switchAi(true, true));
+    EXPECT_FALSE(governor.switchAi(true, true));
+    EXPECT_TRUE(governor.switchAi(false, true));
+    EXPECT_TRUE(governor.switchAi(true, false));
+
+    /// the ladder drives it: down to a rung without ai and back to the top
+    ASSERT_TRUE(governor.update(reading(2, 0), 10 * kS));
+    EXPECT_FALSE(governor.switchAi(governor.current().ai, true));
+    ASSERT_TRUE(governor.update(reading(2, 0), 30 * kS));
+    EXPECT_TRUE(governor.switchAi(governor.current().ai, true));
+    EXPECT_FALSE(governor.current().ai);
+    EXPECT_FALSE(governor.update(reading(0, 0), 40 * kS));
+    ASSERT_TRUE(governor.update(reading(0, 0), 340 * kS));
+    EXPECT_TRUE(governor.switchAi(governor.current().ai, false));
+    EXPECT_TRUE(governor.current().ai);
+}
+
+}  // namespace
+}  // namespace obsbot_ros
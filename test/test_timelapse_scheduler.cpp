@@ -0,0 +1,137 @@
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include <obsbot_ros/timelapse_scheduler.hpp>
+
+namespace obsbot_ros
+{
+namespace
+{
+
+constexpr int64_t kMs = 1000000;
+constexpr int64_t kS = 1000 * kMs;
+
+TimelapseScheduler::Options options()
+{
+    TimelapseScheduler::Options options;
+    options.interval_ns = 10 * kS;
+    options.initial_latency_ns = 3 * kS;
+    options.margin_ns = 200 * kMs;
+    options.timeout_ns = 5 * kS;
+    options.history = 3;
+    return options;
+}
+
+/// one wake, a first frame after latency_ns, then frames every 33 ms up to the shot, and back to sleep
+int64_t cycle(TimelapseScheduler &scheduler, int64_t latency_ns)
+{
+    int64_t wake = scheduler.wakeAt();
+    scheduler.onWake(wake);
+    int64_t frame = wake + latency_ns;
+    while (!scheduler.onFrame(frame))
+    { frame += 33 * kMs; }
+    scheduler.onSleep(frame + 10 * kMs);
+    return frame;
+}
+
+TEST(TimelapseSchedulerTest, PlansTheFirstShotBehindTheInitialLatency)
+{
+    TimelapseScheduler scheduler(options());
+    scheduler.start(100 * kS);
+    EXPECT_EQ(scheduler.phase(), TimelapseScheduler::Phase::Sleeping);
+    EXPECT_EQ(scheduler.shotAt(), 100 * kS + 3 * kS + 200 * kMs);
+    EXPECT_EQ(scheduler.wakeAt(), 100 * kS);
+    EXPECT_EQ(scheduler.latencyEstimate(), 3 * kS);
+    EXPECT_DOUBLE_EQ(scheduler.stats().estimate_ms, 3000.0);
+}
+
+TEST(TimelapseSchedulerTest, FramesBeforeTheShotOnlyMeasureTheLatency)
+{
+    TimelapseScheduler scheduler(options());
+    scheduler.start(0);
+    int64_t shot = scheduler.shotAt();
+
+    /// no wake yet, frames are not looked at
+    EXPECT_FALSE(scheduler.onFrame(shot));
+    EXPECT_EQ(scheduler.stats().shots, 0u);
+
+    scheduler.onWake(0);
+    EXPECT_EQ(scheduler.phase(), TimelapseScheduler::Phase::Waking);
+    EXPECT_EQ(scheduler.deadline(), 5 * kS);
+    EXPECT_FALSE(scheduler.onFrame(1200 * kMs));
+    EXPECT_FALSE(scheduler.onFrame(2500 * kMs));
+    EXPECT_DOUBLE_EQ(scheduler.stats().latency_ms, 1200.0);
+    EXPECT_EQ(scheduler.latencyEstimate(), 1200 * kMs);
+
+    EXPECT_TRUE(scheduler.onFrame(shot + 20 * kMs));
+    EXPECT_EQ(scheduler.phase(), TimelapseScheduler::Phase::Shot);
+    EXPECT_EQ(scheduler.stats().shots, 1u);
+    EXPECT_DOUBLE_EQ(scheduler.stats().late_ms, 20.0);
+    EXPECT_DOUBLE_EQ(scheduler.stats().streaming_ms, (shot + 20 * kMs) / 1e6);
+    /// a second frame of the same wake is not another shot
+    EXPECT_FALSE(scheduler.onFrame(shot + 53 * kMs));
+    EXPECT_EQ(scheduler.stats().shots, 1u);
+}
+
+TEST(TimelapseSchedulerTest, ShotsStayOnTheGridWhenTheyComeLate)
+{
+    TimelapseScheduler scheduler(options());
+    scheduler.start(0);
+    int64_t first = scheduler.shotAt();
+    for (int64_t i = 0; i < 20; ++i)
+    {
+        ASSERT_EQ(scheduler.shotAt(), first + i * 10 * kS) << "shot " << i;
+        int64_t frame = cycle(scheduler, 1500 * kMs);
+        /// every shot within a frame period of its slot, the lateness does not add up
+        EXPECT_GE(frame, first + i * 10 * kS);
+        EXPECT_LT(frame, first + i * 10 * kS + 33 * kMs);
+    }
+    EXPECT_EQ(scheduler.stats().shots, 20u);
+    EXPECT_EQ(scheduler.stats().missed, 0u);
+}
+
+TEST(TimelapseSchedulerTest, WakeLeadIsTheLongestOfTheRecentLatencies)
+{
+    TimelapseScheduler scheduler(options());
+    scheduler.start(0);
+    for (int64_t latency : {1000 * kMs, 2000 * kMs, 500 * kMs})
+    { cycle(scheduler, latency); }
+    EXPECT_EQ(scheduler.latencyEstimate(), 2000 * kMs);
+    EXPECT_EQ(scheduler.wakeAt(), scheduler.shotAt() - 2000 * kMs - 200 * kMs);
+    EXPECT_DOUBLE_EQ(scheduler.stats().max_latency_ms, 2000.0);
+
+    /// the slow wake leaves the history of 3 and the lead shrinks again
+    cycle(scheduler, 400 * kMs);
+    cycle(scheduler, 300 * kMs);
+    EXPECT_EQ(scheduler.latencyEstimate(), 500 * kMs);
+    cycle(scheduler, 300 * kMs);
+    EXPECT_EQ(scheduler.latencyEstimate(), 400 * kMs);
+    EXPECT_DOUBLE_EQ(scheduler.stats().estimate_ms, 400.0);
+    EXPECT_DOUBLE_EQ(scheduler.stats().latency_ms, 300.0);
+    EXPECT_DOUBLE_EQ(scheduler.stats().max_latency_ms, 2000.0);
+}
+
+TEST(TimelapseSchedulerTest, GivesUpAndSkipsTheSlotsItCanNoLongerReach)
+{
+    TimelapseScheduler scheduler(options());
+    scheduler.start(0);
+    int64_t first = scheduler.shotAt();
+
+    /// the wake never delivers a frame, given up at the deadline
+    scheduler.onWake(scheduler.wakeAt());
+    scheduler.onSleep(scheduler.deadline());
+    EXPECT_EQ(scheduler.stats().missed, 1u);
+    EXPECT_EQ(scheduler.shotAt(), first + 10 * kS);
+
+    /// asleep far too long, the slots in between are skipped but the grid is kept
+    scheduler.onWake(scheduler.wakeAt());
+    scheduler.onSleep(first + 45 * kS);
+    EXPECT_EQ(scheduler.stats().missed, 1u + 1u + 3u);
+    EXPECT_EQ(scheduler.shotAt(), first + 50 * kS);
+    EXPECT_GE(scheduler.wakeAt(), first + 45 * kS);
+    EXPECT_EQ(scheduler.stats().shots, 0u);
+}
+
+}  // namespace
+}  // namespace obsbot_ros